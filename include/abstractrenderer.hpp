@@ -12,6 +12,8 @@
 #include <glm/gtx/compatibility.hpp>
 #include "logger.hpp"
 #include <memory>
+#include <map>
+#include <deque>
 #include "imgui/imgui.h"
 
 struct ColourU8
@@ -151,9 +153,14 @@ public:
     {
         eRGB,
         eRGBA,
-        eA
+        eA,
+
+        // Single 8 bit channel that is sampled as is, i.e palette indices
+        eR
     };
 
+    static u32 BytesPerPixel(eTextureFormats format);
+
     enum eLayers
     {
         // Higher numbers render on top
@@ -213,11 +220,38 @@ public:
     virtual void SetVSync(bool on) = 0;
 
     virtual TextureHandle CreateTexture(eTextureFormats internalFormat, u32 width, u32 height, eTextureFormats inputFormat, const void *pixels, bool interpolation) = 0;
+    // Replaces all of the pixels of an existing texture, the size must match what it was created with.
+    // Use for textures that change often (i.e FMV frames) to avoid creating a new texture each time.
+    virtual void UpdateTexture(TextureHandle handle, u32 width, u32 height, eTextureFormats inputFormat, const void *pixels) = 0;
+    // Replaces rows y to y + rows - 1 of an existing texture, pixels points at the first of those rows
+    virtual void UpdateTextureRows(TextureHandle handle, u32 y, u32 width, u32 rows, eTextureFormats inputFormat, const void *pixels) = 0;
     void DestroyTexture(TextureHandle handle);
 
+    // For big textures that aren't needed this frame, i.e the cameras of neighbouring screens. The texture is
+    // created empty and EndFrame() copies the pixels in a few rows at a time, with no more than the staged upload
+    // budget spent per frame over all staged textures. pixelsOwner keeps pixels alive until the copy is done.
+    TextureHandle CreateTextureStaged(eTextureFormats internalFormat, u32 width, u32 height, eTextureFormats inputFormat, const void *pixels, std::shared_ptr<const void> pixelsOwner, bool interpolation);
+    bool IsStagedUploadDone(TextureHandle handle) const;
+    // Copies whatever is left of a staged texture right away, for when it turns out to be needed this frame
+    void FinishStagedUpload(TextureHandle handle);
+    void SetStagedUploadBudget(u32 bytesPerFrame) { mStagedUploadBudget = bytesPerFrame; }
+
+    // Textures that persist across frames and belong to another object, i.e the atlas pages of an AnimationSet keyed
+    // by page index. Once the owner has been destroyed its textures are freed at the end of the frame.
+    TextureHandle CachedTexture(const std::weak_ptr<const void>& owner, u32 key) const;
+    TextureHandle AddCachedTexture(const std::weak_ptr<const void>& owner, u32 key, eTextureFormats internalFormat, u32 width, u32 height, eTextureFormats inputFormat, const void *pixels, bool interpolation);
+
+    // Whether IndexedQuadUV() can be used, otherwise indexed images must be converted to RGBA first
+    virtual bool IndexedTexturesSupported() const { return false; }
+
     // Drawing commands, which will be buffered and issued at the end of the frame.
 
     void TexturedQuad(TextureHandle texHandle, f32 x, f32 y, f32 w, f32 h, int layer, ColourU8 colour, eBlendModes blendMode = eBlendModes::eNormal, eCoordinateSystem coordinateSystem = eCoordinateSystem::eWorld);
+    // Draws the u0,v0 - u1,v1 sub rect of the texture, i.e a single frame of an atlas
+    void TexturedQuadUV(TextureHandle texHandle, f32 u0, f32 v0, f32 u1, f32 v1, f32 x, f32 y, f32 w, f32 h, int layer, ColourU8 colour, eBlendModes blendMode = eBlendModes::eNormal, eCoordinateSystem coordinateSystem = eCoordinateSystem::eWorld);
+    // As TexturedQuadUV but texHandle is an eR texture of indices in to paletteHandle, an eRGBA texture 256 pixels wide and
+    // 1 high. Changing the palette doesn't need texHandle to be touched. An invalid paletteHandle is the same as TexturedQuadUV.
+    void IndexedQuadUV(TextureHandle texHandle, TextureHandle paletteHandle, f32 u0, f32 v0, f32 u1, f32 v1, f32 x, f32 y, f32 w, f32 h, int layer, ColourU8 colour, eBlendModes blendMode = eBlendModes::eNormal, eCoordinateSystem coordinateSystem = eCoordinateSystem::eWorld);
     void Rect(f32 x, f32 y, f32 w, f32 h, int layer, ColourU8 colour, eBlendModes blendMode = eBlendModes::eNormal, eCoordinateSystem coordinateSystem = eCoordinateSystem::eWorld);
     void Text(f32 x, f32 y, f32 fontSize, const char* text, ColourU8 colour, int layer, eBlendModes blendMode = eBlendModes::eNormal, eCoordinateSystem coordinateSystem = eCoordinateSystem::eWorld);
     void PathBegin();
@@ -235,6 +269,9 @@ protected:
         AbstractRenderer* mThisPtr;
         eCoordinateSystem mCoordinateSystem;
         eBlendModes mBlendMode;
+
+        // Set when the texture holds palette indices, see IndexedQuadUV()
+        TextureHandle mPalette;
     };
     virtual void OnSetRenderState(CmdState& info) = 0;
 private:
@@ -268,6 +305,11 @@ private:
         f32 mY;
         f32 mW;
         f32 mH;
+        f32 mU0;
+        f32 mV0;
+        f32 mU1;
+        f32 mV1;
+        u32 mBatchIndex;
     };
 
     struct CmdRect
@@ -326,9 +368,14 @@ private:
     };
 
     void EnsureCmdFreeSpace(u32 size);
+    // Shared by TexturedQuadUV() and IndexedQuadUV(), returns the command that was written
+    CmdTexturedQuad* AddTexturedQuadCmd(TextureHandle texHandle, f32 u0, f32 v0, f32 u1, f32 v1, f32 x, f32 y, f32 w, f32 h, int layer, ColourU8 colour, eBlendModes blendMode, eCoordinateSystem coordinateSystem);
     void generateImGuiCommands();
     static void RenderCallBack(const struct ImDrawList*, const ImDrawCmd* cmd);
-    void PushCallBack(eCoordinateSystem& lastCoordSystem, eBlendModes& lastBlendMode, CmdHeader& header, bool force = false);
+    static void SpriteBatchCallBack(const struct ImDrawList*, const ImDrawCmd* cmd);
+    static bool SameState(const CmdState& a, const CmdState& b);
+    void AddToSpriteBatch(CmdTexturedQuad& cmd, s32& openBatch, CmdState& lastState);
+    void PushCallBack(CmdState& lastState, CmdHeader& header, bool force = false);
     void PushTexture(ImTextureID& last, ImTextureID current);
 
     std::vector<u8> mDrawCommandBuffer;
@@ -339,7 +386,14 @@ private:
     // Rather than moving around lots of data to sort mDrawCommandBuffer
     // we just sort points to items in mDrawCommandBuffer instead and then iterate
     // this when generating GPU commands.
-    std::vector<u8*> mPointersToOrderedCommands;
+    struct SortedCmd
+    {
+        u64 mKey;
+        u8* mCmd;
+    };
+    std::vector<SortedCmd> mPointersToOrderedCommands;
+    std::vector<SortedCmd> mSortScratch;
+    static u64 SortKey(const CmdHeader& header, u32 submissionIndex);
 
     static int FontStashRenderCreate(void* uptr, int width, int height);
     static void FontStashRenderDelete(void* uptr);
@@ -357,8 +411,45 @@ private:
     void HandleTextCommand(f32 dx, f32 dy, f32 fontSize, const char* text, ColourU8* colour, f32* bounds);
 
     void AddUiCmd();
+
+    void DestroyExpiredCachedTextures(bool all);
+
+    struct StagedUpload
+    {
+        TextureHandle mTexture;
+        u32 mWidth;
+        u32 mHeight;
+        u32 mNextRow;
+        eTextureFormats mInputFormat;
+        const u8* mPixels;
+        std::shared_ptr<const void> mPixelsOwner;
+    };
+    void UploadStagedRows(StagedUpload& upload, u32 rows);
+    void UploadStagedTextures();
+
+    // Oldest first, so textures that were asked for first are usable first
+    std::deque<StagedUpload> mStagedUploads;
+    u32 mStagedUploadBudget = 512 * 1024;
+
+    using CachedTextureMap = std::map<u32, TextureHandle>;
+    std::map<std::weak_ptr<const void>, CachedTextureMap, std::owner_less<std::weak_ptr<const void>>> mCachedTextures;
 protected:
     virtual void DestroyTextures() = 0;
+
+    // Runs of textured quads that share a texture and render state, these are drawn directly by
+    // the renderer from mSpriteVertices rather than going through the ImGui draw list.
+    struct SpriteBatch
+    {
+        TextureHandle mTexture;
+        u32 mFirstQuad;
+        u32 mNumQuads;
+    };
+    virtual bool SpriteBatchingSupported() const { return false; }
+    virtual void RenderSpriteBatch(const SpriteBatch& /*batch*/) { }
+
+    // 4 vertices per quad
+    std::vector<ImDrawVert> mSpriteVertices;
+    std::vector<SpriteBatch> mSpriteBatches;
  
     std::vector<TextureHandle> mDestroyTextureList;
     bool mScreenSizeChanged = false;
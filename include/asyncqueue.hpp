@@ -6,8 +6,13 @@
 #include <map>
 #include <mutex>
 #include <deque>
+#include <array>
+#include <algorithm>
 #include <future>
+#include <thread>
+#include <condition_variable>
 #include "types.hpp"
+#include "workstealingdeque.hpp"
 #include <assert.h>
 #include "logger.hpp"
 
@@ -35,6 +40,84 @@ inline T* AsPointer(std::shared_ptr<T>& obj)
     return obj.get();
 }
 
+// Lets threads sleep until there is something to do without a wake up getting lost between
+// checking for work and going to sleep, and without notifiers taking a lock when nobody is waiting.
+// Waiters do PrepareWait(), check for work once more and then either CancelWait() or Wait().
+class EventCount
+{
+public:
+    u32 PrepareWait()
+    {
+        mWaiters.fetch_add(1, std::memory_order_seq_cst);
+        return mEpoch.load(std::memory_order_seq_cst);
+    }
+
+    void CancelWait()
+    {
+        mWaiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void Wait(u32 epoch)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            if (mEpoch.load(std::memory_order_relaxed) == epoch)
+            {
+                mSleeping++;
+                mWakeUp.wait(lock, [&]()
+                {
+                    return mEpoch.load(std::memory_order_relaxed) != epoch;
+                });
+            }
+        }
+        mWaiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    // Call after making the work visible
+    void Notify(bool all)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mWaiters.load(std::memory_order_seq_cst) == 0)
+        {
+            return;
+        }
+
+        u32 toWake = 0;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mEpoch.fetch_add(1, std::memory_order_seq_cst);
+
+            // Threads that have been woken but not scheduled yet still count as waiting, only
+            // signal the ones that are still asleep so that a burst of work is one wake up each
+            toWake = all ? mSleeping : std::min(mSleeping, 1u);
+            mSleeping -= toWake;
+        }
+
+        if (toWake > 1)
+        {
+            mWakeUp.notify_all();
+        }
+        else if (toWake == 1)
+        {
+            mWakeUp.notify_one();
+        }
+    }
+
+private:
+    std::atomic<u32> mEpoch{ 0 };
+    std::atomic<u32> mWaiters{ 0 };
+    std::mutex mMutex;
+    std::condition_variable mWakeUp;
+
+    // Guarded by mMutex
+    u32 mSleeping = 0;
+};
+
+// Work stealing pool. Each worker has a lock free deque per priority: items added by a worker (child
+// jobs) go to its own deque, the worker runs its newest item first and idle workers steal the oldest
+// items of the others. Items added from any other thread go to a shared injection queue. Workers
+// always take the highest priority item they can find, from their own deque, then the injection
+// queue, then by stealing. Idle workers sleep on an EventCount.
 template<class QueuedItemType>
 class ASyncQueue
 {
@@ -49,39 +132,81 @@ public:
     ~ASyncQueue()
     {
         Stop();
+
+        // Completed but never notified
+        DeleteList(mCompletedWork.exchange(nullptr));
     }
 
-    void Add(QueuedItemType item)
+    // Queued items are started in priority order (0 first). Items added from outside of the pool
+    // are FIFO within the same priority.
+    static const u32 kNumPriorities = 3;
+
+    void Add(QueuedItemType item, u32 priority = 0)
     {
-        if (!mQuit && !mStopWork)
+        assert(priority < kNumPriorities);
+        if (mQuit || mStopWork)
         {
+            return;
+        }
+
+        Worker* worker = CurrentWorker();
+        if (worker && worker->mQueue == this)
+        {
+            // Only the worker itself pushes to its deques so no locks are needed. Stop() joins the
+            // workers before clearing the deques so this can't race with it.
+            mQueuedCount++;
+            worker->mDeques[priority].Push(new Node(std::move(item)));
+        }
+        else
+        {
+            std::unique_lock<std::mutex> injectLock(mInjectMutex);
+
+            // Checked again as ClearQueuedWork() takes the lock after the flags are set, otherwise an
+            // item could be injected after Stop() has emptied the queue and never be freed
+            if (mQuit || mStopWork)
             {
-                std::unique_lock<std::mutex> startStopLock(mStartStopMutex);
-                std::unique_lock<std::mutex> queueLock(mQueueMutex);
-                mWorkQueue.push_back(std::move(item));
-            } // Do not hold lock while doing notify_one()
-            mHaveWork.notify_one();
+                return;
+            }
+            mQueuedCount++;
+            mInjectedWork[priority].push_back(new Node(std::move(item)));
+            mInjectedCount++;
         }
+        mWorkAdded.Notify(false);
+    }
+
+    // For an item that has already been executed by the caller, it will only have its completion
+    // notified by Update()
+    void AddCompleted(QueuedItemType item)
+    {
+        PushCompleted(new Node(std::move(item)));
     }
 
     bool IsIdle() const
     {
-        std::unique_lock<std::mutex> queueLock(mQueueMutex);
-        return mExecutingJobCount == 0 && mWorkQueue.empty();
+        // Items are counted as executing before they stop counting as queued, so the queued count
+        // has to be read first
+        return mQueuedCount == 0 && mExecutingJobCount == 0;
+    }
+
+    // Only changes in Start() and Stop()
+    u32 WorkerCount() const
+    {
+        return static_cast<u32>(mWorkers.size());
+    }
+
+    // True when called from any worker thread of an ASyncQueue of this type
+    static bool IsWorkerThread()
+    {
+        return CurrentWorker() != nullptr;
     }
 
     // Don't take anymore work, stop any existing work and return immediately while this happens
     void PauseAndCancelASync()
     {
         std::unique_lock<std::mutex> lock(mStartStopMutex);
-
-        {
-            std::unique_lock<std::mutex> queueLock(mQueueMutex);
-            mWorkQueue.clear();
-        }
-
         mStopWork = true;
-        mHaveWork.notify_all();
+        ClearQueuedWork();
+        mWorkAdded.Notify(true);
     }
 
     // Start taking work again
@@ -90,8 +215,8 @@ public:
         mStopWork = false;
     }
 
-    // Default to half of the CPU cores - if we use all of them then it will take too much time from
-    // whatever core is running the main thread/game loop.
+    // Default to all but one of the CPU cores - if we use all of them then it will take too much time
+    // from whatever core is running the main thread/game loop.
     void Start(s32 numWorkers = std::thread::hardware_concurrency() - 1, bool waitForWorkersToStart = true)
     {
         std::unique_lock<std::mutex> lock(mStartStopMutex);
@@ -104,16 +229,27 @@ public:
             numWorkers = 1;
         }
 
-        // Create workers
+        mQuit = false;
+
+        // All of the workers must exist before any of them can look for something to steal
         mWorkers.reserve(numWorkers);
         for (s32 i = 0; i < numWorkers; i++)
         {
-            mWorkers.push_back(std::thread(&ASyncQueue::WorkerFunc, this));
+            mWorkers.push_back(std::make_unique<Worker>(*this, static_cast<u32>(i)));
+        }
+
+        for (auto& worker : mWorkers)
+        {
+            worker->mThread = std::thread(&ASyncQueue::WorkerFunc, this, worker.get());
         }
 
         if (waitForWorkersToStart)
         {
-            while (mRunningThreadCount < numWorkers) {}
+            std::unique_lock<std::mutex> startedLock(mStartedMutex);
+            mStarted.wait(startedLock, [&]()
+            {
+                return mRunningThreadCount == numWorkers;
+            });
         }
 
         LOG_INFO("Worker queue is using: " << numWorkers << " workers");
@@ -126,22 +262,20 @@ public:
         mQuit = true;
         mStopWork = true;
 
-        {
-            std::unique_lock<std::mutex> queueLock(mQueueMutex);
-            mWorkQueue.clear();
-        }
-
-        mHaveWork.notify_all();
+        mWorkAdded.Notify(true);
 
         // Wait for running workers to exit
-        for (auto& thread : mWorkers)
+        for (auto& worker : mWorkers)
         {
-            if (thread.joinable())
+            if (worker->mThread.joinable())
             {
-                thread.join();
+                worker->mThread.join();
             }
         }
 
+        // In this case outstanding items are not notified of completion
+        ClearQueuedWork();
+
         mWorkers.clear();
         mRunningThreadCount = 0;
     }
@@ -149,69 +283,254 @@ public:
     // Notify and remove completed work
     void Update()
     {
-        std::deque<QueuedItemType> completed;
+        // Take everything at once, then put it back in to completion order
+        Node* completed = mCompletedWork.exchange(nullptr, std::memory_order_acquire);
+        Node* ordered = nullptr;
+        while (completed)
         {
-            // A quick move to avoid holding the lock for too long
-            std::unique_lock<std::mutex> completedWorkLock(mCompletedWorkMutex);
-            completed = std::move(mCompletedWork);
+            Node* next = completed->mNext;
+            completed->mNext = ordered;
+            ordered = completed;
+            completed = next;
         }
 
-        for (auto& complete : completed)
+        while (ordered)
         {
-            AsPointer(complete)->OnFinished();
+            std::unique_ptr<Node> node(ordered);
+            ordered = ordered->mNext;
+            AsPointer(node->mItem)->OnFinished();
         }
     }
 
 private:
-    void WorkerFunc()
+    struct Node
     {
-        mRunningThreadCount++;
+        explicit Node(QueuedItemType&& item)
+            : mItem(std::move(item))
+        {
 
-        std::unique_lock<std::mutex> lock(mQueueMutex);
-        while (!mQuit)
+        }
+
+        QueuedItemType mItem;
+
+        // Only used once completed
+        Node* mNext = nullptr;
+    };
+
+    struct Worker
+    {
+        Worker(ASyncQueue& queue, u32 index)
+            : mQueue(&queue), mRandom(index * 2654435761u + 1)
         {
-            mHaveWork.wait(lock, [this]() 
-            {
-                return !mWorkQueue.empty() || mQuit;
-            });
 
-            if (mQuit)
+        }
+
+        ASyncQueue* mQueue;
+
+        // Where to start looking for work to steal
+        u32 mRandom;
+
+        std::array<WorkStealingDeque<Node>, kNumPriorities> mDeques;
+        std::thread mThread;
+    };
+
+    static Worker*& CurrentWorker()
+    {
+        thread_local Worker* worker = nullptr;
+        return worker;
+    }
+
+    static void DeleteList(Node* node)
+    {
+        while (node)
+        {
+            Node* next = node->mNext;
+            delete node;
+            node = next;
+        }
+    }
+
+    void PushCompleted(Node* node)
+    {
+        node->mNext = mCompletedWork.load(std::memory_order_relaxed);
+        while (!mCompletedWork.compare_exchange_weak(node->mNext, node, std::memory_order_release, std::memory_order_relaxed))
+        {
+
+        }
+    }
+
+    // Any thread, anything still running is left alone
+    void ClearQueuedWork()
+    {
+        for (auto& worker : mWorkers)
+        {
+            for (auto& deque : worker->mDeques)
             {
-                // In this case outstanding jobs are not notified of completion
-                return;
+                while (Node* node = deque.Steal())
+                {
+                    delete node;
+                    mQueuedCount--;
+                }
             }
+        }
 
-            if (!mWorkQueue.empty())
+        std::unique_lock<std::mutex> injectLock(mInjectMutex);
+        for (auto& queue : mInjectedWork)
+        {
+            for (Node* node : queue)
             {
-                auto item = std::move(mWorkQueue.front());
-                mWorkQueue.pop_front();
+                delete node;
+                mQueuedCount--;
+            }
+            queue.clear();
+        }
+        mInjectedCount = 0;
+    }
 
-                lock.unlock();
+    // Takes the oldest item and moves a share of the ones behind it to self's deque, so that a
+    // stream of items from outside of the pool doesn't mean taking the lock for every one of them
+    Node* TakeInjected(Worker& self, u32 priority)
+    {
+        if (mInjectedCount == 0)
+        {
+            // Nothing from outside of the pool, skip the lock
+            return nullptr;
+        }
 
-                mExecutingJobCount++;
-                AsPointer(item)->OnExecute(mStopWork);
-                mExecutingJobCount--;
+        std::unique_lock<std::mutex> injectLock(mInjectMutex);
+        auto& queue = mInjectedWork[priority];
+        if (queue.empty())
+        {
+            return nullptr;
+        }
+        Node* node = queue.front();
+        queue.pop_front();
 
-                // Notify call back on main thread of completed work
+        const size_t share = queue.size() / mWorkers.size();
+        const size_t batchSize = share < kMaxInjectedBatch ? share : kMaxInjectedBatch;
+        for (size_t i = batchSize; i > 0; i--)
+        {
+            // Newest first as the deque pops newest first, keeps them in FIFO order
+            self.mDeques[priority].Push(queue[i - 1]);
+        }
+        queue.erase(queue.begin(), queue.begin() + batchSize);
+        mInjectedCount -= static_cast<u32>(batchSize + 1);
+        return node;
+    }
+
+    Node* FindWork(Worker& self)
+    {
+        const u32 numWorkers = static_cast<u32>(mWorkers.size());
+        for (u32 priority = 0; priority < kNumPriorities; priority++)
+        {
+            if (Node* node = self.mDeques[priority].Pop())
+            {
+                return node;
+            }
+
+            if (Node* node = TakeInjected(self, priority))
+            {
+                return node;
+            }
+
+            // Start from a different victim each time so that idle workers don't all pile on to the same one
+            self.mRandom ^= self.mRandom << 13;
+            self.mRandom ^= self.mRandom >> 17;
+            self.mRandom ^= self.mRandom << 5;
+            const u32 first = self.mRandom % numWorkers;
+            for (u32 i = 0; i < numWorkers; i++)
+            {
+                Worker& victim = *mWorkers[(first + i) % numWorkers];
+                if (&victim != &self)
                 {
-                    std::unique_lock<std::mutex> completedWorkLock(mCompletedWorkMutex);
-                    mCompletedWork.push_back(std::move(item));
+                    if (Node* node = victim.mDeques[priority].Steal())
+                    {
+                        return node;
+                    }
                 }
+            }
+        }
+        return nullptr;
+    }
+
+    void Execute(Node* node)
+    {
+        mExecutingJobCount++;
+        mQueuedCount--;
 
-                lock.lock();
+        AsPointer(node->mItem)->OnExecute(mStopWork);
+
+        // Completed before it stops counting as executing, so that once IsIdle() Update() sees everything
+        PushCompleted(node);
+        mExecutingJobCount--;
+    }
+
+    void WorkerFunc(Worker* self)
+    {
+        CurrentWorker() = self;
+        {
+            std::unique_lock<std::mutex> startedLock(mStartedMutex);
+            mRunningThreadCount++;
+        }
+        mStarted.notify_all();
+
+        while (!mQuit)
+        {
+            Node* node = FindWork(*self);
+            for (u32 i = 0; !node && i < kSpinsBeforeSleeping && !mQuit; i++)
+            {
+                // More work tends to follow shortly, going to sleep and being woken up again
+                // costs far more than giving up the rest of the time slice a few times
+                std::this_thread::yield();
+                node = FindWork(*self);
+            }
+
+            if (!node)
+            {
+                const u32 epoch = mWorkAdded.PrepareWait();
+                node = mQuit ? nullptr : FindWork(*self);
+                if (!node)
+                {
+                    if (mQuit)
+                    {
+                        mWorkAdded.CancelWait();
+                    }
+                    else
+                    {
+                        mWorkAdded.Wait(epoch);
+                    }
+                    continue;
+                }
+                mWorkAdded.CancelWait();
             }
+            Execute(node);
         }
+
+        CurrentWorker() = nullptr;
     }
 
-    std::mutex mStartStopMutex; // Prevent concurrent Start/Stop/Add
-    mutable std::mutex mQueueMutex;     // Protect mWorkQueue
-    mutable std::mutex mCompletedWorkMutex;     // Protect mCompletedWork
+    static const u32 kSpinsBeforeSleeping = 64;
+
+    std::mutex mStartStopMutex; // Prevent concurrent Start/Stop/PauseAndCancelASync
     std::atomic_bool mQuit { false };
     std::atomic_bool mStopWork { false };
-    std::atomic_int mRunningThreadCount { 0 };
+
+    std::mutex mStartedMutex;
+    std::condition_variable mStarted;
+    s32 mRunningThreadCount = 0;
+
+    std::atomic_uint mQueuedCount { 0 };
     std::atomic_uint mExecutingJobCount { 0 };
-    std::condition_variable mHaveWork;
-    std::deque<QueuedItemType> mWorkQueue;
-    std::deque<QueuedItemType> mCompletedWork;
-    std::vector<std::thread> mWorkers;
+    EventCount mWorkAdded;
+
+    // Items added from outside of the pool, FIFO per priority
+    static const size_t kMaxInjectedBatch = 32;
+    std::mutex mInjectMutex;
+    std::atomic_uint mInjectedCount { 0 };
+    std::array<std::deque<Node*>, kNumPriorities> mInjectedWork;
+
+    // Lock free stack of completed items, newest first
+    std::atomic<Node*> mCompletedWork { nullptr };
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
 };
@@ -29,7 +29,7 @@ public:
     RawCdImage& operator = (const RawCdImage&) = delete;
 
     RawCdImage(const std::string& fileName)
-        : mStream(std::make_unique<Oddlib::FileStream>(fileName, Oddlib::IStream::ReadMode::ReadOnly))
+        : mStream(Oddlib::OpenReadOnly(fileName))
     {
         ReadFileSystem();
     }
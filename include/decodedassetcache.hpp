@@ -0,0 +1,77 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include "types.hpp"
+
+class OSBaseFileSystem;
+
+namespace Oddlib
+{
+    class IBits;
+    class AnimationSet;
+}
+
+// Persists decoded cameras (the RGB image and FG1 RGBA layer) and animation sets (atlas pages and
+// frame tables) under {CacheDir}, so that after the first run they're inflated straight out of the
+// mapped cache file instead of going through the VLC/MDEC/frame decompressors again. Each entry is
+// one deflated file keyed by data set, LVL, LVL file and chunk id. Everything is deleted when the
+// engine version changes. Thread safe once Sync() has been called.
+class DecodedAssetCache
+{
+public:
+    struct Key
+    {
+        std::string mDataSet;
+        std::string mLvl;
+        std::string mFile;
+        u32 mChunkId;
+
+        // Size of the chunk(s) the asset is decoded from, catches a data set being swapped for a
+        // different release of the same game
+        u32 mSourceSize;
+    };
+
+    enum class eKind : u32
+    {
+        eCamera,
+        eAnimationSet,
+        eIndexedAnimationSet
+    };
+
+    explicit DecodedAssetCache(OSBaseFileSystem& fs);
+    DecodedAssetCache(const DecodedAssetCache&) = delete;
+    DecodedAssetCache& operator = (const DecodedAssetCache&) = delete;
+
+    // Deletes the cache if it was written by another engine version, and any partial writes left
+    // behind by a crash
+    void Sync();
+
+    // Return nullptr if there is no usable entry for key
+    std::unique_ptr<Oddlib::IBits> LoadCamera(const Key& key);
+    // Indexed and RGBA animation sets are separate entries, so either can be loaded for the same key
+    std::unique_ptr<Oddlib::AnimationSet> LoadAnimationSet(const Key& key, bool indexed);
+
+    void SaveCamera(const Key& key, const Oddlib::IBits& cam);
+    void SaveAnimationSet(const Key& key, const Oddlib::AnimationSet& animSet);
+
+    // The uncompressed payload of an entry, false if it is missing, stale or corrupt
+    bool Load(eKind kind, const Key& key, std::vector<u8>& data);
+    void Save(eKind kind, const Key& key, const std::vector<u8>& data);
+
+    u32 Hits() const { return mHits; }
+    u32 Misses() const { return mMisses; }
+private:
+    std::string FileName(eKind kind, const Key& key) const;
+    void DeleteFromDiskCache(const std::string& filter);
+
+    OSBaseFileSystem& mFs;
+
+    // Makes the temporary file names unique when two jobs write the same entry
+    std::atomic<u32> mNextTmpId{ 0 };
+
+    std::atomic<u32> mHits{ 0 };
+    std::atomic<u32> mMisses{ 0 };
+};
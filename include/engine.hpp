@@ -194,6 +194,8 @@ protected:
  
     SDL_Window* mWindow = nullptr;
 
+    // Used by mResourceLocator so must outlive it
+    std::unique_ptr<class DecodedAssetCache> mDecodedAssetCache;
     std::unique_ptr<class ResourceLocator> mResourceLocator;
     std::unique_ptr<class AbstractRenderer> mRenderer;
     std::unique_ptr<class Sound> mSound;
@@ -206,6 +208,9 @@ protected:
     TextureHandle mGuiFontHandle = {};
     bool mTryDirectX9 = false;
 
+    // Keep animation frames as palette indices instead of RGBA
+    bool mIndexedSprites = false;
+
     EngineStates mState = EngineStates::ePreEngineInit;
     std::unique_ptr<World> mWorld;
     std::unique_ptr<class GameSelectionState> mGameSelectionScreen;
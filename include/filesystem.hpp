@@ -108,8 +108,17 @@ public:
 
     void DeleteFile(const std::string& path);
     void RenameFile(const std::string& source, const std::string& destination);
+
+    // When enabled (the default) Open() memory maps files where the platform supports it. Don't
+    // map files that something else might truncate while they're open.
+    void SetMapFiles(bool mapFiles)
+    {
+        std::unique_lock<std::recursive_mutex> lock(mMutex);
+        mMapFiles = mapFiles;
+    }
 private:
     std::vector<std::string> DoEnumerate(const std::string& directory, bool files, const char* filter);
+    bool mMapFiles = true;
 protected:
     mutable std::recursive_mutex mMutex;
 };
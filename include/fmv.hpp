@@ -10,7 +10,9 @@
 #include "subtitles.hpp"
 #include "stdthread.h"
 #include "resourcemapper.hpp"
+#include "spscring.hpp"
 #include <functional>
+#include <atomic>
 
 class GameData;
 class IAudioController;
@@ -38,7 +40,8 @@ public:
         IAudioController& audioController,
         std::unique_ptr<Oddlib::IStream> stream,
         std::unique_ptr<SubTitleParser> subtitles,
-        u32 startSector, u32 endSector);
+        u32 startSector, u32 endSector,
+        const Oddlib::Masher::ParallelFor& parallelFor = nullptr);
 
     IMovie(const std::string& resourceName, IAudioController& controller, std::unique_ptr<SubTitleParser> subtitles);
 
@@ -50,9 +53,11 @@ public:
     // Main thread context
     bool IsEnd();
 
+    // Main thread context
     void Start();
     void Stop();
 protected:
+    // Decode thread context
     virtual bool EndOfStream() = 0;
     virtual bool NeedBuffer() = 0;
     virtual void FillBuffers() = 0;
@@ -61,29 +66,61 @@ protected:
     virtual bool Play(f32* stream, u32 len) override;
 
 
-    void RenderFrame(AbstractRenderer& rend, int width, int height, const void* pixels, const char* subtitles);
-
 protected:
     struct Frame
     {
-        size_t mFrameNum;
-        u32 mW;
-        u32 mH;
+        size_t mFrameNum = 0;
+        u32 mW = 0;
+        u32 mH = 0;
         std::vector<u8> mPixels;
     };
+
+    void RenderFrame(AbstractRenderer& rend, const Frame& frame, const char* subtitles);
+
+    // Main thread context, derived classes must call this in their destructor
+    void StopDecoding();
+
+    // Decode thread context, FillBuffers() decodes in to these and the decode thread
+    // then moves the results in to the rings as space becomes available
     size_t mFrameCounter = 0;
-    size_t mConsumedAudioBytes = 0;
-    std::mutex mAudioBufferMutex;
     std::deque<u8> mAudioBuffer;
     std::deque<Frame> mVideoBuffer;
+
     IAudioController& mAudioController;
     u32 mAudioBytesPerFrame = 1;
     std::unique_ptr<SubTitleParser> mSubTitles;
     std::string mName;
 
 private:
+    void DecodeThread();
+    bool FlushDecodedToRings();
+    bool ShouldDecode() const;
+
+    std::thread mDecodeThread;
+    std::atomic_bool mStopDecoding{ false };
+    std::atomic_bool mDecodeFinished{ false };
+
+    // Decode thread produces, main thread consumes video and audio thread consumes audio
+    SpscRing<Frame> mVideoRing;
+    SpscRing<u8> mAudioRing;
+
+    // Audio thread context
+    std::atomic<size_t> mConsumedAudioBytes{ 0 };
+    std::vector<u8> mAudioScratch;
+
+    // Main thread context, the frame being shown
+    Frame mDisplayFrame;
+    bool mHaveDisplayFrame = false;
+
     bool mPlaying = false;
     AutoMouseCursorHide mHideMouseCursor;
+
+    // Frames are streamed in to the same texture, only recreated if the frame size changes
+    AbstractRenderer* mRenderer = nullptr;
+    TextureHandle mFrameTexture;
+    u32 mFrameTextureW = 0;
+    u32 mFrameTextureH = 0;
+    size_t mFrameTextureFrameNum = 0;
 };
 
 
@@ -9,6 +9,7 @@
 #include "oddlib/stream.hpp"
 #include "filesystem.hpp"
 #include "logger.hpp"
+#include "symbol.hpp"
 
 namespace JsonDeserializer
 {
@@ -234,7 +235,7 @@ public:
     struct FileSystemInfo
     {
         FileSystemInfo(const std::string& name, bool isMod, std::unique_ptr<IFileSystem> fs)
-            : mDataSetName(name), mIsMod(isMod), mFileSystem(std::move(fs))
+            : mDataSetName(name), mDataSet(name), mIsMod(isMod), mFileSystem(std::move(fs))
         {
 
         }
@@ -247,12 +248,16 @@ public:
         FileSystemInfo& operator = (FileSystemInfo&& rhs)
         {
             mDataSetName = std::move(rhs.mDataSetName);
+            mDataSet = rhs.mDataSet;
             mIsMod = rhs.mIsMod;
             mFileSystem = std::move(rhs.mFileSystem);
             return *this;
         }
 
         std::string mDataSetName;
+
+        // mDataSetName interned up front for keying caches
+        Symbol mDataSet;
         bool mIsMod;
         std::unique_ptr<IFileSystem> mFileSystem;
     };
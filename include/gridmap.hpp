@@ -15,6 +15,8 @@
 #include "mapobject.hpp"
 #include "imgui/imgui.h"
 #include "iterativeforloop.hpp"
+#include "jobsystem.hpp"
+#include <future>
 
 class AbstractRenderer;
 class ResourceLocator;
@@ -45,6 +47,18 @@ public:
     GridScreen(const Oddlib::Path::Camera& camera, ResourceLocator& locator);
     ~GridScreen();
     const std::string& FileName() const { return mFileName; }
+
+    // Starts decoding the camera on a job if it isn't loaded or already on its way, returns true
+    // if a request was made. A camera that is on its way at a lower priority is asked for again at
+    // priority. The textures are then created by UploadIfReady() or LoadTextures().
+    bool Prefetch(JobPriority priority);
+    bool IsPrefetching() const { return mCamFuture.valid(); }
+    JobPriority PrefetchPriority() const { return mCamPriority; }
+
+    // Starts a staged upload of the textures if the prefetched camera has been decoded, never waits
+    bool UploadIfReady(AbstractRenderer& rend);
+
+    // Creates the textures, waiting for the camera if it isn't decoded yet
     void LoadTextures(AbstractRenderer& rend);
     void UnLoadTextures(AbstractRenderer& rend);
     bool hasTexture() const;
@@ -55,11 +69,16 @@ private:
     TextureHandle mCameraTexture;
     TextureHandle mFG1Texture;
 
+    void CreateTextures(AbstractRenderer& rend, std::shared_ptr<Oddlib::IBits> cam, bool staged);
+
     // TODO: This is not the in-game format
     Oddlib::Path::Camera mCamera;
 
-    // Temp hack to prevent constant reloading of LVLs
-    std::unique_ptr<Oddlib::IBits> mCam;
+    std::future<std::shared_ptr<Oddlib::IBits>> mCamFuture;
+    JobPriority mCamPriority = JobPriority::eLow;
+
+    // One path trys to load BRP08C10.CAM which exists in no data sets anywhere!
+    bool mCamMissing = false;
 
     ResourceLocator& mLocator;
 };
@@ -3,6 +3,14 @@
 #include <atomic>
 #include <memory>
 #include <set>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <algorithm>
+#include <future>
+#include <functional>
+#include <type_traits>
 #include "types.hpp"
 
 class CancelFlag
@@ -24,16 +32,25 @@ private:
     std::atomic_bool& mCancelSpecificJobFlag;
 };
 
+// Queued jobs are started highest priority first, running jobs are never pre-empted
+enum class JobPriority
+{
+    eHigh,      // Something is waiting on it right now, i.e the camera the player is entering
+    eNormal,
+    eLow        // Background work, i.e filling caches
+};
+
+class JobSystem;
+class IJob;
+using SP_IJob = std::shared_ptr<IJob>;
+
 class IJob
 {
 public:
     virtual ~IJob() = default;
     
-    void OnExecute(std::atomic_bool& quitFlag)
-    {
-        CancelFlag cancelFlag(mCancel, quitFlag);
-        OnExecute(cancelFlag);
-    }
+    // Also queues any jobs that were waiting on this one, see JobSystem::StartJob
+    void OnExecute(std::atomic_bool& quitFlag);
 
     virtual void OnExecute(const CancelFlag& quitFlag) = 0;
     virtual void OnFinished() = 0;
@@ -44,10 +61,54 @@ public:
     }
 
 private:
+    friend class JobSystem;
+
     std::atomic_bool mCancel{ false };
+
+    struct Dependent
+    {
+        JobSystem* mJobSystem;
+        SP_IJob mJob;
+        JobPriority mPriority;
+    };
+
+    std::mutex mDependentsMutex;
+    std::vector<Dependent> mDependents;
+    bool mExecuted = false;
+
+    // When this job has dependencies, the number that have yet to execute
+    std::atomic<u32> mPendingDependencies{ 0 };
 };
 
-using SP_IJob = std::shared_ptr<IJob>;
+// Runs a function as a job, the future is ready as soon as it has run and OnFinished() calls
+// the optional callback on the main thread.
+template<class ResultType>
+class FunctionJob : public IJob
+{
+public:
+    FunctionJob(std::packaged_task<ResultType()> task, std::function<void()> onFinished)
+        : mTask(std::move(task)), mOnFinished(std::move(onFinished))
+    {
+
+    }
+
+    virtual void OnExecute(const CancelFlag& /*quitFlag*/) override
+    {
+        mTask();
+    }
+
+    virtual void OnFinished() override
+    {
+        if (mOnFinished)
+        {
+            mOnFinished();
+        }
+    }
+
+private:
+    std::packaged_task<ResultType()> mTask;
+    std::function<void()> mOnFinished;
+};
 
 template<class T>
 class ASyncQueue;
@@ -59,9 +120,153 @@ class JobSystem
 public:
     JobSystem();
     ~JobSystem();
-    SP_IJob StartJob(SP_IJob job);
+    SP_IJob StartJob(SP_IJob job, JobPriority priority = JobPriority::eNormal);
+
+    // Queues job once every job in dependencies has executed, straight away if they all already
+    // have. Jobs that are dropped without executing (PauseAndCancel, shutdown) never release their
+    // dependents. Dependents of dependents form a graph, the stages of which are queued by the
+    // worker that ran the last dependency so the main thread is never involved.
+    SP_IJob StartJob(SP_IJob job, JobPriority priority, const std::vector<SP_IJob>& dependencies);
+
+    // Runs func on a worker thread. If the caller is itself a worker func is run right away instead,
+    // so jobs can block on the result of other work without being able to starve the pool.
+    template<class Func>
+    std::future<typename std::result_of<Func()>::type> Async(JobPriority priority, Func func, std::function<void()> onFinished = nullptr)
+    {
+        using ResultType = typename std::result_of<Func()>::type;
+        std::packaged_task<ResultType()> task(std::move(func));
+        auto future = task.get_future();
+        auto job = std::make_shared<FunctionJob<ResultType>>(std::move(task), std::move(onFinished));
+        if (IsWorkerThread())
+        {
+            RunNow(job);
+        }
+        else
+        {
+            StartJob(job, priority);
+        }
+        return future;
+    }
+
+    // Continuation: runs func as a job once every job in dependencies has executed. Unlike Async()
+    // it is always queued, also when called from a worker, so the caller never waits on it. The
+    // returned job can be a dependency of further stages.
+    template<class Func>
+    SP_IJob Then(const std::vector<SP_IJob>& dependencies, JobPriority priority, Func func, std::function<void()> onFinished = nullptr)
+    {
+        static_assert(std::is_void<typename std::result_of<Func()>::type>::value, "Continuations can't return anything");
+        std::packaged_task<void()> task(std::move(func));
+        return StartJob(std::make_shared<FunctionJob<void>>(std::move(task), std::move(onFinished)), priority, dependencies);
+    }
+
+    // Fan out/fan in: calls func(index) for each index in [0, count), in batches of batchSize indices
+    // spread over the workers. The caller takes batches too and only returns once every index has
+    // been done, so this is safe to call from a job (the waiting is only ever on batches that are
+    // running on other workers). The first exception thrown by func is re-thrown once all batches
+    // are done.
+    template<class Func>
+    void ParallelFor(JobPriority priority, u32 count, u32 batchSize, Func func)
+    {
+        batchSize = std::max(batchSize, 1u);
+        const u32 numBatches = (count + batchSize - 1) / batchSize;
+        if (numBatches <= 1)
+        {
+            for (u32 i = 0; i < count; i++)
+            {
+                func(i);
+            }
+            return;
+        }
+
+        auto state = std::make_shared<ParallelForState<Func>>(count, batchSize, std::move(func));
+
+        // Helpers that find nothing left to do just return, func isn't touched after this returns
+        const u32 numHelpers = std::min(numBatches - 1, WorkerCount());
+        for (u32 i = 0; i < numHelpers; i++)
+        {
+            std::packaged_task<void()> task([state]() { state->RunBatches(); });
+            StartJob(std::make_shared<FunctionJob<void>>(std::move(task), nullptr), priority);
+        }
+
+        state->RunBatches();
+        state->Wait();
+    }
+
+    // Calls OnFinished() of completed jobs, must be called from the main thread
     void Update();
+
+    static bool IsWorkerThread();
 private:
+    friend class IJob;
+
+    template<class Func>
+    struct ParallelForState
+    {
+        ParallelForState(u32 count, u32 batchSize, Func func)
+            : mCount(count), mBatchSize(batchSize), mFunc(std::move(func))
+        {
+
+        }
+
+        void RunBatches()
+        {
+            for (;;)
+            {
+                const u32 begin = mNext.fetch_add(mBatchSize);
+                if (begin >= mCount)
+                {
+                    return;
+                }
+
+                const u32 end = std::min(begin + mBatchSize, mCount);
+                try
+                {
+                    for (u32 i = begin; i < end; i++)
+                    {
+                        mFunc(i);
+                    }
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    if (!mException)
+                    {
+                        mException = std::current_exception();
+                    }
+                }
+
+                if (mDone.fetch_add(end - begin) + (end - begin) == mCount)
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mAllDone.notify_all();
+                }
+            }
+        }
+
+        void Wait()
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mAllDone.wait(lock, [this]() { return mDone == mCount; });
+            if (mException)
+            {
+                std::rethrow_exception(mException);
+            }
+        }
+
+        const u32 mCount;
+        const u32 mBatchSize;
+        Func mFunc;
+        std::atomic<u32> mNext{ 0 };
+        std::atomic<u32> mDone{ 0 };
+        std::mutex mMutex;
+        std::condition_variable mAllDone;
+        std::exception_ptr mException;
+    };
+
+    void RunNow(SP_IJob job);
+    void DependencyExecuted(SP_IJob job, JobPriority priority);
+    u32 WorkerCount() const;
+
     // unique_ptr to keep ASyncQueue header out of this header
     std::unique_ptr<ASyncQueue_SP_IJob> mAsyncQueue;
 };
@@ -75,7 +280,7 @@ public:
 
     }
 
-    SP_IJob StartJob(SP_IJob job);
+    SP_IJob StartJob(SP_IJob job, JobPriority priority = JobPriority::eNormal);
 
     void CancelOutstandingJobs()
     {
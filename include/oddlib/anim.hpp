@@ -4,6 +4,8 @@
 #include <memory>
 #include <set>
 #include <map>
+#include <array>
+#include <functional>
 #include "SDL.h"
 #include "sdl_raii.hpp"
 #include <string>
@@ -60,7 +62,9 @@ namespace Oddlib
         AnimSerializer(const AnimSerializer&) = delete;
         AnimSerializer& operator = (const AnimSerializer&) = delete;
 
-        SDL_SurfacePtr ApplyPalleteToFrame(const FrameHeader& header, u32 realWidth, const std::vector<u8>& decompressedData, std::vector<u32>& pixels);
+        SDL_SurfacePtr ApplyPalleteToFrame(const FrameHeader& header, u32 realWidth, const std::vector<u8>& decompressedData, std::vector<u32>& pixels) const;
+        // RGBA with red in the most significant byte, indices past the end of the palette are clamped
+        u32 GetPaltValue(u32 idx) const;
         const std::set< u32 >& UniqueFrames() const { return mUniqueFrameHeaderOffsets; }
         u32 MaxW() const { return mHeader.mMaxW; }
         u32 MaxH() const { return mHeader.mMaxH; }
@@ -72,6 +76,15 @@ namespace Oddlib
             u32 mFixedWidth = 0;
         };
         DecodedFrame ReadAndDecompressFrame(u32 frameOffset);
+
+        // Reads from stream instead, a view from StreamView(). Nothing else is modified so
+        // different frames can be decoded on different threads, each with its own view.
+        DecodedFrame ReadAndDecompressFrame(u32 frameOffset, IStream& stream) const;
+
+        // A separate read position over the same data. Only available when the serializer was
+        // created from a MemoryStream, anything else can't be viewed without copying it.
+        bool HasStreamViews() const;
+        std::unique_ptr<IStream> StreamView() const;
         bool IsSingleFrame() const { return mSingleFrameOffset > 0; }
 
         struct FrameInfoHeader;
@@ -123,7 +136,6 @@ namespace Oddlib
 
         const std::vector<std::unique_ptr<AnimationHeader>>& Animations() const { return mAnimationHeaders; }
     private:
-        u32 GetPaltValue(u32 idx);
         u32 ParsePallete();
         void ParseAnimationSets();
         void ParseFrameInfoHeaders();
@@ -154,7 +166,7 @@ namespace Oddlib
         bool mbIsAoFile = true;
 
         template<class T>
-        std::vector<u8> Decompress(FrameHeader& header, u32 finalW);
+        static std::vector<u8> Decompress(IStream& stream, FrameHeader& header, u32 finalW);
         IStream& mStream;
     };
 
@@ -202,6 +214,16 @@ namespace Oddlib
 
             // Image pixel data - pointer as data is sometimes shared between frames
             SDL_Surface* mFrame;
+
+            // Offset of the frame header, uniquely identifies mFrame within its AnimationSet
+            u32 mFrameOffset;
+
+            // Which page of the AnimationSet atlas mFrame lives in and its normalized texture coordinates
+            u32 mAtlasIndex;
+            f32 mU0;
+            f32 mV0;
+            f32 mU1;
+            f32 mV1;
         };
 
         s32 NumFrames() const { return static_cast<s32>(mFrames.size()); }
@@ -224,22 +246,67 @@ namespace Oddlib
     class AnimationSet
     {
     public:
-        explicit AnimationSet(AnimSerializer& as);
+        struct FrameImage
+        {
+            // Sub surface of the atlas page, the pixels are owned by the page
+            SDL_SurfacePtr mSurface;
+            u32 mAtlasIndex = 0;
+            SDL_Rect mAtlasRect = {};
+        };
+
+        // Must call func(index) for every index in [0, count) and only return once they all have,
+        // the calls can be made concurrently
+        using ParallelFor = std::function<void(u32 count, const std::function<void(u32 index)>& func)>;
+
+        // The colours of an indexed set, in the same byte order as the pixels of an RGBA atlas
+        static const u32 kPaletteSize = 256;
+        using Palette = std::array<u32, kPaletteSize>;
+
+        // When given parallelFor the frames are decoded by it rather than one after another. When indexed
+        // the frames and atlases are 8 bit indices in to GetPalette() instead of RGBA, a quarter of the size.
+        explicit AnimationSet(AnimSerializer& as, const ParallelFor& parallelFor = nullptr, bool indexed = false);
         u32 NumberOfAnimations() const;
         const Animation* AnimationAt(u32 idx) const;
         SDL_Surface* FrameByOffset(u32 offset) const;
+        const FrameImage* FrameImageByOffset(u32 offset) const;
+        u32 NumberOfAtlases() const { return static_cast<u32>(mAtlases.size()); }
+        SDL_Surface* Atlas(u32 idx) const { return mAtlases[idx].get(); }
         u32 MaxW() const { return mMaxW; }
         u32 MaxH() const { return mMaxH; }
+        bool IsIndexed() const { return mIndexed; }
+        const Palette& GetPalette() const { return mPalette; }
+
+        // Converts an indexed surface to RGBA pixels with palette, for when the indices can't be drawn as they are
+        static void ExpandIndexed(const SDL_Surface* indexed, const Palette& palette, std::vector<u32>& rgba);
+
+        // Approximate memory used by the decoded pixels and frame tables
+        size_t SizeInBytes() const;
+
+        // The decoded atlases and frame tables, so that the set can be recreated without decompressing
+        // any frames. ReadCache() throws Exception if stream doesn't hold what WriteCache() wrote.
+        void WriteCache(std::vector<u8>& out) const;
+        static std::unique_ptr<AnimationSet> ReadCache(IStream& stream);
     private:
-        SDL_SurfacePtr MakeFrame(AnimSerializer& as, const AnimSerializer::DecodedFrame& df, u32 offsetData);
+        AnimationSet() = default;
+        static SDL_Rect FrameRect(const AnimSerializer& as, const AnimSerializer::DecodedFrame& df, u32 offsetData);
+        static SDL_SurfacePtr MakeFrame(const AnimSerializer& as, const AnimSerializer::DecodedFrame& df, u32 offsetData);
+        static SDL_SurfacePtr MakeIndexedFrame(const AnimSerializer& as, const AnimSerializer::DecodedFrame& df, u32 offsetData);
+        void BuildAtlases();
+        static SDL_SurfacePtr AtlasView(SDL_Surface* atlas, const SDL_Rect& rect);
 
         std::vector<std::unique_ptr<Animation>> mAnimations;
 
+        // All unique frames packed into as few pages as possible, must outlive mFrames
+        std::vector<SDL_SurfacePtr> mAtlases;
+
         // Map of frame offsets to frame images
-        std::map<u32, SDL_SurfacePtr> mFrames;
+        std::map<u32, FrameImage> mFrames;
 
         u32 mMaxW = 0;
         u32 mMaxH = 0;
+
+        bool mIndexed = false;
+        Palette mPalette = {};
     };
 
 }
@@ -27,7 +27,9 @@ namespace Oddlib
         signed int g_left7_array = 0;
         unsigned short int* g_pointer_to_vlc_buffer = nullptr;
         int g_right25_array = 0;
-        unsigned short int g_vram[240][640];
+        // Decode scratch, only allocated while GenerateImage() runs so that a decoded camera
+        // is just its RGB24 surface
+        std::unique_ptr<unsigned short int[][640]> g_vram;
 
         friend struct BitsLogic;
 
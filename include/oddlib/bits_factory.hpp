@@ -38,6 +38,6 @@ namespace Oddlib
     };
 
     bool IsPsxCamera(IStream& stream);
-    std::unique_ptr<IBits> MakeBits(SDL_SurfacePtr camImage);
+    std::unique_ptr<IBits> MakeBits(SDL_SurfacePtr camImage, SDL_SurfacePtr fg1Image = nullptr);
     std::unique_ptr<IBits> MakeBits(IStream& bitsStream, IStream* fg1Stream);
 }
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "types.hpp"
+#include <vector>
+#include <string>
+#include <cstring>
+
+namespace Oddlib
+{
+    // FNV-1a
+    inline u32 HashBytes(const void* data, size_t size)
+    {
+        const u8* bytes = static_cast<const u8*>(data);
+        u32 hash = 2166136261u;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    inline u32 HashString(const std::string& str)
+    {
+        return HashBytes(str.data(), str.size());
+    }
+
+    inline u32 HashString(const char* str)
+    {
+        return HashBytes(str, strlen(str));
+    }
+
+    // Finaliser from murmur3, spreads ids that only differ in the low bits over the whole table
+    inline u32 HashU32(u32 value)
+    {
+        value ^= value >> 16;
+        value *= 0x85ebca6bu;
+        value ^= value >> 13;
+        value *= 0xc2b2ae35u;
+        value ^= value >> 16;
+        return value;
+    }
+
+    // Open addressing (linear probing) table from a key hash to an index in to an array owned by
+    // someone else, the keys themselves live in that array and are compared with the passed in
+    // predicate. Built once up front, after that lookups don't lock or allocate.
+    class HashIndex
+    {
+    public:
+        static const u32 kNotFound = 0xFFFFFFFF;
+
+        // Drops everything and sizes the table for count items at <= 50% load
+        void Reset(u32 count)
+        {
+            u32 capacity = 8;
+            while (capacity < count * 2)
+            {
+                capacity *= 2;
+            }
+            mSlots.assign(capacity, Slot());
+            mMask = capacity - 1;
+        }
+
+        // Number of slots, Reset() keeps this at least twice the item count
+        u32 Capacity() const
+        {
+            return static_cast<u32>(mSlots.size());
+        }
+
+        // If isSameKey(existingValue) is true for something already added then value is dropped,
+        // so with duplicate keys the first one added is what Find() returns
+        template<class Predicate>
+        void Insert(u32 hash, u32 value, Predicate isSameKey)
+        {
+            for (u32 i = hash & mMask;; i = (i + 1) & mMask)
+            {
+                Slot& slot = mSlots[i];
+                if (slot.mValue == kNotFound)
+                {
+                    slot.mHash = hash;
+                    slot.mValue = value;
+                    return;
+                }
+
+                if (slot.mHash == hash && isSameKey(slot.mValue))
+                {
+                    return;
+                }
+            }
+        }
+
+        template<class Predicate>
+        u32 Find(u32 hash, Predicate isKey) const
+        {
+            if (mSlots.empty())
+            {
+                return kNotFound;
+            }
+
+            for (u32 i = hash & mMask;; i = (i + 1) & mMask)
+            {
+                const Slot& slot = mSlots[i];
+                if (slot.mValue == kNotFound)
+                {
+                    return kNotFound;
+                }
+
+                if (slot.mHash == hash && isKey(slot.mValue))
+                {
+                    return slot.mValue;
+                }
+            }
+        }
+
+    private:
+        struct Slot
+        {
+            u32 mHash = 0;
+            u32 mValue = kNotFound;
+        };
+        std::vector<Slot> mSlots;
+        u32 mMask = 0;
+    };
+}
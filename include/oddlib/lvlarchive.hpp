@@ -8,6 +8,8 @@
 #include "oddlib/stream.hpp"
 #include "oddlib/exceptions.hpp"
 #include "types.hpp"
+#include "stdthread.h"
+#include "oddlib/hashindex.hpp"
 
 namespace Oddlib
 {
@@ -25,6 +27,9 @@ namespace Oddlib
         explicit InvalidLvl(const char* msg) : Exception(msg) { }
     };
 
+    // Once loaded chunks can be read from any number of threads at once. When the archive is in
+    // memory (or mapped) chunk reads are views/copies out of it, otherwise reads of the underlying
+    // stream are serialised.
     class LvlArchive
     {
     public:
@@ -33,19 +38,21 @@ namespace Oddlib
         public:
             FileChunk& operator = (const FileChunk&) const = delete;
             FileChunk(const FileChunk&) = delete;
-            FileChunk(IStream& stream, u32 type, u32 id, u32 dataSize)
-                : mStream(stream), mId(id), mType(type), mDataSize(dataSize)
+            FileChunk(IStream& stream, std::mutex& streamMutex, u32 type, u32 id, u32 dataSize)
+                : mStream(stream), mStreamMutex(streamMutex), mId(id), mType(type), mDataSize(dataSize)
             {
                 mFilePos = static_cast<u32>(stream.Pos());
             }
             u32 Id() const;
             u32 Type() const;
+            u32 Size() const;
             std::vector<u8> ReadData() const;
             std::unique_ptr<Oddlib::IStream> Stream() const;
             bool operator != (const FileChunk& rhs) const;
             bool operator == (const FileChunk& rhs) const;
         private:
             IStream& mStream;
+            std::mutex& mStreamMutex;
             u32 mId = 0;
             u32 mType = 0;
             u32 mFilePos = 0;
@@ -58,8 +65,9 @@ namespace Oddlib
         public:
             File(const File&) = delete;
             File& operator = (const File&) = delete;
-            File(IStream& stream, const FileRecord& rec);
+            File(IStream& stream, std::mutex& streamMutex, const FileRecord& rec);
             const std::string& FileName() const;
+            // The first chunk with the given id/type, or nullptr. O(1) and allocation free.
             FileChunk* ChunkById(u32 id);
             FileChunk* ChunkByIndex(u32 index) { return mChunks[index].get(); }
             const FileChunk* ChunkByIndex(u32 index) const { return mChunks[index].get(); }
@@ -68,9 +76,12 @@ namespace Oddlib
             // Debugging feature
             void SaveChunks();
         private:
-            void LoadChunks(IStream& stream, u32 fileSize);
+            void LoadChunks(IStream& stream, std::mutex& streamMutex, u32 fileSize);
+            void BuildIndex();
             std::string mFileName;
             std::vector<std::unique_ptr<FileChunk>> mChunks;
+            HashIndex mChunksById;
+            HashIndex mChunksByType;
         };
 
         explicit LvlArchive(const std::string& fileName);
@@ -78,6 +89,7 @@ namespace Oddlib
         explicit LvlArchive(std::unique_ptr<IStream> stream);
         ~LvlArchive();
 
+        // O(1) and allocation free
         File* FileByName(const std::string& fileName);
         File* FileByIndex(u32 index) { return mFiles[index].get(); }
         const File* FileByIndex(u32 index) const { return mFiles[index].get(); }
@@ -117,6 +129,8 @@ namespace Oddlib
         void ReadHeader(LvlHeader& header);
 
         std::unique_ptr<IStream> mStream;
+        std::mutex mStreamMutex;
         std::vector<std::unique_ptr<File>> mFiles;
+        HashIndex mFilesByName;
     };
 }
@@ -3,6 +3,7 @@
 #include "types.hpp"
 #include "stream.hpp"
 #include "oddlib/exceptions.hpp"
+#include <functional>
 
 
 namespace Oddlib
@@ -63,11 +64,20 @@ namespace Oddlib
         u32 FrameNumber() const { return mCurrentFrame; }
         u32 FrameRate() const { return mFileHeader.mFrameRate; }
         u32 NumberOfFrames() const { return mFileHeader.mNumberOfFrames; }
+
+        // Must call func(index) for every index in [0, count) and only return once they all have,
+        // the calls can be made concurrently
+        using ParallelFor = std::function<void(u32 count, const std::function<void(u32 index)>& func)>;
+
+        // Once a frame is dequantised the IDCT and colour conversion of each column of macroblocks is
+        // done by parallelFor. Without one (the default) frames are decoded serially.
+        void SetParallelFor(ParallelFor parallelFor) { mParallelFor = std::move(parallelFor); }
     protected:
         void decode_audio_frame(u16 *rawFrameBuffer, u16 *outPtr, signed int numSamplesPerFrame);
     private:
         void Read();
         void ParseVideoFrame(u32* pixelBuffer);
+        void ConvertMacroblocks(u32 begin, u32 end, u32* pixelBuffer) const;
 
         void ParseAudioFrame(u8* audioBuffer);
        
@@ -123,6 +133,8 @@ namespace Oddlib
 
         std::vector<u16> mMacroBlockBuffer;
 
+        ParallelFor mParallelFor;
+
     protected:
         std::vector<u16> mDecodedVideoFrameData;
     };
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "types.hpp"
+
+// 8x8 IDCT and colour conversion kernels shared by the DDV (Masher) and PSX STR (MDEC) decoders.
+// Each function picks the best version for ActiveSimdLevel() at runtime, every version gives the
+// exact same output as the scalar one.
+namespace Oddlib
+{
+    namespace Mdec
+    {
+        // Masher's integer IDCT. input is 64 signed 16bit coefficients each stored in the low half
+        // of a 32bit slot (as the dequantiser writes them), output is 64 values.
+        void MasherIdct(const s16* input, s32* output);
+
+        // Converts a Masher macroblock made of the Cr, Cb and 4 luma (top left, top right, bottom left,
+        // bottom right) IDCT outputs to 0x00BBGGRR pixels. Pixels outside of width/height are not written.
+        void MasherBlitMacroblock(const s32* cr, const s32* cb, const s32* const luma[4],
+            u32* pixelBuffer, s32 xoff, s32 yoff, s32 width, s32 height);
+
+        // PSXMDECDecoder's AAN IDCT in place, without the DC only shortcut
+        void PsxIdct(s16* block);
+
+        // The reference versions the others must match
+        namespace Scalar
+        {
+            void MasherIdct(const s16* input, s32* output);
+            void MasherBlitMacroblock(const s32* cr, const s32* cb, const s32* const luma[4],
+                u32* pixelBuffer, s32 xoff, s32 yoff, s32 width, s32 height);
+            void PsxIdct(s16* block);
+        }
+
+        // Only built for x86, each translation unit is compiled for its instruction set
+        namespace Sse41
+        {
+            void MasherIdct(const s16* input, s32* output);
+            void MasherBlitMacroblock(const s32* cr, const s32* cb, const s32* const luma[4],
+                u32* pixelBuffer, s32 xoff, s32 yoff, s32 width, s32 height);
+            void PsxIdct(s16* block);
+        }
+
+        namespace Avx2
+        {
+            void MasherIdct(const s16* input, s32* output);
+            void MasherBlitMacroblock(const s32* cr, const s32* cb, const s32* const luma[4],
+                u32* pixelBuffer, s32 xoff, s32 yoff, s32 width, s32 height);
+            void PsxIdct(s16* block);
+        }
+    }
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "types.hpp"
+
+// Vector versions of the Mdec::Scalar kernels, written once against a small set of operations so the
+// SSE4.1 and AVX2 translation units only have to provide those. V must provide:
+//
+//   Reg/FReg              32bit integer/float vector of kLanes lanes
+//   kLanes, kRegsPerRow   kLanes * kRegsPerRow == 8
+//   Set1, Add, Sub, Mul (low 32 bits), Sra, Sll, Or, Trunc16 (sign extend the low 16 bits)
+//   LoadS32, StoreS32, LoadS16 (sign extends), StoreS16 (values must fit), LoadS32Dup (kLanes / 2 values, each twice)
+//   FSet1, ToFloat, FAdd, FSub, FMul, FMax, FMin, ToIntTruncate
+//   Transpose8x8(Reg m[8 * kRegsPerRow]) where row r part p is m[r * kRegsPerRow + p]
+//
+// Everything wraps on overflow just like the 32bit scalar code does in practice, so the results are identical.
+namespace Oddlib
+{
+    namespace Mdec
+    {
+        namespace Kernels
+        {
+            // One pass of Masher's IDCT down the columns of each part
+            template<class V>
+            inline void MasherHalfIdct(typename V::Reg* m, s32 shift)
+            {
+                typedef typename V::Reg Reg;
+                const Reg c8192 = V::Set1(8192);
+                const Reg c10703 = V::Set1(10703);
+                const Reg c10704 = V::Set1(10704);
+                const Reg c4433 = V::Set1(4433);
+                const Reg c11363 = V::Set1(11363);
+                const Reg c11362 = V::Set1(11362);
+                const Reg c9633 = V::Set1(9633);
+                const Reg c6437 = V::Set1(6437);
+                const Reg c6436 = V::Set1(6436);
+                const Reg c2261 = V::Set1(2261);
+                const Reg c2260 = V::Set1(2260);
+                const Reg c2259 = V::Set1(2259);
+
+                for (int part = 0; part < V::kRegsPerRow; part++)
+                {
+                    Reg s[8];
+                    for (int k = 0; k < 8; k++)
+                    {
+                        s[k] = m[k * V::kRegsPerRow + part];
+                    }
+
+                    const Reg s0 = V::Mul(s[0], c8192);
+                    const Reg s4 = V::Mul(s[4], c8192);
+                    const Reg t4 = V::Add(V::Add(s0, V::Mul(s[2], c10703)), V::Add(s4, V::Mul(s[6], c4433)));
+                    const Reg t5 = V::Sub(V::Sub(V::Add(s0, V::Mul(s[2], c4433)), s4), V::Mul(s[6], c10704));
+                    const Reg t6 = V::Add(V::Sub(V::Sub(s0, V::Mul(s[2], c4433)), s4), V::Mul(s[6], c10704));
+                    const Reg t7 = V::Sub(V::Add(V::Sub(s0, V::Mul(s[2], c10703)), s4), V::Mul(s[6], c4433));
+
+                    const Reg t0 = V::Add(V::Add(V::Mul(s[1], c11363), V::Mul(s[3], c9633)), V::Add(V::Mul(s[5], c6437), V::Mul(s[7], c2260)));
+                    const Reg t1 = V::Sub(V::Sub(V::Sub(V::Mul(s[1], c9633), V::Mul(s[3], c2259)), V::Mul(s[5], c11362)), V::Mul(s[7], c6436));
+                    const Reg t2 = V::Add(V::Add(V::Sub(V::Mul(s[1], c6437), V::Mul(s[3], c11362)), V::Mul(s[5], c2261)), V::Mul(s[7], c9633));
+                    const Reg t3 = V::Sub(V::Add(V::Sub(V::Mul(s[1], c2260), V::Mul(s[3], c6436)), V::Mul(s[5], c9633)), V::Mul(s[7], c11363));
+
+                    m[0 * V::kRegsPerRow + part] = V::Sra(V::Add(t4, t0), shift);
+                    m[1 * V::kRegsPerRow + part] = V::Sra(V::Add(t5, t1), shift);
+                    m[2 * V::kRegsPerRow + part] = V::Sra(V::Add(t6, t2), shift);
+                    m[3 * V::kRegsPerRow + part] = V::Sra(V::Add(t7, t3), shift);
+                    m[4 * V::kRegsPerRow + part] = V::Sra(V::Sub(t7, t3), shift);
+                    m[5 * V::kRegsPerRow + part] = V::Sra(V::Sub(t6, t2), shift);
+                    m[6 * V::kRegsPerRow + part] = V::Sra(V::Sub(t5, t1), shift);
+                    m[7 * V::kRegsPerRow + part] = V::Sra(V::Sub(t4, t0), shift);
+                }
+            }
+
+            template<class V>
+            inline void MasherIdct(const s16* input, s32* output)
+            {
+                typename V::Reg m[8 * V::kRegsPerRow];
+
+                // Coefficients are in the low half of each 32bit slot
+                const s32* source = reinterpret_cast<const s32*>(input);
+                for (int i = 0; i < 8 * V::kRegsPerRow; i++)
+                {
+                    m[i] = V::Trunc16(V::LoadS32(source + (i * V::kLanes)));
+                }
+
+                // Columns, then rows by transposing in and out
+                MasherHalfIdct<V>(m, 11);
+                V::Transpose8x8(m);
+                MasherHalfIdct<V>(m, 18);
+                V::Transpose8x8(m);
+
+                for (int i = 0; i < 8 * V::kRegsPerRow; i++)
+                {
+                    V::StoreS32(output + (i * V::kLanes), m[i]);
+                }
+            }
+
+            template<class V>
+            inline void MasherBlitMacroblock(const s32* cr, const s32* cb, const s32* const luma[4],
+                u32* pixelBuffer, s32 xoff, s32 yoff, s32 width, s32 height)
+            {
+                typedef typename V::Reg Reg;
+                typedef typename V::FReg FReg;
+
+                const FReg rCb = V::FSet1(1.402f);
+                const FReg gCr = V::FSet1(0.3437f);
+                const FReg gCb = V::FSet1(0.7143f);
+                const FReg bCr = V::FSet1(1.772f);
+                const FReg zero = V::FSet1(0.0f);
+                const FReg max = V::FSet1(255.0f);
+
+                const bool wholeRow = xoff + 16 <= width;
+                for (s32 y = 0; y < 16; y++)
+                {
+                    const s32 ypos = y + yoff;
+                    if (ypos >= height)
+                    {
+                        // Due to macro block padding this can be out of bounds
+                        break;
+                    }
+
+                    u32* dst = pixelBuffer + (width * ypos) + xoff;
+                    for (s32 x = 0; x < 16; x += V::kLanes)
+                    {
+                        const s32* yBlock = luma[(y / 8) * 2 + (x / 8)];
+                        const FReg Y = V::ToFloat(V::LoadS32(yBlock + ((y % 8) * 8) + (x % 8)));
+                        const FReg Cb = V::ToFloat(V::LoadS32Dup(cb + ((y / 2) * 8) + (x / 2)));
+                        const FReg Cr = V::ToFloat(V::LoadS32Dup(cr + ((y / 2) * 8) + (x / 2)));
+
+                        // Same operations in the same order as the scalar version for identical rounding
+                        const FReg r = V::FAdd(Y, V::FMul(rCb, Cb));
+                        const FReg g = V::FSub(V::FSub(Y, V::FMul(gCr, Cr)), V::FMul(gCb, Cb));
+                        const FReg b = V::FAdd(Y, V::FMul(bCr, Cr));
+
+                        const Reg ri = V::ToIntTruncate(V::FMin(V::FMax(r, zero), max));
+                        const Reg gi = V::ToIntTruncate(V::FMin(V::FMax(g, zero), max));
+                        const Reg bi = V::ToIntTruncate(V::FMin(V::FMax(b, zero), max));
+                        const Reg pixels = V::Or(V::Or(V::Sll(bi, 16), V::Sll(gi, 8)), ri);
+
+                        if (wholeRow)
+                        {
+                            V::StoreS32(reinterpret_cast<s32*>(dst + x), pixels);
+                        }
+                        else
+                        {
+                            s32 lanes[V::kLanes];
+                            V::StoreS32(lanes, pixels);
+                            for (s32 i = 0; i < V::kLanes && xoff + x + i < width; i++)
+                            {
+                                dst[x + i] = static_cast<u32>(lanes[i]);
+                            }
+                        }
+                    }
+                }
+            }
+
+            // One pass of PSXMDECDecoder's IDCT down the columns of each part. Every Trunc16 is where
+            // the scalar code stores in to a 16bit variable.
+            template<class V>
+            inline void PsxHalfIdct(typename V::Reg* m, bool finalPass)
+            {
+                typedef typename V::Reg Reg;
+                const Reg fix_1_082392200 = V::Set1(277);
+                const Reg fix_1_414213562 = V::Set1(362);
+                const Reg fix_1_847759065 = V::Set1(473);
+                const Reg fix_2_613125930 = V::Set1(669);
+                const s32 kConstBits = 8;
+                const s32 kFinalShift = 2 + 3;
+
+                for (int part = 0; part < V::kRegsPerRow; part++)
+                {
+                    Reg p[8];
+                    for (int k = 0; k < 8; k++)
+                    {
+                        p[k] = m[k * V::kRegsPerRow + part];
+                    }
+
+                    Reg z10 = V::Trunc16(V::Add(p[0], p[4]));
+                    Reg z11 = V::Trunc16(V::Sub(p[0], p[4]));
+                    Reg z13 = V::Trunc16(V::Add(p[2], p[6]));
+                    Reg z12 = V::Trunc16(V::Sub(V::Sra(V::Mul(V::Sub(p[2], p[6]), fix_1_414213562), kConstBits), z13));
+
+                    const Reg tmp0 = V::Trunc16(V::Add(z10, z13));
+                    const Reg tmp3 = V::Trunc16(V::Sub(z10, z13));
+                    const Reg tmp1 = V::Trunc16(V::Add(z11, z12));
+                    const Reg tmp2 = V::Trunc16(V::Sub(z11, z12));
+
+                    z13 = V::Trunc16(V::Add(p[3], p[5]));
+                    z10 = V::Trunc16(V::Sub(p[3], p[5]));
+                    z11 = V::Trunc16(V::Add(p[1], p[7]));
+                    z12 = V::Trunc16(V::Sub(p[1], p[7]));
+
+                    const Reg z5 = V::Trunc16(V::Sra(V::Mul(V::Sub(z12, z10), fix_1_847759065), kConstBits));
+                    const Reg tmp7 = V::Trunc16(V::Add(z11, z13));
+                    const Reg tmp6 = V::Trunc16(V::Sub(V::Add(V::Sra(V::Mul(z10, fix_2_613125930), kConstBits), z5), tmp7));
+                    const Reg tmp5 = V::Trunc16(V::Sub(V::Sra(V::Mul(V::Sub(z11, z13), fix_1_414213562), kConstBits), tmp6));
+                    const Reg tmp4 = V::Trunc16(V::Add(V::Sub(V::Sra(V::Mul(z12, fix_1_082392200), kConstBits), z5), tmp5));
+
+                    Reg out[8];
+                    out[0] = V::Add(tmp0, tmp7);
+                    out[7] = V::Sub(tmp0, tmp7);
+                    out[1] = V::Add(tmp1, tmp6);
+                    out[6] = V::Sub(tmp1, tmp6);
+                    out[2] = V::Add(tmp2, tmp5);
+                    out[5] = V::Sub(tmp2, tmp5);
+                    out[4] = V::Add(tmp3, tmp4);
+                    out[3] = V::Sub(tmp3, tmp4);
+
+                    for (int k = 0; k < 8; k++)
+                    {
+                        m[k * V::kRegsPerRow + part] = V::Trunc16(finalPass ? V::Sra(out[k], kFinalShift) : out[k]);
+                    }
+                }
+            }
+
+            template<class V>
+            inline void PsxIdct(s16* block)
+            {
+                typename V::Reg m[8 * V::kRegsPerRow];
+                for (int i = 0; i < 8 * V::kRegsPerRow; i++)
+                {
+                    m[i] = V::LoadS16(block + (i * V::kLanes));
+                }
+
+                // The scalar version skips columns and rows that only have a DC value,
+                // the full calculation gives the same result for those.
+                PsxHalfIdct<V>(m, false);
+                V::Transpose8x8(m);
+                PsxHalfIdct<V>(m, true);
+                V::Transpose8x8(m);
+
+                for (int i = 0; i < 8 * V::kRegsPerRow; i++)
+                {
+                    V::StoreS16(block + (i * V::kLanes), m[i]);
+                }
+            }
+        }
+    }
+}
@@ -12,6 +12,7 @@ namespace Oddlib
     class IStream;
 
     using UP_Path = std::unique_ptr<class Path>;
+    using SP_Path = std::shared_ptr<class Path>;
     class Path
     {
     public:
@@ -90,6 +91,9 @@ namespace Oddlib
         const std::vector<CollisionItem>& CollisionItems() const { return mCollisionItems; }
         bool IsAo() const { return mIsAo; }
         const std::string& MusicThemeName() const { return mMusicThemeName; }
+
+        // Approximate memory used by the cameras, map objects and collision items
+        size_t SizeInBytes() const;
     private:
         void ReadPath(IStream& stream, u32 collisionDataOffset, u32 objectIndexTableOffset, u32 objectDataOffset);
         void ReadCamera(IStream& stream);
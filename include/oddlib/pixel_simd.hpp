@@ -0,0 +1,50 @@
+#pragma once
+
+#include "types.hpp"
+
+// 15/16bit colour and palette expansion loops shared by the camera and animation decoders. Each
+// function picks the best version for ActiveSimdLevel() at runtime, every version gives the exact
+// same output as the scalar one.
+namespace Oddlib
+{
+    namespace Pixels
+    {
+        // PC RGB565 to SDL_PIXELFORMAT_RGB24 (R, G, B bytes), channels scaled as (c*255)/31 and (c*255)/63
+        // which is what SDL_ConvertSurfaceFormat() does
+        void Rgb565ToRgb24(const u16* src, u8* dst, u32 count);
+
+        // PSX/PC palette colours (red in the low bits, bit 15 semi transparent) to 0xRRGGBBAA. Alpha is
+        // 127 for semi transparent colours, 0 for black and 255 for everything else.
+        void Bgr555ToRgba(const u16* src, u32* dst, u32 count);
+
+        // count 8bit indices through a 256 entry palette. There is no way to look up that many
+        // 32bit entries without a gather, so this is a plain table lookup on every level.
+        void ExpandPalette8(const u8* src, u32* dst, u32 count, const u32* palette);
+
+        // count 4bit indices (two per byte, low nibble first) through a 16 entry palette
+        void ExpandPalette4(const u8* src, u32* dst, u32 count, const u32* palette);
+
+        // The reference versions the others must match
+        namespace Scalar
+        {
+            void Rgb565ToRgb24(const u16* src, u8* dst, u32 count);
+            void Bgr555ToRgba(const u16* src, u32* dst, u32 count);
+            void ExpandPalette4(const u8* src, u32* dst, u32 count, const u32* palette);
+        }
+
+        // Only built for x86, each translation unit is compiled for its instruction set
+        namespace Sse41
+        {
+            void Rgb565ToRgb24(const u16* src, u8* dst, u32 count);
+            void Bgr555ToRgba(const u16* src, u32* dst, u32 count);
+            void ExpandPalette4(const u8* src, u32* dst, u32 count, const u32* palette);
+        }
+
+        namespace Avx2
+        {
+            void Rgb565ToRgb24(const u16* src, u8* dst, u32 count);
+            void Bgr555ToRgba(const u16* src, u32* dst, u32 count);
+            void ExpandPalette4(const u8* src, u32* dst, u32 count, const u32* palette);
+        }
+    }
+}
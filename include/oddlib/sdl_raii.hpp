@@ -54,4 +54,15 @@ public:
 
     static SDL_SurfacePtr LoadPng(Oddlib::IStream& stream, bool hasAlpha);
 
+    // Appends the size, pixel format and tightly packed rows of surface to out, for caching decoded images.
+    // Only the indices of an 8 bit surface are kept, not its palette.
+    static void WriteSurface(std::vector<u8>& out, const SDL_Surface* surface);
+
+    // Recreates a surface written by WriteSurface(), throws Oddlib::Exception if what's in stream isn't one
+    static SDL_SurfacePtr ReadSurface(Oddlib::IStream& stream);
+
+    // Same as SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGB24, 0) for a 16 bit RGB565 surface,
+    // but with the vectorised Oddlib::Pixels::Rgb565ToRgb24()
+    static SDL_SurfacePtr Rgb565ToRgb24(const SDL_Surface* surface);
+
 };
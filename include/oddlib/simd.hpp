@@ -0,0 +1,28 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ODDLIB_X86_SIMD 1
+#endif
+
+namespace Oddlib
+{
+    // Instruction sets that the hot decoding loops have hand written versions for, in order of preference
+    enum class SimdLevel
+    {
+        eScalar,
+        eSse41,
+        eAvx2
+    };
+
+    // What this CPU/OS supports, detected once
+    SimdLevel DetectedSimdLevel();
+
+    // What the decoders use, defaults to DetectedSimdLevel()
+    SimdLevel ActiveSimdLevel();
+
+    // Can't be raised above DetectedSimdLevel(), mostly so tests and benchmarks can compare
+    // against the scalar code
+    void SetSimdLevel(SimdLevel level);
+
+    const char* SimdLevelName(SimdLevel level);
+}
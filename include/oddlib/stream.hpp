@@ -174,14 +174,45 @@ namespace Oddlib
         std::string mName;
     };
 
-    class MemoryStream : public Stream<std::stringstream>
+    // Reads directly out of a buffer that is never modified after construction, so Clone() and
+    // sub streams are views that share it rather than copies.
+    class MemoryStream : public IStream
     {
     public:
         explicit MemoryStream(std::vector<u8>&& data);
+
+        // data must stay valid and unchanged for as long as the last owner of it is alive
+        MemoryStream(std::shared_ptr<const u8> data, size_t size, std::string name);
+
         virtual IStream* Clone() override;
-        virtual IStream* Clone(u32 start, u32 size) override { return Stream<std::stringstream>::Clone(start, size); }
+        virtual IStream* Clone(u32 start, u32 size) override;
+        virtual void ReadBytes(u8* pDest, size_t destSize) override;
+        virtual void WriteBytes(const u8* pSrc, size_t srcSize) override;
+        virtual void Seek(size_t pos) override;
+        virtual size_t Pos() const override { return mPos; }
+        virtual size_t Size() const override { return mSize; }
+        virtual bool AtEnd() const override { return mPos >= mSize; }
+        virtual const std::string& Name() const override { return mName; }
+        virtual std::string LoadAllToString() override;
+
+        // Valid for as long as any stream sharing the buffer is alive
+        const u8* Data() const { return mData.get(); }
+    private:
+        std::shared_ptr<const u8> mData;
+        size_t mSize = 0;
+        size_t mPos = 0;
+        std::string mName;
     };
 
+    // Maps the whole of fileName read only and returns a MemoryStream over the mapping, so reads are
+    // a memcpy and sub streams (LVL chunks, CD sectors, stored ZIP entries) are free. The mapping lives
+    // until the last stream using it is destroyed. Returns nullptr if the file can't be mapped (or the
+    // platform has no mmap), callers should fall back to FileStream.
+    std::unique_ptr<IStream> MapFile(const std::string& fileName);
+
+    // MapFile() falling back to a read only FileStream
+    std::unique_ptr<IStream> OpenReadOnly(const std::string& fileName);
+
     class FileStream :public Stream<std::fstream>
     {
     public:
@@ -10,13 +10,17 @@ public:
     ~OpenGLRenderer();
 
     virtual TextureHandle CreateTexture(eTextureFormats internalFormat, u32 width, u32 height, eTextureFormats inputFormat, const void *pixels, bool interpolation) override;
+    virtual void UpdateTexture(TextureHandle handle, u32 width, u32 height, eTextureFormats inputFormat, const void *pixels) override;
+    virtual void UpdateTextureRows(TextureHandle handle, u32 y, u32 width, u32 rows, eTextureFormats inputFormat, const void *pixels) override;
     virtual void DestroyTextures() override;
     virtual const char* Name() const override;
     virtual void SetVSync(bool on) override;
+    virtual bool IndexedTexturesSupported() const override { return true; }
 
 private:
-    void SetWorldMatrix();
-    void SetScreenMatrix();
+    void UseShader(TextureHandle palette, const f32* projMtx);
+    void SetWorldMatrix(TextureHandle palette);
+    void SetScreenMatrix(TextureHandle palette);
 
     virtual void OnSetRenderState(CmdState& info) override;
 
@@ -29,6 +33,10 @@ private:
 
     bool CreateShadersAndBufferObjects();
 
+    virtual bool SpriteBatchingSupported() const override { return true; }
+    virtual void RenderSpriteBatch(const SpriteBatch& batch) override;
+    void UploadSpriteVertices();
+
     SDL_GLContext mContext = nullptr;
     SDL_Window* mWindow = nullptr;
 
@@ -40,6 +48,19 @@ private:
     std::unique_ptr<class BufferObject> mGuiVbo;
     std::unique_ptr<class BufferObject> mGuiIbo;
 
+    // Sprite vertices are streamed in to a ring buffer, it is only orphaned when it wraps
+    std::unique_ptr<class Vao> mSpriteVao;
+    std::unique_ptr<class BufferObject> mSpriteVbo;
+    std::unique_ptr<class BufferObject> mSpriteIbo;
+    u32 mSpriteVboSize = 0;
+    u32 mSpriteVboWritePos = 0;
+    u32 mSpriteIboQuads = 0;
+
+    // Texture updates are staged through alternating pixel unpack buffers so that the copy to
+    // the texture can happen asynchronously while the next update is being written
+    std::unique_ptr<class BufferObject> mUploadPbos[2];
+    u32 mUploadPboIndex = 0;
+
     std::unique_ptr<class Shader> mShader;
 
     int mAttribLocationTex = 0;
@@ -47,4 +68,10 @@ private:
     int mAttribLocationPosition = 0;
     int mAttribLocationUV = 0;
     int mAttribLocationColor = 0;
+
+    // For textures of palette indices, see IndexedQuadUV()
+    std::unique_ptr<class Shader> mIndexedShader;
+    int mIndexedLocationTex = 0;
+    int mIndexedLocationPalette = 0;
+    int mIndexedLocationProjMtx = 0;
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "types.hpp"
+#include <vector>
+#include <array>
+#include <utility>
+#include <cstddef>
+
+// LSD radix sort on a 64bit key, 8 bits per pass. T must have a u64 mKey member.
+// Passes where every key has the same byte are skipped, so keys that only use a few of
+// their bits cost far less than 8 passes. Stable, and scratch is reused to avoid allocations.
+template<class T>
+inline void RadixSortByKey(std::vector<T>& items, std::vector<T>& scratch)
+{
+    const size_t count = items.size();
+    if (count < 2)
+    {
+        return;
+    }
+    scratch.resize(count);
+
+    // Histogram every byte in one go rather than once per pass
+    std::array<std::array<u32, 256>, 8> histograms = {};
+    for (const T& item : items)
+    {
+        for (u32 pass = 0; pass < 8; pass++)
+        {
+            histograms[pass][(item.mKey >> (pass * 8)) & 0xFF]++;
+        }
+    }
+
+    std::vector<T>* src = &items;
+    std::vector<T>* dst = &scratch;
+    for (u32 pass = 0; pass < 8; pass++)
+    {
+        std::array<u32, 256>& histogram = histograms[pass];
+        const u32 shift = pass * 8;
+        if (histogram[(items[0].mKey >> shift) & 0xFF] == count)
+        {
+            // Nothing to reorder by
+            continue;
+        }
+
+        // Turn counts into starting offsets
+        u32 offset = 0;
+        for (u32& bucket : histogram)
+        {
+            const u32 bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+
+        for (const T& item : *src)
+        {
+            (*dst)[histogram[(item.mKey >> shift) & 0xFF]++] = item;
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != &items)
+    {
+        items.swap(scratch);
+    }
+}
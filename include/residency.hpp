@@ -0,0 +1,134 @@
+#pragma once
+
+#include "types.hpp"
+#include "symbol.hpp"
+#include "oddlib/hashindex.hpp"
+#include "stdthread.h"
+#include <memory>
+#include <list>
+#include <vector>
+#include <unordered_map>
+
+// Keeps recently used decoded assets alive after their last user has dropped them so that going
+// back to a screen doesn't have to re-open the LVL and decode everything again. Anything not
+// pinned is evicted least recently used first once the total size goes over the byte budget,
+// pinned entries are never evicted but do still count towards the total. Thread safe.
+class ResidencyManager
+{
+public:
+    enum class eKind : u32
+    {
+        eCamera,
+        eAnimationSet,
+        ePath
+    };
+
+    struct Key
+    {
+        // Cameras and paths are keyed by resource name alone since mods can replace them
+        static Key Camera(const std::string& cameraName) { return Key(eKind::eCamera, Symbol(), Symbol(), Symbol(cameraName), 0); }
+        static Key Path(const std::string& pathName) { return Key(eKind::ePath, Symbol(), Symbol(), Symbol(pathName), 0); }
+        static Key AnimationSet(const Symbol& dataSetName, const Symbol& lvlArchiveFileName, const Symbol& lvlFileName, u32 chunkId)
+        {
+            return Key(eKind::eAnimationSet, dataSetName, lvlArchiveFileName, lvlFileName, chunkId);
+        }
+
+        bool operator == (const Key& rhs) const
+        {
+            return mKind == rhs.mKind && mId == rhs.mId && mName == rhs.mName && mLvl == rhs.mLvl && mDataSet == rhs.mDataSet;
+        }
+
+        eKind mKind;
+        Symbol mDataSet;
+        Symbol mLvl;
+        Symbol mName;
+        u32 mId;
+        u32 mHash;
+
+    private:
+        Key(eKind kind, const Symbol& dataSet, const Symbol& lvl, const Symbol& name, u32 id)
+            : mKind(kind), mDataSet(dataSet), mLvl(lvl), mName(name), mId(id),
+              mHash(Oddlib::HashU32(static_cast<u32>(kind) ^ Oddlib::HashU32(dataSet.Hash() ^ Oddlib::HashU32(lvl.Hash() ^ Oddlib::HashU32(name.Hash() ^ Oddlib::HashU32(id))))))
+        {
+        }
+    };
+
+    struct Stats
+    {
+        u64 mHits = 0;
+        u64 mMisses = 0;
+        u64 mEvictions = 0;
+        size_t mBytesResident = 0;
+        size_t mBytesPinned = 0;
+        size_t mBudget = 0;
+        u32 mEntries = 0;
+
+        f32 HitRate() const
+        {
+            const u64 lookups = mHits + mMisses;
+            return lookups ? static_cast<f32>(mHits) / static_cast<f32>(lookups) : 0.0f;
+        }
+    };
+
+    static const size_t kDefaultBudget = 256 * 1024 * 1024;
+
+    explicit ResidencyManager(size_t budget = kDefaultBudget);
+    ResidencyManager(const ResidencyManager&) = delete;
+    ResidencyManager& operator = (const ResidencyManager&) = delete;
+
+    void SetBudget(size_t budget);
+
+    // The caller must ask for the same type that was added under key, the kind in the key is what
+    // keeps a camera from being found as a path
+    template<class T>
+    std::shared_ptr<T> Find(const Key& key)
+    {
+        return std::static_pointer_cast<T>(FindObject(key));
+    }
+
+    // Replaces anything already resident under key and may evict other entries to make room
+    void Add(const Key& key, std::shared_ptr<void> object, size_t sizeInBytes);
+
+    // Pins are counted and can be taken before the asset is loaded, whatever is later added
+    // under the key is then kept until the last Unpin()
+    void Pin(const Key& key);
+    void Unpin(const Key& key);
+    bool IsPinned(const Key& key) const;
+
+    // Drops everything that isn't pinned
+    void Clear();
+
+    Stats GetStats() const;
+
+private:
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            return key.mHash;
+        }
+    };
+
+    struct Entry
+    {
+        Key mKey;
+        std::shared_ptr<void> mObject;
+        size_t mSize;
+    };
+    using Entries = std::list<Entry>;
+
+    std::shared_ptr<void> FindObject(const Key& key);
+    bool IsPinnedLocked(const Key& key) const;
+
+    // Unlinks entries until under budget, they are handed back so that they are destroyed
+    // after the lock has been released
+    void Evict(std::vector<std::shared_ptr<void>>& evicted);
+
+    mutable std::mutex mMutex;
+
+    // Most recently used at the front
+    Entries mLru;
+    std::unordered_map<Key, Entries::iterator, KeyHash> mEntries;
+    std::unordered_map<Key, u32, KeyHash> mPins;
+    Stats mStats;
+};
@@ -17,10 +17,17 @@
 #include "proxy_rapidjson.hpp"
 #include "filesystem.hpp"
 #include "sound_resources.hpp"
+#include "jobsystem.hpp"
+#include "oddlib/hashindex.hpp"
+#include "stringmap.hpp"
+#include "symbol.hpp"
+#include "residency.hpp"
+#include "decodedassetcache.hpp"
 
 #include "gamedefinition.hpp" // DataPaths
 #include "imgui/imgui.h"
 #include <future>
+#include <condition_variable>
 
 namespace Oddlib
 {
@@ -32,6 +39,8 @@ inline std::vector<u8> StringToVector(const std::string& str)
     return std::vector<u8>(str.begin(), str.end());
 }
 
+// The tables are only written while parsing the json, once a ResourceMapper is handed to a
+// ResourceLocator the const Find* methods are safe to call from any thread without locking.
 class ResourceMapper
 {
 public:
@@ -55,16 +64,26 @@ public:
         return *this;
     }
 
+    // If precompiledFile is given and was built from the same json then it is loaded instead of
+    // parsing the json, otherwise the json is parsed and precompiledFile is (re)written for next time.
     ResourceMapper(IFileSystem& fileSystem,
         const char* dataSetContentsFile,
         const char* animationResourceFile,
         const char* soundResourceMapFile,
         const char* pathsResourceMapFile,
-        const char* fmvsResourceMapFile);
+        const char* fmvsResourceMapFile,
+        const char* precompiledFile = nullptr);
+
+    // Binary form of everything loaded from the json, see resourcedb.cpp. sourceHash identifies the
+    // json it was built from, LoadPrecompiled() rejects anything that doesn't match it.
+    static u32 PrecompiledSourceHash(const std::vector<std::string>& jsonFiles);
+    std::vector<u8> SavePrecompiled(u32 sourceHash) const;
+    bool LoadPrecompiled(const u8* data, size_t size, u32 sourceHash);
 
     struct AnimFile
     {
-        std::string mFile;
+        // Interned when the map is loaded since it is part of every cache key for this animation
+        Symbol mFile;
         u32 mId;
         u32 mAnimationIndex;
     };
@@ -94,14 +113,9 @@ public:
     };
 
 
-    const FmvMapping* FindFmv(const char* resourceName)
+    const FmvMapping* FindFmv(const char* resourceName) const
     {
-        const auto it = mFmvMaps.find(resourceName);
-        if (it != std::end(mFmvMaps))
-        {
-            return &it->second;
-        }
-        return nullptr;
+        return mFmvMaps.Find(resourceName);
     }
 
     struct PathLocation
@@ -134,19 +148,14 @@ public:
         }
     };
 
-    const SoundResource* FindSound(const char* resourceName)
+    const SoundResource* FindSound(const char* resourceName) const
     {
         return mSoundResources.FindSound(resourceName);
     }
 
-    const PathMapping* FindPath(const char* resourceName)
+    const PathMapping* FindPath(const char* resourceName) const
     {
-        const auto it = mPathMaps.find(resourceName);
-        if (it != std::end(mPathMaps))
-        {
-            return &it->second;
-        }
-        return nullptr;
+        return mPathMaps.Find(resourceName);
     }
 
     struct AnimMapping
@@ -158,20 +167,15 @@ public:
         std::vector<AnimFileLocations> mLocations;
     };
 
-    const AnimMapping* FindAnimation(const char* resourceName)
+    const AnimMapping* FindAnimation(const char* resourceName) const
     {
-        const auto& am = mAnimMaps.find(resourceName);
-        if (am != std::end(mAnimMaps))
-        {
-            return &am->second;
-        }
-        return nullptr;
+        return mAnimMaps.Find(resourceName);
     }
 
     struct DataSetFileAttributes
     {
-        // LVL this data set file lives in
-        std::string mLvlName;
+        // LVL this data set file lives in, interned when the map is loaded
+        Symbol mLvlName;
 
         // Is this lvl a PSX lvl?
         bool mIsPsx;
@@ -183,39 +187,31 @@ public:
         bool mScaleFrameOffsets;
     };
 
-    const std::vector<DataSetFileAttributes>* FindFileLocation(const char* dataSetName, const char* fileName)
+    const std::vector<DataSetFileAttributes>* FindFileLocation(const char* dataSetName, const char* fileName) const
     {
-        auto fileIt = mFileLocations.find(fileName);
-        if (fileIt != std::end(mFileLocations))
-        {
-            auto dataSetIt = fileIt->second.find(dataSetName);
-            if (dataSetIt != std::end(fileIt->second))
-            {
-                return &dataSetIt->second;
-            }
-        }
-        return nullptr;
+        const auto* dataSets = mFileLocations.Find(fileName);
+        return dataSets ? dataSets->Find(dataSetName) : nullptr;
     }
 
 
-    const DataSetFileAttributes* FindFileAttributes(const std::string& fileName, const std::string& dataSetName, const std::string& lvlName)
+    const DataSetFileAttributes* FindFileAttributes(const std::string& fileName, const std::string& dataSetName, const std::string& lvlName) const
     {
-        auto fileNameIt = mFileLocations.find(fileName);
-        if (fileNameIt == std::end(mFileLocations))
+        const auto* dataSets = mFileLocations.Find(fileName);
+        if (!dataSets)
         {
             return nullptr;
         }
 
-        auto dataSetIt = fileNameIt->second.find(dataSetName);
-        if (dataSetIt == std::end(fileNameIt->second))
+        const std::vector<DataSetFileAttributes>* lvls = dataSets->Find(dataSetName);
+        if (!lvls)
         {
             return nullptr;
         }
 
-        // TODO: More performant look up
-        for (const DataSetFileAttributes& attr : dataSetIt->second)
+        // A file is only ever in a handful of a data set's LVLs, a scan beats hashing the name
+        for (const DataSetFileAttributes& attr : *lvls)
         {
-            if (attr.mLvlName == lvlName)
+            if (attr.mLvlName.Str() == lvlName)
             {
                 return &attr;
             }
@@ -247,13 +243,17 @@ public:
     };
     UiContext mUi;
 
-    const std::map<std::string, ResourceMapper::PathMapping>& PathMaps() const { return mPathMaps; }
+    // Iterate in name order
+    const StringMap<ResourceMapper::PathMapping>& PathMaps() const { return mPathMaps; }
+    const StringMap<ResourceMapper::AnimMapping>& AnimMaps() const { return mAnimMaps; }
 
 private:
+    // Called once everything is loaded
+    void SortMaps();
 
-    std::map<std::string, AnimMapping> mAnimMaps;
-    std::map<std::string, FmvMapping> mFmvMaps;
-    std::map<std::string, PathMapping> mPathMaps;
+    StringMap<AnimMapping> mAnimMaps;
+    StringMap<FmvMapping> mFmvMaps;
+    StringMap<PathMapping> mPathMaps;
     SoundResources mSoundResources;
 
     friend class Sound; // TODO: Temp debug ui
@@ -337,7 +337,8 @@ private:
         }
     }
 
-    std::map<std::string, std::map<std::string, std::vector<DataSetFileAttributes>>> mFileLocations;
+    // File name -> data set name -> LVLs the file is in
+    StringMap<StringMap<std::vector<DataSetFileAttributes>>> mFileLocations;
 
     template<typename JsonObject>
     void ParseFileLocations(const JsonObject& obj)
@@ -361,7 +362,7 @@ private:
             JsonDeserializer::ReadStringArray("files", lvlRecord, lvlFiles);
             for (const std::string& fileName : lvlFiles)
             {
-                dataSetAttributes.mLvlName = lvlName;
+                dataSetAttributes.mLvlName = Symbol(lvlName);
                 mFileLocations[fileName][dataSetName].push_back(dataSetAttributes);
             }
         }
@@ -393,7 +394,7 @@ private:
         ParseAnimResourceLocations(obj, mapping);
 
         const auto& name = obj["name"].GetString();
-        if (!mAnimMaps.insert(std::make_pair(name, mapping)).second)
+        if (!mAnimMaps.Insert(name, mapping).second)
         {
             throw std::runtime_error(std::string(name) + " animation resource was already added! Remove the duplicate from the json.");
         }
@@ -453,7 +454,7 @@ private:
             {
                 AnimFile animFile;
 
-                animFile.mFile = file["filename"].GetString();
+                animFile.mFile = Symbol(file["filename"].GetString());
                 animFile.mId = file["id"].GetInt();
                 animFile.mAnimationIndex = file["index"].GetInt();
 
@@ -482,8 +483,8 @@ private:
         }
     }
 public:
-    const SoundBankLocation* FindSoundBank(const std::string& soundBank);
-    const MusicTheme* FindSoundTheme(const char* themeName);
+    const SoundBankLocation* FindSoundBank(const std::string& soundBank) const;
+    const MusicTheme* FindSoundTheme(const char* themeName) const;
     const std::vector<SoundResource>& GetSoundResources() const;
     const std::vector<SoundBankLocation>& GetSoundBankResources() const;
 };
@@ -513,6 +514,12 @@ public:
         const Oddlib::Animation& Animation() const;
         u32 MaxW() const;
         u32 MaxH() const;
+        TextureHandle FrameTexture(AbstractRenderer& rend, const Oddlib::Animation::Frame& frame) const;
+
+        // The palette texture to draw FrameTexture() with, palette instead of the set's own if given. Invalid if the
+        // set isn't indexed or rend can't draw indexed textures, FrameTexture() is RGBA then.
+        using SP_Palette = std::shared_ptr<const Oddlib::AnimationSet::Palette>;
+        TextureHandle PaletteTexture(AbstractRenderer& rend, const SP_Palette& palette) const;
     private:
         std::shared_ptr<Oddlib::LvlArchive> mLvlPtr;
         std::shared_ptr<Oddlib::AnimationSet> mAnimSetPtr;
@@ -539,6 +546,11 @@ public:
     s32 FrameNumber() const;
     u32 NumberOfFrames() const;
     void SetScale(f32 scale);
+
+    // Draws the frames with palette rather than the colours they were decoded with, i.e for tinting a possessed Slig.
+    // Costs nothing when the animation set is indexed, has no effect when it isn't. nullptr goes back to the set's
+    // own colours. The palette must not be modified after it has been used, set a new one instead.
+    void SetPalette(AnimationSetHolder::SP_Palette palette);
 private:
 
     // 640 (pc xres) / 368 (psx xres) = 1.73913043478 scale factor
@@ -551,6 +563,7 @@ private:
     bool mScaleFrameOffsets = false;
     std::string mSourceDataSet;
     AbstractRenderer::eBlendModes mBlendingMode = AbstractRenderer::eBlendModes::eNormal;
+    AnimationSetHolder::SP_Palette mPalette;
 
     // The "FPS" of the animation, set to 1 first so that the first Update() brings us from frame -1 to 0
     u32 mFrameDelay = 1;
@@ -567,27 +580,11 @@ private:
     bool mCompleted = false;
 };
 
-template<typename KeyType, typename ValueType>
-class AutoRemoveFromContainerDeleter
-{
-private:
-    using Container = std::map<KeyType, std::weak_ptr<ValueType>>;
-    Container* mContainer;
-    KeyType mKey;
-public:
-    AutoRemoveFromContainerDeleter(Container* container, KeyType key)
-        : mContainer(container), mKey(key)
-    {
-    }
-
-    void operator()(ValueType* ptr)
-    {
-        mContainer->erase(mKey);
-        delete ptr;
-    }
-};
-
-// Thread safe
+// Thread safe. Holds weak references so objects are freed as soon as the last user lets go of them.
+// GetOrAdd*() also coalesces in-flight loads: if another thread is already creating the object for
+// a key then the caller waits for and shares that result (including a failed load or exception)
+// rather than loading its own copy. Waiting is per key, so loads of different LVLs/anim sets still
+// happen in parallel.
 class ResourceCache
 {
 public:
@@ -595,56 +592,207 @@ public:
     ResourceCache(const ResourceCache&) = delete;
     ResourceCache& operator = (const ResourceCache&) = delete;
 
-    std::shared_ptr<Oddlib::LvlArchive> AddLvl(std::unique_ptr<Oddlib::LvlArchive> uptr, const std::string& dataSetName, const std::string& lvlArchiveFileName)
+    // Keys are made of names interned up front with the hash worked out when the key is built, so
+    // finding an entry doesn't hash or compare any strings or take the symbol pool lock
+    struct LvlKey
     {
-        std::string key = dataSetName + lvlArchiveFileName;
-        return Add(key, mOpenLvls, std::move(uptr));
+        LvlKey(const Symbol& dataSetName, const Symbol& lvlArchiveFileName)
+            : mDataSet(dataSetName), mLvl(lvlArchiveFileName),
+              mHash(Oddlib::HashU32(mDataSet.Hash() ^ Oddlib::HashU32(mLvl.Hash())))
+        {
+        }
+
+        bool operator == (const LvlKey& rhs) const
+        {
+            return mDataSet == rhs.mDataSet && mLvl == rhs.mLvl;
+        }
+
+        Symbol mDataSet;
+        Symbol mLvl;
+        u32 mHash;
+    };
+
+    struct AnimSetKey
+    {
+        AnimSetKey(const LvlKey& lvl, const Symbol& lvlFileName, u32 chunkId)
+            : mLvl(lvl), mFile(lvlFileName), mChunkId(chunkId),
+              mHash(Oddlib::HashU32(mLvl.mHash ^ Oddlib::HashU32(mFile.Hash() ^ Oddlib::HashU32(chunkId))))
+        {
+        }
+
+        bool operator == (const AnimSetKey& rhs) const
+        {
+            return mChunkId == rhs.mChunkId && mFile == rhs.mFile && mLvl == rhs.mLvl;
+        }
+
+        LvlKey mLvl;
+        Symbol mFile;
+        u32 mChunkId;
+        u32 mHash;
+    };
+
+    template<class Factory>
+    std::shared_ptr<Oddlib::LvlArchive> GetOrAddLvl(const LvlKey& key, Factory factory)
+    {
+        return GetOrAdd<Oddlib::LvlArchive>(key, mOpenLvls, factory);
     }
 
-    std::shared_ptr<Oddlib::LvlArchive> GetLvl(const std::string& dataSetName, const std::string& lvlArchiveFileName)
+    std::shared_ptr<Oddlib::LvlArchive> GetLvl(const LvlKey& key)
     {
-        std::string key = dataSetName + lvlArchiveFileName;
         return Get<Oddlib::LvlArchive>(key, mOpenLvls);
     }
 
-    std::shared_ptr<Oddlib::AnimationSet> AddAnimSet(std::unique_ptr<Oddlib::AnimationSet> uptr, const std::string& dataSetName, const std::string& lvlArchiveFileName, const std::string& lvlFileName, u32 chunkId)
+    template<class Factory>
+    std::shared_ptr<Oddlib::AnimationSet> GetOrAddAnimSet(const AnimSetKey& key, Factory factory)
     {
-        std::string key = dataSetName + lvlArchiveFileName + lvlFileName + std::to_string(chunkId);
-        return Add(key, mAnimationSets, std::move(uptr));
+        return GetOrAdd<Oddlib::AnimationSet>(key, mAnimationSets, factory);
     }
 
-    std::shared_ptr<Oddlib::AnimationSet> GetAnimSet(const std::string& dataSetName, const std::string& lvlArchiveFileName, const std::string& lvlFileName, u32 chunkId)
+    std::shared_ptr<Oddlib::AnimationSet> GetAnimSet(const AnimSetKey& key)
     {
-        std::string key = dataSetName + lvlArchiveFileName + lvlFileName + std::to_string(chunkId);
         return Get<Oddlib::AnimationSet>(key, mAnimationSets);
     }
 
+    struct Stats
+    {
+        u32 mLoads = 0;      // Factory calls
+        u32 mCoalesced = 0;  // Callers that waited on another thread's load instead of loading
+        u32 mHits = 0;       // Callers that found a live object
+    };
+
+    Stats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mStats;
+    }
+
 private:
-    template<class ObjectType, class KeyType, class Container>
-    std::shared_ptr<ObjectType> Add(KeyType& key, Container& container, std::unique_ptr<ObjectType> uptr)
+    template<class KeyType>
+    struct KeyHash
     {
-        assert(container.find(key) == std::end(container));
+        size_t operator()(const KeyType& key) const
+        {
+            return key.mHash;
+        }
+    };
+
+    template<class ObjectType, class KeyType>
+    struct Container
+    {
+        std::unordered_map<KeyType, std::weak_ptr<ObjectType>, KeyHash<KeyType>> mLoaded;
+        std::unordered_map<KeyType, std::shared_future<std::shared_ptr<ObjectType>>, KeyHash<KeyType>> mInFlight;
+    };
+
+    // Removes the cache entry when the object dies, unless the key has already been reused for a new object
+    template<class ObjectType, class KeyType>
+    class Deleter
+    {
+    public:
+        Deleter(ResourceCache* cache, Container<ObjectType, KeyType>* container, const KeyType& key)
+            : mCache(cache), mContainer(container), mKey(key)
+        {
+        }
+
+        void operator()(ObjectType* ptr)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mCache->mMutex);
+                auto it = mContainer->mLoaded.find(mKey);
+                if (it != std::end(mContainer->mLoaded) && it->second.expired())
+                {
+                    mContainer->mLoaded.erase(it);
+                }
+            }
+            delete ptr;
+        }
+    private:
+        ResourceCache* mCache;
+        Container<ObjectType, KeyType>* mContainer;
+        KeyType mKey;
+    };
+
+    template<class ObjectType, class KeyType>
+    std::shared_ptr<ObjectType> Get(const KeyType& key, Container<ObjectType, KeyType>& container)
+    {
+        // Declared before the lock so that if this turns out to be the last reference the
+        // object is destroyed (which takes the lock again) after unlocking
+        std::shared_ptr<ObjectType> sptr;
         std::lock_guard<std::mutex> lock(mMutex);
-        std::shared_ptr<ObjectType> sptr(uptr.release(), AutoRemoveFromContainerDeleter<KeyType, ObjectType>(&container, key));
-        container.insert(std::make_pair(key, sptr));
+        auto it = container.mLoaded.find(key);
+        if (it != std::end(container.mLoaded))
+        {
+            sptr = it->second.lock();
+        }
         return sptr;
     }
 
-    template<class ObjectType, class KeyType, class Container>
-    std::shared_ptr<ObjectType> Get(KeyType& key, Container& container)
+    template<class ObjectType, class KeyType, class Factory>
+    std::shared_ptr<ObjectType> GetOrAdd(const KeyType& key, Container<ObjectType, KeyType>& container, Factory& factory)
     {
-        std::lock_guard<std::mutex> lock(mMutex);
-        auto it = container.find(key);
-        if (it != std::end(container))
+        std::shared_ptr<ObjectType> sptr;
+        std::shared_future<std::shared_ptr<ObjectType>> inFlight;
+        std::promise<std::shared_ptr<ObjectType>> result;
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        auto it = container.mLoaded.find(key);
+        if (it != std::end(container.mLoaded))
+        {
+            sptr = it->second.lock();
+            if (sptr)
+            {
+                mStats.mHits++;
+                return sptr;
+            }
+        }
+
+        auto flightIt = container.mInFlight.find(key);
+        if (flightIt != std::end(container.mInFlight))
         {
-            return it->second.lock();
+            // Someone else is loading it, share whatever they end up with
+            mStats.mCoalesced++;
+            inFlight = flightIt->second;
+            lock.unlock();
+            return inFlight.get();
         }
-        return nullptr;
+
+        // This thread is now the one loading key
+        container.mInFlight[key] = result.get_future().share();
+        mStats.mLoads++;
+        lock.unlock();
+
+        std::unique_ptr<ObjectType> uptr;
+        try
+        {
+            uptr = factory();
+        }
+        catch (...)
+        {
+            lock.lock();
+            container.mInFlight.erase(key);
+            lock.unlock();
+            result.set_exception(std::current_exception());
+            throw;
+        }
+
+        lock.lock();
+        if (uptr)
+        {
+            sptr = std::shared_ptr<ObjectType>(uptr.release(), Deleter<ObjectType, KeyType>(this, &container, key));
+            container.mLoaded[key] = sptr;
+        }
+
+        // A failed load isn't remembered, the next caller that isn't already waiting tries again
+        container.mInFlight.erase(key);
+        lock.unlock();
+
+        result.set_value(sptr);
+        return sptr;
     }
 
     std::mutex mMutex;
-    std::map<std::string, std::weak_ptr<Oddlib::LvlArchive>> mOpenLvls;
-    std::map<std::string, std::weak_ptr<Oddlib::AnimationSet>> mAnimationSets;
+    Stats mStats;
+    Container<Oddlib::LvlArchive, LvlKey> mOpenLvls;
+    Container<Oddlib::AnimationSet, AnimSetKey> mAnimationSets;
 };
 
 // TODO: Provide higher level abstraction
@@ -700,15 +848,27 @@ public:
     std::unique_ptr<Oddlib::IStream> mSeqData;
 };
 
-using future_UP_Path = std::future<Oddlib::UP_Path>;
-using up_future_UP_Path = std::unique_ptr<future_UP_Path>;
-
+using future_SP_Path = std::future<Oddlib::SP_Path>;
+using up_future_SP_Path = std::unique_ptr<future_SP_Path>;
+
+// Locate* requests run concurrently: the mapper tables are read only, LVLs and anim sets are
+// shared/de-duplicated via mCache and each file system/LVL guards its own stream. So the cameras of
+// neighbouring screens, an animation set and a sound only wait on each other when they need the
+// same LVL to be opened. The active data paths must not be changed while requests are in flight.
+// Decoded cameras, paths and animation sets stay resident in mResidency after they are released,
+// within its byte budget, so returning to a screen doesn't decode it again.
+// Requests are jobs on jobSystem, the futures are ready as soon as the job has run (when requested
+// from a job they run right away on the calling worker).
 class ResourceLocator
 {
 public:
     ResourceLocator(const ResourceLocator&) = delete;
     ResourceLocator& operator =(const ResourceLocator&) = delete;
-    ResourceLocator(ResourceMapper&& resourceMapper, DataPaths&& dataPaths);
+    // When given a decodedCache cameras and animation sets from the data sets are loaded from and
+    // saved to it, it must outlive the locator
+    ResourceLocator(ResourceMapper&& resourceMapper, DataPaths&& dataPaths, JobSystem& jobSystem, DecodedAssetCache* decodedCache = nullptr);
+
+    // Waits for running requests, queued requests that haven't started yet return nothing
     ~ResourceLocator();
 
     // TOOD: Provide limited interface to this?
@@ -718,18 +878,24 @@ public:
     }
     
     // Not thread safe - only used by debug path browsers etc
-    const std::map<std::string, ResourceMapper::PathMapping>& PathMaps() const { return mResMapper.PathMaps(); }
+    const StringMap<ResourceMapper::PathMapping>& PathMaps() const { return mResMapper.PathMaps(); }
+
+    ResidencyManager& Residency() { return mResidency; }
+
+    // Decode animation sets as palette indices rather than RGBA, see Oddlib::AnimationSet. Not thread safe,
+    // must be set before any animations are located.
+    void SetIndexedAnimations(bool indexed) { mIndexedAnimations = indexed; }
 
     std::future<std::string> LocateScript(const std::string& scriptName);
 
-    std::future<std::unique_ptr<ISound>> LocateSound(const std::string& resourceName, const std::string& explicitSoundBankName = "", bool useMusicRec = true, bool useSfxRec = true);
+    std::future<std::unique_ptr<ISound>> LocateSound(const std::string& resourceName, const std::string& explicitSoundBankName = "", bool useMusicRec = true, bool useSfxRec = true, JobPriority priority = JobPriority::eNormal);
     std::future<const MusicTheme*> LocateSoundTheme(const std::string& themeName);
 
     // TODO: Should be returning higher level abstraction
-    up_future_UP_Path LocatePath(const std::string& resourceName);
-    std::future<std::unique_ptr<Oddlib::IBits>> LocateCamera(const std::string& resourceName);
+    up_future_SP_Path LocatePath(const std::string& resourceName, JobPriority priority = JobPriority::eNormal);
+    std::future<std::shared_ptr<Oddlib::IBits>> LocateCamera(const std::string& resourceName, JobPriority priority = JobPriority::eHigh);
     std::future<std::unique_ptr<class IMovie>> LocateFmv(class IAudioController& audioController, const std::string& resourceName, const ResourceMapper::FmvFileLocation* location);
-    std::future<std::unique_ptr<Animation>> LocateAnimation(const std::string& resourceName);
+    std::future<std::unique_ptr<Animation>> LocateAnimation(const std::string& resourceName, JobPriority priority = JobPriority::eNormal);
 
     // This method should be used for debugging only - i.e so we can compare what resource X looks like
     // in dataset A and B.
@@ -738,8 +904,32 @@ public:
     // Not thread safe
     std::vector<std::tuple<const char*, const char*, bool>> DebugUi(const char* dataSetFilter, const char* nameFilter);
 
-    std::future<std::unique_ptr<Vab>> LocateVab(const std::string& dataSetName, const std::string& baseVabName);
+    std::future<std::unique_ptr<Vab>> LocateVab(const std::string& dataSetName, const std::string& baseVabName, JobPriority priority = JobPriority::eNormal);
 private:
+    template<class Func>
+    std::future<typename std::result_of<Func()>::type> Run(JobPriority priority, Func func);
+
+    // For work that nothing waits on, i.e. writing to the decoded asset cache. It is queued as a
+    // low priority job even when called from a request, so that request's future isn't held up.
+    template<class Func>
+    void RunInBackground(Func func);
+
+    // Wraps func so that it does nothing once the locator is being destroyed, and so that the
+    // destructor waits for it if it is running
+    template<class Func>
+    std::function<typename std::result_of<Func()>::type()> Guarded(Func func);
+
+    // Shared with the queued jobs so that they can tell if the locator has gone away
+    struct Requests
+    {
+        std::mutex mMutex;
+        std::condition_variable mIdle;
+        u32 mRunning = 0;
+        bool mClosed = false;
+    };
+    std::shared_ptr<Requests> mRequests = std::make_shared<Requests>();
+    JobSystem& mJobSystem;
+
     std::unique_ptr<ISound> DoLoadSoundEffect(const char* resourceName, const DataPaths::FileSystemInfo& fs, const std::string& strSb, const SoundEffectResource& sfxRes, const SoundEffectResourceLocation& sfxResLoc);
     std::unique_ptr<ISound> DoLoadSoundMusic(const char* resourceName, const DataPaths::FileSystemInfo& fs, const std::string& strSb, const MusicResource& sfxRes);
 
@@ -749,19 +939,22 @@ private:
 
     std::unique_ptr<IMovie> DoLocateFmvFromFileLocation(const ResourceMapper::FmvFileLocation& location, const DataPaths::FileSystemInfo& fs, const char* resourceName, IAudioController& audioController);
 
-    std::unique_ptr<Oddlib::IBits> DoLocateCamera(const char* resourceName, bool ignoreMods);
+    std::shared_ptr<Oddlib::IBits> DoLocateCamera(const char* resourceName, bool ignoreMods);
 
-    std::shared_ptr<Oddlib::LvlArchive> OpenLvl(IFileSystem& fs, const std::string& dataSetName, const std::string& lvlName);
+    std::shared_ptr<Oddlib::LvlArchive> OpenLvl(IFileSystem& fs, const ResourceCache::LvlKey& key);
 
     ResourceCache mCache;
+    DecodedAssetCache* mDecodedCache = nullptr;
+    bool mIndexedAnimations = false;
     ResourceMapper mResMapper;
     DataPaths mDataPaths;
 
+    // After mCache and mDataPaths so the resident assets are released before them
+    ResidencyManager mResidency;
+
     friend class FmvDebugUi; // TODO: Temp debug ui
     friend class World; // TODO: Temp debug ui
     friend class Sound; // TODO: Temp debug ui
-
-    std::mutex mMutex;
 public:
     const std::vector<SoundResource>& GetSoundResources() const;
     const std::vector<SoundBankLocation>& GetSoundBankResources() const;
@@ -24,7 +24,7 @@ public:
 class MusicResource
 {
 public:
-    u32 mResourceId;
+    u32 mResourceId = 0;
     std::set<std::string> mSoundBanks;
 };
 
@@ -33,17 +33,17 @@ class SoundEffectResourceLocation
 public:
     // Because each sound of sound banks can be in another data set 
     // the program/tone can also change between them
-    s32 mProgram;
-    s32 mTone;
+    s32 mProgram = 0;
+    s32 mTone = 0;
     std::set<std::string> mSoundBanks;
 };
 
 class SoundEffectResource
 {
 public:
-    s32 mVolume;
-    s32 mMinPitch;
-    s32 mMaxPitch;
+    s32 mVolume = 0;
+    s32 mMinPitch = 0;
+    s32 mMaxPitch = 0;
     std::vector<SoundEffectResourceLocation> mSoundBanks;
 };
 
@@ -51,7 +51,7 @@ class SoundResource
 {
 public:
     std::string mResourceName;
-    bool mIsCacheResident;
+    bool mIsCacheResident = false;
     MusicResource mMusic;
     SoundEffectResource mSoundEffect;
     std::string mComment;
@@ -62,7 +62,7 @@ class MusicThemeEntry
 {
 public:
     std::string mMusicName;
-    s32 mLoopCount;
+    s32 mLoopCount = 0;
 };
 
 class MusicTheme
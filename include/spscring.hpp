@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <cstddef>
+
+// Bounded lock free queue for exactly one producer thread and one consumer thread.
+// Slots are reused, so items that own memory (i.e std::vector) keep their allocations around.
+template<class T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t capacity)
+        : mItems(capacity + 1)
+    {
+
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator = (const SpscRing&) = delete;
+
+    // Producer thread context
+    bool Push(T&& item)
+    {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        const size_t next = Next(tail);
+        if (next == mHead.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        mItems[tail] = std::move(item);
+        mTail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Producer thread context, returns how many were pushed
+    template<class Iterator>
+    size_t Push(Iterator first, size_t count)
+    {
+        const size_t head = mHead.load(std::memory_order_acquire);
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        size_t pushed = 0;
+        while (pushed < count && Next(tail) != head)
+        {
+            mItems[tail] = *first++;
+            tail = Next(tail);
+            pushed++;
+        }
+        mTail.store(tail, std::memory_order_release);
+        return pushed;
+    }
+
+    // Consumer thread context, nullptr if empty. Valid until Pop().
+    T* Front()
+    {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        return &mItems[head];
+    }
+
+    // Consumer thread context
+    void Pop()
+    {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        mHead.store(Next(head), std::memory_order_release);
+    }
+
+    // Consumer thread context, returns how many were popped
+    size_t Pop(T* out, size_t count)
+    {
+        const size_t tail = mTail.load(std::memory_order_acquire);
+        size_t head = mHead.load(std::memory_order_relaxed);
+        size_t popped = 0;
+        while (popped < count && head != tail)
+        {
+            out[popped++] = std::move(mItems[head]);
+            head = Next(head);
+        }
+        mHead.store(head, std::memory_order_release);
+        return popped;
+    }
+
+    // Any thread context, only a snapshot when the other side is running
+    size_t Size() const
+    {
+        const size_t head = mHead.load(std::memory_order_acquire);
+        const size_t tail = mTail.load(std::memory_order_acquire);
+        return tail >= head ? tail - head : mItems.size() - head + tail;
+    }
+
+    size_t Capacity() const { return mItems.size() - 1; }
+    bool Empty() const { return Size() == 0; }
+    bool Full() const { return Size() == Capacity(); }
+
+    // Only when neither side is running
+    void Clear()
+    {
+        mHead.store(0);
+        mTail.store(0);
+    }
+
+private:
+    size_t Next(size_t idx) const
+    {
+        return (idx + 1) == mItems.size() ? 0 : idx + 1;
+    }
+
+    // One slot is always left empty to tell full and empty apart
+    std::vector<T> mItems;
+    std::atomic<size_t> mHead{ 0 };
+    std::atomic<size_t> mTail{ 0 };
+};
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "types.hpp"
+#include "oddlib/hashindex.hpp"
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+
+// Flat hash map from a string to T, for tables that are filled once and then only read (i.e the
+// resource maps). Entries are stored contiguously and looking up by std::string or const char*
+// doesn't allocate. Adding entries invalidates pointers/references to values.
+template<class T>
+class StringMap
+{
+public:
+    typedef std::pair<std::string, T> value_type;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+    const_iterator begin() const { return mEntries.begin(); }
+    const_iterator end() const { return mEntries.end(); }
+    size_t size() const { return mEntries.size(); }
+    bool empty() const { return mEntries.empty(); }
+
+    void reserve(size_t count)
+    {
+        mEntries.reserve(count);
+        mHashes.reserve(count);
+        if (count * 2 > mIndex.Capacity())
+        {
+            Rehash(static_cast<u32>(count));
+        }
+    }
+
+    const T* Find(const char* key) const
+    {
+        return Find(key, strlen(key));
+    }
+
+    const T* Find(const std::string& key) const
+    {
+        return Find(key.data(), key.size());
+    }
+
+    T* Find(const char* key)
+    {
+        return const_cast<T*>(static_cast<const StringMap&>(*this).Find(key));
+    }
+
+    T* Find(const std::string& key)
+    {
+        return const_cast<T*>(static_cast<const StringMap&>(*this).Find(key));
+    }
+
+    // Adds key unless it is already there, returns the value for key and whether it was added
+    std::pair<T*, bool> Insert(const std::string& key, T value)
+    {
+        const u32 hash = Oddlib::HashBytes(key.data(), key.size());
+        const u32 index = FindIndex(key.data(), key.size(), hash);
+        if (index != Oddlib::HashIndex::kNotFound)
+        {
+            return std::make_pair(&mEntries[index].second, false);
+        }
+
+        mEntries.emplace_back(key, std::move(value));
+        mHashes.push_back(hash);
+        if (mEntries.size() * 2 > mIndex.Capacity())
+        {
+            // Double up front so that filling the map is amortised O(1)
+            Rehash(static_cast<u32>(mEntries.size() * 2));
+        }
+        else
+        {
+            mIndex.Insert(hash, static_cast<u32>(mEntries.size() - 1), [](u32) { return false; });
+        }
+        return std::make_pair(&mEntries.back().second, true);
+    }
+
+    T& operator[](const std::string& key)
+    {
+        T* value = Find(key);
+        if (value)
+        {
+            return *value;
+        }
+        return *Insert(key, T()).first;
+    }
+
+    // Puts iteration in to key order, for anything that lists the entries
+    void SortByKey()
+    {
+        std::vector<u32> order(mEntries.size());
+        for (u32 i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+
+        std::sort(order.begin(), order.end(), [&](u32 a, u32 b) { return mEntries[a].first < mEntries[b].first; });
+
+        std::vector<value_type> entries;
+        std::vector<u32> hashes;
+        entries.reserve(mEntries.size());
+        hashes.reserve(mHashes.size());
+        for (u32 i : order)
+        {
+            entries.emplace_back(std::move(mEntries[i]));
+            hashes.push_back(mHashes[i]);
+        }
+        mEntries = std::move(entries);
+        mHashes = std::move(hashes);
+        Rehash(static_cast<u32>(mEntries.size()));
+    }
+
+private:
+    const T* Find(const char* key, size_t length) const
+    {
+        const u32 index = FindIndex(key, length, Oddlib::HashBytes(key, length));
+        return index == Oddlib::HashIndex::kNotFound ? nullptr : &mEntries[index].second;
+    }
+
+    u32 FindIndex(const char* key, size_t length, u32 hash) const
+    {
+        return mIndex.Find(hash, [&](u32 i)
+        {
+            const std::string& entryKey = mEntries[i].first;
+            return entryKey.size() == length && memcmp(entryKey.data(), key, length) == 0;
+        });
+    }
+
+    void Rehash(u32 count)
+    {
+        // Keys are already unique so nothing needs comparing
+        mIndex.Reset(std::max(count, static_cast<u32>(mEntries.size())));
+        for (u32 i = 0; i < mEntries.size(); i++)
+        {
+            mIndex.Insert(mHashes[i], i, [](u32) { return false; });
+        }
+    }
+
+    std::vector<value_type> mEntries;
+    std::vector<u32> mHashes;
+    Oddlib::HashIndex mIndex;
+};
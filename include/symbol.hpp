@@ -0,0 +1,57 @@
+#pragma once
+
+#include "types.hpp"
+#include <string>
+#include <ostream>
+#include <functional>
+
+// Interned string. Every Symbol made from the same text refers to the same pooled copy, so copying
+// or comparing them is a pointer operation and the hash is only worked out once. Pooled strings
+// live until exit, so this is meant for bounded sets of names (data sets, LVLs, file names).
+// Thread safe.
+class Symbol
+{
+public:
+    Symbol();
+    explicit Symbol(const char* str);
+    explicit Symbol(const std::string& str);
+
+    const std::string& Str() const { return mEntry->mStr; }
+    const char* c_str() const { return mEntry->mStr.c_str(); }
+    u32 Hash() const { return mEntry->mHash; }
+    bool Empty() const { return mEntry->mStr.empty(); }
+
+    bool operator == (const Symbol& rhs) const { return mEntry == rhs.mEntry; }
+    bool operator != (const Symbol& rhs) const { return mEntry != rhs.mEntry; }
+
+    // By text rather than address so that ordering is the same every run
+    bool operator < (const Symbol& rhs) const { return mEntry != rhs.mEntry && Str() < rhs.Str(); }
+
+private:
+    struct Entry
+    {
+        std::string mStr;
+        u32 mHash;
+    };
+
+    static const Entry* Intern(const char* str, size_t length);
+
+    const Entry* mEntry;
+};
+
+inline std::ostream& operator << (std::ostream& stream, const Symbol& symbol)
+{
+    return stream << symbol.Str();
+}
+
+namespace std
+{
+    template<>
+    struct hash<Symbol>
+    {
+        size_t operator()(const Symbol& symbol) const
+        {
+            return symbol.Hash();
+        }
+    };
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <assert.h>
+
+// Chase-Lev deque of pointers, as in "Correct and Efficient Work-Stealing for Weak Memory Models"
+// (Le, Pop, Cohen, Zappa Nardelli). The owning thread pushes and pops at the bottom without any
+// locks, other threads steal from the top and only contend with each other (and with the owner for
+// the very last item). Grows when full. Replaced buffers are kept until destruction because a thief
+// may still be reading from one.
+template<class T>
+class WorkStealingDeque
+{
+public:
+    // capacity must be a power of 2
+    explicit WorkStealingDeque(int64_t capacity = 256)
+    {
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+        mBuffers.push_back(std::make_unique<Buffer>(capacity));
+        mBuffer.store(mBuffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator = (const WorkStealingDeque&) = delete;
+
+    // Owner thread context
+    void Push(T* item)
+    {
+        const int64_t bottom = mBottom.load(std::memory_order_relaxed);
+        const int64_t top = mTop.load(std::memory_order_acquire);
+        Buffer* buffer = mBuffer.load(std::memory_order_relaxed);
+        if (bottom - top > buffer->mCapacity - 1)
+        {
+            buffer = Grow(buffer, top, bottom);
+        }
+        buffer->Put(bottom, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        mBottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    // Owner thread context, newest first. nullptr if empty.
+    T* Pop()
+    {
+        const int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+        Buffer* buffer = mBuffer.load(std::memory_order_relaxed);
+        mBottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = mTop.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            mBottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* item = buffer->Get(bottom);
+        if (top == bottom)
+        {
+            // Last item, thieves might be after it too
+            if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                item = nullptr;
+            }
+            mBottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread, oldest first. nullptr if empty.
+    T* Steal()
+    {
+        for (;;)
+        {
+            int64_t top = mTop.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t bottom = mBottom.load(std::memory_order_acquire);
+            if (top >= bottom)
+            {
+                return nullptr;
+            }
+
+            Buffer* buffer = mBuffer.load(std::memory_order_acquire);
+            T* item = buffer->Get(top);
+            if (mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return item;
+            }
+            // Lost the race for it to another thief or the owner, try the next one
+        }
+    }
+
+    // Any thread, only a hint when other threads are using the deque
+    bool Empty() const
+    {
+        return mTop.load(std::memory_order_acquire) >= mBottom.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Buffer
+    {
+        explicit Buffer(int64_t capacity)
+            : mCapacity(capacity), mItems(new std::atomic<T*>[static_cast<size_t>(capacity)])
+        {
+
+        }
+
+        // Capacity is always a power of 2
+        T* Get(int64_t index) const
+        {
+            return mItems[static_cast<size_t>(index & (mCapacity - 1))].load(std::memory_order_relaxed);
+        }
+
+        void Put(int64_t index, T* item)
+        {
+            mItems[static_cast<size_t>(index & (mCapacity - 1))].store(item, std::memory_order_relaxed);
+        }
+
+        int64_t mCapacity;
+        std::unique_ptr<std::atomic<T*>[]> mItems;
+    };
+
+    // Owner thread context
+    Buffer* Grow(Buffer* buffer, int64_t top, int64_t bottom)
+    {
+        mBuffers.push_back(std::make_unique<Buffer>(buffer->mCapacity * 2));
+        Buffer* bigger = mBuffers.back().get();
+        for (int64_t i = top; i < bottom; i++)
+        {
+            bigger->Put(i, buffer->Get(i));
+        }
+        mBuffer.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    // Padded so that thieves bumping mTop don't keep taking the owner's mBottom cache line away. Padding
+    // rather than alignas as over aligned types can't be heap allocated reliably before C++17.
+    std::atomic<int64_t> mTop{ 0 };
+    char mTopPadding[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> mBottom{ 0 };
+    char mBottomPadding[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<Buffer*> mBuffer{ nullptr };
+
+    // Owner thread only
+    std::vector<std::unique_ptr<Buffer>> mBuffers;
+};
@@ -70,12 +70,27 @@ public:
     u32 CurrentCameraX() const { return mCurrentCameraX; }
     u32 CurrentCameraY() const { return mCurrentCameraY; }
 
+    // Keeps the cameras of the screen at x,y and the 8 around it resident and starts decoding any
+    // that aren't loaded yet in the background, along with the screen after next in the direction
+    // of travel. Replaces whatever was pinned for the previous screen.
+    void SetActiveScreen(s32 x, s32 y);
+    void ClearActiveScreen();
+
+    // Starts the staged texture uploads of prefetched screens whose cameras have finished decoding
+    void UploadPrefetchedScreens(AbstractRenderer& rend);
+
     std::unique_ptr<PlayFmvState> mPlayFmvState;
     u32 mGlobalFrameCounter = 0;
 private:
     void RenderGrid(AbstractRenderer& rend) const;
     u32 mCurrentCameraX = 0;
     u32 mCurrentCameraY = 0;
+
+    ResidencyManager& mResidency;
+    std::vector<ResidencyManager::Key> mPinnedScreens;
+    std::vector<GridScreen*> mPrefetchingScreens;
+    s32 mActiveX = -1;
+    s32 mActiveY = -1;
 };
 
 class World
@@ -108,8 +123,8 @@ private:
     std::unique_ptr<class EditorMode> mEditorMode;
     std::unique_ptr<class GameMode> mGameMode;
 
-    up_future_UP_Path mLocatePathFuture;
-    Oddlib::UP_Path mPathBeingLoaded;
+    up_future_SP_Path mLocatePathFuture;
+    Oddlib::SP_Path mPathBeingLoaded;
 
 
     ResourceLocator& mLocator;
@@ -42,6 +42,8 @@ private:
     bool LocateEndOfCentralDirectoryRecord();
     bool LoadCentralDirectoryRecords();
 
+    // Open() seeks around in mStream so must be serialised, everything else only reads mRecords
+    std::mutex mMutex;
     std::unique_ptr<Oddlib::IStream> mStream;
     std::string mFileName;
 
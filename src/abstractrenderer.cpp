@@ -1,5 +1,6 @@
 #include "abstractrenderer.hpp"
 #include "oddlib/exceptions.hpp"
+#include "radixsort.hpp"
 
 #include <algorithm>
 #include <cassert>
@@ -30,6 +31,10 @@
 
 #include <boost/utility/string_view.hpp>
 #include "string_util.hpp"
+#include <cstdlib>
+
+// TODO: Error message
+#define ALIVE_FATAL_ERROR() abort()
 
 glm::vec2 CoordinateSpace::WorldToScreen(const glm::vec2& worldPos)
 {
@@ -46,7 +51,10 @@ AbstractRenderer::AbstractRenderer()
     // These should be large enough so that no allocations are done during game
     mDestroyTextureList.reserve(1024);
     mPointersToOrderedCommands.reserve(1024*10);
+    mSortScratch.reserve(1024*10);
     mDrawCommandBuffer.reserve(1024*1024);
+    mSpriteVertices.reserve(1024*4);
+    mSpriteBatches.reserve(1024);
 
     mFontStashParams = std::make_unique<FONSparams>();
     mFontStashParams->userPtr = this;
@@ -93,7 +101,9 @@ void AbstractRenderer::Init(const char* regularFontPath, const char* italticFont
 
 void AbstractRenderer::ShutDown()
 {
+    mStagedUploads.clear();
     DestroyTexture(mFontStashTexture);
+    DestroyExpiredCachedTextures(true);
     DestroyTextures();
     if (mFontStashContext)
     {
@@ -134,28 +144,30 @@ void AbstractRenderer::Clear(f32 r, f32 g, f32 b)
 
 void AbstractRenderer::EndFrame()
 {
+    UploadStagedTextures();
+
     AddUiCmd();
 
     if (!mDrawCommandBuffer.empty())
     {
         u8* ptr = mDrawCommandBuffer.data();
+        u32 submissionIndex = 0;
         do
         {
-            mPointersToOrderedCommands.push_back(ptr);
-            ptr += reinterpret_cast<CmdHeader*>(ptr)->mSize;
+            const CmdHeader* header = reinterpret_cast<CmdHeader*>(ptr);
+            mPointersToOrderedCommands.push_back(SortedCmd{ SortKey(*header, submissionIndex++), ptr });
+            ptr += header->mSize;
         } while (ptr != mDrawCommandBuffer.data() + mDrawCommandBuffer.size());
 
         // This is the primary reason for buffering drawing command. Call order doesn't determine draw order, but layers do.
-        std::stable_sort(mPointersToOrderedCommands.begin(), mPointersToOrderedCommands.end(), [](const u8* a, const u8* b)
-        {
-            return (*reinterpret_cast<const CmdHeader*>(a)).mLayer < (*reinterpret_cast<const CmdHeader*>(b)).mLayer;
-        });
+        RadixSortByKey(mPointersToOrderedCommands, mSortScratch);
 
         generateImGuiCommands();
     }
 
     RenderCommandsImpl();
 
+    DestroyExpiredCachedTextures(false);
     DestroyTextures();
     mScreenSizeChanged = false;
 
@@ -163,18 +175,165 @@ void AbstractRenderer::EndFrame()
     mDrawList.Clear();
     mDrawCommandBuffer.clear();
     mPointersToOrderedCommands.clear();
+    mSpriteVertices.clear();
+    mSpriteBatches.clear();
     mRenderDrawLists.clear();
     mRenderDrawData.CmdListsCount = 0;
 }
 
+/*static*/ u64 AbstractRenderer::SortKey(const CmdHeader& header, u32 submissionIndex)
+{
+    // Layer in the high bits, submission index in the low bits. Commands in the same layer can
+    // overlap (the UI is drawn in the FMV layer after the video quad) so they must stay in call
+    // order, the sprite batcher still merges neighbouring quads that share state.
+    const u64 layer = header.mLayer > 0xFFFF ? 0xFFFF : header.mLayer;
+    return (layer << 32) | submissionIndex;
+}
+
+/*static*/ u32 AbstractRenderer::BytesPerPixel(eTextureFormats format)
+{
+    switch (format)
+    {
+    case eTextureFormats::eRGBA:
+        return 4;
+    case eTextureFormats::eRGB:
+        return 3;
+    case eTextureFormats::eA:
+        return 1;
+    case eTextureFormats::eR:
+        return 1;
+    }
+    ALIVE_FATAL_ERROR();
+}
+
 void AbstractRenderer::DestroyTexture(TextureHandle handle)
 {
     if (handle.IsValid())
     {
+        mStagedUploads.erase(std::remove_if(mStagedUploads.begin(), mStagedUploads.end(), [&](const StagedUpload& upload)
+        {
+            return upload.mTexture.mData == handle.mData;
+        }), mStagedUploads.end());
+
         mDestroyTextureList.push_back(handle); // Delay the deletion after drawing current frame
     }
 }
 
+TextureHandle AbstractRenderer::CreateTextureStaged(eTextureFormats internalFormat, u32 width, u32 height, eTextureFormats inputFormat, const void *pixels, std::shared_ptr<const void> pixelsOwner, bool interpolation)
+{
+    // An empty alpha only texture can't be created, there is nothing to expand to RGBA
+    assert(inputFormat != eTextureFormats::eA);
+
+    const TextureHandle handle = CreateTexture(internalFormat, width, height, inputFormat, nullptr, interpolation);
+    if (handle.IsValid())
+    {
+        mStagedUploads.push_back(StagedUpload{ handle, width, height, 0, inputFormat, static_cast<const u8*>(pixels), std::move(pixelsOwner) });
+    }
+    return handle;
+}
+
+bool AbstractRenderer::IsStagedUploadDone(TextureHandle handle) const
+{
+    for (const StagedUpload& upload : mStagedUploads)
+    {
+        if (upload.mTexture.mData == handle.mData)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AbstractRenderer::FinishStagedUpload(TextureHandle handle)
+{
+    for (auto it = mStagedUploads.begin(); it != mStagedUploads.end(); ++it)
+    {
+        if (it->mTexture.mData == handle.mData)
+        {
+            UploadStagedRows(*it, it->mHeight - it->mNextRow);
+            mStagedUploads.erase(it);
+            return;
+        }
+    }
+}
+
+void AbstractRenderer::UploadStagedRows(StagedUpload& upload, u32 rows)
+{
+    const u32 rowSize = upload.mWidth * BytesPerPixel(upload.mInputFormat);
+    UpdateTextureRows(upload.mTexture, upload.mNextRow, upload.mWidth, rows, upload.mInputFormat, upload.mPixels + (upload.mNextRow * rowSize));
+    upload.mNextRow += rows;
+}
+
+void AbstractRenderer::UploadStagedTextures()
+{
+    u32 budget = mStagedUploadBudget;
+    while (!mStagedUploads.empty() && budget > 0)
+    {
+        StagedUpload& upload = mStagedUploads.front();
+        const u32 rowSize = upload.mWidth * BytesPerPixel(upload.mInputFormat);
+        const u32 rowsLeft = upload.mHeight - upload.mNextRow;
+
+        // At least one row per frame so a budget smaller than a row still makes progress, but what
+        // is left over after other rows isn't rounded up to a row
+        const u32 minRows = budget == mStagedUploadBudget ? 1u : 0u;
+        const u32 rows = std::min(rowsLeft, std::max(budget / rowSize, minRows));
+        if (rows == 0 && rowsLeft > 0)
+        {
+            break;
+        }
+        UploadStagedRows(upload, rows);
+        budget -= std::min(budget, rows * rowSize);
+
+        if (upload.mNextRow == upload.mHeight)
+        {
+            mStagedUploads.pop_front();
+        }
+    }
+}
+
+TextureHandle AbstractRenderer::CachedTexture(const std::weak_ptr<const void>& owner, u32 key) const
+{
+    auto ownerIt = mCachedTextures.find(owner);
+    if (ownerIt != std::end(mCachedTextures))
+    {
+        auto it = ownerIt->second.find(key);
+        if (it != std::end(ownerIt->second))
+        {
+            return it->second;
+        }
+    }
+    return TextureHandle();
+}
+
+TextureHandle AbstractRenderer::AddCachedTexture(const std::weak_ptr<const void>& owner, u32 key, eTextureFormats internalFormat, u32 width, u32 height, eTextureFormats inputFormat, const void *pixels, bool interpolation)
+{
+    assert(!CachedTexture(owner, key).IsValid());
+    const TextureHandle handle = CreateTexture(internalFormat, width, height, inputFormat, pixels, interpolation);
+    mCachedTextures[owner][key] = handle;
+    return handle;
+}
+
+void AbstractRenderer::DestroyExpiredCachedTextures(bool all)
+{
+    // Owners are compared by control block, so a new owner allocated at the address of
+    // a dead one can never pick up its stale textures
+    for (auto it = mCachedTextures.begin(); it != mCachedTextures.end();)
+    {
+        if (all || it->first.expired())
+        {
+            for (const auto& keyAndTexture : it->second)
+            {
+                DestroyTexture(keyAndTexture.second);
+            }
+            it = mCachedTextures.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+}
+
 static u32 ToImCol(const ColourU8& col)
 {
     return IM_COL32(col.r, col.g, col.b, col.a);
@@ -190,14 +349,51 @@ void AbstractRenderer::RenderCallBack(const struct ImDrawList*, const ImDrawCmd*
     }
 }
 
-void AbstractRenderer::PushCallBack(AbstractRenderer::eCoordinateSystem& lastCoordSystem, AbstractRenderer::eBlendModes& lastBlendMode, AbstractRenderer::CmdHeader& header, bool force)
+void AbstractRenderer::SpriteBatchCallBack(const struct ImDrawList*, const ImDrawCmd* cmd)
+{
+    CmdTexturedQuad* data = reinterpret_cast<CmdTexturedQuad*>(cmd->UserCallbackData);
+    AbstractRenderer* thisPtr = data->mHeader.mState.mThisPtr;
+    thisPtr->OnSetRenderState(data->mHeader.mState);
+    thisPtr->RenderSpriteBatch(thisPtr->mSpriteBatches[data->mBatchIndex]);
+}
+
+/*static*/ bool AbstractRenderer::SameState(const CmdState& a, const CmdState& b)
 {
-    if (force || (header.mState.mCoordinateSystem != lastCoordSystem || header.mState.mBlendMode != lastBlendMode))
+    return a.mCoordinateSystem == b.mCoordinateSystem && a.mBlendMode == b.mBlendMode && a.mPalette.mData == b.mPalette.mData;
+}
+
+void AbstractRenderer::AddToSpriteBatch(CmdTexturedQuad& cmd, s32& openBatch, CmdState& lastState)
+{
+    // Only quads that are next to each other in draw order can be merged, otherwise layering would break
+    const bool stateChanged = !SameState(cmd.mHeader.mState, lastState);
+    if (openBatch == -1 || stateChanged || mSpriteBatches[openBatch].mTexture.mData != cmd.mTexture.mData)
+    {
+        openBatch = static_cast<s32>(mSpriteBatches.size());
+        mSpriteBatches.push_back(SpriteBatch{ cmd.mTexture, static_cast<u32>(mSpriteVertices.size() / 4), 0 });
+
+        // The batch sets its own render state
+        cmd.mHeader.mState.mThisPtr = this;
+        cmd.mBatchIndex = openBatch;
+        mDrawList.AddCallback(SpriteBatchCallBack, &cmd);
+        lastState = cmd.mHeader.mState;
+    }
+    mSpriteBatches[openBatch].mNumQuads++;
+
+    // Same winding as ImDrawList::PrimRectUV
+    const ImU32 col = ToImCol(cmd.mHeader.mColour);
+    mSpriteVertices.push_back(ImDrawVert{ { cmd.mX, cmd.mY }, { cmd.mU0, cmd.mV0 }, col });
+    mSpriteVertices.push_back(ImDrawVert{ { cmd.mX + cmd.mW, cmd.mY }, { cmd.mU1, cmd.mV0 }, col });
+    mSpriteVertices.push_back(ImDrawVert{ { cmd.mX + cmd.mW, cmd.mY + cmd.mH }, { cmd.mU1, cmd.mV1 }, col });
+    mSpriteVertices.push_back(ImDrawVert{ { cmd.mX, cmd.mY + cmd.mH }, { cmd.mU0, cmd.mV1 }, col });
+}
+
+void AbstractRenderer::PushCallBack(AbstractRenderer::CmdState& lastState, AbstractRenderer::CmdHeader& header, bool force)
+{
+    if (force || !SameState(header.mState, lastState))
     {
         header.mState.mThisPtr = this;
         mDrawList.AddCallback(RenderCallBack, &header);
-        lastBlendMode = header.mState.mBlendMode;
-        lastCoordSystem = header.mState.mCoordinateSystem;
+        lastState = header.mState;
     }
 }
 
@@ -353,25 +549,32 @@ void AbstractRenderer::TextBounds(f32 x, f32 y, f32 fontSize, const char* text,
 void AbstractRenderer::generateImGuiCommands()
 {
     // Used to cache previous state and skip redundant ones
-    eCoordinateSystem lastCoordSystem = eCoordinateSystem::eScreen;
-    eBlendModes lastBlendMode = eBlendModes::eOpaque;
+    CmdState lastState = { this, eCoordinateSystem::eScreen, eBlendModes::eOpaque, TextureHandle() };
     ImTextureID lastTextureId = nullptr;
+    s32 openSpriteBatch = -1;
+    const bool batchSprites = SpriteBatchingSupported();
 
-    for (u8* cmdType : mPointersToOrderedCommands)
+    for (const SortedCmd& sortedCmd : mPointersToOrderedCommands)
     {
+        u8* cmdType = sortedCmd.mCmd;
+        if (reinterpret_cast<CmdHeader*>(cmdType)->mType != eTexturedQuad)
+        {
+            openSpriteBatch = -1;
+        }
+
         switch (reinterpret_cast<CmdHeader*>(cmdType)->mType)
         {
         case eImGuiUi:
         {
             CmdHeader* cmd = reinterpret_cast<CmdHeader*>(cmdType);
-            PushCallBack(lastCoordSystem, lastBlendMode, *cmd, true);
+            PushCallBack(lastState, *cmd, true);
         }
         break;
 
         case eRect:
         {
             CmdRect* cmd = reinterpret_cast<CmdRect*>(cmdType);
-            PushCallBack(lastCoordSystem, lastBlendMode, cmd->mHeader);
+            PushCallBack(lastState, cmd->mHeader);
             PushTexture(lastTextureId, ImGui::GetIO().Fonts->TexID);
             mDrawList.AddRect({ cmd->mX, cmd->mY }, { cmd->mX+cmd->mW, cmd->mY+cmd->mH }, ToImCol(cmd->mHeader.mColour));
         }
@@ -380,14 +583,19 @@ void AbstractRenderer::generateImGuiCommands()
         case eTexturedQuad:
         {
             CmdTexturedQuad* cmd = reinterpret_cast<CmdTexturedQuad*>(cmdType);
-            PushCallBack(lastCoordSystem, lastBlendMode, cmd->mHeader);
+            if (batchSprites)
+            {
+                AddToSpriteBatch(*cmd, openSpriteBatch, lastState);
+                break;
+            }
+            PushCallBack(lastState, cmd->mHeader);
             PushTexture(lastTextureId, cmd->mTexture.mData);
             mDrawList.PrimReserve(6, 4);
             mDrawList.PrimRectUV(
                 { cmd->mX, cmd->mY },
                 { cmd->mX + cmd->mW, cmd->mY + cmd->mH },
-                { 0.0f, 0.0f },
-                { 1.0f, 1.0f },
+                { cmd->mU0, cmd->mV0 },
+                { cmd->mU1, cmd->mV1 },
                 ToImCol(cmd->mHeader.mColour));
         }
         break;
@@ -395,7 +603,7 @@ void AbstractRenderer::generateImGuiCommands()
         case eText:
         {
             CmdText* cmd = reinterpret_cast<CmdText*>(cmdType);
-            PushCallBack(lastCoordSystem, lastBlendMode, cmd->mHeader, true);
+            PushCallBack(lastState, cmd->mHeader, true);
             PushTexture(lastTextureId, ImGui::GetIO().Fonts->TexID);
             mDrawList.PushClipRectFullScreen();
             HandleTextCommand(cmd->mX, cmd->mY, cmd->mFontSize, &cmd->mText, &cmd->mHeader.mColour, nullptr);
@@ -405,7 +613,7 @@ void AbstractRenderer::generateImGuiCommands()
         case ePath:
         {
             CmdBeginPath* cmd = reinterpret_cast<CmdBeginPath*>(cmdType);
-            PushCallBack(lastCoordSystem, lastBlendMode, cmd->mHeader);
+            PushCallBack(lastState, cmd->mHeader);
             PushTexture(lastTextureId, ImGui::GetIO().Fonts->TexID);
 
             const u32 remainderSize = cmd->mHeader.mSize - sizeof(CmdBeginPath);
@@ -435,7 +643,7 @@ void AbstractRenderer::generateImGuiCommands()
         case eLine:
         {
             CmdLine* cmd = reinterpret_cast<CmdLine*>(cmdType);
-            PushCallBack(lastCoordSystem, lastBlendMode, cmd->mHeader);
+            PushCallBack(lastState, cmd->mHeader);
             PushTexture(lastTextureId, ImGui::GetIO().Fonts->TexID);
             mDrawList.AddLine({ cmd->mP1X, cmd->mP1Y }, { cmd->mP2X, cmd->mP2Y }, ToImCol(cmd->mHeader.mColour), cmd->mLineWidth);
         }
@@ -444,7 +652,7 @@ void AbstractRenderer::generateImGuiCommands()
         case eCircleFilled:
         {
             CmdCircleFilled* cmd = reinterpret_cast<CmdCircleFilled*>(cmdType);
-            PushCallBack(lastCoordSystem, lastBlendMode, cmd->mHeader);
+            PushCallBack(lastState, cmd->mHeader);
             PushTexture(lastTextureId, ImGui::GetIO().Fonts->TexID);
             mDrawList.AddCircleFilled({ cmd->mX, cmd->mY }, cmd->mRadius, ToImCol(cmd->mHeader.mColour), cmd->mNumSegments);
         }
@@ -468,6 +676,16 @@ void AbstractRenderer::generateImGuiCommands()
 }
 
 void AbstractRenderer::TexturedQuad(TextureHandle texHandle, f32 x, f32 y, f32 w, f32 h, int layer, ColourU8 colour, eBlendModes blendMode, eCoordinateSystem coordinateSystem)
+{
+    TexturedQuadUV(texHandle, 0.0f, 0.0f, 1.0f, 1.0f, x, y, w, h, layer, colour, blendMode, coordinateSystem);
+}
+
+void AbstractRenderer::TexturedQuadUV(TextureHandle texHandle, f32 u0, f32 v0, f32 u1, f32 v1, f32 x, f32 y, f32 w, f32 h, int layer, ColourU8 colour, eBlendModes blendMode, eCoordinateSystem coordinateSystem)
+{
+    AddTexturedQuadCmd(texHandle, u0, v0, u1, v1, x, y, w, h, layer, colour, blendMode, coordinateSystem);
+}
+
+AbstractRenderer::CmdTexturedQuad* AbstractRenderer::AddTexturedQuadCmd(TextureHandle texHandle, f32 u0, f32 v0, f32 u1, f32 v1, f32 x, f32 y, f32 w, f32 h, int layer, ColourU8 colour, eBlendModes blendMode, eCoordinateSystem coordinateSystem)
 {
     assert(mInPath == false);
     EnsureCmdFreeSpace(sizeof(CmdTexturedQuad));
@@ -482,9 +700,23 @@ void AbstractRenderer::TexturedQuad(TextureHandle texHandle, f32 x, f32 y, f32 w
     cmd->mY = y;
     cmd->mW = w;
     cmd->mH = h;
+    cmd->mU0 = u0;
+    cmd->mV0 = v0;
+    cmd->mU1 = u1;
+    cmd->mV1 = v1;
     cmd->mTexture = texHandle;
     cmd->mHeader.mState.mBlendMode = blendMode;
     cmd->mHeader.mState.mCoordinateSystem = coordinateSystem;
+    return cmd;
+}
+
+void AbstractRenderer::IndexedQuadUV(TextureHandle texHandle, TextureHandle paletteHandle, f32 u0, f32 v0, f32 u1, f32 v1, f32 x, f32 y, f32 w, f32 h, int layer, ColourU8 colour, eBlendModes blendMode, eCoordinateSystem coordinateSystem)
+{
+    assert(!paletteHandle.IsValid() || IndexedTexturesSupported());
+    CmdTexturedQuad* const cmd = AddTexturedQuadCmd(texHandle, u0, v0, u1, v1, x, y, w, h, layer, colour, blendMode, coordinateSystem);
+
+    // The palette is part of the render state, so quads with different palettes are never batched together
+    cmd->mHeader.mState.mPalette = paletteHandle;
 }
 
 void AbstractRenderer::Rect(f32 x, f32 y, f32 w, f32 h, int layer, ColourU8 colour, eBlendModes blendMode, eCoordinateSystem coordinateSystem)
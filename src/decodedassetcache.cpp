@@ -0,0 +1,320 @@
+#include "decodedassetcache.hpp"
+#include "filesystem.hpp"
+#include "logger.hpp"
+#include "oddlib/stream.hpp"
+#include "oddlib/exceptions.hpp"
+#include "oddlib/hashindex.hpp"
+#include "oddlib/lvlarchive.hpp"
+#include "oddlib/bits_factory.hpp"
+#include "oddlib/anim.hpp"
+#include "oddlib/sdl_raii.hpp"
+#include "libdeflate.h"
+#include "alive_version.h"
+#include <cstring>
+
+// Layout of a cache file (native endian, only ever read back on the machine that wrote it):
+//   Header
+//   mStoredSize bytes of raw deflate data, or the payload as is when it didn't compress
+//
+// Camera payload:        camera surface, u32 has FG1, FG1 surface (see SDLHelpers::WriteSurface)
+// Animation set payload: see AnimationSet::WriteCache, the same for indexed sets
+
+namespace
+{
+    const u32 kCacheMagic = Oddlib::MakeType("DCAC");
+
+    // Bump when the layout or either payload changes
+    const u32 kCacheVersion = 2;
+
+    // Far bigger than any camera or animation set, guards the allocation against a corrupt header
+    const u32 kMaxPayloadSize = 256 * 1024 * 1024;
+
+    const char* kVersionFile = "{CacheDir}/DecodedCacheVersion.txt";
+
+    struct CacheHeader
+    {
+        u32 mMagic;
+        u32 mVersion;
+        u32 mEngineVersionHash;
+        u32 mKind;
+        u32 mKeyHash;
+        u32 mChunkId;
+        u32 mSourceSize;
+        u32 mDeflated;
+        u32 mStoredSize;
+        u32 mPayloadSize;
+    };
+
+    u32 KeyHash(const DecodedAssetCache::Key& key)
+    {
+        return Oddlib::HashU32(Oddlib::HashString(key.mDataSet) ^ Oddlib::HashU32(Oddlib::HashString(key.mLvl) ^ Oddlib::HashString(key.mFile)));
+    }
+
+    u32 EngineVersionHash()
+    {
+        return Oddlib::HashString(ALIVE_VERSION);
+    }
+}
+
+DecodedAssetCache::DecodedAssetCache(OSBaseFileSystem& fs)
+    : mFs(fs)
+{
+
+}
+
+void DecodedAssetCache::Sync()
+{
+    TRACE_ENTRYEXIT;
+
+    std::string versionFile = kVersionFile;
+    bool ok = false;
+    if (mFs.FileExists(versionFile))
+    {
+        if (mFs.Open(versionFile)->LoadAllToString() == ALIVE_VERSION)
+        {
+            ok = true;
+        }
+    }
+
+    if (!ok)
+    {
+        DeleteFromDiskCache("*.dcache");
+
+        // Update cache version marker to current
+        Oddlib::FileStream versionStream(mFs.ExpandPath(versionFile), Oddlib::IStream::ReadMode::ReadWrite);
+        versionStream.Write(std::string(ALIVE_VERSION));
+    }
+
+    DeleteFromDiskCache("*.dcache_tmp");
+}
+
+void DecodedAssetCache::DeleteFromDiskCache(const std::string& filter)
+{
+    const std::string dirName = mFs.ExpandPath("{CacheDir}");
+    const auto files = mFs.EnumerateFiles(dirName, filter.c_str());
+    for (const auto& file : files)
+    {
+        const std::string fullName = dirName + "/" + file;
+        LOG_INFO("Deleting: " << fullName);
+        mFs.DeleteFile(fullName);
+    }
+}
+
+std::string DecodedAssetCache::FileName(eKind kind, const Key& key) const
+{
+    return "{CacheDir}/" + key.mDataSet + "_" + key.mLvl + "_" + key.mFile + "_" + std::to_string(key.mChunkId) +
+        (kind == eKind::eCamera ? ".cam" : kind == eKind::eIndexedAnimationSet ? ".ianim" : ".anim") + ".dcache";
+}
+
+bool DecodedAssetCache::Load(eKind kind, const Key& key, std::vector<u8>& data)
+{
+    std::string fileName = FileName(kind, key);
+    if (!mFs.FileExists(fileName))
+    {
+        mMisses++;
+        return false;
+    }
+
+    try
+    {
+        auto stream = mFs.Open(fileName);
+
+        // Inflate straight out of the mapping when there is one
+        std::vector<u8> fileData;
+        const u8* fileBytes = nullptr;
+        size_t fileSize = 0;
+        if (const Oddlib::MemoryStream* memoryStream = dynamic_cast<const Oddlib::MemoryStream*>(stream.get()))
+        {
+            fileBytes = memoryStream->Data();
+            fileSize = memoryStream->Size();
+        }
+        else
+        {
+            fileData = Oddlib::IStream::ReadAll(*stream);
+            fileBytes = fileData.data();
+            fileSize = fileData.size();
+        }
+
+        CacheHeader header = {};
+        if (fileSize < sizeof(header))
+        {
+            throw Oddlib::Exception("Truncated header");
+        }
+        memcpy(&header, fileBytes, sizeof(header));
+
+        if (header.mMagic != kCacheMagic ||
+            header.mVersion != kCacheVersion ||
+            header.mEngineVersionHash != EngineVersionHash() ||
+            header.mKind != static_cast<u32>(kind) ||
+            header.mKeyHash != KeyHash(key) ||
+            header.mChunkId != key.mChunkId ||
+            header.mSourceSize != key.mSourceSize)
+        {
+            LOG_INFO(fileName << " is out of date");
+            mMisses++;
+            return false;
+        }
+
+        if (header.mStoredSize != fileSize - sizeof(header))
+        {
+            throw Oddlib::Exception("Truncated data");
+        }
+
+        if (header.mPayloadSize > kMaxPayloadSize)
+        {
+            throw Oddlib::Exception("Bad payload size");
+        }
+
+        const u8* stored = fileBytes + sizeof(header);
+        if (header.mDeflated)
+        {
+            data.resize(header.mPayloadSize);
+            size_t actualOut = 0;
+            deflate_decompressor* decompressor = deflate_alloc_decompressor();
+            const decompress_result result = deflate_decompress(decompressor, stored, header.mStoredSize, data.data(), data.size(), &actualOut);
+            deflate_free_decompressor(decompressor);
+            if (result != DECOMPRESS_SUCCESS || actualOut != header.mPayloadSize)
+            {
+                throw Oddlib::Exception("Bad deflate data");
+            }
+        }
+        else
+        {
+            if (header.mPayloadSize != header.mStoredSize)
+            {
+                throw Oddlib::Exception("Bad stored size");
+            }
+            data.assign(stored, stored + header.mStoredSize);
+        }
+    }
+    catch (const Oddlib::Exception& e)
+    {
+        // Will be decoded from the data set and written again
+        LOG_ERROR("Corrupt decoded asset cache file " << fileName << ": " << e.what());
+        mMisses++;
+        return false;
+    }
+
+    mHits++;
+    return true;
+}
+
+void DecodedAssetCache::Save(eKind kind, const Key& key, const std::vector<u8>& data)
+{
+    CacheHeader header = {};
+    header.mMagic = kCacheMagic;
+    header.mVersion = kCacheVersion;
+    header.mEngineVersionHash = EngineVersionHash();
+    header.mKind = static_cast<u32>(kind);
+    header.mKeyHash = KeyHash(key);
+    header.mChunkId = key.mChunkId;
+    header.mSourceSize = key.mSourceSize;
+    header.mPayloadSize = static_cast<u32>(data.size());
+
+    // Any output that isn't smaller than the input isn't worth inflating later, so the buffer is
+    // only that big and a failed compression just means storing the payload as is
+    std::vector<u8> deflated(data.size());
+    deflate_compressor* compressor = deflate_alloc_compressor(6);
+    const size_t deflatedSize = compressor ? deflate_compress(compressor, data.data(), data.size(), deflated.data(), deflated.size()) : 0;
+    deflate_free_compressor(compressor);
+
+    header.mDeflated = deflatedSize > 0 ? 1 : 0;
+    header.mStoredSize = static_cast<u32>(deflatedSize > 0 ? deflatedSize : data.size());
+    const u8* stored = deflatedSize > 0 ? deflated.data() : data.data();
+
+    // Write to a tmp file and rename it when complete, so a crash can't leave a partial entry
+    // behind that would then be loaded
+    const std::string finalFileName = mFs.ExpandPath(FileName(kind, key));
+    const std::string tmpFileName = finalFileName + "." + std::to_string(mNextTmpId++) + ".dcache_tmp";
+    try
+    {
+        {
+            Oddlib::FileStream stream(tmpFileName, Oddlib::IStream::ReadMode::ReadWrite);
+            stream.WriteBytes(reinterpret_cast<const u8*>(&header), sizeof(header));
+            stream.WriteBytes(stored, header.mStoredSize);
+        }
+        mFs.RenameFile(tmpFileName, finalFileName);
+    }
+    catch (const Oddlib::Exception& e)
+    {
+        // Not fatal, it'll just be decoded again next time
+        LOG_ERROR("Failed to write " << finalFileName << ": " << e.what());
+    }
+}
+
+std::unique_ptr<Oddlib::IBits> DecodedAssetCache::LoadCamera(const Key& key)
+{
+    std::vector<u8> data;
+    if (!Load(eKind::eCamera, key, data))
+    {
+        return nullptr;
+    }
+
+    try
+    {
+        Oddlib::MemoryStream stream(std::move(data));
+        SDL_SurfacePtr camera = SDLHelpers::ReadSurface(stream);
+        SDL_SurfacePtr fg1;
+        u32 hasFg1 = 0;
+        stream.Read(hasFg1);
+        if (hasFg1)
+        {
+            fg1 = SDLHelpers::ReadSurface(stream);
+        }
+        return Oddlib::MakeBits(std::move(camera), std::move(fg1));
+    }
+    catch (const Oddlib::Exception& e)
+    {
+        LOG_ERROR("Corrupt cached camera " << key.mFile << ": " << e.what());
+        return nullptr;
+    }
+}
+
+std::unique_ptr<Oddlib::AnimationSet> DecodedAssetCache::LoadAnimationSet(const Key& key, bool indexed)
+{
+    std::vector<u8> data;
+    if (!Load(indexed ? eKind::eIndexedAnimationSet : eKind::eAnimationSet, key, data))
+    {
+        return nullptr;
+    }
+
+    try
+    {
+        Oddlib::MemoryStream stream(std::move(data));
+        std::unique_ptr<Oddlib::AnimationSet> animSet = Oddlib::AnimationSet::ReadCache(stream);
+        if (animSet->IsIndexed() != indexed)
+        {
+            throw Oddlib::Exception("Wrong kind of animation set");
+        }
+        return animSet;
+    }
+    catch (const Oddlib::Exception& e)
+    {
+        LOG_ERROR("Corrupt cached animation set " << key.mFile << " " << key.mChunkId << ": " << e.what());
+        return nullptr;
+    }
+}
+
+void DecodedAssetCache::SaveCamera(const Key& key, const Oddlib::IBits& cam)
+{
+    std::vector<u8> data;
+    SDLHelpers::WriteSurface(data, cam.GetSurface());
+
+    SDL_Surface* fg1 = cam.GetFg1() ? cam.GetFg1()->GetSurface() : nullptr;
+    const u32 hasFg1 = fg1 ? 1 : 0;
+    const u8* hasFg1Bytes = reinterpret_cast<const u8*>(&hasFg1);
+    data.insert(data.end(), hasFg1Bytes, hasFg1Bytes + sizeof(hasFg1));
+    if (fg1)
+    {
+        SDLHelpers::WriteSurface(data, fg1);
+    }
+
+    Save(eKind::eCamera, key, data);
+}
+
+void DecodedAssetCache::SaveAnimationSet(const Key& key, const Oddlib::AnimationSet& animSet)
+{
+    std::vector<u8> data;
+    animSet.WriteCache(data);
+    Save(animSet.IsIndexed() ? eKind::eIndexedAnimationSet : eKind::eAnimationSet, key, data);
+}
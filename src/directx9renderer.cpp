@@ -421,11 +421,66 @@ static inline D3DFORMAT ToD3DFormat(AbstractRenderer::eTextureFormats format)
         return D3DFMT_A8R8G8B8;
     case AbstractRenderer::eTextureFormats::eA:
         return D3DFMT_A8;
+    case AbstractRenderer::eTextureFormats::eR:
+        // Indices can't be looked up in a palette without shaders, so they're only viewable as grey
+        return D3DFMT_A8R8G8B8;
     }
     abort();
 }
 
 
+// Copies to rows firstRow to firstRow + height - 1 of the texture
+static bool CopyPixelsToTexture(LPDIRECT3DTEXTURE9 pTexture, u32 firstRow, u32 width, u32 height, AbstractRenderer::eTextureFormats inputFormat, const void* pixels)
+{
+    const RECT rows = { 0, static_cast<LONG>(firstRow), static_cast<LONG>(width), static_cast<LONG>(firstRow + height) };
+    D3DLOCKED_RECT lockedRect = {};
+    if (FAILED(pTexture->LockRect(0, &lockedRect, &rows, 0)))
+    {
+        LOG_ERROR("LockRect for texture failed");
+        return false;
+    }
+
+
+    DWORD* imageData = (DWORD*)lockedRect.pBits;
+    BYTE* iPixelData = (BYTE*)pixels;
+
+    DWORD srcIdx = 0;
+
+    for (u32 y = 0; y < height; ++y)
+    {
+        for (u32 x = 0; x < width; x++)
+        {
+            unsigned char r = 0xff; 
+            unsigned char g = 0xff;
+            unsigned char b = 0xff;
+            unsigned char a = 0xff;
+
+            if (inputFormat == AbstractRenderer::eTextureFormats::eRGBA || inputFormat == AbstractRenderer::eTextureFormats::eRGB)
+            {
+                r = iPixelData[srcIdx++];
+                g = iPixelData[srcIdx++];
+                b = iPixelData[srcIdx++];
+            }
+
+            if (inputFormat == AbstractRenderer::eTextureFormats::eRGBA || inputFormat == AbstractRenderer::eTextureFormats::eA)
+            {
+                a = iPixelData[srcIdx++];
+            }
+
+            if (inputFormat == AbstractRenderer::eTextureFormats::eR)
+            {
+                r = g = b = iPixelData[srcIdx++];
+            }
+
+            const DWORD index = (x * 4 + (y*(lockedRect.Pitch)));
+            imageData[index / 4] = D3DCOLOR_RGBA(r, g, b, a);
+        }
+    }
+
+    pTexture->UnlockRect(0);
+    return true;
+}
+
 TextureHandle DirectX9Renderer::CreateTexture(AbstractRenderer::eTextureFormats internalFormat, u32 width, u32 height, AbstractRenderer::eTextureFormats inputFormat, const void* pixels, bool /*interpolation*/)
 {
     LPDIRECT3DTEXTURE9 pTexture = nullptr;
@@ -437,46 +492,10 @@ TextureHandle DirectX9Renderer::CreateTexture(AbstractRenderer::eTextureFormats
 
     if (pixels)
     {
-        D3DLOCKED_RECT lockedRect = {};
-        if (FAILED(pTexture->LockRect(0, &lockedRect, nullptr, 0)))
+        if (!CopyPixelsToTexture(pTexture, 0, width, height, inputFormat, pixels))
         {
-            LOG_ERROR("LockRect for texture failed");
             return DxToTextureHandle(nullptr);
         }
-
-
-        DWORD* imageData = (DWORD*)lockedRect.pBits;
-        BYTE* iPixelData = (BYTE*)pixels;
-
-        DWORD srcIdx = 0;
-
-        for (u32 y = 0; y < height; ++y)
-        {
-            for (u32 x = 0; x < width; x++)
-            {
-                unsigned char r = 0xff; 
-                unsigned char g = 0xff;
-                unsigned char b = 0xff;
-                unsigned char a = 0xff;
-
-                if (inputFormat == AbstractRenderer::eTextureFormats::eRGBA || inputFormat == AbstractRenderer::eTextureFormats::eRGB)
-                {
-                    r = iPixelData[srcIdx++];
-                    g = iPixelData[srcIdx++];
-                    b = iPixelData[srcIdx++];
-                }
-
-                if (inputFormat == AbstractRenderer::eTextureFormats::eRGBA || inputFormat == AbstractRenderer::eTextureFormats::eA)
-                {
-                    a = iPixelData[srcIdx++];
-                }
-
-                const DWORD index = (x * 4 + (y*(lockedRect.Pitch)));
-                imageData[index / 4] = D3DCOLOR_RGBA(r, g, b, a);
-            }
-        }
-
-        pTexture->UnlockRect(0);
     }
 
     // TODO: Should allow per texture... or just change renderer API so its global ?
@@ -487,6 +506,16 @@ TextureHandle DirectX9Renderer::CreateTexture(AbstractRenderer::eTextureFormats
     return DxToTextureHandle(pTexture);
 }
 
+void DirectX9Renderer::UpdateTexture(TextureHandle handle, u32 width, u32 height, AbstractRenderer::eTextureFormats inputFormat, const void* pixels)
+{
+    CopyPixelsToTexture(TextureHandleToDx(handle), 0, width, height, inputFormat, pixels);
+}
+
+void DirectX9Renderer::UpdateTextureRows(TextureHandle handle, u32 y, u32 width, u32 rows, AbstractRenderer::eTextureFormats inputFormat, const void* pixels)
+{
+    CopyPixelsToTexture(TextureHandleToDx(handle), y, width, rows, inputFormat, pixels);
+}
+
 void DirectX9Renderer::DestroyTextures()
 {
     if (!mDestroyTextureList.empty())
@@ -88,6 +88,10 @@ Engine::Engine(const std::vector<std::string>& commandLineArguments)
             mTryDirectX9 = true;
 #endif
         }
+        else if (string_util::iequals("-indexedsprites", argument))
+        {
+            mIndexedSprites = true;
+        }
     }
 }
 
@@ -707,9 +711,15 @@ void Engine::InitResources()
         "{GameDir}/data/animations.json",
         "{GameDir}/data/sounds.json",
         "{GameDir}/data/paths.json",
-        "{GameDir}/data/fmvs.json");
+        "{GameDir}/data/fmvs.json",
+        "{CacheDir}/resource_maps.db");
+
+    // Decoded cameras and animation sets from previous runs, so they don't have to be decompressed again
+    mDecodedAssetCache = std::make_unique<DecodedAssetCache>(*mFileSystem);
+    mDecodedAssetCache->Sync();
 
-    mResourceLocator = std::make_unique<ResourceLocator>(std::move(mapper), std::move(dataPaths));
+    mResourceLocator = std::make_unique<ResourceLocator>(std::move(mapper), std::move(dataPaths), mJobSystem, mDecodedAssetCache.get());
+    mResourceLocator->SetIndexedAnimations(mIndexedSprites);
 
     // TODO: After user selects game def then add/validate the required paths/data sets in the res mapper
     // also add in any extra maps for resources defined by the mod @ game selection screen
@@ -140,6 +140,10 @@ static std::wstring Utf8ToUtf16(const std::string& utf8)
 std::unique_ptr<Oddlib::IStream> OSBaseFileSystem::Open(const std::string& fileName)
 {
     std::unique_lock<std::recursive_mutex> lock(mMutex);
+    if (mMapFiles)
+    {
+        return Oddlib::OpenReadOnly(ExpandPath(fileName));
+    }
     return std::make_unique<Oddlib::FileStream>(ExpandPath(fileName), Oddlib::IStream::ReadMode::ReadOnly);
 }
 
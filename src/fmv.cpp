@@ -6,6 +6,9 @@
 #include "cdromfilesystem.hpp"
 #include "soxr.h"
 #include "engine.hpp"
+#include <chrono>
+#include <cassert>
+#include <algorithm>
 
 static f32 Percent(f32 max, f32 percent)
 {
@@ -33,33 +36,106 @@ static void RenderSubtitles(AbstractRenderer& rend, const char* msg, float x, fl
         AbstractRenderer::eCoordinateSystem::eScreen);
 }
 
+// About 2 seconds of video at 15 fps
+static const size_t kVideoRingFrames = 30;
+
+// Ring sizes for 44.1khz stereo s16
+static const size_t kAudioChannels = 2;
+static const size_t kAudioBytesPerSecond = 44100 * kAudioChannels * sizeof(s16);
+static const size_t kAudioRingBytes = kAudioBytesPerSecond * 4;
+
+// Below this the decoder keeps going even if the video ring is full, some streams
+// have their audio a long way behind the video
+static const size_t kAudioLowWaterBytes = kAudioBytesPerSecond;
+
 IMovie::IMovie(const std::string& resourceName, IAudioController& controller, std::unique_ptr<SubTitleParser> subtitles)
-    : mAudioController(controller), mSubTitles(std::move(subtitles)), mName(resourceName)
+    : mAudioController(controller), mSubTitles(std::move(subtitles)), mName(resourceName), mVideoRing(kVideoRingFrames), mAudioRing(kAudioRingBytes)
 {
-
+    // Sized for a whole audio callback up front, Play() must not allocate
+    mAudioScratch.resize(std::max<size_t>(mAudioController.AudioFrameSize(), 1) * kAudioChannels * sizeof(s16));
 }
 
 IMovie::~IMovie()
 {
+    // Derived classes must have stopped the thread already as it calls their overrides
+    assert(!mDecodeThread.joinable());
 
+    if (mRenderer)
+    {
+        mRenderer->DestroyTexture(mFrameTexture);
+    }
 }
 
+// Decode thread context
+bool IMovie::FlushDecodedToRings()
+{
+    bool flushedAny = false;
+    while (!mVideoBuffer.empty() && mVideoRing.Push(std::move(mVideoBuffer.front())))
+    {
+        mVideoBuffer.pop_front();
+        flushedAny = true;
+    }
 
-// Main thread context
-void IMovie::OnRenderFrame(AbstractRenderer& rend)
+    if (!mAudioBuffer.empty())
+    {
+        const size_t pushed = mAudioRing.Push(mAudioBuffer.begin(), mAudioBuffer.size());
+        mAudioBuffer.erase(mAudioBuffer.begin(), mAudioBuffer.begin() + pushed);
+        flushedAny = flushedAny || pushed > 0;
+    }
+    return flushedAny;
+}
+
+// Decode thread context
+bool IMovie::ShouldDecode() const
 {
-    // TODO: Populate mAudioBuffer and mVideoBuffer
-    // for up to N buffered frames
-    std::lock_guard<std::mutex> lock(mAudioBufferMutex);
+    if (mAudioRing.Size() < kAudioLowWaterBytes)
+    {
+        return true;
+    }
+    return mVideoBuffer.empty() && mAudioBuffer.empty() && !mVideoRing.Full();
+}
 
-    if (!mPlaying)
+// Decode thread context
+void IMovie::DecodeThread()
+{
+    try
     {
-        return;
+        while (!mStopDecoding)
+        {
+            const bool flushed = FlushDecodedToRings();
+            if (ShouldDecode() && NeedBuffer())
+            {
+                FillBuffers();
+            }
+            else if (EndOfStream() && mVideoBuffer.empty() && mAudioBuffer.empty())
+            {
+                break;
+            }
+            else if (!flushed)
+            {
+                // Rings are full, wait for the main and audio threads to consume some
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        }
+    }
+    catch (const Oddlib::Exception& ex)
+    {
+        LOG_ERROR("FMV decoding failed: " << ex.what());
+    }
+    catch (const std::exception& ex)
+    {
+        // Anything escaping the thread would terminate the game, i.e std::bad_alloc on a corrupt frame size
+        LOG_ERROR("FMV decoding failed: " << ex.what());
     }
+    mDecodeFinished = true;
+}
 
-    while (NeedBuffer())
+// Main thread context
+void IMovie::OnRenderFrame(AbstractRenderer& rend)
+{
+    if (!mPlaying)
     {
-        FillBuffers();
+        return;
     }
 
     // TODO: If the buffer call back for audio is large, then this might only get called every N frames meaning
@@ -82,54 +158,33 @@ void IMovie::OnRenderFrame(AbstractRenderer& rend)
         }
     }
 
-    bool played = false;
-    while (!mVideoBuffer.empty())
+    // Skip any frames the audio has already passed. The last one taken is kept so that if the video
+    // ends before the audio does we keep displaying whatever the last frame was.
+    while (Frame* next = mVideoRing.Front())
     {
-        Frame& f = mVideoBuffer.front();
-        if (f.mFrameNum < videoFrameIndex)
-        {
-            if (mVideoBuffer.size() == 1)
-            {
-                // Don't remove everything otherwise we won't have any frame to display at all
-                break;
-            }
-
-            mVideoBuffer.pop_front();
-            continue;
-        }
-
-        if (f.mFrameNum == videoFrameIndex)
+        if (next->mFrameNum > videoFrameIndex && mHaveDisplayFrame)
         {
-            // Don't pop frame after rendering for the case when the video ends and we are playing
-            // audio but there are no more frames. In the case we just keep displaying whatever the last
-            // frame was (since we didn't pop it).
-            RenderFrame(rend, f.mW, f.mH, f.mPixels.data(), current_subs);
-            played = true;
             break;
         }
 
+        std::swap(mDisplayFrame, *next);
+        mHaveDisplayFrame = true;
+        mVideoRing.Pop();
     }
 
-    if (!played && !mVideoBuffer.empty())
-    {
-        Frame& f = mVideoBuffer.front();
-        RenderFrame(rend, f.mW, f.mH, f.mPixels.data(), current_subs);
-    }
-
-    while (NeedBuffer())
+    if (mHaveDisplayFrame)
     {
-        FillBuffers();
+        RenderFrame(rend, mDisplayFrame, current_subs);
     }
 }
 
 // Main thread context
 bool IMovie::IsEnd()
 {
-    std::lock_guard<std::mutex> lock(mAudioBufferMutex);
-    const auto ret = EndOfStream() && mAudioBuffer.empty();
-    if (ret && mVideoBuffer.size() > 1)
+    const auto ret = mDecodeFinished && mAudioRing.Empty();
+    if (ret && mVideoRing.Size() > 1)
     {
-        LOG_ERROR("Still " << mVideoBuffer.size() << " frames left after audio finished");
+        LOG_ERROR("Still " << mVideoRing.Size() << " frames left after audio finished");
     }
     return ret;
 }
@@ -137,56 +192,90 @@ bool IMovie::IsEnd()
 // Main thread context
 void IMovie::Start()
 {
-    std::lock_guard<std::mutex> lock(mAudioBufferMutex);
     mAudioController.SetExclusiveAudioPlayer(this);
     mPlaying = true;
+    if (!mDecodeThread.joinable())
+    {
+        mStopDecoding = false;
+        mDecodeThread = std::thread(&IMovie::DecodeThread, this);
+    }
 }
 
 // Main thread context
 void IMovie::Stop()
 {
-    std::lock_guard<std::mutex> lock(mAudioBufferMutex);
     mAudioController.SetExclusiveAudioPlayer(nullptr);
     mPlaying = false;
+    StopDecoding();
+}
+
+// Main thread context
+void IMovie::StopDecoding()
+{
+    if (mDecodeThread.joinable())
+    {
+        mStopDecoding = true;
+        mDecodeThread.join();
+    }
 }
 
 // Audio thread context, from IAudioPlayer
 bool IMovie::Play(f32* stream, u32 len)
 {
-    std::lock_guard<std::mutex> lock(mAudioBufferMutex);
+    // Consume mAudioRing and update the amount of consumed bytes. If the device asks for more than
+    // mAudioScratch holds it is filled in pieces rather than grown here.
+    const size_t scratchSamples = mAudioScratch.size() / sizeof(int16_t);
+    size_t take = 0;
+    while (take < len)
+    {
+        const size_t want = std::min(len - take, scratchSamples);
+        const size_t got = mAudioRing.Pop(mAudioScratch.data(), want*sizeof(int16_t)) / sizeof(int16_t);
+        for (auto i = 0u; i < got; i++)
+        {
+            uint8_t low = mAudioScratch[i*sizeof(int16_t)];
+            uint8_t high = mAudioScratch[i*sizeof(int16_t) + 1];
+            int16_t fixed = (int16_t)(low | (high << 8));
 
-    // Consume mAudioBuffer and update the amount of consumed bytes
-    size_t have = mAudioBuffer.size()/sizeof(int16_t);
-    size_t take = len;
-    if (take > have)
-    {
-        // Buffer underflow - we don't have enough data to fill the requested buffer
-        // audio glitches ahoy!
-        LOG_ERROR("Audio buffer underflow want " << take << " samples " << " have " << have << " samples");
-        take = have;
+            // TODO: Add a proper audio mixing algorithm/API, this will clip/overflow and cause weridnes when
+            // 2 streams of diff sample rates are mixed
+            stream[take + i] += fixed / 32768.0f;
+        }
+        take += got;
+
+        if (got < want)
+        {
+            break;
+        }
     }
 
-    for (auto i = 0u; i < take; i++)
+    if (take < len && !mDecodeFinished)
     {
-        uint8_t low = mAudioBuffer[i*sizeof(int16_t)];
-        uint8_t high = mAudioBuffer[i*sizeof(int16_t) + 1];
-        int16_t fixed = (int16_t)(low | (high << 8));
-
-        // TODO: Add a proper audio mixing algorithm/API, this will clip/overflow and cause weridnes when
-        // 2 streams of diff sample rates are mixed
-        stream[i] += fixed / 32768.0f;
+        // Buffer underflow - we don't have enough data to fill the requested buffer
+        // audio glitches ahoy!
+        LOG_ERROR("Audio buffer underflow want " << len << " samples " << " have " << take << " samples");
     }
-    mAudioBuffer.erase(mAudioBuffer.begin(), mAudioBuffer.begin() + take*sizeof(int16_t));
     mConsumedAudioBytes += take*sizeof(int16_t);
     return false;
 }
 
-void IMovie::RenderFrame(AbstractRenderer &rend, int width, int height, const void *pixels, const char* subtitles)
+void IMovie::RenderFrame(AbstractRenderer &rend, const Frame& frame, const char* subtitles)
 {
-    // TODO: Optimize - should update 1 texture rather than creating per frame
-    TextureHandle texhandle = rend.CreateTexture(AbstractRenderer::eTextureFormats::eRGB, width, height, AbstractRenderer::eTextureFormats::eRGBA, pixels, true);
+    if (!mFrameTexture.IsValid() || mFrameTextureW != frame.mW || mFrameTextureH != frame.mH)
+    {
+        rend.DestroyTexture(mFrameTexture);
+        mRenderer = &rend;
+        mFrameTextureW = frame.mW;
+        mFrameTextureH = frame.mH;
+        mFrameTexture = rend.CreateTexture(AbstractRenderer::eTextureFormats::eRGB, frame.mW, frame.mH, AbstractRenderer::eTextureFormats::eRGBA, frame.mPixels.data(), true);
+    }
+    else if (mFrameTextureFrameNum != frame.mFrameNum)
+    {
+        // Video runs at a lower rate than we render, so only upload when the frame has changed
+        rend.UpdateTexture(mFrameTexture, frame.mW, frame.mH, AbstractRenderer::eTextureFormats::eRGBA, frame.mPixels.data());
+    }
+    mFrameTextureFrameNum = frame.mFrameNum;
     
-    rend.TexturedQuad(texhandle, 
+    rend.TexturedQuad(mFrameTexture, 
         0,
         0,
         static_cast<f32>(rend.Width()),
@@ -206,8 +295,6 @@ void IMovie::RenderFrame(AbstractRenderer &rend, int width, int height, const vo
             static_cast<f32>(rend.Width()),
             static_cast<f32>(rend.Height()));
     }
-
-    rend.DestroyTexture(texhandle);
 }
 
 // PSX MOV/STR format, all PSX game versions use this.
@@ -227,7 +314,7 @@ public:
 
     ~MovMovie()
     {
-
+        StopDecoding();
     }
 
     MovMovie(const std::string& resourceName, IAudioController& audioController, std::unique_ptr<Oddlib::IStream> stream, std::unique_ptr<SubTitleParser> subtitles, u32 startSector, u32 numberOfSectors)
@@ -470,7 +557,7 @@ public:
 class MasherMovie : public IMovie
 {
 public:
-    MasherMovie(const std::string& resourceName, IAudioController& audioController, std::unique_ptr<Oddlib::IStream> stream, std::unique_ptr<SubTitleParser> subtitles)
+    MasherMovie(const std::string& resourceName, IAudioController& audioController, std::unique_ptr<Oddlib::IStream> stream, std::unique_ptr<SubTitleParser> subtitles, const Oddlib::Masher::ParallelFor& parallelFor)
         : IMovie(resourceName, audioController, std::move(subtitles))
     {
         mMasher = std::make_unique<Oddlib::Masher>(std::move(stream));
@@ -483,6 +570,7 @@ public:
         if (mMasher->HasVideo())
         {
             mFramePixels.resize(mMasher->Width() * mMasher->Height() * sizeof(u32));
+            mMasher->SetParallelFor(parallelFor);
         }
 
         const u32 kNumChannels = 2;
@@ -491,7 +579,7 @@ public:
 
     ~MasherMovie()
     {
-
+        StopDecoding();
     }
 
     virtual bool EndOfStream() override
@@ -540,7 +628,8 @@ private:
     IAudioController& audioController,
     std::unique_ptr<Oddlib::IStream> stream,
     std::unique_ptr<SubTitleParser> subTitles,
-    u32 startSector, u32 endSector)
+    u32 startSector, u32 endSector,
+    const Oddlib::Masher::ParallelFor& parallelFor)
 {
 
     char idBuffer[4] = {};
@@ -549,7 +638,7 @@ private:
     std::string idStr(idBuffer, 3);
     if (idStr == "DDV")
     {
-        return std::make_unique<MasherMovie>(resourceName, audioController, std::move(stream), std::move(subTitles));
+        return std::make_unique<MasherMovie>(resourceName, audioController, std::move(stream), std::move(subTitles), parallelFor);
     }
     else if (idStr == "MOI")
     {
@@ -19,6 +19,7 @@ void GameMode::UpdateMenu(const InputState& /*input*/, CoordinateSpace& /*coords
         mMenuState = MenuStates::eCameraRoll;
         mWorldState.SetCurrentCamera("STP01C25.CAM");
         mWorldState.SetGameCameraToCameraAt(mWorldState.CurrentCameraX(), mWorldState.CurrentCameraY());
+        mWorldState.SetActiveScreen(static_cast<s32>(mWorldState.CurrentCameraX()), static_cast<s32>(mWorldState.CurrentCameraY()));
         break;
 
     case GameMode::MenuStates::eCameraRoll:
@@ -93,6 +94,7 @@ void GameMode::Update(const InputState& input, CoordinateSpace& coords)
     {
         const s32 camX = static_cast<s32>(mWorldState.mCameraSubject->mXPos / mWorldState.kCameraBlockSize.x);
         const s32 camY = static_cast<s32>(mWorldState.mCameraSubject->mYPos / mWorldState.kCameraBlockSize.y);
+        mWorldState.SetActiveScreen(camX, camY);
 
         const glm::vec2 camPos = glm::vec2(
             (camX * mWorldState.kCameraBlockSize.x) + mWorldState.kCameraBlockImageOffset.x,
@@ -117,6 +119,8 @@ static f32 Percent2(f32 max, f32 percent)
 
 void GameMode::Render(AbstractRenderer& rend) const
 {
+    mWorldState.UploadPrefetchedScreens(rend);
+
     if (mWorldState.mCameraSubject && Debugging().mDrawCameras)
     {
         const s32 camX = mState == eMenu ? static_cast<s32>(mWorldState.CurrentCameraX()) : static_cast<s32>(mWorldState.mCameraSubject->mXPos / mWorldState.kCameraBlockSize.x);
@@ -28,26 +28,92 @@ GridScreen::~GridScreen()
     assert(mFG1Texture.IsValid() == false);
 }
 
+bool GridScreen::Prefetch(JobPriority priority)
+{
+    if (mCameraTexture.IsValid() || mCamMissing || !hasTexture())
+    {
+        return false;
+    }
+
+    if (mCamFuture.valid())
+    {
+        // A neighbour asked for in the background can become the screen the player is on while its
+        // job is still queued behind the rest of the background work. Ask again at the new priority,
+        // the job left behind then finds the camera resident when it gets to run.
+        if (priority >= mCamPriority)
+        {
+            return false;
+        }
+
+        mCamPriority = priority;
+        if (mCamFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            return false;
+        }
+    }
+
+    mCamPriority = priority;
+    mCamFuture = mLocator.LocateCamera(mFileName, priority);
+    return true;
+}
+
+bool GridScreen::UploadIfReady(AbstractRenderer& rend)
+{
+    if (mCamFuture.valid() && mCamFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        CreateTextures(rend, mCamFuture.get(), true);
+        return true;
+    }
+    return false;
+}
+
 void GridScreen::LoadTextures(AbstractRenderer& rend)
 {
-    if (!mCameraTexture.IsValid())
+    if (mCameraTexture.IsValid())
+    {
+        // Prefetched but the pixels might still be trickling in, they're needed now
+        rend.FinishStagedUpload(mCameraTexture);
+        rend.FinishStagedUpload(mFG1Texture);
+    }
+    else if (!mCamMissing)
     {
-        mCam = mLocator.LocateCamera(mFileName).get();
-        if (mCam) // One path trys to load BRP08C10.CAM which exists in no data sets anywhere!
+        // Waits on the prefetch if there is one, so the camera isn't decoded twice. Promotes it first if
+        // it was only queued in the background.
+        Prefetch(JobPriority::eHigh);
+        if (mCamFuture.valid())
         {
-            SDL_Surface* surf = mCam->GetSurface();
-            mCameraTexture = rend.CreateTexture(AbstractRenderer::eTextureFormats::eRGB, surf->w, surf->h, AbstractRenderer::eTextureFormats::eRGB, surf->pixels, true);
+            CreateTextures(rend, mCamFuture.get(), false);
+        }
+    }
+}
+
+void GridScreen::CreateTextures(AbstractRenderer& rend, std::shared_ptr<Oddlib::IBits> cam, bool staged)
+{
+    if (!cam)
+    {
+        mCamMissing = true;
+        return;
+    }
 
-            if (!mFG1Texture.IsValid())
+    // The textures are copies, after the upload the decoded camera is only kept around by the
+    // locator's residency manager
+    auto createTexture = [&](AbstractRenderer::eTextureFormats format, SDL_Surface* surf)
+    {
+        return staged ?
+            rend.CreateTextureStaged(format, surf->w, surf->h, format, surf->pixels, cam, true) :
+            rend.CreateTexture(format, surf->w, surf->h, format, surf->pixels, true);
+    };
+
+    mCameraTexture = createTexture(AbstractRenderer::eTextureFormats::eRGB, cam->GetSurface());
+
+    if (!mFG1Texture.IsValid())
+    {
+        if (cam->GetFg1())
+        {
+            SDL_Surface* fg1Surf = cam->GetFg1()->GetSurface();
+            if (fg1Surf)
             {
-                if (mCam->GetFg1())
-                {
-                    SDL_Surface* fg1Surf = mCam->GetFg1()->GetSurface();
-                    if (fg1Surf)
-                    {
-                        mFG1Texture = rend.CreateTexture(AbstractRenderer::eTextureFormats::eRGBA, fg1Surf->w, fg1Surf->h, AbstractRenderer::eTextureFormats::eRGBA, fg1Surf->pixels, true);
-                    }
-                }
+                mFG1Texture = createTexture(AbstractRenderer::eTextureFormats::eRGBA, fg1Surf);
             }
         }
     }
@@ -55,6 +121,9 @@ void GridScreen::LoadTextures(AbstractRenderer& rend)
 
 void GridScreen::UnLoadTextures(AbstractRenderer& rend)
 {
+    // A prefetch still in flight finishes in to the residency manager rather than this screen
+    mCamFuture = std::future<std::shared_ptr<Oddlib::IBits>>();
+
     if (mCameraTexture.IsValid())
     {
         rend.DestroyTexture(mCameraTexture);
@@ -451,6 +520,7 @@ void GridMap::UnloadMap(AbstractRenderer& renderer)
         }
     }
 
+    mWorldState.ClearActiveScreen();
     mWorldState.mObjs.clear();
     mWorldState.mCollisionItems.clear();
     mWorldState.mScreens.clear();
@@ -1,6 +1,24 @@
 #include "jobsystem.hpp"
 #include "asyncqueue.hpp"
 
+void IJob::OnExecute(std::atomic_bool& quitFlag)
+{
+    CancelFlag cancelFlag(mCancel, quitFlag);
+    OnExecute(cancelFlag);
+
+    std::vector<Dependent> dependents;
+    {
+        std::lock_guard<std::mutex> lock(mDependentsMutex);
+        mExecuted = true;
+        dependents.swap(mDependents);
+    }
+
+    for (Dependent& dependent : dependents)
+    {
+        dependent.mJobSystem->DependencyExecuted(std::move(dependent.mJob), dependent.mPriority);
+    }
+}
+
 JobSystem::JobSystem()
 {
     TRACE_ENTRYEXIT;
@@ -15,22 +33,67 @@ JobSystem::~JobSystem()
     mAsyncQueue = nullptr;
 }
 
-SP_IJob JobSystem::StartJob(SP_IJob job)
+SP_IJob JobSystem::StartJob(SP_IJob job, JobPriority priority)
+{
+    mAsyncQueue->Add(job, static_cast<u32>(priority));
+    return job;
+}
+
+SP_IJob JobSystem::StartJob(SP_IJob job, JobPriority priority, const std::vector<SP_IJob>& dependencies)
 {
-    mAsyncQueue->Add(job);
+    // Held until every dependency has been registered, so that the ones that execute in the
+    // meantime can't start the job early
+    job->mPendingDependencies = 1;
+
+    for (const SP_IJob& dependency : dependencies)
+    {
+        std::lock_guard<std::mutex> lock(dependency->mDependentsMutex);
+        if (!dependency->mExecuted)
+        {
+            job->mPendingDependencies++;
+            dependency->mDependents.push_back(IJob::Dependent{ this, job, priority });
+        }
+    }
+
+    DependencyExecuted(job, priority);
     return job;
 }
 
+void JobSystem::DependencyExecuted(SP_IJob job, JobPriority priority)
+{
+    if (--job->mPendingDependencies == 0)
+    {
+        StartJob(std::move(job), priority);
+    }
+}
+
+u32 JobSystem::WorkerCount() const
+{
+    return mAsyncQueue->WorkerCount();
+}
+
+void JobSystem::RunNow(SP_IJob job)
+{
+    std::atomic_bool notQuitting{ false };
+    job->OnExecute(notQuitting);
+    mAsyncQueue->AddCompleted(job);
+}
+
+/*static*/ bool JobSystem::IsWorkerThread()
+{
+    return ASyncQueue_SP_IJob::IsWorkerThread();
+}
+
 void JobSystem::Update()
 {
     mAsyncQueue->Update();
 }
 
-SP_IJob JobTracker::StartJob(SP_IJob job)
+SP_IJob JobTracker::StartJob(SP_IJob job, JobPriority priority)
 {
     auto trackedJob = std::make_shared<TrackedJobWrapper>(*this, job);
     mOutstandingJobs.insert(trackedJob);
-    return mJobSystem.StartJob(trackedJob);
+    return mJobSystem.StartJob(trackedJob, priority);
 }
 
 TrackedJobWrapper::TrackedJobWrapper(JobTracker& jobTracker, SP_IJob trackedJob) 
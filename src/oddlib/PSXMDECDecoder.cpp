@@ -28,6 +28,7 @@
 #include <memory.h>
 
 #include "oddlib/PSXMDECDecoder.h"
+#include "oddlib/mdec_simd.hpp"
 #include "types.hpp"
 
 // This tables based on MPEG2DEC by MPEG Software Simulation Group
@@ -257,96 +258,7 @@ void PSXMDECDecoder::IDCT(int16_t *arg_block, uint8_t arg_k)
         return;
     }
 
-    int16_t *ptr = arg_block;
-    int16_t tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
-    int16_t z5, z10, z11, z12, z13;
-    for (uint8_t i = 0; i < DCT_SIZE; i++, ptr++)
-    {
-        if ((ptr[DCT_SIZE * 1] | ptr[DCT_SIZE * 2] | ptr[DCT_SIZE * 3] |
-            ptr[DCT_SIZE * 4] | ptr[DCT_SIZE * 5] | ptr[DCT_SIZE * 6] |
-            ptr[DCT_SIZE * 7]) == 0)
-        {
-            ptr[DCT_SIZE * 0] = ptr[DCT_SIZE * 1] = ptr[DCT_SIZE * 2] =
-                ptr[DCT_SIZE * 3] = ptr[DCT_SIZE * 4] = ptr[DCT_SIZE * 5] =
-                ptr[DCT_SIZE * 6] = ptr[DCT_SIZE * 7] = ptr[DCT_SIZE * 0];
-
-            continue;
-        }
-
-        z10 = ptr[DCT_SIZE * 0] + ptr[DCT_SIZE * 4];
-        z11 = ptr[DCT_SIZE * 0] - ptr[DCT_SIZE * 4];
-        z13 = ptr[DCT_SIZE * 2] + ptr[DCT_SIZE * 6];
-        z12 = (((ptr[DCT_SIZE * 2] - ptr[DCT_SIZE * 6]) * IDCT_FIX_1_414213562)
-            >> IDCT_CONST_BITS) - z13;
-
-        tmp0 = z10 + z13;
-        tmp3 = z10 - z13;
-        tmp1 = z11 + z12;
-        tmp2 = z11 - z12;
-
-        z13 = ptr[DCT_SIZE * 3] + ptr[DCT_SIZE * 5];
-        z10 = ptr[DCT_SIZE * 3] - ptr[DCT_SIZE * 5];
-        z11 = ptr[DCT_SIZE * 1] + ptr[DCT_SIZE * 7];
-        z12 = ptr[DCT_SIZE * 1] - ptr[DCT_SIZE * 7];
-
-        z5 = (((z12 - z10) * IDCT_FIX_1_847759065) >> IDCT_CONST_BITS);
-        tmp7 = z11 + z13;
-        tmp6 = ((z10 * IDCT_FIX_2_613125930) >> IDCT_CONST_BITS) + z5 - tmp7;
-        tmp5 = (((z11 - z13) * IDCT_FIX_1_414213562) >> IDCT_CONST_BITS) - tmp6;
-        tmp4 = ((z12 * IDCT_FIX_1_082392200) >> IDCT_CONST_BITS) - z5 + tmp5;
-
-        ptr[DCT_SIZE * 0] = (tmp0 + tmp7);
-        ptr[DCT_SIZE * 7] = (tmp0 - tmp7);
-        ptr[DCT_SIZE * 1] = (tmp1 + tmp6);
-        ptr[DCT_SIZE * 6] = (tmp1 - tmp6);
-        ptr[DCT_SIZE * 2] = (tmp2 + tmp5);
-        ptr[DCT_SIZE * 5] = (tmp2 - tmp5);
-        ptr[DCT_SIZE * 4] = (tmp3 + tmp4);
-        ptr[DCT_SIZE * 3] = (tmp3 - tmp4);
-    }
-
-    ptr = arg_block;
-    for (uint8_t i = 0; i < DCT_SIZE; i++, ptr += DCT_SIZE)
-    {
-        if ((ptr[1] | ptr[2] | ptr[3] | ptr[4] | ptr[5] | ptr[6] | ptr[7]) == 0)
-        {
-            ptr[0] = ptr[1] = ptr[2] = ptr[3] = ptr[4] = ptr[5] = ptr[6] =
-                ptr[7] = (ptr[0] >> (IDCT_PASS1_BITS + 3));
-
-            continue;
-        }
-
-        z10 = ptr[0] + ptr[4];
-        z11 = ptr[0] - ptr[4];
-        z13 = ptr[2] + ptr[6];
-        z12 = (((ptr[2] - ptr[6]) * IDCT_FIX_1_414213562) >> IDCT_CONST_BITS) -
-            z13;
-
-        tmp0 = z10 + z13;
-        tmp3 = z10 - z13;
-        tmp1 = z11 + z12;
-        tmp2 = z11 - z12;
-
-        z13 = ptr[3] + ptr[5];
-        z10 = ptr[3] - ptr[5];
-        z11 = ptr[1] + ptr[7];
-        z12 = ptr[1] - ptr[7];
-
-        z5 = (((z12 - z10) * IDCT_FIX_1_847759065) >> IDCT_CONST_BITS);
-        tmp7 = z11 + z13;
-        tmp6 = ((z10 * IDCT_FIX_2_613125930) >> IDCT_CONST_BITS) + z5 - tmp7;
-        tmp5 = (((z11 - z13) * IDCT_FIX_1_414213562) >> IDCT_CONST_BITS) - tmp6;
-        tmp4 = ((z12 * IDCT_FIX_1_082392200) >> IDCT_CONST_BITS) - z5 + tmp5;
-
-        ptr[0] = (tmp0 + tmp7) >> (IDCT_PASS1_BITS + 3);
-        ptr[7] = (tmp0 - tmp7) >> (IDCT_PASS1_BITS + 3);
-        ptr[1] = (tmp1 + tmp6) >> (IDCT_PASS1_BITS + 3);
-        ptr[6] = (tmp1 - tmp6) >> (IDCT_PASS1_BITS + 3);
-        ptr[2] = (tmp2 + tmp5) >> (IDCT_PASS1_BITS + 3);
-        ptr[5] = (tmp2 - tmp5) >> (IDCT_PASS1_BITS + 3);
-        ptr[4] = (tmp3 + tmp4) >> (IDCT_PASS1_BITS + 3);
-        ptr[3] = (tmp3 - tmp4) >> (IDCT_PASS1_BITS + 3);
-    }
+    Oddlib::Mdec::PsxIdct(arg_block);
 }
 
 
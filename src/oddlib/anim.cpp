@@ -9,8 +9,11 @@
 #include "oddlib/compressiontype6or7aepsx.hpp"
 #include "logger.hpp"
 #include "oddlib/sdl_raii.hpp"
+#include "oddlib/pixel_simd.hpp"
 #include <assert.h>
 #include <array>
+#include <algorithm>
+#include <cstring>
 
 namespace Oddlib
 {
@@ -28,7 +31,17 @@ namespace Oddlib
             Frame tmp;
 
             // Frame image
-            tmp.mFrame = animSet.FrameByOffset(frameInfo->mFrameHeaderOffset);
+            const AnimationSet::FrameImage* image = animSet.FrameImageByOffset(frameInfo->mFrameHeaderOffset);
+            tmp.mFrame = image->mSurface.get();
+            tmp.mFrameOffset = frameInfo->mFrameHeaderOffset;
+
+            // Where to find the frame when drawing from the atlas
+            const SDL_Surface* atlas = animSet.Atlas(image->mAtlasIndex);
+            tmp.mAtlasIndex = image->mAtlasIndex;
+            tmp.mU0 = static_cast<f32>(image->mAtlasRect.x) / atlas->w;
+            tmp.mV0 = static_cast<f32>(image->mAtlasRect.y) / atlas->h;
+            tmp.mU1 = static_cast<f32>(image->mAtlasRect.x + image->mAtlasRect.w) / atlas->w;
+            tmp.mV1 = static_cast<f32>(image->mAtlasRect.y + image->mAtlasRect.h) / atlas->h;
 
             // Frame offset so animation "looks" correct
             tmp.mOffX = frameInfo->mOffx;
@@ -48,18 +61,52 @@ namespace Oddlib
         return mFrames[idx];
     }
 
-    AnimationSet::AnimationSet(AnimSerializer& as)
+    AnimationSet::AnimationSet(AnimSerializer& as, const ParallelFor& parallelFor, bool indexed)
+        : mIndexed(indexed)
     {
         mMaxW = as.MaxW();
         mMaxH = as.MaxH();
 
-        // Add all frames
-        for (auto it : as.UniqueFrames())
+        if (mIndexed)
+        {
+            // Swap the bytes around so a colour is laid out the same as an RGBA atlas pixel
+            for (u32 i = 0; i < kPaletteSize; i++)
+            {
+                const u32 value = as.GetPaltValue(i);
+                mPalette[i] = (value >> 24) | ((value >> 8) & 0x0000FF00) | ((value << 8) & 0x00FF0000) | (value << 24);
+            }
+        }
+
+        // Add all frames. The entries are created up front so that decoding a frame only writes
+        // to its own entry and doesn't modify the map.
+        const std::vector<u32> offsets(as.UniqueFrames().begin(), as.UniqueFrames().end());
+        std::vector<FrameImage*> images;
+        images.reserve(offsets.size());
+        for (u32 offset : offsets)
+        {
+            images.push_back(&mFrames[offset]);
+        }
+
+        if (parallelFor && offsets.size() > 1 && as.HasStreamViews())
+        {
+            parallelFor(static_cast<u32>(offsets.size()), [&](u32 index)
+            {
+                std::unique_ptr<IStream> stream = as.StreamView();
+                const AnimSerializer::DecodedFrame decoded = as.ReadAndDecompressFrame(offsets[index], *stream);
+                images[index]->mSurface = indexed ? MakeIndexedFrame(as, decoded, offsets[index]) : MakeFrame(as, decoded, offsets[index]);
+            });
+        }
+        else
         {
-            const AnimSerializer::DecodedFrame decoded = as.ReadAndDecompressFrame(it);
-            mFrames[it] = MakeFrame(as, decoded, it);
+            for (size_t i = 0; i < offsets.size(); i++)
+            {
+                const AnimSerializer::DecodedFrame decoded = as.ReadAndDecompressFrame(offsets[i]);
+                images[i]->mSurface = indexed ? MakeIndexedFrame(as, decoded, offsets[i]) : MakeFrame(as, decoded, offsets[i]);
+            }
         }
 
+        BuildAtlases();
+
         // Add animations that point to the frames
         for (const std::unique_ptr<AnimSerializer::AnimationHeader>& animSet : as.Animations())
         {
@@ -71,17 +118,8 @@ namespace Oddlib
         }
     }
 
-    SDL_SurfacePtr AnimationSet::MakeFrame(AnimSerializer& as, const AnimSerializer::DecodedFrame& df, u32 offsetData)
+    /*static*/ SDL_Rect AnimationSet::FrameRect(const AnimSerializer& as, const AnimSerializer::DecodedFrame& df, u32 offsetData)
     {
-        std::vector<u32> pixels;
-        auto frame = as.ApplyPalleteToFrame(df.mFrameHeader, df.mFixedWidth, df.mPixelData, pixels);
-
-        SDL_Rect dstRect;
-        dstRect.x = 0;
-        dstRect.y = 0;
-        dstRect.w = df.mFrameHeader.mWidth;
-        dstRect.h = df.mFrameHeader.mHeight;
-
         SDL_Rect srcRect;
         if (as.IsSingleFrame())
         {
@@ -100,11 +138,6 @@ namespace Oddlib
             srcRect.y = bytes[2];
             srcRect.w = bytes[1];
             srcRect.h = bytes[0];
-
-
-            dstRect.w = srcRect.w;
-            dstRect.h = srcRect.h;
-
         }
         else
         {
@@ -113,6 +146,16 @@ namespace Oddlib
             srcRect.w = df.mFrameHeader.mWidth;
             srcRect.h = df.mFrameHeader.mHeight;
         }
+        return srcRect;
+    }
+
+    /*static*/ SDL_SurfacePtr AnimationSet::MakeFrame(const AnimSerializer& as, const AnimSerializer::DecodedFrame& df, u32 offsetData)
+    {
+        std::vector<u32> pixels;
+        auto frame = as.ApplyPalleteToFrame(df.mFrameHeader, df.mFixedWidth, df.mPixelData, pixels);
+
+        SDL_Rect srcRect = FrameRect(as, df, offsetData);
+        SDL_Rect dstRect = { 0, 0, srcRect.w, srcRect.h };
 
         const auto red_mask = 0x000000ff;
         const auto green_mask = 0x0000ff00;
@@ -124,6 +167,345 @@ namespace Oddlib
         return tmp;
     }
 
+    /*static*/ SDL_SurfacePtr AnimationSet::MakeIndexedFrame(const AnimSerializer& as, const AnimSerializer::DecodedFrame& df, u32 offsetData)
+    {
+        const u32 depth = df.mFrameHeader.mColourDepth;
+        if (depth != 8 && depth != 4)
+        {
+            throw Exception("Unsupported frame colour depth");
+        }
+
+        // Same cut out as MakeFrame, but the indices are copied instead of the colours they map to. 4 bit
+        // indices are unpacked to a byte each, low nibble first, as they can't be sampled packed.
+        const SDL_Rect srcRect = FrameRect(as, df, offsetData);
+        SDL_SurfacePtr frame(SDL_CreateRGBSurface(0, srcRect.w, srcRect.h, 8, 0, 0, 0, 0));
+        const std::vector<u8>& data = df.mPixelData;
+        for (int y = 0; y < srcRect.h; y++)
+        {
+            u8* dst = static_cast<u8*>(frame->pixels) + (y * frame->pitch);
+            const u32 srcY = static_cast<u32>(srcRect.y + y);
+            for (int x = 0; x < srcRect.w; x++)
+            {
+                // Anything outside of the decoded frame is index 0, which is the transparent colour in
+                // the palettes, as clipping the blit in MakeFrame leaves those pixels transparent
+                const u32 srcX = static_cast<u32>(srcRect.x + x);
+                if (srcX >= df.mFrameHeader.mWidth || srcY >= df.mFrameHeader.mHeight)
+                {
+                    dst[x] = 0;
+                    continue;
+                }
+
+                const u32 pixel = (srcY * df.mFixedWidth) + srcX;
+                if (depth == 8)
+                {
+                    dst[x] = pixel < data.size() ? data[pixel] : 0;
+                }
+                else
+                {
+                    const u8 packed = (pixel / 2) < data.size() ? data[pixel / 2] : 0;
+                    dst[x] = (pixel & 1) ? ((packed >> 4) & 0x0F) : (packed & 0x0F);
+                }
+            }
+        }
+        return frame;
+    }
+
+    /*static*/ void AnimationSet::ExpandIndexed(const SDL_Surface* indexed, const Palette& palette, std::vector<u32>& rgba)
+    {
+        rgba.resize(static_cast<size_t>(indexed->w) * static_cast<size_t>(indexed->h));
+        for (int y = 0; y < indexed->h; y++)
+        {
+            const u8* src = static_cast<const u8*>(indexed->pixels) + (y * indexed->pitch);
+            Pixels::ExpandPalette8(src, rgba.data() + (y * indexed->w), static_cast<u32>(indexed->w), palette.data());
+        }
+    }
+
+    // Pages are kept within the minimum max texture size that GL 3.x guarantees
+    static const u32 kAtlasPageSize = 1024;
+
+    // Transparent gap between frames so that filtering doesn't bleed in the neighbours
+    static const u32 kAtlasPadding = 1;
+
+    void AnimationSet::BuildAtlases()
+    {
+        // Shelf packing, tallest frames first so that each shelf wastes as little height as possible
+        std::vector<std::pair<u32, SDL_Surface*>> sorted;
+        sorted.reserve(mFrames.size());
+        for (const auto& frame : mFrames)
+        {
+            sorted.emplace_back(frame.first, frame.second.mSurface.get());
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), [](const std::pair<u32, SDL_Surface*>& a, const std::pair<u32, SDL_Surface*>& b)
+        {
+            return a.second->h > b.second->h;
+        });
+
+        struct PageSize
+        {
+            u32 mW;
+            u32 mH;
+        };
+        std::vector<PageSize> pages;
+
+        u32 shelfX = 0;
+        u32 shelfY = 0;
+        u32 shelfH = 0;
+        for (const auto& frame : sorted)
+        {
+            const u32 w = static_cast<u32>(frame.second->w) + kAtlasPadding;
+            const u32 h = static_cast<u32>(frame.second->h) + kAtlasPadding;
+
+            FrameImage& image = mFrames[frame.first];
+            if (w > kAtlasPageSize || h > kAtlasPageSize)
+            {
+                // Too big to share a page, gets one to itself. Next frame must start a new page.
+                pages.push_back(PageSize{ w, h });
+                image.mAtlasIndex = static_cast<u32>(pages.size() - 1);
+                image.mAtlasRect = SDL_Rect{ 0, 0, frame.second->w, frame.second->h };
+                shelfX = kAtlasPageSize;
+                shelfY = kAtlasPageSize;
+                continue;
+            }
+
+            if (shelfX + w > kAtlasPageSize)
+            {
+                shelfY += shelfH;
+                shelfX = 0;
+                shelfH = 0;
+            }
+
+            if (pages.empty() || shelfY + h > kAtlasPageSize)
+            {
+                pages.push_back(PageSize{ 0, 0 });
+                shelfX = 0;
+                shelfY = 0;
+                shelfH = 0;
+            }
+
+            image.mAtlasIndex = static_cast<u32>(pages.size() - 1);
+            image.mAtlasRect = SDL_Rect{ static_cast<int>(shelfX), static_cast<int>(shelfY), frame.second->w, frame.second->h };
+
+            PageSize& page = pages.back();
+            page.mW = std::max(page.mW, shelfX + w);
+            page.mH = std::max(page.mH, shelfY + h);
+
+            shelfX += w;
+            shelfH = std::max(shelfH, h);
+        }
+
+        // Same format as MakeFrame or MakeIndexedFrame creates
+        const auto red_mask = mIndexed ? 0 : 0x000000ff;
+        const auto green_mask = mIndexed ? 0 : 0x0000ff00;
+        const auto blue_mask = mIndexed ? 0 : 0x00ff0000;
+        const auto alpha_mask = mIndexed ? 0 : 0xff000000;
+        for (const PageSize& page : pages)
+        {
+            // Rows of 8 bit surfaces are padded to 4 bytes, indexed pages are made that wide so that they're
+            // tightly packed and can be uploaded as they are
+            const u32 w = mIndexed ? ((page.mW + 3) & ~3u) : page.mW;
+            mAtlases.emplace_back(SDL_CreateRGBSurface(0, w, page.mH, mIndexed ? 8 : 32, red_mask, green_mask, blue_mask, alpha_mask));
+        }
+
+        for (auto& frame : mFrames)
+        {
+            FrameImage& image = frame.second;
+            SDL_Surface* atlas = mAtlases[image.mAtlasIndex].get();
+
+            if (mIndexed)
+            {
+                // A blit would map the indices through the surface palettes, they're wanted as they are
+                const SDL_Surface* src = image.mSurface.get();
+                for (int y = 0; y < src->h; y++)
+                {
+                    memcpy(static_cast<u8*>(atlas->pixels) + ((image.mAtlasRect.y + y) * atlas->pitch) + image.mAtlasRect.x,
+                        static_cast<const u8*>(src->pixels) + (y * src->pitch),
+                        static_cast<size_t>(src->w));
+                }
+            }
+            else
+            {
+                // Copy the pixels as is rather than blending them with the empty page
+                SDL_SetSurfaceBlendMode(image.mSurface.get(), SDL_BLENDMODE_NONE);
+                SDL_BlitSurface(image.mSurface.get(), nullptr, atlas, &image.mAtlasRect);
+            }
+
+            // Swap the stand alone frame for a view of the atlas so the pixels are not stored twice
+            image.mSurface = AtlasView(atlas, image.mAtlasRect);
+        }
+    }
+
+    /*static*/ SDL_SurfacePtr AnimationSet::AtlasView(SDL_Surface* atlas, const SDL_Rect& rect)
+    {
+        u8* pixels = static_cast<u8*>(atlas->pixels) + (rect.y * atlas->pitch) + (rect.x * atlas->format->BytesPerPixel);
+        return SDL_SurfacePtr(SDL_CreateRGBSurfaceFrom(pixels, rect.w, rect.h, atlas->format->BitsPerPixel, atlas->pitch,
+            atlas->format->Rmask, atlas->format->Gmask, atlas->format->Bmask, atlas->format->Amask));
+    }
+
+    template<class T>
+    static void AppendCache(std::vector<u8>& out, T value)
+    {
+        static_assert(std::is_fundamental<T>::value, "Can only write fundamental types");
+        const u8* bytes = reinterpret_cast<const u8*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(value));
+    }
+
+    void AnimationSet::WriteCache(std::vector<u8>& out) const
+    {
+        AppendCache<u32>(out, mMaxW);
+        AppendCache<u32>(out, mMaxH);
+
+        AppendCache<u32>(out, mIndexed ? 1 : 0);
+        if (mIndexed)
+        {
+            for (u32 colour : mPalette)
+            {
+                AppendCache<u32>(out, colour);
+            }
+        }
+
+        AppendCache<u32>(out, static_cast<u32>(mAtlases.size()));
+        for (const SDL_SurfacePtr& atlas : mAtlases)
+        {
+            SDLHelpers::WriteSurface(out, atlas.get());
+        }
+
+        AppendCache<u32>(out, static_cast<u32>(mFrames.size()));
+        for (const auto& frame : mFrames)
+        {
+            AppendCache<u32>(out, frame.first);
+            AppendCache<u32>(out, frame.second.mAtlasIndex);
+            AppendCache<s32>(out, frame.second.mAtlasRect.x);
+            AppendCache<s32>(out, frame.second.mAtlasRect.y);
+            AppendCache<s32>(out, frame.second.mAtlasRect.w);
+            AppendCache<s32>(out, frame.second.mAtlasRect.h);
+        }
+
+        // Only what Animation keeps of the headers, which is all that's needed to construct them again
+        AppendCache<u32>(out, static_cast<u32>(mAnimations.size()));
+        for (const std::unique_ptr<Animation>& anim : mAnimations)
+        {
+            u32 flags = 0;
+            flags |= anim->Loop() ? AnimSerializer::AnimationHeader::eLoopFlag : 0;
+            flags |= anim->FlipX() ? AnimSerializer::AnimationHeader::eFlipXFlag : 0;
+            flags |= anim->FlipY() ? AnimSerializer::AnimationHeader::eFlipYFlag : 0;
+
+            AppendCache<u32>(out, anim->Fps());
+            AppendCache<u32>(out, anim->LoopStartFrame());
+            AppendCache<u32>(out, flags);
+            AppendCache<u32>(out, static_cast<u32>(anim->NumFrames()));
+            for (s32 i = 0; i < anim->NumFrames(); i++)
+            {
+                const Animation::Frame& frame = anim->GetFrame(i);
+                AppendCache<u32>(out, frame.mFrameOffset);
+                AppendCache<s32>(out, frame.mOffX);
+                AppendCache<s32>(out, frame.mOffY);
+                AppendCache<s32>(out, frame.mTopLeft.x);
+                AppendCache<s32>(out, frame.mTopLeft.y);
+                AppendCache<s32>(out, frame.mBottomRight.x);
+                AppendCache<s32>(out, frame.mBottomRight.y);
+            }
+        }
+    }
+
+    template<class T>
+    static T ReadCacheValue(IStream& stream)
+    {
+        T value = 0;
+        stream.Read(value);
+        return value;
+    }
+
+    /*static*/ std::unique_ptr<AnimationSet> AnimationSet::ReadCache(IStream& stream)
+    {
+        std::unique_ptr<AnimationSet> animSet(new AnimationSet());
+        animSet->mMaxW = ReadCacheValue<u32>(stream);
+        animSet->mMaxH = ReadCacheValue<u32>(stream);
+
+        animSet->mIndexed = ReadCacheValue<u32>(stream) != 0;
+        if (animSet->mIndexed)
+        {
+            for (u32& colour : animSet->mPalette)
+            {
+                colour = ReadCacheValue<u32>(stream);
+            }
+        }
+
+        const u32 numAtlases = ReadCacheValue<u32>(stream);
+        for (u32 i = 0; i < numAtlases; i++)
+        {
+            animSet->mAtlases.push_back(SDLHelpers::ReadSurface(stream));
+            if (animSet->mAtlases.back()->format->BitsPerPixel != (animSet->mIndexed ? 8 : 32))
+            {
+                throw Exception("Cached atlas is the wrong bit depth");
+            }
+        }
+
+        const u32 numFrames = ReadCacheValue<u32>(stream);
+        for (u32 i = 0; i < numFrames; i++)
+        {
+            const u32 offset = ReadCacheValue<u32>(stream);
+            FrameImage& image = animSet->mFrames[offset];
+            image.mAtlasIndex = ReadCacheValue<u32>(stream);
+            image.mAtlasRect.x = ReadCacheValue<s32>(stream);
+            image.mAtlasRect.y = ReadCacheValue<s32>(stream);
+            image.mAtlasRect.w = ReadCacheValue<s32>(stream);
+            image.mAtlasRect.h = ReadCacheValue<s32>(stream);
+
+            if (image.mAtlasIndex >= numAtlases)
+            {
+                throw Exception("Cached frame atlas index out of bounds");
+            }
+
+            SDL_Surface* atlas = animSet->mAtlases[image.mAtlasIndex].get();
+            const SDL_Rect& rect = image.mAtlasRect;
+            // Frames can be empty, MakeFrame() and BuildAtlases() give them a zero sized rect
+            if (rect.x < 0 || rect.y < 0 || rect.w < 0 || rect.h < 0 || rect.x + rect.w > atlas->w || rect.y + rect.h > atlas->h)
+            {
+                throw Exception("Cached frame rect out of bounds");
+            }
+            image.mSurface = AtlasView(atlas, rect);
+        }
+
+        const u32 numAnimations = ReadCacheValue<u32>(stream);
+        for (u32 i = 0; i < numAnimations; i++)
+        {
+            AnimSerializer::AnimationHeader header;
+            header.mFps = static_cast<u16>(ReadCacheValue<u32>(stream));
+            header.mLoopStartFrame = static_cast<u16>(ReadCacheValue<u32>(stream));
+            header.mFlags = static_cast<u16>(ReadCacheValue<u32>(stream));
+
+            const u32 numAnimFrames = ReadCacheValue<u32>(stream);
+            if (numAnimFrames == 0 || numAnimFrames > 0xFFFF)
+            {
+                throw Exception("Bad cached animation frame count");
+            }
+            header.mNumFrames = static_cast<u16>(numAnimFrames);
+
+            for (u32 j = 0; j < numAnimFrames; j++)
+            {
+                auto frameInfo = std::make_unique<AnimSerializer::FrameInfoHeader>();
+                frameInfo->mFrameHeaderOffset = ReadCacheValue<u32>(stream);
+                frameInfo->mOffx = static_cast<s16>(ReadCacheValue<s32>(stream));
+                frameInfo->mOffy = static_cast<s16>(ReadCacheValue<s32>(stream));
+                frameInfo->mTopLeft.x = static_cast<s16>(ReadCacheValue<s32>(stream));
+                frameInfo->mTopLeft.y = static_cast<s16>(ReadCacheValue<s32>(stream));
+                frameInfo->mBottomRight.x = static_cast<s16>(ReadCacheValue<s32>(stream));
+                frameInfo->mBottomRight.y = static_cast<s16>(ReadCacheValue<s32>(stream));
+
+                // Animation's constructor expects every frame to exist
+                if (!animSet->FrameImageByOffset(frameInfo->mFrameHeaderOffset))
+                {
+                    throw Exception("Cached animation refers to a missing frame");
+                }
+                header.mFrameInfos.push_back(std::move(frameInfo));
+            }
+
+            animSet->mAnimations.push_back(std::make_unique<Animation>(header, *animSet));
+        }
+
+        return animSet;
+    }
+
     u32 AnimationSet::NumberOfAnimations() const
     {
         return static_cast<u32>(mAnimations.size());
@@ -135,15 +517,36 @@ namespace Oddlib
     }
 
     SDL_Surface* AnimationSet::FrameByOffset(u32 offset) const
+    {
+        const FrameImage* image = FrameImageByOffset(offset);
+        return image ? image->mSurface.get() : nullptr;
+    }
+
+    const AnimationSet::FrameImage* AnimationSet::FrameImageByOffset(u32 offset) const
     {
         auto it = mFrames.find(offset);
         if (it != std::end(mFrames))
         {
-            return it->second.get();
+            return &it->second;
         }
         return nullptr;
     }
 
+    size_t AnimationSet::SizeInBytes() const
+    {
+        size_t size = sizeof(AnimationSet);
+        for (const SDL_SurfacePtr& atlas : mAtlases)
+        {
+            size += static_cast<size_t>(atlas->h) * static_cast<size_t>(atlas->pitch);
+        }
+        size += mFrames.size() * sizeof(FrameImage);
+        for (const std::unique_ptr<Animation>& anim : mAnimations)
+        {
+            size += sizeof(Animation) + (static_cast<size_t>(anim->NumFrames()) * sizeof(Animation::Frame));
+        }
+        return size;
+    }
+
     std::unique_ptr<AnimationSet> LoadAnimations(IStream& stream, bool bIsPsx)
     {
         AnimSerializer as(stream, bIsPsx);
@@ -356,57 +759,23 @@ namespace Oddlib
         }
 
         // Read the palette
-        mPalt.reserve(mHeader.mPaltSize);
+        std::vector<u16> colours(mHeader.mPaltSize);
+        mStream.Read(colours);
 
-        for (auto i = 0u; i < mHeader.mPaltSize; i++)
+        // TODO: Only apply to problematic sprites in AO PSX demo
+        /*
+        for (u16& colour : colours)
         {
-            u16 tmp = 0;
-            mStream.Read(tmp);
-
-            unsigned int oldPixel = tmp;
-
-            // TODO: Only apply to problematic sprites in AO PSX demo
-            /*
-            if (oldPixel == 0x0400 || oldPixel == 0xe422 || oldPixel == 0x9c00)
+            if (colour == 0x0400 || colour == 0xe422 || colour == 0x9c00)
             {
-            oldPixel = 1 << 15;
+                colour = 1 << 15;
             }
-            */
-
-            const unsigned short int semiTrans = (((oldPixel) >> 15) & 0xffff);
-
-
-            // RGB555
-            const unsigned short int green16 = ((oldPixel >> 5) & 0x1F);
-            const unsigned short int red16 = ((oldPixel >> 0) & 0x1F);
-            const unsigned short int blue16 = ((oldPixel >> 10) & 0x1F);
-
-            // TODO: Get colour ramp off real PSX in 16bit mode as they dont 100% map to PC RGB ramp
-
-            const unsigned int green32 = ((green16 * 255) / 31);
-            const unsigned int blue32 = ((blue16 * 255) / 31);
-            const unsigned int red32 = ((red16 * 255) / 31);
-
-
-            unsigned int newPixel = (red32 << 24) | (blue32 << 8) | (green32 << 16);
-            //unsigned int newPixel = (blue32 << 8) | (green32 << 0) | (red32 << 16);
-
-            if (semiTrans)
-            {
-                newPixel |= (255 / 2);
-            }
-            else if (newPixel == 0)
-            {
-                // Fully transparent
-                newPixel |= 0;
-            }
-            else
-            {
-                newPixel |= 255;
-            }
-
-            mPalt.push_back(newPixel);
         }
+        */
+
+        // TODO: Get colour ramp off real PSX in 16bit mode as they dont 100% map to PC RGB ramp
+        mPalt.resize(colours.size());
+        Pixels::Bgr555ToRgba(colours.data(), mPalt.data(), static_cast<u32>(colours.size()));
         return frameStart;
     }
 
@@ -543,14 +912,14 @@ namespace Oddlib
     }
 
     template<class T>
-    std::vector<u8> AnimSerializer::Decompress(AnimSerializer::FrameHeader& header, u32 finalW)
+    /*static*/ std::vector<u8> AnimSerializer::Decompress(IStream& stream, AnimSerializer::FrameHeader& header, u32 finalW)
     {
         T decompressor;
-        auto decompressedData = decompressor.Decompress(mStream, finalW, header.mWidth, header.mHeight, header.mFrameDataSize);
+        auto decompressedData = decompressor.Decompress(stream, finalW, header.mWidth, header.mHeight, header.mFrameDataSize);
         return decompressedData;
     }
 
-    u32 AnimSerializer::GetPaltValue(u32 idx)
+    u32 AnimSerializer::GetPaltValue(u32 idx) const
     {
         // ABEEND.BAN from the AO PSX demo goes out of bounds - probably why the resulting
         // beta image looks quite strange.
@@ -562,17 +931,21 @@ namespace Oddlib
         return mPalt[idx];
     }
 
-    SDL_SurfacePtr AnimSerializer::ApplyPalleteToFrame(const FrameHeader& header, u32 realWidth, const std::vector<u8>& decompressedData, std::vector<u32>& pixels)
+    SDL_SurfacePtr AnimSerializer::ApplyPalleteToFrame(const FrameHeader& header, u32 realWidth, const std::vector<u8>& decompressedData, std::vector<u32>& pixels) const
     {
         // Apply the pallete
         if (header.mColourDepth == 8)
         {
-            // TODO: Could recycle buffer
-            pixels.reserve(pixels.size());
-            for (auto v : decompressedData)
+            // Looked up once per index rather than once per pixel, GetPaltValue() clamps out of range indices
+            std::array<u32, 256> palette;
+            for (u32 i = 0; i < palette.size(); i++)
             {
-                pixels.push_back(GetPaltValue(v));
+                palette[i] = GetPaltValue(i);
             }
+
+            // TODO: Could recycle buffer
+            pixels.resize(decompressedData.size());
+            Pixels::ExpandPalette8(decompressedData.data(), pixels.data(), static_cast<u32>(decompressedData.size()), palette.data());
             // Create an SDL surface
             const auto red_mask = 0xff000000;
             const auto green_mask = 0x00ff0000;
@@ -584,16 +957,15 @@ namespace Oddlib
         }
         else if (header.mColourDepth == 4)
         {
-#define HI_NIBBLE(b) (((b) >> 4) & 0x0F)
-#define LO_NIBBLE(b) ((b) & 0x0F)
-
-            pixels.reserve(decompressedData.size() * 2);
-            for (auto v : decompressedData)
+            std::array<u32, 16> palette;
+            for (u32 i = 0; i < palette.size(); i++)
             {
-                pixels.push_back(GetPaltValue(LO_NIBBLE(v)));
-                pixels.push_back(GetPaltValue(HI_NIBBLE(v)));
+                palette[i] = GetPaltValue(i);
             }
 
+            pixels.resize(decompressedData.size() * 2);
+            Pixels::ExpandPalette4(decompressedData.data(), pixels.data(), static_cast<u32>(pixels.size()), palette.data());
+
             // Create an SDL surface
             const auto red_mask = 0xff000000;
             const auto green_mask = 0x00ff0000;
@@ -609,29 +981,48 @@ namespace Oddlib
         }
     }
 
+    bool AnimSerializer::HasStreamViews() const
+    {
+        return dynamic_cast<const MemoryStream*>(&mStream) != nullptr;
+    }
+
+    std::unique_ptr<IStream> AnimSerializer::StreamView() const
+    {
+        if (!HasStreamViews())
+        {
+            return nullptr;
+        }
+        return std::unique_ptr<IStream>(mStream.Clone());
+    }
+
     AnimSerializer::DecodedFrame AnimSerializer::ReadAndDecompressFrame(u32 frameOffset)
+    {
+        return ReadAndDecompressFrame(frameOffset, mStream);
+    }
+
+    AnimSerializer::DecodedFrame AnimSerializer::ReadAndDecompressFrame(u32 frameOffset, IStream& stream) const
     {
         DecodedFrame ret;
 
         if (mSingleFrameOffset > 0)
         {
             // There is only one frame here.. can't seek anywhere else!
-            mStream.Seek(mSingleFrameOffset);
+            stream.Seek(mSingleFrameOffset);
         }
         else
         {
-            mStream.Seek(frameOffset);
+            stream.Seek(frameOffset);
         }
 
         FrameHeader frameHeader;
-        mStream.Read(frameHeader.mClutOffset);
+        stream.Read(frameHeader.mClutOffset);
 
 
-        mStream.Read(frameHeader.mWidth);
-        mStream.Read(frameHeader.mHeight);
-        mStream.Read(frameHeader.mColourDepth);
-        mStream.Read(frameHeader.mCompressionType);
-        mStream.Read(frameHeader.mFrameDataSize);
+        stream.Read(frameHeader.mWidth);
+        stream.Read(frameHeader.mHeight);
+        stream.Read(frameHeader.mColourDepth);
+        stream.Read(frameHeader.mCompressionType);
+        stream.Read(frameHeader.mFrameDataSize);
 
         u32 nTextureWidth = 0;
         u32 actualWidth = 0;
@@ -670,7 +1061,7 @@ namespace Oddlib
             {
 
                 // The frame size field isn't used in this case, its actually part of the frame pixel data
-                mStream.Seek(mStream.Pos() - 4);
+                stream.Seek(stream.Pos() - 4);
 
                 if (frameHeader.mColourDepth == 4)
                 {
@@ -687,7 +1078,7 @@ namespace Oddlib
 
                 if (!ret.mPixelData.empty())
                 {
-                    mStream.Read(ret.mPixelData);
+                    stream.Read(ret.mPixelData);
                 }
                 else
                 {
@@ -703,25 +1094,25 @@ namespace Oddlib
 
         case 2:
            // In AE but never used, used for AO, same algorithm, 0x0040AA50 in AE
-            ret.mPixelData = Decompress<CompressionType2>(frameHeader, actualWidth);
+            ret.mPixelData = Decompress<CompressionType2>(stream, frameHeader, actualWidth);
             break;
 
         case 3:
             if (frameHeader.mClutOffset == 0x8)
             {
                 // The size is the header seems to be half the size of the calculated frameDataSize, give or take 3 bytes
-                ret.mPixelData = Decompress<CompressionType3>(frameHeader, actualWidth );
+                ret.mPixelData = Decompress<CompressionType3>(stream, frameHeader, actualWidth );
             }
             else
             {
-                ret.mPixelData = Decompress<CompressionType3Ae>(frameHeader, actualWidth);
+                ret.mPixelData = Decompress<CompressionType3Ae>(stream, frameHeader, actualWidth);
             }
             break;
 
         case 4:
         case 5:
             // Both AO and AE
-            ret.mPixelData = Decompress<CompressionType4Or5>(frameHeader, actualWidth);
+            ret.mPixelData = Decompress<CompressionType4Or5>(stream, frameHeader, actualWidth);
             break;
 
         // AO cases end at 5
@@ -732,11 +1123,11 @@ namespace Oddlib
 
                 // This clips off extra "bad" pixels that sometimes get added
                 frameHeader.mHeight -= 1;
-                ret.mPixelData = Decompress<CompressionType6or7AePsx<8>>(frameHeader, actualWidth);
+                ret.mPixelData = Decompress<CompressionType6or7AePsx<8>>(stream, frameHeader, actualWidth);
             }
             else
             {
-                ret.mPixelData = Decompress<CompressionType6Ae>(frameHeader, actualWidth);
+                ret.mPixelData = Decompress<CompressionType6Ae>(stream, frameHeader, actualWidth);
             }
             break;
             
@@ -746,7 +1137,7 @@ namespace Oddlib
             {
                 // This clips off extra "bad" pixels that sometimes get added
                 frameHeader.mHeight -= 1;
-                ret.mPixelData = Decompress<CompressionType6or7AePsx<6>>(frameHeader, actualWidth);
+                ret.mPixelData = Decompress<CompressionType6or7AePsx<6>>(stream, frameHeader, actualWidth);
             }
             else
             {
@@ -754,7 +1145,7 @@ namespace Oddlib
 
                 // This clips off extra "bad" pixels that sometimes get added
                 frameHeader.mHeight -= 1;
-                ret.mPixelData = Decompress<CompressionType6or7AePsx<8>>(frameHeader, actualWidth);
+                ret.mPixelData = Decompress<CompressionType6or7AePsx<8>>(stream, frameHeader, actualWidth);
             }
             break;
 
@@ -126,7 +126,7 @@ namespace Oddlib
         const u32 kStripSize = 16;
         const u32 kNumStrips = 640 / kStripSize;
 
-        memset(g_vram, 0, sizeof(g_vram));
+        g_vram.reset(new unsigned short int[240][640]());
 
         for (u32 i = 0; i < kNumStrips; i++)
         {
@@ -156,11 +156,11 @@ namespace Oddlib
             }
         }
 
-        mSurface.reset(SDL_CreateRGBSurfaceFrom(g_vram, 640, 240, 16, 640 * sizeof(u16), red_mask, green_mask, blue_mask, 0));
-        if (mSurface->format->format != SDL_PIXELFORMAT_RGB24)
-        {
-            mSurface.reset(SDL_ConvertSurfaceFormat(mSurface.get(), SDL_PIXELFORMAT_RGB24, 0));
-        }
+        // Always a copy, the vram surface only borrows the scratch buffer
+        SDL_SurfacePtr vram(SDL_CreateRGBSurfaceFrom(g_vram.get(), 640, 240, 16, 640 * sizeof(u16), red_mask, green_mask, blue_mask, 0));
+        mSurface = SDLHelpers::Rgb565ToRgb24(vram.get());
+        vram.reset();
+        g_vram.reset();
     }
 
     void AeBitsPc::vlc_decode(const std::vector<u16>& aCamSeg, std::vector<u16>& aDst)
@@ -56,10 +56,7 @@ namespace Oddlib
             dstRect.h = 240;
             SDL_BlitSurface(strip.get(), NULL, mSurface.get(), &dstRect);
         } 
-        if (mSurface->format->format != SDL_PIXELFORMAT_RGB24)
-        {
-            mSurface.reset(SDL_ConvertSurfaceFormat(mSurface.get(), SDL_PIXELFORMAT_RGB24, 0));
-        }
+        mSurface = SDLHelpers::Rgb565ToRgb24(mSurface.get());
     }
 
 }
@@ -144,13 +144,34 @@ namespace Oddlib
         abort();
     }
 
+    class SurfaceFg1 : public IFg1
+    {
+    public:
+        SurfaceFg1(SDL_SurfacePtr fg1Image)
+            : mFg1Image(std::move(fg1Image))
+        {
+
+        }
+
+        virtual SDL_Surface* GetSurface() const override
+        {
+            return mFg1Image.get();
+        }
+
+    private:
+        SDL_SurfacePtr mFg1Image;
+    };
+
     class Bits : public IBits
     {
     public:
-        Bits(SDL_SurfacePtr camImage)
+        Bits(SDL_SurfacePtr camImage, SDL_SurfacePtr fg1Image)
             : mCameraImage(std::move(camImage))
         {
-
+            if (fg1Image)
+            {
+                mFg1 = std::make_unique<SurfaceFg1>(std::move(fg1Image));
+            }
         }
 
         virtual SDL_Surface* GetSurface() const override
@@ -158,15 +179,16 @@ namespace Oddlib
             return mCameraImage.get();
         }
 
-        virtual IFg1* GetFg1() const override { return nullptr; }
+        virtual IFg1* GetFg1() const override { return mFg1.get(); }
 
     private:
         SDL_SurfacePtr mCameraImage;
+        std::unique_ptr<SurfaceFg1> mFg1;
     };
 
-    std::unique_ptr<IBits> MakeBits(SDL_SurfacePtr camImage)
+    std::unique_ptr<IBits> MakeBits(SDL_SurfacePtr camImage, SDL_SurfacePtr fg1Image)
     {
-        return std::make_unique<Bits>(std::move(camImage));
+        return std::make_unique<Bits>(std::move(camImage), std::move(fg1Image));
     }
 
     std::unique_ptr<IBits> MakeBits(IStream& bitsStream, IStream* fg1Stream)
@@ -104,10 +104,7 @@ namespace Oddlib
             }
         }
 
-        if (mSurface->format->format != SDL_PIXELFORMAT_RGB24)
-        {
-            mSurface.reset(SDL_ConvertSurfaceFormat(mSurface.get(), SDL_PIXELFORMAT_RGB24, 0));
-        }
+        mSurface = SDLHelpers::Rgb565ToRgb24(mSurface.get());
     }
 
 }
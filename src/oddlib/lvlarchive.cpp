@@ -1,8 +1,8 @@
-#include <algorithm>
 #include "oddlib/lvlarchive.hpp"
 #include "oddlib/exceptions.hpp"
 #include "logger.hpp"
 #include <fstream>
+#include <cstring>
 
 namespace Oddlib
 {
@@ -16,19 +16,42 @@ namespace Oddlib
         return mType;
     }
 
+    u32 LvlArchive::FileChunk::Size() const
+    {
+        return mDataSize;
+    }
+
     std::vector<u8> LvlArchive::FileChunk::ReadData() const
     {
         std::vector<u8> r(mDataSize);
         if (mDataSize > 0)
         {
-            mStream.Seek(mFilePos);
-            mStream.Read(r);
+            if (const MemoryStream* memoryStream = dynamic_cast<const MemoryStream*>(&mStream))
+            {
+                // No seeking so no need to lock
+                if (static_cast<size_t>(mFilePos) + mDataSize > memoryStream->Size())
+                {
+                    throw Exception("ReadBytes failure");
+                }
+                memcpy(r.data(), memoryStream->Data() + mFilePos, mDataSize);
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(mStreamMutex);
+                mStream.Seek(mFilePos);
+                mStream.Read(r);
+            }
         }
         return r;
     }
 
     std::unique_ptr<Oddlib::IStream> LvlArchive::FileChunk::Stream() const
     {
+        // When the whole LVL is already in memory the chunk can be a view in to it
+        if (MemoryStream* memoryStream = dynamic_cast<MemoryStream*>(&mStream))
+        {
+            return std::unique_ptr<Oddlib::IStream>(memoryStream->Clone(mFilePos, mDataSize));
+        }
         return std::make_unique<MemoryStream>(ReadData());
     }
     
@@ -64,7 +87,7 @@ namespace Oddlib
 
     // ===================================================================
 
-    LvlArchive::File::File(IStream& stream, const LvlArchive::FileRecord& rec)
+    LvlArchive::File::File(IStream& stream, std::mutex& streamMutex, const LvlArchive::FileRecord& rec)
     {
         mFileName = std::string(
             reinterpret_cast<const char*>(rec.iFileNameBytes), 
@@ -76,31 +99,39 @@ namespace Oddlib
         if (string_util::ends_with(mFileName, ".VH") || string_util::ends_with(mFileName, ".VB"))
         {
             // Handle loading as a "blob" by inserting a dummy chunk
-            mChunks.emplace_back(std::make_unique<FileChunk>(stream, 0, 0, rec.iFileSize));
-            return;
+            mChunks.emplace_back(std::make_unique<FileChunk>(stream, streamMutex, 0, 0, rec.iFileSize));
+        }
+        else
+        {
+            LoadChunks(stream, streamMutex, rec.iFileSize);
         }
+        BuildIndex();
+    }
 
-        LoadChunks(stream, rec.iFileSize);
+    void LvlArchive::File::BuildIndex()
+    {
+        const u32 count = static_cast<u32>(mChunks.size());
+        mChunksById.Reset(count);
+        mChunksByType.Reset(count);
+        for (u32 i = 0; i < count; i++)
+        {
+            const u32 id = mChunks[i]->Id();
+            const u32 type = mChunks[i]->Type();
+            mChunksById.Insert(HashU32(id), i, [&](u32 existing) { return mChunks[existing]->Id() == id; });
+            mChunksByType.Insert(HashU32(type), i, [&](u32 existing) { return mChunks[existing]->Type() == type; });
+        }
     }
 
     LvlArchive::FileChunk* LvlArchive::File::ChunkById(u32 id)
     {
-        LOG_INFO("Find chunk with id " << id);
-        auto it = std::find_if(std::begin(mChunks), std::end(mChunks), [&] (std::unique_ptr<FileChunk>& chunk)
-        {
-            return chunk->Id() == id;
-        });
-        return it == std::end(mChunks) ? nullptr : it->get();
+        const u32 index = mChunksById.Find(HashU32(id), [&](u32 i) { return mChunks[i]->Id() == id; });
+        return index == HashIndex::kNotFound ? nullptr : mChunks[index].get();
     }
 
     LvlArchive::FileChunk* LvlArchive::File::ChunkByType(u32 type)
     {
-        LOG_INFO("Find chunk with type " << type);
-        auto it = std::find_if(std::begin(mChunks), std::end(mChunks), [&](std::unique_ptr<FileChunk>& chunk)
-        {
-            return chunk->Type() == type;
-        });
-        return it == std::end(mChunks) ? nullptr : it->get();
+        const u32 index = mChunksByType.Find(HashU32(type), [&](u32 i) { return mChunks[i]->Type() == type; });
+        return index == HashIndex::kNotFound ? nullptr : mChunks[index].get();
     }
 
     void LvlArchive::File::SaveChunks()
@@ -116,7 +147,7 @@ namespace Oddlib
         }
     }
 
-    void LvlArchive::File::LoadChunks(IStream& stream, u32 fileSize)
+    void LvlArchive::File::LoadChunks(IStream& stream, std::mutex& streamMutex, u32 fileSize)
     {
         while (stream.Pos() < (stream.Pos() + fileSize))
         {
@@ -131,7 +162,7 @@ namespace Oddlib
 
             if (!isEnd)
             {
-                mChunks.emplace_back(std::make_unique<FileChunk>(stream, header.iType, header.iId, header.iSize - kChunkHeaderSize));
+                mChunks.emplace_back(std::make_unique<FileChunk>(stream, streamMutex, header.iType, header.iId, header.iSize - kChunkHeaderSize));
             }
 
             // Only move to next if the block isn't empty
@@ -151,7 +182,7 @@ namespace Oddlib
     // ===================================================================
 
     LvlArchive::LvlArchive(const std::string& fileName)
-        : mStream(std::make_unique<FileStream>(fileName, IStream::ReadMode::ReadOnly))
+        : mStream(OpenReadOnly(fileName))
     {
         TRACE_ENTRYEXIT;
         Load();
@@ -206,7 +237,14 @@ namespace Oddlib
 
         for (const auto& rec : recs)
         {
-            mFiles.emplace_back(std::make_unique<File>(*mStream, rec));
+            mFiles.emplace_back(std::make_unique<File>(*mStream, mStreamMutex, rec));
+        }
+
+        mFilesByName.Reset(static_cast<u32>(mFiles.size()));
+        for (u32 i = 0; i < mFiles.size(); i++)
+        {
+            const std::string& name = mFiles[i]->FileName();
+            mFilesByName.Insert(HashString(name), i, [&](u32 existing) { return mFiles[existing]->FileName() == name; });
         }
 
         LOG_INFO("Loaded LVL '" << mStream->Name() << "' with " << header.iNumFiles << " files");
@@ -214,12 +252,8 @@ namespace Oddlib
 
     LvlArchive::File* LvlArchive::FileByName(const std::string& fileName)
     {
-        LOG_INFO("Find file '" << fileName << "'");
-        auto it = std::find_if(std::begin(mFiles), std::end(mFiles), [&](std::unique_ptr<File>& file)
-        {
-            return file->FileName() == fileName;
-        });
-        return it == std::end(mFiles) ? nullptr : it->get();
+        const u32 index = mFilesByName.Find(HashString(fileName), [&](u32 i) { return mFiles[i]->FileName() == fileName; });
+        return index == HashIndex::kNotFound ? nullptr : mFiles[index].get();
     }
 
     void LvlArchive::ReadHeader(LvlHeader& header)
@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <array>
 #include "oddlib/PSXMDECDecoder.h"
+#include "oddlib/mdec_simd.hpp"
 
 constexpr u32 kVideoFlag = 1;
 constexpr u32 kAudioFlag = 2;
@@ -518,159 +519,9 @@ namespace Oddlib
         return (int16_t*)pInput;
     }
 
-    // TODO: Should probably just be 64? Making this bigger fixes a sound glitch which is probably caused
-    // by an out of bounds write somewhere.
-    typedef std::array<int32_t, 64 * 4> T64IntsArray;
-
-    static T64IntsArray Cr_block = {};
-    static T64IntsArray Cb_block = {};
-    static T64IntsArray Y1_block = {};
-    static T64IntsArray Y2_block = {};
-    static T64IntsArray Y3_block = {};
-    static T64IntsArray Y4_block = {};
-
-
-    void half_idct(T64IntsArray& pSource, T64IntsArray& pDestination, int nPitch, int nIncrement, int nShift)
-    {
-        std::array<int32_t, 8> pTemp;
-
-        size_t sourceIdx = 0;
-        size_t destinationIdx = 0;
-
-        for (int i = 0; i < 8; i++)
-        {
-            pTemp[4] = pSource[(0 * nPitch) + sourceIdx] * 8192 + pSource[(2 * nPitch) + sourceIdx] * 10703 + pSource[(4 * nPitch) + sourceIdx] * 8192 + pSource[(6 * nPitch) + sourceIdx] * 4433;
-            pTemp[5] = pSource[(0 * nPitch) + sourceIdx] * 8192 + pSource[(2 * nPitch) + sourceIdx] * 4433 - pSource[(4 * nPitch) + sourceIdx] * 8192 - pSource[(6 * nPitch) + sourceIdx] * 10704;
-            pTemp[6] = pSource[(0 * nPitch) + sourceIdx] * 8192 - pSource[(2 * nPitch) + sourceIdx] * 4433 - pSource[(4 * nPitch) + sourceIdx] * 8192 + pSource[(6 * nPitch) + sourceIdx] * 10704;
-            pTemp[7] = pSource[(0 * nPitch) + sourceIdx] * 8192 - pSource[(2 * nPitch) + sourceIdx] * 10703 + pSource[(4 * nPitch) + sourceIdx] * 8192 - pSource[(6 * nPitch) + sourceIdx] * 4433;
-
-            pTemp[0] = pSource[(1 * nPitch) + sourceIdx] * 11363 + pSource[(3 * nPitch) + sourceIdx] * 9633 + pSource[(5 * nPitch) + sourceIdx] * 6437 + pSource[(7 * nPitch) + sourceIdx] * 2260;
-            pTemp[1] = pSource[(1 * nPitch) + sourceIdx] * 9633 - pSource[(3 * nPitch) + sourceIdx] * 2259 - pSource[(5 * nPitch) + sourceIdx] * 11362 - pSource[(7 * nPitch) + sourceIdx] * 6436;
-            pTemp[2] = pSource[(1 * nPitch) + sourceIdx] * 6437 - pSource[(3 * nPitch) + sourceIdx] * 11362 + pSource[(5 * nPitch) + sourceIdx] * 2261 + pSource[(7 * nPitch) + sourceIdx] * 9633;
-            pTemp[3] = pSource[(1 * nPitch) + sourceIdx] * 2260 - pSource[(3 * nPitch) + sourceIdx] * 6436 + pSource[(5 * nPitch) + sourceIdx] * 9633 - pSource[(7 * nPitch) + sourceIdx] * 11363;
-
-            pDestination[(0 * nPitch) + destinationIdx] = (pTemp[4] + pTemp[0]) >> nShift;
-            pDestination[(1 * nPitch) + destinationIdx] = (pTemp[5] + pTemp[1]) >> nShift;
-            pDestination[(2 * nPitch) + destinationIdx] = (pTemp[6] + pTemp[2]) >> nShift;
-            pDestination[(3 * nPitch) + destinationIdx] = (pTemp[7] + pTemp[3]) >> nShift;
-            pDestination[(4 * nPitch) + destinationIdx] = (pTemp[7] - pTemp[3]) >> nShift;
-            pDestination[(5 * nPitch) + destinationIdx] = (pTemp[6] - pTemp[2]) >> nShift;
-            pDestination[(6 * nPitch) + destinationIdx] = (pTemp[5] - pTemp[1]) >> nShift;
-            pDestination[(7 * nPitch) + destinationIdx] = (pTemp[4] - pTemp[0]) >> nShift;
-
-            sourceIdx += nIncrement;
-            destinationIdx += nIncrement;
-        }
-    }
-
-    // 0x40ED90
-    void idct(int16_t* input, T64IntsArray& pDestination) // dst is 64 dwords
-    {
-        T64IntsArray pTemp;
-        T64IntsArray pExtendedSource;
-
-        // Source is passed as signed 16 bits stored every 32 bits
-        // We sign extend it at the beginning like Masher does
-        for (int i = 0; i < 64; i++)
-        {
-            pExtendedSource[i] = input[i * 2];
-        }
-
-        half_idct(pExtendedSource, pTemp, 8, 1, 11);
-        half_idct(pTemp, pDestination, 1, 8, 18);
-    }
-
-    static int To1d(int x, int y)
-    {
-        // 8x8 index to x64 index
-        return y * 8 + x;
-    }
-
-    unsigned char Clamp(f32 v)
-    {
-        if (v < 0.0f) v = 0.0f;
-        if (v > 255.0f) v = 255.0f;
-        return (unsigned char)v;
-    }
-
-    void SetElement(int x, int y, int width, u32* ptr, u32 value)
-    {
-        ptr[(width * y) + x] = value;
-    }
-
-    static void ConvertYuvToRgbAndBlit(u32* pixelBuffer, int xoff, int yoff, int width, int height)
-    {
-        // convert the Y1 Y2 Y3 Y4 and Cb and Cr blocks into a 16x16 array of (Y, Cb, Cr) pixels
-        struct Macroblock_YCbCr_Struct
-        {
-            f32 Y;
-            f32 Cb;
-            f32 Cr;
-        };
-
-        std::array< std::array<Macroblock_YCbCr_Struct, 16>, 16> Macroblock_YCbCr = {};
-
-        for (int x = 0; x < 8; x++)
-        {
-            for (int y = 0; y < 8; y++)
-            {
-                Macroblock_YCbCr[x][y].Y = static_cast<f32>(Y1_block[To1d(x, y)]);
-                Macroblock_YCbCr[x + 8][y].Y = static_cast<f32>(Y2_block[To1d(x, y)]);
-                Macroblock_YCbCr[x][y + 8].Y = static_cast<f32>(Y3_block[To1d(x, y)]);
-                Macroblock_YCbCr[x + 8][y + 8].Y = static_cast<f32>(Y4_block[To1d(x, y)]);
-
-                Macroblock_YCbCr[x * 2][y * 2].Cb = static_cast<f32>(Cb_block[To1d(x, y)]);
-                Macroblock_YCbCr[x * 2 + 1][y * 2].Cb = static_cast<f32>(Cb_block[To1d(x, y)]);
-                Macroblock_YCbCr[x * 2][y * 2 + 1].Cb = static_cast<f32>(Cb_block[To1d(x, y)]);
-                Macroblock_YCbCr[x * 2 + 1][y * 2 + 1].Cb = static_cast<f32>(Cb_block[To1d(x, y)]);
-
-                Macroblock_YCbCr[x * 2][y * 2].Cr = static_cast<f32>(Cr_block[To1d(x, y)]);
-                Macroblock_YCbCr[x * 2 + 1][y * 2].Cr = static_cast<f32>(Cr_block[To1d(x, y)]);
-                Macroblock_YCbCr[x * 2][y * 2 + 1].Cr = static_cast<f32>(Cr_block[To1d(x, y)]);
-                Macroblock_YCbCr[x * 2 + 1][y * 2 + 1].Cr = static_cast<f32>(Cr_block[To1d(x, y)]);
-            }
-        }
-
-        // Convert the (Y, Cb, Cr) pixels into RGB pixels
-        struct Macroblock_RGB_Struct
-        {
-            unsigned char Red;
-            unsigned char Green;
-            unsigned char Blue;
-            unsigned char A;
-        };
-
-        std::array< std::array<Macroblock_RGB_Struct, 16>, 16> Macroblock_RGB = {};
-
-        for (u32 x = 0; x < kMacroBlockWidth; x++)
-        {
-            for (u32 y = 0; y < kMacroBlockHeight; y++)
-            {
-                const f32 r = (Macroblock_YCbCr[x][y].Y) + 1.402f *  Macroblock_YCbCr[x][y].Cb;
-                const f32 g = (Macroblock_YCbCr[x][y].Y) - 0.3437f * Macroblock_YCbCr[x][y].Cr - 0.7143f * Macroblock_YCbCr[x][y].Cb;
-                const f32 b = (Macroblock_YCbCr[x][y].Y) + 1.772f *  Macroblock_YCbCr[x][y].Cr;
-
-                Macroblock_RGB[x][y].Red = Clamp(r);
-                Macroblock_RGB[x][y].Green = Clamp(g);
-                Macroblock_RGB[x][y].Blue = Clamp(b);
-
-                // Due to macro block padding this can be out of bounds
-                int xpos = x + xoff;
-                int ypos = y + yoff;
-                if (xpos < width && ypos < height)
-                {
-                    u32 pixelValue = 0;
-                    pixelValue = (pixelValue << 8) + Macroblock_RGB[x][y].Blue;
-                    pixelValue = (pixelValue << 8) + Macroblock_RGB[x][y].Green;
-                    pixelValue = (pixelValue << 8) + Macroblock_RGB[x][y].Red;
-
-                    // Actually is no alpha in FMVs
-                    // pixelValue = (pixelValue << 8) + Macroblock_RGB[x][y].A
-                    SetElement(xpos, ypos, width, pixelBuffer, pixelValue);
-                }
-            }
-        }
-    }
+    // Each block is 64 coefficients stored every 32 bits, with room to spare
+    constexpr u32 kBlockStride = 256;
+    constexpr u32 kMacroBlockStride = kBlockStride * kNumberOfBlocks;
 
     static void after_block_decode_no_effect_q_impl(int quantScale)
     {
@@ -714,49 +565,54 @@ namespace Oddlib
 
         after_block_decode_no_effect_q_impl(quantScale);
 
-
+        // Blocks are variable length so dequantising has to be done in order. The blocks of every
+        // macroblock are kept as non key frames add to the previous frames coefficients.
         int16_t* bitstreamCurPos = (int16_t*)mDecodedVideoFrameData.data();
-        int16_t* block1Output = (int16_t*)mMacroBlockBuffer.data();
-
-        int xoff = 0;
-        for (unsigned int xBlock = 0; xBlock < mNumMacroblocksX; xBlock++)
+        int16_t* blockOutput = (int16_t*)mMacroBlockBuffer.data();
+        const u32 numMacroblocks = mNumMacroblocksX * mNumMacroblocksY;
+        for (u32 i = 0; i < numMacroblocks; i++)
         {
-            int yoff = 0;
-            for (unsigned int yBlock = 0; yBlock < mNumMacroblocksY; yBlock++)
+            // Cr, Cb then the 4 luma blocks
+            for (u32 block = 0; block < kNumberOfBlocks; block++)
             {
-                const int dataSizeBytes = 64 * 4;// thisPtr->mBlockDataSize_q * 4; // Convert to byte count 64*4=256
-
-                int16_t* afterBlock1Ptr = ddv_func7_DecodeMacroBlock_impl(bitstreamCurPos, block1Output, 0);
-                idct(block1Output, Cr_block);
-                int16_t* block2Output = dataSizeBytes + block1Output;
-
-                int16_t* afterBlock2Ptr = ddv_func7_DecodeMacroBlock_impl(afterBlock1Ptr, block2Output, 0);
-                idct(block2Output, Cb_block);
-                int16_t* block3Output = dataSizeBytes + block2Output;
-
-                int16_t* afterBlock3Ptr = ddv_func7_DecodeMacroBlock_impl(afterBlock2Ptr, block3Output, 1);
-                idct(block3Output, Y1_block);
-                int16_t* block4Output = dataSizeBytes + block3Output;
-
-                int16_t* afterBlock4Ptr = ddv_func7_DecodeMacroBlock_impl(afterBlock3Ptr, block4Output, 1);
-                idct(block4Output, Y2_block);
-                int16_t* block5Output = dataSizeBytes + block4Output;
-
-                int16_t* afterBlock5Ptr = ddv_func7_DecodeMacroBlock_impl(afterBlock4Ptr, block5Output, 1);
-                idct(block5Output, Y3_block);
-                int16_t* block6Output = dataSizeBytes + block5Output;
+                bitstreamCurPos = ddv_func7_DecodeMacroBlock_impl(bitstreamCurPos, blockOutput, block >= 2);
+                blockOutput += kBlockStride;
+            }
+        }
 
-                bitstreamCurPos = ddv_func7_DecodeMacroBlock_impl(afterBlock5Ptr, block6Output, 1);
-                idct(block6Output, Y4_block);
-                block1Output = dataSizeBytes + block6Output;
+        // After that each macroblock can be converted on its own
+        if (mParallelFor)
+        {
+            // Macroblocks are stored a column at a time
+            mParallelFor(mNumMacroblocksX, [this, pixelBuffer](u32 column)
+            {
+                ConvertMacroblocks(column * mNumMacroblocksY, (column + 1) * mNumMacroblocksY, pixelBuffer);
+            });
+        }
+        else
+        {
+            ConvertMacroblocks(0, numMacroblocks, pixelBuffer);
+        }
+    }
 
-                ConvertYuvToRgbAndBlit(pixelBuffer, xoff, yoff, mVideoHeader.mWidth, mVideoHeader.mHeight);
+    void Masher::ConvertMacroblocks(u32 begin, u32 end, u32* pixelBuffer) const
+    {
+        std::array<std::array<s32, 64>, kNumberOfBlocks> blocks;
+        const s32* const luma[4] = { blocks[2].data(), blocks[3].data(), blocks[4].data(), blocks[5].data() };
 
-                yoff += kMacroBlockHeight;
+        for (u32 i = begin; i < end; i++)
+        {
+            const int16_t* macroBlock = reinterpret_cast<const int16_t*>(mMacroBlockBuffer.data()) + (i * kMacroBlockStride);
+            for (u32 block = 0; block < kNumberOfBlocks; block++)
+            {
+                Mdec::MasherIdct(macroBlock + (block * kBlockStride), blocks[block].data());
             }
-            xoff += kMacroBlockWidth;
-        }
 
+            // Macroblocks are stored a column at a time
+            const s32 xoff = static_cast<s32>((i / mNumMacroblocksY) * kMacroBlockWidth);
+            const s32 yoff = static_cast<s32>((i % mNumMacroblocksY) * kMacroBlockHeight);
+            Mdec::MasherBlitMacroblock(blocks[0].data(), blocks[1].data(), luma, pixelBuffer, xoff, yoff, mVideoHeader.mWidth, mVideoHeader.mHeight);
+        }
     }
 
     AudioDecompressor::AudioDecompressor()
@@ -0,0 +1,260 @@
+#include "oddlib/mdec_simd.hpp"
+#include "oddlib/simd.hpp"
+#include <array>
+#include <cstddef>
+
+namespace Oddlib
+{
+    namespace Mdec
+    {
+        namespace Scalar
+        {
+            typedef std::array<s32, 64> T64Ints;
+
+            static void MasherHalfIdct(const T64Ints& pSource, T64Ints& pDestination, int nPitch, int nIncrement, int nShift)
+            {
+                std::array<s32, 8> pTemp;
+
+                size_t sourceIdx = 0;
+                size_t destinationIdx = 0;
+
+                for (int i = 0; i < 8; i++)
+                {
+                    pTemp[4] = pSource[(0 * nPitch) + sourceIdx] * 8192 + pSource[(2 * nPitch) + sourceIdx] * 10703 + pSource[(4 * nPitch) + sourceIdx] * 8192 + pSource[(6 * nPitch) + sourceIdx] * 4433;
+                    pTemp[5] = pSource[(0 * nPitch) + sourceIdx] * 8192 + pSource[(2 * nPitch) + sourceIdx] * 4433 - pSource[(4 * nPitch) + sourceIdx] * 8192 - pSource[(6 * nPitch) + sourceIdx] * 10704;
+                    pTemp[6] = pSource[(0 * nPitch) + sourceIdx] * 8192 - pSource[(2 * nPitch) + sourceIdx] * 4433 - pSource[(4 * nPitch) + sourceIdx] * 8192 + pSource[(6 * nPitch) + sourceIdx] * 10704;
+                    pTemp[7] = pSource[(0 * nPitch) + sourceIdx] * 8192 - pSource[(2 * nPitch) + sourceIdx] * 10703 + pSource[(4 * nPitch) + sourceIdx] * 8192 - pSource[(6 * nPitch) + sourceIdx] * 4433;
+
+                    pTemp[0] = pSource[(1 * nPitch) + sourceIdx] * 11363 + pSource[(3 * nPitch) + sourceIdx] * 9633 + pSource[(5 * nPitch) + sourceIdx] * 6437 + pSource[(7 * nPitch) + sourceIdx] * 2260;
+                    pTemp[1] = pSource[(1 * nPitch) + sourceIdx] * 9633 - pSource[(3 * nPitch) + sourceIdx] * 2259 - pSource[(5 * nPitch) + sourceIdx] * 11362 - pSource[(7 * nPitch) + sourceIdx] * 6436;
+                    pTemp[2] = pSource[(1 * nPitch) + sourceIdx] * 6437 - pSource[(3 * nPitch) + sourceIdx] * 11362 + pSource[(5 * nPitch) + sourceIdx] * 2261 + pSource[(7 * nPitch) + sourceIdx] * 9633;
+                    pTemp[3] = pSource[(1 * nPitch) + sourceIdx] * 2260 - pSource[(3 * nPitch) + sourceIdx] * 6436 + pSource[(5 * nPitch) + sourceIdx] * 9633 - pSource[(7 * nPitch) + sourceIdx] * 11363;
+
+                    pDestination[(0 * nPitch) + destinationIdx] = (pTemp[4] + pTemp[0]) >> nShift;
+                    pDestination[(1 * nPitch) + destinationIdx] = (pTemp[5] + pTemp[1]) >> nShift;
+                    pDestination[(2 * nPitch) + destinationIdx] = (pTemp[6] + pTemp[2]) >> nShift;
+                    pDestination[(3 * nPitch) + destinationIdx] = (pTemp[7] + pTemp[3]) >> nShift;
+                    pDestination[(4 * nPitch) + destinationIdx] = (pTemp[7] - pTemp[3]) >> nShift;
+                    pDestination[(5 * nPitch) + destinationIdx] = (pTemp[6] - pTemp[2]) >> nShift;
+                    pDestination[(6 * nPitch) + destinationIdx] = (pTemp[5] - pTemp[1]) >> nShift;
+                    pDestination[(7 * nPitch) + destinationIdx] = (pTemp[4] - pTemp[0]) >> nShift;
+
+                    sourceIdx += nIncrement;
+                    destinationIdx += nIncrement;
+                }
+            }
+
+            // 0x40ED90
+            void MasherIdct(const s16* input, s32* output)
+            {
+                T64Ints pExtendedSource;
+                T64Ints pTemp;
+                T64Ints pDestination;
+
+                // Source is passed as signed 16 bits stored every 32 bits
+                // We sign extend it at the beginning like Masher does
+                for (int i = 0; i < 64; i++)
+                {
+                    pExtendedSource[i] = input[i * 2];
+                }
+
+                MasherHalfIdct(pExtendedSource, pTemp, 8, 1, 11);
+                MasherHalfIdct(pTemp, pDestination, 1, 8, 18);
+
+                for (int i = 0; i < 64; i++)
+                {
+                    output[i] = pDestination[i];
+                }
+            }
+
+            static u8 Clamp(f32 v)
+            {
+                if (v < 0.0f) v = 0.0f;
+                if (v > 255.0f) v = 255.0f;
+                return static_cast<u8>(v);
+            }
+
+            void MasherBlitMacroblock(const s32* cr, const s32* cb, const s32* const luma[4],
+                u32* pixelBuffer, s32 xoff, s32 yoff, s32 width, s32 height)
+            {
+                for (s32 y = 0; y < 16; y++)
+                {
+                    const s32 ypos = y + yoff;
+                    if (ypos >= height)
+                    {
+                        // Due to macro block padding this can be out of bounds
+                        break;
+                    }
+
+                    for (s32 x = 0; x < 16; x++)
+                    {
+                        const s32 xpos = x + xoff;
+                        if (xpos >= width)
+                        {
+                            break;
+                        }
+
+                        const s32* yBlock = luma[(y / 8) * 2 + (x / 8)];
+                        const f32 Y = static_cast<f32>(yBlock[(y % 8) * 8 + (x % 8)]);
+                        const f32 Cb = static_cast<f32>(cb[(y / 2) * 8 + (x / 2)]);
+                        const f32 Cr = static_cast<f32>(cr[(y / 2) * 8 + (x / 2)]);
+
+                        const f32 r = Y + 1.402f * Cb;
+                        const f32 g = Y - 0.3437f * Cr - 0.7143f * Cb;
+                        const f32 b = Y + 1.772f * Cr;
+
+                        // Actually is no alpha in FMVs
+                        pixelBuffer[(width * ypos) + xpos] = (static_cast<u32>(Clamp(b)) << 16) | (static_cast<u32>(Clamp(g)) << 8) | Clamp(r);
+                    }
+                }
+            }
+
+            static const s32 kPsxConstBits = 8;
+            static const s32 kPsxPass1Bits = 2;
+            static const s32 kPsxFix_1_082392200 = 277;
+            static const s32 kPsxFix_1_414213562 = 362;
+            static const s32 kPsxFix_1_847759065 = 473;
+            static const s32 kPsxFix_2_613125930 = 669;
+
+            void PsxIdct(s16* block)
+            {
+                s16 *ptr = block;
+                s16 tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+                s16 z5, z10, z11, z12, z13;
+                for (s32 i = 0; i < 8; i++, ptr++)
+                {
+                    if ((ptr[8 * 1] | ptr[8 * 2] | ptr[8 * 3] | ptr[8 * 4] | ptr[8 * 5] | ptr[8 * 6] | ptr[8 * 7]) == 0)
+                    {
+                        ptr[8 * 1] = ptr[8 * 2] = ptr[8 * 3] = ptr[8 * 4] = ptr[8 * 5] = ptr[8 * 6] = ptr[8 * 7] = ptr[8 * 0];
+                        continue;
+                    }
+
+                    z10 = ptr[8 * 0] + ptr[8 * 4];
+                    z11 = ptr[8 * 0] - ptr[8 * 4];
+                    z13 = ptr[8 * 2] + ptr[8 * 6];
+                    z12 = (((ptr[8 * 2] - ptr[8 * 6]) * kPsxFix_1_414213562) >> kPsxConstBits) - z13;
+
+                    tmp0 = z10 + z13;
+                    tmp3 = z10 - z13;
+                    tmp1 = z11 + z12;
+                    tmp2 = z11 - z12;
+
+                    z13 = ptr[8 * 3] + ptr[8 * 5];
+                    z10 = ptr[8 * 3] - ptr[8 * 5];
+                    z11 = ptr[8 * 1] + ptr[8 * 7];
+                    z12 = ptr[8 * 1] - ptr[8 * 7];
+
+                    z5 = (((z12 - z10) * kPsxFix_1_847759065) >> kPsxConstBits);
+                    tmp7 = z11 + z13;
+                    tmp6 = ((z10 * kPsxFix_2_613125930) >> kPsxConstBits) + z5 - tmp7;
+                    tmp5 = (((z11 - z13) * kPsxFix_1_414213562) >> kPsxConstBits) - tmp6;
+                    tmp4 = ((z12 * kPsxFix_1_082392200) >> kPsxConstBits) - z5 + tmp5;
+
+                    ptr[8 * 0] = (tmp0 + tmp7);
+                    ptr[8 * 7] = (tmp0 - tmp7);
+                    ptr[8 * 1] = (tmp1 + tmp6);
+                    ptr[8 * 6] = (tmp1 - tmp6);
+                    ptr[8 * 2] = (tmp2 + tmp5);
+                    ptr[8 * 5] = (tmp2 - tmp5);
+                    ptr[8 * 4] = (tmp3 + tmp4);
+                    ptr[8 * 3] = (tmp3 - tmp4);
+                }
+
+                ptr = block;
+                for (s32 i = 0; i < 8; i++, ptr += 8)
+                {
+                    if ((ptr[1] | ptr[2] | ptr[3] | ptr[4] | ptr[5] | ptr[6] | ptr[7]) == 0)
+                    {
+                        ptr[0] = ptr[1] = ptr[2] = ptr[3] = ptr[4] = ptr[5] = ptr[6] = ptr[7] = (ptr[0] >> (kPsxPass1Bits + 3));
+                        continue;
+                    }
+
+                    z10 = ptr[0] + ptr[4];
+                    z11 = ptr[0] - ptr[4];
+                    z13 = ptr[2] + ptr[6];
+                    z12 = (((ptr[2] - ptr[6]) * kPsxFix_1_414213562) >> kPsxConstBits) - z13;
+
+                    tmp0 = z10 + z13;
+                    tmp3 = z10 - z13;
+                    tmp1 = z11 + z12;
+                    tmp2 = z11 - z12;
+
+                    z13 = ptr[3] + ptr[5];
+                    z10 = ptr[3] - ptr[5];
+                    z11 = ptr[1] + ptr[7];
+                    z12 = ptr[1] - ptr[7];
+
+                    z5 = (((z12 - z10) * kPsxFix_1_847759065) >> kPsxConstBits);
+                    tmp7 = z11 + z13;
+                    tmp6 = ((z10 * kPsxFix_2_613125930) >> kPsxConstBits) + z5 - tmp7;
+                    tmp5 = (((z11 - z13) * kPsxFix_1_414213562) >> kPsxConstBits) - tmp6;
+                    tmp4 = ((z12 * kPsxFix_1_082392200) >> kPsxConstBits) - z5 + tmp5;
+
+                    ptr[0] = (tmp0 + tmp7) >> (kPsxPass1Bits + 3);
+                    ptr[7] = (tmp0 - tmp7) >> (kPsxPass1Bits + 3);
+                    ptr[1] = (tmp1 + tmp6) >> (kPsxPass1Bits + 3);
+                    ptr[6] = (tmp1 - tmp6) >> (kPsxPass1Bits + 3);
+                    ptr[2] = (tmp2 + tmp5) >> (kPsxPass1Bits + 3);
+                    ptr[5] = (tmp2 - tmp5) >> (kPsxPass1Bits + 3);
+                    ptr[4] = (tmp3 + tmp4) >> (kPsxPass1Bits + 3);
+                    ptr[3] = (tmp3 - tmp4) >> (kPsxPass1Bits + 3);
+                }
+            }
+        }
+
+        void MasherIdct(const s16* input, s32* output)
+        {
+#ifdef ODDLIB_X86_SIMD
+            switch (ActiveSimdLevel())
+            {
+            case SimdLevel::eAvx2:
+                Avx2::MasherIdct(input, output);
+                return;
+            case SimdLevel::eSse41:
+                Sse41::MasherIdct(input, output);
+                return;
+            case SimdLevel::eScalar:
+                break;
+            }
+#endif
+            Scalar::MasherIdct(input, output);
+        }
+
+        void MasherBlitMacroblock(const s32* cr, const s32* cb, const s32* const luma[4],
+            u32* pixelBuffer, s32 xoff, s32 yoff, s32 width, s32 height)
+        {
+#ifdef ODDLIB_X86_SIMD
+            switch (ActiveSimdLevel())
+            {
+            case SimdLevel::eAvx2:
+                Avx2::MasherBlitMacroblock(cr, cb, luma, pixelBuffer, xoff, yoff, width, height);
+                return;
+            case SimdLevel::eSse41:
+                Sse41::MasherBlitMacroblock(cr, cb, luma, pixelBuffer, xoff, yoff, width, height);
+                return;
+            case SimdLevel::eScalar:
+                break;
+            }
+#endif
+            Scalar::MasherBlitMacroblock(cr, cb, luma, pixelBuffer, xoff, yoff, width, height);
+        }
+
+        void PsxIdct(s16* block)
+        {
+#ifdef ODDLIB_X86_SIMD
+            switch (ActiveSimdLevel())
+            {
+            case SimdLevel::eAvx2:
+                Avx2::PsxIdct(block);
+                return;
+            case SimdLevel::eSse41:
+                Sse41::PsxIdct(block);
+                return;
+            case SimdLevel::eScalar:
+                break;
+            }
+#endif
+            Scalar::PsxIdct(block);
+        }
+    }
+}
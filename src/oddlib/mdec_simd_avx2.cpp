@@ -0,0 +1,104 @@
+#include "oddlib/mdec_simd.hpp"
+#include "oddlib/simd.hpp"
+
+#ifdef ODDLIB_X86_SIMD
+
+// Built with AVX2 enabled (but not FMA, that would change the float rounding), only called when the CPU has it
+#include "oddlib/mdec_simd_kernels.hpp"
+#include <immintrin.h>
+
+namespace Oddlib
+{
+    namespace Mdec
+    {
+        namespace Avx2
+        {
+            struct Ops
+            {
+                typedef __m256i Reg;
+                typedef __m256 FReg;
+                static const int kLanes = 8;
+                static const int kRegsPerRow = 1;
+
+                static Reg Set1(s32 v) { return _mm256_set1_epi32(v); }
+                static Reg Add(Reg a, Reg b) { return _mm256_add_epi32(a, b); }
+                static Reg Sub(Reg a, Reg b) { return _mm256_sub_epi32(a, b); }
+                static Reg Mul(Reg a, Reg b) { return _mm256_mullo_epi32(a, b); }
+                static Reg Sra(Reg a, s32 bits) { return _mm256_sra_epi32(a, _mm_cvtsi32_si128(bits)); }
+                static Reg Sll(Reg a, s32 bits) { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(bits)); }
+                static Reg Or(Reg a, Reg b) { return _mm256_or_si256(a, b); }
+                static Reg Trunc16(Reg a) { return _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16); }
+
+                static Reg LoadS32(const s32* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+                static void StoreS32(s32* p, Reg a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), a); }
+                static Reg LoadS16(const s16* p) { return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); }
+                static void StoreS16(s16* p, Reg a)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1)));
+                }
+                static Reg LoadS32Dup(const s32* p)
+                {
+                    const __m256i v = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+                    return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3));
+                }
+
+                static FReg FSet1(f32 v) { return _mm256_set1_ps(v); }
+                static FReg ToFloat(Reg a) { return _mm256_cvtepi32_ps(a); }
+                static FReg FAdd(FReg a, FReg b) { return _mm256_add_ps(a, b); }
+                static FReg FSub(FReg a, FReg b) { return _mm256_sub_ps(a, b); }
+                static FReg FMul(FReg a, FReg b) { return _mm256_mul_ps(a, b); }
+                static FReg FMax(FReg a, FReg b) { return _mm256_max_ps(a, b); }
+                static FReg FMin(FReg a, FReg b) { return _mm256_min_ps(a, b); }
+                static Reg ToIntTruncate(FReg a) { return _mm256_cvttps_epi32(a); }
+
+                static void Transpose8x8(Reg* m)
+                {
+                    const __m256i t0 = _mm256_unpacklo_epi32(m[0], m[1]);
+                    const __m256i t1 = _mm256_unpackhi_epi32(m[0], m[1]);
+                    const __m256i t2 = _mm256_unpacklo_epi32(m[2], m[3]);
+                    const __m256i t3 = _mm256_unpackhi_epi32(m[2], m[3]);
+                    const __m256i t4 = _mm256_unpacklo_epi32(m[4], m[5]);
+                    const __m256i t5 = _mm256_unpackhi_epi32(m[4], m[5]);
+                    const __m256i t6 = _mm256_unpacklo_epi32(m[6], m[7]);
+                    const __m256i t7 = _mm256_unpackhi_epi32(m[6], m[7]);
+
+                    const __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+                    const __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+                    const __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+                    const __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+                    const __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+                    const __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+                    const __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+                    const __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+                    m[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+                    m[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+                    m[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+                    m[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+                    m[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+                    m[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+                    m[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+                    m[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+                }
+            };
+
+            void MasherIdct(const s16* input, s32* output)
+            {
+                Kernels::MasherIdct<Ops>(input, output);
+            }
+
+            void MasherBlitMacroblock(const s32* cr, const s32* cb, const s32* const luma[4],
+                u32* pixelBuffer, s32 xoff, s32 yoff, s32 width, s32 height)
+            {
+                Kernels::MasherBlitMacroblock<Ops>(cr, cb, luma, pixelBuffer, xoff, yoff, width, height);
+            }
+
+            void PsxIdct(s16* block)
+            {
+                Kernels::PsxIdct<Ops>(block);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,98 @@
+#include "oddlib/mdec_simd.hpp"
+#include "oddlib/simd.hpp"
+
+#ifdef ODDLIB_X86_SIMD
+
+// Built with SSE4.1 enabled, only called when the CPU has it
+#include "oddlib/mdec_simd_kernels.hpp"
+#include <smmintrin.h>
+
+namespace Oddlib
+{
+    namespace Mdec
+    {
+        namespace Sse41
+        {
+            struct Ops
+            {
+                typedef __m128i Reg;
+                typedef __m128 FReg;
+                static const int kLanes = 4;
+                static const int kRegsPerRow = 2;
+
+                static Reg Set1(s32 v) { return _mm_set1_epi32(v); }
+                static Reg Add(Reg a, Reg b) { return _mm_add_epi32(a, b); }
+                static Reg Sub(Reg a, Reg b) { return _mm_sub_epi32(a, b); }
+                static Reg Mul(Reg a, Reg b) { return _mm_mullo_epi32(a, b); }
+                static Reg Sra(Reg a, s32 bits) { return _mm_sra_epi32(a, _mm_cvtsi32_si128(bits)); }
+                static Reg Sll(Reg a, s32 bits) { return _mm_sll_epi32(a, _mm_cvtsi32_si128(bits)); }
+                static Reg Or(Reg a, Reg b) { return _mm_or_si128(a, b); }
+                static Reg Trunc16(Reg a) { return _mm_srai_epi32(_mm_slli_epi32(a, 16), 16); }
+
+                static Reg LoadS32(const s32* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+                static void StoreS32(s32* p, Reg a) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), a); }
+                static Reg LoadS16(const s16* p) { return _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))); }
+                static void StoreS16(s16* p, Reg a) { _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(a, a)); }
+                static Reg LoadS32Dup(const s32* p)
+                {
+                    const __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+                    return _mm_unpacklo_epi32(v, v);
+                }
+
+                static FReg FSet1(f32 v) { return _mm_set1_ps(v); }
+                static FReg ToFloat(Reg a) { return _mm_cvtepi32_ps(a); }
+                static FReg FAdd(FReg a, FReg b) { return _mm_add_ps(a, b); }
+                static FReg FSub(FReg a, FReg b) { return _mm_sub_ps(a, b); }
+                static FReg FMul(FReg a, FReg b) { return _mm_mul_ps(a, b); }
+                static FReg FMax(FReg a, FReg b) { return _mm_max_ps(a, b); }
+                static FReg FMin(FReg a, FReg b) { return _mm_min_ps(a, b); }
+                static Reg ToIntTruncate(FReg a) { return _mm_cvttps_epi32(a); }
+
+                static void Transpose4x4(Reg& r0, Reg& r1, Reg& r2, Reg& r3)
+                {
+                    const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+                    const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+                    const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+                    const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+                    r0 = _mm_unpacklo_epi64(t0, t1);
+                    r1 = _mm_unpackhi_epi64(t0, t1);
+                    r2 = _mm_unpacklo_epi64(t2, t3);
+                    r3 = _mm_unpackhi_epi64(t2, t3);
+                }
+
+                static void Transpose8x8(Reg* m)
+                {
+                    // Transpose each 4x4 quarter then swap the top right and bottom left quarters
+                    Transpose4x4(m[0], m[2], m[4], m[6]);
+                    Transpose4x4(m[1], m[3], m[5], m[7]);
+                    Transpose4x4(m[8], m[10], m[12], m[14]);
+                    Transpose4x4(m[9], m[11], m[13], m[15]);
+                    for (int r = 0; r < 4; r++)
+                    {
+                        const Reg topRight = m[r * 2 + 1];
+                        m[r * 2 + 1] = m[(r + 4) * 2];
+                        m[(r + 4) * 2] = topRight;
+                    }
+                }
+            };
+
+            void MasherIdct(const s16* input, s32* output)
+            {
+                Kernels::MasherIdct<Ops>(input, output);
+            }
+
+            void MasherBlitMacroblock(const s32* cr, const s32* cb, const s32* const luma[4],
+                u32* pixelBuffer, s32 xoff, s32 yoff, s32 width, s32 height)
+            {
+                Kernels::MasherBlitMacroblock<Ops>(cr, cb, luma, pixelBuffer, xoff, yoff, width, height);
+            }
+
+            void PsxIdct(s16* block)
+            {
+                Kernels::PsxIdct<Ops>(block);
+            }
+        }
+    }
+}
+
+#endif
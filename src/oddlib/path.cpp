@@ -73,6 +73,16 @@ namespace Oddlib
         return mYSize;
     }
 
+    size_t Path::SizeInBytes() const
+    {
+        size_t size = sizeof(Path) + (mCollisionItems.size() * sizeof(CollisionItem));
+        for (const Camera& camera : mCameras)
+        {
+            size += sizeof(Camera) + camera.mName.capacity() + (camera.mObjects.size() * sizeof(MapObject));
+        }
+        return size;
+    }
+
     const Path::Camera& Path::CameraByPosition(u32 x, u32 y) const
     {
         if (x >= XSize() || y >= YSize())
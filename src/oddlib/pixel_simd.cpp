@@ -0,0 +1,136 @@
+#include "oddlib/pixel_simd.hpp"
+#include "oddlib/simd.hpp"
+
+namespace Oddlib
+{
+    namespace Pixels
+    {
+        namespace Scalar
+        {
+            void Rgb565ToRgb24(const u16* src, u8* dst, u32 count)
+            {
+                for (u32 i = 0; i < count; i++)
+                {
+                    const u32 c = src[i];
+                    *dst++ = static_cast<u8>((((c >> 11) & 0x1F) * 255) / 31);
+                    *dst++ = static_cast<u8>((((c >> 5) & 0x3F) * 255) / 63);
+                    *dst++ = static_cast<u8>(((c & 0x1F) * 255) / 31);
+                }
+            }
+
+            void Bgr555ToRgba(const u16* src, u32* dst, u32 count)
+            {
+                for (u32 i = 0; i < count; i++)
+                {
+                    const u32 c = src[i];
+                    const u32 red = (((c >> 0) & 0x1F) * 255) / 31;
+                    const u32 green = (((c >> 5) & 0x1F) * 255) / 31;
+                    const u32 blue = (((c >> 10) & 0x1F) * 255) / 31;
+
+                    u32 pixel = (red << 24) | (green << 16) | (blue << 8);
+                    if (c & 0x8000)
+                    {
+                        // Semi transparent
+                        pixel |= (255 / 2);
+                    }
+                    else if (pixel != 0)
+                    {
+                        // Black is fully transparent, anything else opaque
+                        pixel |= 255;
+                    }
+                    dst[i] = pixel;
+                }
+            }
+
+            void ExpandPalette4(const u8* src, u32* dst, u32 count, const u32* palette)
+            {
+                for (u32 i = 0; i < count / 2; i++)
+                {
+                    *dst++ = palette[src[i] & 0x0F];
+                    *dst++ = palette[(src[i] >> 4) & 0x0F];
+                }
+
+                if (count & 1)
+                {
+                    *dst = palette[src[count / 2] & 0x0F];
+                }
+            }
+        }
+
+        void Rgb565ToRgb24(const u16* src, u8* dst, u32 count)
+        {
+#ifdef ODDLIB_X86_SIMD
+            switch (ActiveSimdLevel())
+            {
+            case SimdLevel::eAvx2:
+                Avx2::Rgb565ToRgb24(src, dst, count);
+                return;
+            case SimdLevel::eSse41:
+                Sse41::Rgb565ToRgb24(src, dst, count);
+                return;
+            case SimdLevel::eScalar:
+                break;
+            }
+#endif
+            Scalar::Rgb565ToRgb24(src, dst, count);
+        }
+
+        void Bgr555ToRgba(const u16* src, u32* dst, u32 count)
+        {
+#ifdef ODDLIB_X86_SIMD
+            switch (ActiveSimdLevel())
+            {
+            case SimdLevel::eAvx2:
+                Avx2::Bgr555ToRgba(src, dst, count);
+                return;
+            case SimdLevel::eSse41:
+                Sse41::Bgr555ToRgba(src, dst, count);
+                return;
+            case SimdLevel::eScalar:
+                break;
+            }
+#endif
+            Scalar::Bgr555ToRgba(src, dst, count);
+        }
+
+        void ExpandPalette8(const u8* src, u32* dst, u32 count, const u32* palette)
+        {
+            // Unrolled so the loads of the next few indices don't wait on the previous store
+            u32 i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                const u32 a = palette[src[i + 0]];
+                const u32 b = palette[src[i + 1]];
+                const u32 c = palette[src[i + 2]];
+                const u32 d = palette[src[i + 3]];
+                dst[i + 0] = a;
+                dst[i + 1] = b;
+                dst[i + 2] = c;
+                dst[i + 3] = d;
+            }
+
+            for (; i < count; i++)
+            {
+                dst[i] = palette[src[i]];
+            }
+        }
+
+        void ExpandPalette4(const u8* src, u32* dst, u32 count, const u32* palette)
+        {
+#ifdef ODDLIB_X86_SIMD
+            switch (ActiveSimdLevel())
+            {
+            case SimdLevel::eAvx2:
+                Avx2::ExpandPalette4(src, dst, count, palette);
+                return;
+            case SimdLevel::eSse41:
+                Sse41::ExpandPalette4(src, dst, count, palette);
+                return;
+            case SimdLevel::eScalar:
+                break;
+            }
+#endif
+            Scalar::ExpandPalette4(src, dst, count, palette);
+        }
+    }
+}
@@ -0,0 +1,175 @@
+#include "oddlib/pixel_simd.hpp"
+#include "oddlib/simd.hpp"
+
+#ifdef ODDLIB_X86_SIMD
+
+// Built with AVX2 enabled, only called when the CPU has it. Same approach as the SSE4.1 versions
+// with twice the pixels per step, pshufb and the unpacks work within each 128bit lane so the
+// results are put back in order with permutes.
+#include <immintrin.h>
+
+namespace Oddlib
+{
+    namespace Pixels
+    {
+        namespace Avx2
+        {
+            // (c*255)/31 for c in 0-31
+            static __m256i Expand5(__m256i c)
+            {
+                return _mm256_srli_epi16(_mm256_mullo_epi16(c, _mm256_set1_epi16(1053)), 7);
+            }
+
+            // (c*255)/63 for c in 0-63
+            static __m256i Expand6(__m256i c)
+            {
+                return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(c, _mm256_set1_epi16(259)), _mm256_set1_epi16(3)), 6);
+            }
+
+            // 16 words to 16 bytes in order
+            static __m128i Pack(__m256i a)
+            {
+                return _mm_packus_epi16(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+            }
+
+            // Picks channel's bytes out of 16 packed R, G or B values for the block'th 16 bytes of 16 RGB24 pixels
+            static __m128i Rgb24Shuffle(int block, int channel)
+            {
+                alignas(16) s8 mask[16];
+                for (int i = 0; i < 16; i++)
+                {
+                    const int pos = (block * 16) + i;
+                    mask[i] = (pos % 3 == channel) ? static_cast<s8>(pos / 3) : static_cast<s8>(0x80);
+                }
+                return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+            }
+
+            void Rgb565ToRgb24(const u16* src, u8* dst, u32 count)
+            {
+                __m128i shuffles[3][3];
+                for (int block = 0; block < 3; block++)
+                {
+                    for (int channel = 0; channel < 3; channel++)
+                    {
+                        shuffles[block][channel] = Rgb24Shuffle(block, channel);
+                    }
+                }
+
+                const __m256i mask5 = _mm256_set1_epi16(0x1F);
+                const __m256i mask6 = _mm256_set1_epi16(0x3F);
+                u32 i = 0;
+                for (; i + 16 <= count; i += 16)
+                {
+                    const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                    const __m128i r = Pack(Expand5(_mm256_srli_epi16(c, 11)));
+                    const __m128i g = Pack(Expand6(_mm256_and_si256(_mm256_srli_epi16(c, 5), mask6)));
+                    const __m128i b = Pack(Expand5(_mm256_and_si256(c, mask5)));
+
+                    __m128i* out = reinterpret_cast<__m128i*>(dst + (i * 3));
+                    for (int block = 0; block < 3; block++)
+                    {
+                        const __m128i rgb = _mm_or_si128(_mm_or_si128(
+                            _mm_shuffle_epi8(r, shuffles[block][0]),
+                            _mm_shuffle_epi8(g, shuffles[block][1])),
+                            _mm_shuffle_epi8(b, shuffles[block][2]));
+                        _mm_storeu_si128(out + block, rgb);
+                    }
+                }
+
+                Scalar::Rgb565ToRgb24(src + i, dst + (i * 3), count - i);
+            }
+
+            void Bgr555ToRgba(const u16* src, u32* dst, u32 count)
+            {
+                const __m256i mask5 = _mm256_set1_epi16(0x1F);
+                const __m256i colourMask = _mm256_set1_epi16(0x7FFF);
+                const __m256i opaque = _mm256_set1_epi16(255);
+                const __m256i semiTrans = _mm256_set1_epi16(255 / 2);
+                u32 i = 0;
+                for (; i + 16 <= count; i += 16)
+                {
+                    const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                    const __m256i r = Expand5(_mm256_and_si256(c, mask5));
+                    const __m256i g = Expand5(_mm256_and_si256(_mm256_srli_epi16(c, 5), mask5));
+                    const __m256i b = Expand5(_mm256_and_si256(_mm256_srli_epi16(c, 10), mask5));
+
+                    // Semi transparent wins, otherwise only black is transparent
+                    const __m256i isSemiTrans = _mm256_srai_epi16(c, 15);
+                    const __m256i isBlack = _mm256_cmpeq_epi16(_mm256_and_si256(c, colourMask), _mm256_setzero_si256());
+                    const __m256i alpha = _mm256_blendv_epi8(_mm256_andnot_si256(isBlack, opaque), semiTrans, isSemiTrans);
+
+                    // Low half of each pixel is blue/alpha, high half red/green. The unpacks give pixels
+                    // 0-3 and 8-11, then 4-7 and 12-15.
+                    const __m256i lo = _mm256_or_si256(_mm256_slli_epi16(b, 8), alpha);
+                    const __m256i hi = _mm256_or_si256(_mm256_slli_epi16(r, 8), g);
+                    const __m256i first = _mm256_unpacklo_epi16(lo, hi);
+                    const __m256i second = _mm256_unpackhi_epi16(lo, hi);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute2x128_si256(first, second, 0x20));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), _mm256_permute2x128_si256(first, second, 0x31));
+                }
+
+                Scalar::Bgr555ToRgba(src + i, dst + i, count - i);
+            }
+
+            // Indices for pixels 0-15 in the low lane and 32-47 in the high lane to those pixels
+            static void Lookup16x2(__m256i indices, const __m256i planes[4], u32* dst)
+            {
+                const __m256i b0 = _mm256_shuffle_epi8(planes[0], indices);
+                const __m256i b1 = _mm256_shuffle_epi8(planes[1], indices);
+                const __m256i b2 = _mm256_shuffle_epi8(planes[2], indices);
+                const __m256i b3 = _mm256_shuffle_epi8(planes[3], indices);
+
+                const __m256i lo01 = _mm256_unpacklo_epi8(b0, b1);
+                const __m256i hi01 = _mm256_unpackhi_epi8(b0, b1);
+                const __m256i lo23 = _mm256_unpacklo_epi8(b2, b3);
+                const __m256i hi23 = _mm256_unpackhi_epi8(b2, b3);
+
+                // Pixels 0-3, 4-7, 8-11 and 12-15 of each lane
+                const __m256i q0 = _mm256_unpacklo_epi16(lo01, lo23);
+                const __m256i q1 = _mm256_unpackhi_epi16(lo01, lo23);
+                const __m256i q2 = _mm256_unpacklo_epi16(hi01, hi23);
+                const __m256i q3 = _mm256_unpackhi_epi16(hi01, hi23);
+
+                __m256i* out = reinterpret_cast<__m256i*>(dst);
+                _mm256_storeu_si256(out + 0, _mm256_permute2x128_si256(q0, q1, 0x20));
+                _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(q2, q3, 0x20));
+                _mm256_storeu_si256(out + 4, _mm256_permute2x128_si256(q0, q1, 0x31));
+                _mm256_storeu_si256(out + 5, _mm256_permute2x128_si256(q2, q3, 0x31));
+            }
+
+            void ExpandPalette4(const u8* src, u32* dst, u32 count, const u32* palette)
+            {
+                // Byte n of every palette entry in plane n, in both lanes
+                alignas(16) u8 planeBytes[4][16];
+                for (int i = 0; i < 16; i++)
+                {
+                    for (int plane = 0; plane < 4; plane++)
+                    {
+                        planeBytes[plane][i] = static_cast<u8>(palette[i] >> (plane * 8));
+                    }
+                }
+
+                __m256i planes[4];
+                for (int plane = 0; plane < 4; plane++)
+                {
+                    planes[plane] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(planeBytes[plane])));
+                }
+
+                const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+                u32 i = 0;
+                for (; i + 64 <= count; i += 64)
+                {
+                    const __m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + (i / 2)));
+                    const __m256i lo = _mm256_and_si256(packed, nibbleMask);
+                    const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(packed, 4), nibbleMask);
+                    Lookup16x2(_mm256_unpacklo_epi8(lo, hi), planes, dst + i);
+                    Lookup16x2(_mm256_unpackhi_epi8(lo, hi), planes, dst + i + 16);
+                }
+
+                Scalar::ExpandPalette4(src + (i / 2), dst + i, count - i, palette);
+            }
+        }
+    }
+}
+
+#endif
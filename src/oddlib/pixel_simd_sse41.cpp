@@ -0,0 +1,163 @@
+#include "oddlib/pixel_simd.hpp"
+#include "oddlib/simd.hpp"
+
+#ifdef ODDLIB_X86_SIMD
+
+// Built with SSE4.1 enabled, only called when the CPU has it. The palette lookups are pshufb's on
+// the palette split into byte planes, the 5/6bit channel scaling is a multiply and shift.
+#include <smmintrin.h>
+
+namespace Oddlib
+{
+    namespace Pixels
+    {
+        namespace Sse41
+        {
+            // (c*255)/31 for c in 0-31
+            static __m128i Expand5(__m128i c)
+            {
+                return _mm_srli_epi16(_mm_mullo_epi16(c, _mm_set1_epi16(1053)), 7);
+            }
+
+            // (c*255)/63 for c in 0-63
+            static __m128i Expand6(__m128i c)
+            {
+                return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(c, _mm_set1_epi16(259)), _mm_set1_epi16(3)), 6);
+            }
+
+            // Picks channel's bytes out of 16 packed R, G or B values for the block'th 16 bytes of 16 RGB24 pixels
+            static __m128i Rgb24Shuffle(int block, int channel)
+            {
+                alignas(16) s8 mask[16];
+                for (int i = 0; i < 16; i++)
+                {
+                    const int pos = (block * 16) + i;
+                    mask[i] = (pos % 3 == channel) ? static_cast<s8>(pos / 3) : static_cast<s8>(0x80);
+                }
+                return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+            }
+
+            void Rgb565ToRgb24(const u16* src, u8* dst, u32 count)
+            {
+                __m128i shuffles[3][3];
+                for (int block = 0; block < 3; block++)
+                {
+                    for (int channel = 0; channel < 3; channel++)
+                    {
+                        shuffles[block][channel] = Rgb24Shuffle(block, channel);
+                    }
+                }
+
+                const __m128i mask5 = _mm_set1_epi16(0x1F);
+                const __m128i mask6 = _mm_set1_epi16(0x3F);
+                u32 i = 0;
+                for (; i + 16 <= count; i += 16)
+                {
+                    const __m128i c0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                    const __m128i c1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+
+                    const __m128i r = _mm_packus_epi16(Expand5(_mm_srli_epi16(c0, 11)), Expand5(_mm_srli_epi16(c1, 11)));
+                    const __m128i g = _mm_packus_epi16(
+                        Expand6(_mm_and_si128(_mm_srli_epi16(c0, 5), mask6)),
+                        Expand6(_mm_and_si128(_mm_srli_epi16(c1, 5), mask6)));
+                    const __m128i b = _mm_packus_epi16(Expand5(_mm_and_si128(c0, mask5)), Expand5(_mm_and_si128(c1, mask5)));
+
+                    __m128i* out = reinterpret_cast<__m128i*>(dst + (i * 3));
+                    for (int block = 0; block < 3; block++)
+                    {
+                        const __m128i rgb = _mm_or_si128(_mm_or_si128(
+                            _mm_shuffle_epi8(r, shuffles[block][0]),
+                            _mm_shuffle_epi8(g, shuffles[block][1])),
+                            _mm_shuffle_epi8(b, shuffles[block][2]));
+                        _mm_storeu_si128(out + block, rgb);
+                    }
+                }
+
+                Scalar::Rgb565ToRgb24(src + i, dst + (i * 3), count - i);
+            }
+
+            void Bgr555ToRgba(const u16* src, u32* dst, u32 count)
+            {
+                const __m128i mask5 = _mm_set1_epi16(0x1F);
+                const __m128i colourMask = _mm_set1_epi16(0x7FFF);
+                const __m128i opaque = _mm_set1_epi16(255);
+                const __m128i semiTrans = _mm_set1_epi16(255 / 2);
+                u32 i = 0;
+                for (; i + 8 <= count; i += 8)
+                {
+                    const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                    const __m128i r = Expand5(_mm_and_si128(c, mask5));
+                    const __m128i g = Expand5(_mm_and_si128(_mm_srli_epi16(c, 5), mask5));
+                    const __m128i b = Expand5(_mm_and_si128(_mm_srli_epi16(c, 10), mask5));
+
+                    // Semi transparent wins, otherwise only black is transparent
+                    const __m128i isSemiTrans = _mm_srai_epi16(c, 15);
+                    const __m128i isBlack = _mm_cmpeq_epi16(_mm_and_si128(c, colourMask), _mm_setzero_si128());
+                    const __m128i alpha = _mm_blendv_epi8(_mm_andnot_si128(isBlack, opaque), semiTrans, isSemiTrans);
+
+                    // Low half of each pixel is blue/alpha, high half red/green
+                    const __m128i lo = _mm_or_si128(_mm_slli_epi16(b, 8), alpha);
+                    const __m128i hi = _mm_or_si128(_mm_slli_epi16(r, 8), g);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(lo, hi));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(lo, hi));
+                }
+
+                Scalar::Bgr555ToRgba(src + i, dst + i, count - i);
+            }
+
+            // 16 indices to 16 pixels
+            static void Lookup16(__m128i indices, const __m128i planes[4], u32* dst)
+            {
+                const __m128i b0 = _mm_shuffle_epi8(planes[0], indices);
+                const __m128i b1 = _mm_shuffle_epi8(planes[1], indices);
+                const __m128i b2 = _mm_shuffle_epi8(planes[2], indices);
+                const __m128i b3 = _mm_shuffle_epi8(planes[3], indices);
+
+                const __m128i lo01 = _mm_unpacklo_epi8(b0, b1);
+                const __m128i hi01 = _mm_unpackhi_epi8(b0, b1);
+                const __m128i lo23 = _mm_unpacklo_epi8(b2, b3);
+                const __m128i hi23 = _mm_unpackhi_epi8(b2, b3);
+
+                __m128i* out = reinterpret_cast<__m128i*>(dst);
+                _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(lo01, lo23));
+                _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo01, lo23));
+                _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi01, hi23));
+                _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi01, hi23));
+            }
+
+            void ExpandPalette4(const u8* src, u32* dst, u32 count, const u32* palette)
+            {
+                // Byte n of every palette entry in plane n
+                alignas(16) u8 planeBytes[4][16];
+                for (int i = 0; i < 16; i++)
+                {
+                    for (int plane = 0; plane < 4; plane++)
+                    {
+                        planeBytes[plane][i] = static_cast<u8>(palette[i] >> (plane * 8));
+                    }
+                }
+
+                __m128i planes[4];
+                for (int plane = 0; plane < 4; plane++)
+                {
+                    planes[plane] = _mm_load_si128(reinterpret_cast<const __m128i*>(planeBytes[plane]));
+                }
+
+                const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+                u32 i = 0;
+                for (; i + 32 <= count; i += 32)
+                {
+                    const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i / 2)));
+                    const __m128i lo = _mm_and_si128(packed, nibbleMask);
+                    const __m128i hi = _mm_and_si128(_mm_srli_epi16(packed, 4), nibbleMask);
+                    Lookup16(_mm_unpacklo_epi8(lo, hi), planes, dst + i);
+                    Lookup16(_mm_unpackhi_epi8(lo, hi), planes, dst + i + 16);
+                }
+
+                Scalar::ExpandPalette4(src + (i / 2), dst + i, count - i, palette);
+            }
+        }
+    }
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "oddlib/sdl_raii.hpp"
 #include "lodepng/lodepng.h"
+#include "oddlib/pixel_simd.hpp"
 
 /*static*/ void SDLHelpers::SaveSurfaceAsPng(const char* fileName, SDL_Surface* surface)
 {
@@ -64,3 +65,83 @@
     }
     return nullptr;
 }
+
+static void AppendU32(std::vector<u8>& out, u32 value)
+{
+    const u8* bytes = reinterpret_cast<const u8*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+/*static*/ void SDLHelpers::WriteSurface(std::vector<u8>& out, const SDL_Surface* surface)
+{
+    AppendU32(out, static_cast<u32>(surface->w));
+    AppendU32(out, static_cast<u32>(surface->h));
+    AppendU32(out, surface->format->BitsPerPixel);
+    AppendU32(out, surface->format->Rmask);
+    AppendU32(out, surface->format->Gmask);
+    AppendU32(out, surface->format->Bmask);
+    AppendU32(out, surface->format->Amask);
+
+    // The pitch is padded, only the pixels are stored
+    const size_t rowSize = static_cast<size_t>(surface->w) * surface->format->BytesPerPixel;
+    const u8* pixels = static_cast<const u8*>(surface->pixels);
+    for (int y = 0; y < surface->h; y++)
+    {
+        const u8* row = pixels + (y * surface->pitch);
+        out.insert(out.end(), row, row + rowSize);
+    }
+}
+
+/*static*/ SDL_SurfacePtr SDLHelpers::ReadSurface(Oddlib::IStream& stream)
+{
+    u32 w = 0;
+    u32 h = 0;
+    u32 bpp = 0;
+    u32 masks[4] = {};
+    stream.Read(w);
+    stream.Read(h);
+    stream.Read(bpp);
+    stream.Read(masks);
+
+    if (w == 0 || h == 0 || w > 0x4000 || h > 0x4000 || (bpp != 8 && bpp != 16 && bpp != 24 && bpp != 32))
+    {
+        throw Oddlib::Exception("Bad surface header");
+    }
+
+    SDL_SurfacePtr surface(SDL_CreateRGBSurface(0, w, h, bpp, masks[0], masks[1], masks[2], masks[3]));
+    if (!surface)
+    {
+        throw Oddlib::Exception("Bad surface format");
+    }
+
+    const size_t rowSize = static_cast<size_t>(w) * surface->format->BytesPerPixel;
+    u8* pixels = static_cast<u8*>(surface->pixels);
+    for (u32 y = 0; y < h; y++)
+    {
+        stream.ReadBytes(pixels + (y * surface->pitch), rowSize);
+    }
+    return surface;
+}
+
+/*static*/ SDL_SurfacePtr SDLHelpers::Rgb565ToRgb24(const SDL_Surface* surface)
+{
+    if (surface->format->BitsPerPixel != 16 || surface->format->Rmask != 0xF800 || surface->format->Gmask != 0x7E0 || surface->format->Bmask != 0x1F)
+    {
+        throw Oddlib::Exception("Not an RGB565 surface");
+    }
+
+    // R, G, B bytes in memory order
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    SDL_SurfacePtr rgb(SDL_CreateRGBSurface(0, surface->w, surface->h, 24, 0xFF0000, 0x00FF00, 0x0000FF, 0));
+#else
+    SDL_SurfacePtr rgb(SDL_CreateRGBSurface(0, surface->w, surface->h, 24, 0x0000FF, 0x00FF00, 0xFF0000, 0));
+#endif
+
+    for (int y = 0; y < surface->h; y++)
+    {
+        const u16* src = reinterpret_cast<const u16*>(static_cast<const u8*>(surface->pixels) + (y * surface->pitch));
+        u8* dst = static_cast<u8*>(rgb->pixels) + (y * rgb->pitch);
+        Oddlib::Pixels::Rgb565ToRgb24(src, dst, static_cast<u32>(surface->w));
+    }
+    return rgb;
+}
@@ -0,0 +1,62 @@
+#include "oddlib/simd.hpp"
+#include "SDL.h"
+#include <atomic>
+
+namespace Oddlib
+{
+    static SimdLevel Detect()
+    {
+#ifdef ODDLIB_X86_SIMD
+        // SDL also checks that the OS saves the AVX registers
+        if (SDL_HasAVX2())
+        {
+            return SimdLevel::eAvx2;
+        }
+        if (SDL_HasSSE41())
+        {
+            return SimdLevel::eSse41;
+        }
+#endif
+        return SimdLevel::eScalar;
+    }
+
+    static std::atomic<int>& ActiveLevel()
+    {
+        static std::atomic<int> level(static_cast<int>(DetectedSimdLevel()));
+        return level;
+    }
+
+    SimdLevel DetectedSimdLevel()
+    {
+        static const SimdLevel detected = Detect();
+        return detected;
+    }
+
+    SimdLevel ActiveSimdLevel()
+    {
+        return static_cast<SimdLevel>(ActiveLevel().load(std::memory_order_relaxed));
+    }
+
+    void SetSimdLevel(SimdLevel level)
+    {
+        if (static_cast<int>(level) > static_cast<int>(DetectedSimdLevel()))
+        {
+            level = DetectedSimdLevel();
+        }
+        ActiveLevel().store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    const char* SimdLevelName(SimdLevel level)
+    {
+        switch (level)
+        {
+        case SimdLevel::eScalar:
+            return "Scalar";
+        case SimdLevel::eSse41:
+            return "SSE4.1";
+        case SimdLevel::eAvx2:
+            return "AVX2";
+        }
+        return "Unknown";
+    }
+}
@@ -2,33 +2,138 @@
 #include <algorithm>
 #include <fstream>
 #include <iterator>
+#include <cstring>
 #include "logger.hpp"
 #include "oddlib/stream.hpp"
 #include "oddlib/exceptions.hpp"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace Oddlib
 {
     MemoryStream::MemoryStream(std::vector<u8>&& data)
+        : mSize(data.size())
     {
-        mSize = data.size();
-        auto s = std::make_unique<std::stringstream>();
-        std::copy(data.begin(), data.end(), std::ostream_iterator<unsigned char>(*s));
-        mStream = std::move(s);
-        Seek(0);
+        // Alias the vector's storage so views don't need to know what owns the bytes
+        auto buffer = std::make_shared<const std::vector<u8>>(std::move(data));
+        mData = std::shared_ptr<const u8>(buffer, buffer->data());
         mName = "Memory buffer (" + std::to_string(mSize) + ") bytes";
         LOG_INFO(mName);
     }
 
+    MemoryStream::MemoryStream(std::shared_ptr<const u8> data, size_t size, std::string name)
+        : mData(std::move(data)), mSize(size), mName(std::move(name))
+    {
+
+    }
+
     IStream* MemoryStream::Clone()
     {
-        auto oldPos = Pos();
+        return new MemoryStream(mData, mSize, mName);
+    }
 
-        Seek(0);
-        std::vector<u8> streamData(Size());
-        Read(streamData);
-        Seek(oldPos);
+    IStream* MemoryStream::Clone(u32 start, u32 size)
+    {
+        if (static_cast<size_t>(start) + size > mSize)
+        {
+            throw Exception("Sub clone is out of bounds");
+        }
+        return new MemoryStream(std::shared_ptr<const u8>(mData, mData.get() + start), size,
+            mName + " sub(" + std::to_string(start) + ", " + std::to_string(size) + ")");
+    }
+
+    void MemoryStream::ReadBytes(u8* pDest, size_t destSize)
+    {
+        if (destSize > mSize - mPos)
+        {
+            throw Exception("ReadBytes failure");
+        }
+
+        if (destSize > 0)
+        {
+            memcpy(pDest, Data() + mPos, destSize);
+            mPos += destSize;
+        }
+    }
+
+    void MemoryStream::WriteBytes(const u8* /*pSrc*/, size_t /*srcSize*/)
+    {
+        throw Exception("Memory streams are read only");
+    }
 
-        return new MemoryStream(std::move(streamData));
+    void MemoryStream::Seek(size_t pos)
+    {
+        if (pos > mSize)
+        {
+            throw Exception("Seek get failure");
+        }
+        mPos = pos;
+    }
+
+    std::string MemoryStream::LoadAllToString()
+    {
+        mPos = mSize;
+        return std::string(reinterpret_cast<const char*>(Data()), mSize);
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    std::unique_ptr<IStream> MapFile(const std::string& fileName)
+    {
+        const int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd == -1)
+        {
+            return nullptr;
+        }
+
+        struct stat st = {};
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+        {
+            // Nothing to map for empty files, FileStream handles them fine
+            ::close(fd);
+            return nullptr;
+        }
+
+        const size_t size = static_cast<size_t>(st.st_size);
+        void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        // The mapping holds its own reference to the file
+        ::close(fd);
+
+        if (mapping == MAP_FAILED)
+        {
+            LOG_ERROR("Failed to map " << fileName << " errno: " << errno);
+            return nullptr;
+        }
+
+        std::shared_ptr<const u8> data(static_cast<const u8*>(mapping), [size](const u8* p)
+        {
+            ::munmap(const_cast<u8*>(p), size);
+        });
+
+        LOG_INFO("Mapped " << fileName << " (" << size << " bytes)");
+        return std::make_unique<MemoryStream>(std::move(data), size, fileName);
+    }
+#else
+    std::unique_ptr<IStream> MapFile(const std::string& /*fileName*/)
+    {
+        return nullptr;
+    }
+#endif
+
+    std::unique_ptr<IStream> OpenReadOnly(const std::string& fileName)
+    {
+        auto stream = MapFile(fileName);
+        if (!stream)
+        {
+            stream = std::make_unique<FileStream>(fileName, IStream::ReadMode::ReadOnly);
+        }
+        return stream;
     }
 
     FileStream::FileStream(const std::string& fileName, ReadMode mode)
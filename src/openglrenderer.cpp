@@ -2,6 +2,8 @@
 
 #include "imgui/imgui.h"
 #include "oddlib/exceptions.hpp"
+#include <algorithm>
+#include <cstring>
 #include <GL/gl3w.h>
 #ifdef WIN32_LEAN_AND_MEAN
 #undef WIN32_LEAN_AND_MEAN
@@ -52,6 +54,26 @@ public:
         GL(glBufferData(mType, size * sizeof(typename std::remove_pointer<T>::type), verts, GL_STREAM_DRAW));
     }
 
+    // Allocates new storage, any data still being used by the GPU remains valid until it is done with it
+    void Orphan(u32 sizeInBytes)
+    {
+        Bind();
+        GL(glBufferData(mType, sizeInBytes, nullptr, GL_STREAM_DRAW));
+    }
+
+    // Writes to a range that the GPU isn't using, so no need to wait for it
+    void WriteUnsynchronized(u32 offset, u32 sizeInBytes, const void* data)
+    {
+        Bind();
+        void* dst = glMapBufferRange(mType, offset, sizeInBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!dst)
+        {
+            throw Oddlib::Exception("Failed to map buffer object");
+        }
+        memcpy(dst, data, sizeInBytes);
+        GL(glUnmapBuffer(mType));
+    }
+
     u32 mType;
     u32 mBo;
 };
@@ -77,7 +99,7 @@ public:
         GL(glBindVertexArray(mVao));
     }
 
-    void BindAttributes(std::unique_ptr<class BufferObject>& vbo, int posAttr, int colourAttr, int uvAttr)
+    void BindAttributes(std::unique_ptr<class BufferObject>& vbo, int posAttr, int colourAttr, int uvAttr, size_t baseOffset = 0)
     {
         vbo->Bind();
 
@@ -86,9 +108,9 @@ public:
         GL(glEnableVertexAttribArray(colourAttr));
 
 #define OFFSETOF(TYPE, ELEMENT) ((size_t)&(((TYPE *)0)->ELEMENT))
-        GL(glVertexAttribPointer(posAttr, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, pos)));
-        GL(glVertexAttribPointer(uvAttr, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, uv)));
-        GL(glVertexAttribPointer(colourAttr, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, col)));
+        GL(glVertexAttribPointer(posAttr, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(baseOffset + OFFSETOF(ImDrawVert, pos))));
+        GL(glVertexAttribPointer(uvAttr, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(baseOffset + OFFSETOF(ImDrawVert, uv))));
+        GL(glVertexAttribPointer(colourAttr, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)(baseOffset + OFFSETOF(ImDrawVert, col))));
 #undef OFFSETOF
 
     }
@@ -151,6 +173,12 @@ public:
         GL(glAttachShader(mShader, shader.mShaderProgram));
     }
 
+    // Must be called before Link()
+    void BindAttribute(GLuint location, const char* name)
+    {
+        GL(glBindAttribLocation(mShader, location, name));
+    }
+
     GLint Attribute(const char* name)
     {
         GLint ret = glGetAttribLocation(mShader, name);
@@ -185,6 +213,32 @@ public:
 // TODO: Error message
 #define ALIVE_FATAL_ERROR() abort()
 
+static inline TextureHandle GLToTextureHandle(const GLuint textureNumber)
+{
+    TextureHandle r;
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4312) // 'reinterpret_cast': conversion from 'const GLuint' to 'void *' of greater size
+#endif
+    r.mData = reinterpret_cast<void*>(textureNumber);
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+    return r;
+}
+
+static inline GLuint TextureHandleToGL(TextureHandle handle)
+{
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4311) // 'reinterpret_cast': pointer truncation from 'void *' to 'GLuint'
+#endif
+    return static_cast<GLuint>(reinterpret_cast<uintptr_t>(handle.mData));
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+}
+
 const static GLchar* kVertexShader =
     "#version 330\n"
     "uniform mat4 ProjMtx;\n"
@@ -211,6 +265,21 @@ const static GLchar* kFragmentShader =
     "   Out_Color = Frag_Color * texture( Texture, Frag_UV.st);\n"
     "}\n";
 
+// Texture holds palette indices, the colour is fetched from the 256x1 palette. The index texture
+// must not be filtered as blending indices together gives unrelated colours.
+const static GLchar* kIndexedFragmentShader =
+    "#version 330\n"
+    "uniform sampler2D Texture;\n"
+    "uniform sampler2D Palette;\n"
+    "in vec2 Frag_UV;\n"
+    "in vec4 Frag_Color;\n"
+    "out vec4 Out_Color;\n"
+    "void main()\n"
+    "{\n"
+    "   int index = int(texture( Texture, Frag_UV.st).r * 255.0 + 0.5);\n"
+    "   Out_Color = Frag_Color * texelFetch( Palette, ivec2(index, 0), 0);\n"
+    "}\n";
+
 bool OpenGLRenderer::CreateShadersAndBufferObjects()
 {
     mShader = std::make_unique<Shader>();
@@ -226,6 +295,21 @@ bool OpenGLRenderer::CreateShadersAndBufferObjects()
     mAttribLocationUV = mShader->Attribute("UV");
     mAttribLocationColor = mShader->Attribute("Color");
 
+    // Draws with the same vertex arrays, so the attributes have to be where the first shader has them
+    mIndexedShader = std::make_unique<Shader>();
+    mIndexedShader->mVertexShader.Compile(&kVertexShader);
+    mIndexedShader->mFragmentShader.Compile(&kIndexedFragmentShader);
+    mIndexedShader->AddShader(mIndexedShader->mVertexShader);
+    mIndexedShader->AddShader(mIndexedShader->mFragmentShader);
+    mIndexedShader->BindAttribute(mAttribLocationPosition, "Position");
+    mIndexedShader->BindAttribute(mAttribLocationUV, "UV");
+    mIndexedShader->BindAttribute(mAttribLocationColor, "Color");
+    mIndexedShader->Link();
+
+    mIndexedLocationTex = mIndexedShader->Uniform("Texture");
+    mIndexedLocationPalette = mIndexedShader->Uniform("Palette");
+    mIndexedLocationProjMtx = mIndexedShader->Uniform("ProjMtx");
+
     mGuiVbo = std::make_unique<BufferObject>(GL_ARRAY_BUFFER);
     mGuiIbo = std::make_unique<BufferObject>(GL_ELEMENT_ARRAY_BUFFER);
     mGuiVao = std::make_unique<Vao>();
@@ -238,6 +322,13 @@ bool OpenGLRenderer::CreateShadersAndBufferObjects()
     mRendererVao->Bind();
     mGuiVao->BindAttributes(mRendererVbo, mAttribLocationPosition, mAttribLocationColor, mAttribLocationUV);
 
+    mSpriteVbo = std::make_unique<BufferObject>(GL_ARRAY_BUFFER);
+    mSpriteIbo = std::make_unique<BufferObject>(GL_ELEMENT_ARRAY_BUFFER);
+    mSpriteVao = std::make_unique<Vao>();
+
+    mUploadPbos[0] = std::make_unique<BufferObject>(GL_PIXEL_UNPACK_BUFFER);
+    mUploadPbos[1] = std::make_unique<BufferObject>(GL_PIXEL_UNPACK_BUFFER);
+
     return true;
 }
 
@@ -253,15 +344,34 @@ OpenGLRenderer::~OpenGLRenderer()
     SDL_GL_DeleteContext(mContext);
 }
 
-void OpenGLRenderer::SetWorldMatrix()
+void OpenGLRenderer::UseShader(TextureHandle palette, const f32* projMtx)
+{
+    if (palette.IsValid())
+    {
+        // The indices are bound to unit 0 like any other texture, the palette goes in unit 1
+        mIndexedShader->Use();
+        glUniform1i(mIndexedLocationTex, 0);
+        glUniform1i(mIndexedLocationPalette, 1);
+        glUniformMatrix4fv(mIndexedLocationProjMtx, 1, GL_FALSE, projMtx);
+        GL(glActiveTexture(GL_TEXTURE1));
+        GL(glBindTexture(GL_TEXTURE_2D, TextureHandleToGL(palette)));
+        GL(glActiveTexture(GL_TEXTURE0));
+    }
+    else
+    {
+        mShader->Use();
+        glUniform1i(mAttribLocationTex, 0);
+        glUniformMatrix4fv(mAttribLocationProjMtx, 1, GL_FALSE, projMtx);
+    }
+}
+
+void OpenGLRenderer::SetWorldMatrix(TextureHandle palette)
 {
     glm::mat4 mat = mProjection * mView;
-    mShader->Use();
-    glUniform1i(mAttribLocationTex, 0);
-    glUniformMatrix4fv(mAttribLocationProjMtx, 1, GL_FALSE, &mat[0][0]);
+    UseShader(palette, &mat[0][0]);
 }
 
-void OpenGLRenderer::SetScreenMatrix()
+void OpenGLRenderer::SetScreenMatrix(TextureHandle palette)
 {
     ImGuiIO& io = ImGui::GetIO();
     const float ortho_projection[4][4] =
@@ -271,9 +381,7 @@ void OpenGLRenderer::SetScreenMatrix()
         { 0.0f,                  0.0f,                  -1.0f, 0.0f },
         { -1.0f,                  1.0f,                   0.0f, 1.0f },
     };
-    mShader->Use();
-    glUniform1i(mAttribLocationTex, 0);
-    glUniformMatrix4fv(mAttribLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]);
+    UseShader(palette, &ortho_projection[0][0]);
 }
 
 void OpenGLRenderer::OnSetRenderState(CmdState& info)
@@ -281,11 +389,11 @@ void OpenGLRenderer::OnSetRenderState(CmdState& info)
    
     if (info.mCoordinateSystem == AbstractRenderer::eScreen)
     {
-        SetScreenMatrix();
+        SetScreenMatrix(info.mPalette);
     }
     else if (info.mCoordinateSystem == AbstractRenderer::eWorld)
     {
-        SetWorldMatrix();
+        SetWorldMatrix(info.mPalette);
     }
 
     if (info.mBlendMode == AbstractRenderer::eNormal)
@@ -311,10 +419,17 @@ static int ToGLFormat(AbstractRenderer::eTextureFormats format)
         return GL_RGB;
     case AbstractRenderer::eTextureFormats::eA:
         return GL_ALPHA;
+    case AbstractRenderer::eTextureFormats::eR:
+        return GL_RED;
     }
     ALIVE_FATAL_ERROR();
 }
 
+static int ToGLInternalFormat(AbstractRenderer::eTextureFormats format)
+{
+    return format == AbstractRenderer::eTextureFormats::eR ? GL_R8 : ToGLFormat(format);
+}
+
 
 struct BlendMode
 {
@@ -403,31 +518,6 @@ static inline BlendMode ToBlendMode(const AbstractRenderer::eBlendModes mode)
 }
 */
 
-static inline TextureHandle GLToTextureHandle(const GLuint textureNumber)
-{
-    TextureHandle r;
-#ifdef _MSC_VER
-#pragma warning(push)
-#pragma warning(disable: 4312) // 'reinterpret_cast': conversion from 'const GLuint' to 'void *' of greater size
-#endif
-    r.mData = reinterpret_cast<void*>(textureNumber);
-#ifdef _MSC_VER
-#pragma warning(pop)
-#endif
-    return r;
-}
-
-static inline GLuint TextureHandleToGL(TextureHandle handle)
-{
-#ifdef _MSC_VER
-#pragma warning(push)
-#pragma warning(disable: 4311) // 'reinterpret_cast': pointer truncation from 'void *' to 'GLuint'
-#endif
-    return static_cast<GLuint>(reinterpret_cast<uintptr_t>(handle.mData));
-#ifdef _MSC_VER
-#pragma warning(pop)
-#endif
-}
 
 void OpenGLRenderer::ImGuiRender(ImDrawData* draw_data, std::unique_ptr<Vao>& vao, std::unique_ptr<BufferObject>& vbo, std::unique_ptr<BufferObject>& ibo)
 {
@@ -493,6 +583,9 @@ void OpenGLRenderer::ImGuiRender(ImDrawData* draw_data, std::unique_ptr<Vao>& va
             if (pcmd->UserCallback)
             {
                 pcmd->UserCallback(cmd_list, pcmd);
+
+                // Sprite batches bind their own buffers
+                vao->Bind();
             }
             else
             {
@@ -528,10 +621,78 @@ void OpenGLRenderer::ImGuiRender()
     }
 }
 
+// Room for this many frames worth of sprites before the ring buffer has to be orphaned
+static const u32 kSpriteRingFrames = 3;
+
+void OpenGLRenderer::UploadSpriteVertices()
+{
+    if (mSpriteVertices.empty())
+    {
+        return;
+    }
+
+    // Every quad uses the same indices relative to its first vertex, so they only need
+    // to be generated again when there are more quads than ever before
+    const u32 numQuads = static_cast<u32>(mSpriteVertices.size() / 4);
+    if (numQuads > mSpriteIboQuads)
+    {
+        mSpriteIboQuads = std::max(numQuads, mSpriteIboQuads * 2);
+        std::vector<u32> indices(mSpriteIboQuads * 6);
+        for (u32 i = 0; i < mSpriteIboQuads; i++)
+        {
+            const u32 v = i * 4;
+            indices[(i * 6) + 0] = v + 0;
+            indices[(i * 6) + 1] = v + 1;
+            indices[(i * 6) + 2] = v + 2;
+            indices[(i * 6) + 3] = v + 0;
+            indices[(i * 6) + 4] = v + 2;
+            indices[(i * 6) + 5] = v + 3;
+        }
+        mSpriteVao->Bind();
+        mSpriteIbo->SetData(static_cast<int>(indices.size()), indices.data());
+    }
+
+    const u32 sizeInBytes = static_cast<u32>(mSpriteVertices.size() * sizeof(ImDrawVert));
+    if (sizeInBytes * kSpriteRingFrames > mSpriteVboSize)
+    {
+        mSpriteVboSize = sizeInBytes * kSpriteRingFrames;
+        mSpriteVbo->Orphan(mSpriteVboSize);
+        mSpriteVboWritePos = 0;
+    }
+    else if (mSpriteVboWritePos + sizeInBytes > mSpriteVboSize)
+    {
+        mSpriteVbo->Orphan(mSpriteVboSize);
+        mSpriteVboWritePos = 0;
+    }
+
+    mSpriteVbo->WriteUnsynchronized(mSpriteVboWritePos, sizeInBytes, mSpriteVertices.data());
+
+    // Point the attributes at this frames vertices so the indices can start from 0
+    mSpriteVao->Bind();
+    mSpriteVao->BindAttributes(mSpriteVbo, mAttribLocationPosition, mAttribLocationColor, mAttribLocationUV, mSpriteVboWritePos);
+    mSpriteIbo->Bind();
+
+    mSpriteVboWritePos += sizeInBytes;
+}
+
+void OpenGLRenderer::RenderSpriteBatch(const SpriteBatch& batch)
+{
+    // Sprites are not clipped, ImGui sets its scissor rect again before its next draw
+    glDisable(GL_SCISSOR_TEST);
+
+    mSpriteVao->Bind();
+    glBindTexture(GL_TEXTURE_2D, TextureHandleToGL(batch.mTexture));
+    glDrawElements(GL_TRIANGLES, batch.mNumQuads * 6, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid*>(static_cast<uintptr_t>(batch.mFirstQuad) * 6 * sizeof(u32)));
+
+    glEnable(GL_SCISSOR_TEST);
+}
+
 void OpenGLRenderer::RenderCommandsImpl()
 {
     GL(glViewport(0, 0, mW, mH));
 
+    UploadSpriteVertices();
+
     if (mRenderDrawLists.empty() == false)
     {
         ImGuiRender(&mRenderDrawData, mRendererVao, mRendererVbo, mRendererIbo);
@@ -554,23 +715,30 @@ void OpenGLRenderer::SetVSync(bool on)
     SDL_GL_SetSwapInterval(on ? 1 : 0);
 }
 
-TextureHandle OpenGLRenderer::CreateTexture(eTextureFormats internalFormat, u32 width, u32 height, eTextureFormats inputFormat, const void* pixels, bool interpolation)
+// Expands alpha only pixels to white RGBA
+static const void* ConvertAlphaToRGBA(u32 width, u32 height, const void* pixels)
 {
     static std::vector<u32> converted; // Shared scratch buffer - not thread safe, but then GL isn't thread safe anyway
-    if (inputFormat == AbstractRenderer::eTextureFormats::eA)
+    converted.resize(width*height);
+    const u8* alphaPixels = reinterpret_cast<const u8*>(pixels);
+    u32 srcIdx = 0;
+    u32 dstIdx = 0;
+    for (u32 y = 0; y < height; ++y)
     {
-        converted.resize(width*height);
-        const u8* alphaPixels = reinterpret_cast<const u8*>(pixels);
-        u32 srcIdx = 0;
-        u32 dstIdx = 0;
-        for (u32 y = 0; y < height; ++y)
+        for (u32 x = 0; x < width; x++)
         {
-            for (u32 x = 0; x < width; x++)
-            {
-                const u8 a = alphaPixels[srcIdx++];
-                converted[dstIdx++] = ColourU8{ 255,255,255, a }.To32Bit();
-            }
+            const u8 a = alphaPixels[srcIdx++];
+            converted[dstIdx++] = ColourU8{ 255,255,255, a }.To32Bit();
         }
+    }
+    return converted.data();
+}
+
+TextureHandle OpenGLRenderer::CreateTexture(eTextureFormats internalFormat, u32 width, u32 height, eTextureFormats inputFormat, const void* pixels, bool interpolation)
+{
+    if (inputFormat == AbstractRenderer::eTextureFormats::eA)
+    {
+        pixels = ConvertAlphaToRGBA(width, height, pixels);
         inputFormat = AbstractRenderer::eTextureFormats::eRGBA;
     }
 
@@ -584,17 +752,45 @@ TextureHandle OpenGLRenderer::CreateTexture(eTextureFormats internalFormat, u32
 
     GL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
     GL(glTexImage2D(GL_TEXTURE_2D, 0,
-        ToGLFormat(internalFormat),
+        ToGLInternalFormat(internalFormat),
         width, height, 0,
         ToGLFormat(inputFormat),
         GL_UNSIGNED_BYTE,
-        converted.empty() ? pixels : converted.data()));
-    
-    converted.clear();
+        pixels));
 
     return GLToTextureHandle(tex);
 }
 
+void OpenGLRenderer::UpdateTexture(TextureHandle handle, u32 width, u32 height, eTextureFormats inputFormat, const void* pixels)
+{
+    UpdateTextureRows(handle, 0, width, height, inputFormat, pixels);
+}
+
+void OpenGLRenderer::UpdateTextureRows(TextureHandle handle, u32 y, u32 width, u32 rows, eTextureFormats inputFormat, const void* pixels)
+{
+    if (inputFormat == AbstractRenderer::eTextureFormats::eA)
+    {
+        pixels = ConvertAlphaToRGBA(width, rows, pixels);
+        inputFormat = AbstractRenderer::eTextureFormats::eRGBA;
+    }
+
+    // Orphan the buffer and fill it, the driver then DMAs it to the texture while the other
+    // buffer is used for the next update
+    std::unique_ptr<BufferObject>& pbo = mUploadPbos[mUploadPboIndex];
+    mUploadPboIndex = (mUploadPboIndex + 1) % 2;
+
+    const u32 sizeInBytes = width * rows * BytesPerPixel(inputFormat);
+    pbo->Orphan(sizeInBytes);
+    pbo->WriteUnsynchronized(0, sizeInBytes, pixels);
+
+    GL(glBindTexture(GL_TEXTURE_2D, TextureHandleToGL(handle)));
+    GL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+
+    // With a bound unpack buffer the pixels "pointer" is an offset in to it
+    GL(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, rows, ToGLFormat(inputFormat), GL_UNSIGNED_BYTE, nullptr));
+    GL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+}
+
 void OpenGLRenderer::DestroyTextures()
 {
     if (!mDestroyTextureList.empty())
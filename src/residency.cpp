@@ -0,0 +1,142 @@
+#include "residency.hpp"
+
+ResidencyManager::ResidencyManager(size_t budget)
+{
+    mStats.mBudget = budget;
+}
+
+void ResidencyManager::SetBudget(size_t budget)
+{
+    std::vector<std::shared_ptr<void>> evicted;
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStats.mBudget = budget;
+    Evict(evicted);
+}
+
+std::shared_ptr<void> ResidencyManager::FindObject(const Key& key)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(key);
+    if (it == std::end(mEntries))
+    {
+        mStats.mMisses++;
+        return nullptr;
+    }
+
+    mStats.mHits++;
+    mLru.splice(std::begin(mLru), mLru, it->second);
+    return it->second->mObject;
+}
+
+void ResidencyManager::Add(const Key& key, std::shared_ptr<void> object, size_t sizeInBytes)
+{
+    // Declared before the lock so that whatever gets replaced or evicted is freed after unlocking
+    std::vector<std::shared_ptr<void>> evicted;
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mEntries.find(key);
+    if (it != std::end(mEntries))
+    {
+        Entry& entry = *it->second;
+        mStats.mBytesResident -= entry.mSize;
+        evicted.push_back(std::move(entry.mObject));
+        entry.mObject = std::move(object);
+        entry.mSize = sizeInBytes;
+        mLru.splice(std::begin(mLru), mLru, it->second);
+    }
+    else
+    {
+        mLru.push_front(Entry{ key, std::move(object), sizeInBytes });
+        mEntries.emplace(key, std::begin(mLru));
+    }
+    mStats.mBytesResident += sizeInBytes;
+
+    Evict(evicted);
+}
+
+void ResidencyManager::Pin(const Key& key)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPins[key]++;
+}
+
+void ResidencyManager::Unpin(const Key& key)
+{
+    std::vector<std::shared_ptr<void>> evicted;
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mPins.find(key);
+    if (it == std::end(mPins))
+    {
+        return;
+    }
+
+    if (--it->second == 0)
+    {
+        mPins.erase(it);
+        Evict(evicted);
+    }
+}
+
+void ResidencyManager::Clear()
+{
+    std::vector<std::shared_ptr<void>> evicted;
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto it = std::begin(mLru); it != std::end(mLru);)
+    {
+        if (IsPinnedLocked(it->mKey))
+        {
+            ++it;
+            continue;
+        }
+        mStats.mBytesResident -= it->mSize;
+        evicted.push_back(std::move(it->mObject));
+        mEntries.erase(it->mKey);
+        it = mLru.erase(it);
+    }
+}
+
+bool ResidencyManager::IsPinned(const Key& key) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return IsPinnedLocked(key);
+}
+
+ResidencyManager::Stats ResidencyManager::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Stats stats = mStats;
+    stats.mEntries = static_cast<u32>(mLru.size());
+    stats.mBytesPinned = 0;
+    for (const Entry& entry : mLru)
+    {
+        if (IsPinnedLocked(entry.mKey))
+        {
+            stats.mBytesPinned += entry.mSize;
+        }
+    }
+    return stats;
+}
+
+bool ResidencyManager::IsPinnedLocked(const Key& key) const
+{
+    return mPins.find(key) != std::end(mPins);
+}
+
+void ResidencyManager::Evict(std::vector<std::shared_ptr<void>>& evicted)
+{
+    auto it = std::end(mLru);
+    while (mStats.mBytesResident > mStats.mBudget && it != std::begin(mLru))
+    {
+        --it;
+        if (IsPinnedLocked(it->mKey))
+        {
+            continue;
+        }
+
+        mStats.mBytesResident -= it->mSize;
+        mStats.mEvictions++;
+        evicted.push_back(std::move(it->mObject));
+        mEntries.erase(it->mKey);
+        it = mLru.erase(it);
+    }
+}
@@ -0,0 +1,509 @@
+#include "resourcemapper.hpp"
+#include "oddlib/exceptions.hpp"
+#include <cstring>
+
+// Precompiled form of everything ResourceMapper parses out of the resource json files, so that
+// startup doesn't have to run rapidjson over megabytes of text.
+//
+// Layout (native endian, the file is only ever read back on the machine that wrote it):
+//   Header
+//   u32 mNumWords records: every value is a u32, strings are byte offsets in to the string table
+//   mStringsSize bytes of '\0' terminated, de-duplicated strings
+//
+// Maps are written in iteration order, so a loaded map lists its entries in the same order.
+
+namespace
+{
+    const u32 kPrecompiledMagic = Oddlib::MakeType("ALDB");
+
+    // Bump when the layout or anything that is written changes
+    const u32 kPrecompiledVersion = 1;
+
+    struct PrecompiledHeader
+    {
+        u32 mMagic;
+        u32 mVersion;
+        u32 mSourceHash;
+        u32 mNumWords;
+        u32 mStringsSize;
+    };
+
+    class PrecompiledWriter
+    {
+    public:
+        void U32(u32 value)
+        {
+            mWords.push_back(value);
+        }
+
+        void S32(s32 value)
+        {
+            U32(static_cast<u32>(value));
+        }
+
+        void Bool(bool value)
+        {
+            U32(value ? 1 : 0);
+        }
+
+        void Count(size_t count)
+        {
+            U32(static_cast<u32>(count));
+        }
+
+        void String(const std::string& str)
+        {
+            auto it = mStringOffsets.find(str);
+            if (it == std::end(mStringOffsets))
+            {
+                it = mStringOffsets.insert(std::make_pair(str, static_cast<u32>(mStrings.size()))).first;
+                mStrings.append(str.c_str(), str.size() + 1);
+            }
+            U32(it->second);
+        }
+
+        std::vector<u8> Finish(u32 sourceHash) const
+        {
+            PrecompiledHeader header = {};
+            header.mMagic = kPrecompiledMagic;
+            header.mVersion = kPrecompiledVersion;
+            header.mSourceHash = sourceHash;
+            header.mNumWords = static_cast<u32>(mWords.size());
+            header.mStringsSize = static_cast<u32>(mStrings.size());
+
+            std::vector<u8> ret(sizeof(header) + mWords.size() * sizeof(u32) + mStrings.size());
+            memcpy(ret.data(), &header, sizeof(header));
+            if (!mWords.empty())
+            {
+                memcpy(ret.data() + sizeof(header), mWords.data(), mWords.size() * sizeof(u32));
+            }
+            if (!mStrings.empty())
+            {
+                memcpy(ret.data() + sizeof(header) + mWords.size() * sizeof(u32), mStrings.data(), mStrings.size());
+            }
+            return ret;
+        }
+
+    private:
+        std::vector<u32> mWords;
+        std::string mStrings;
+        std::unordered_map<std::string, u32> mStringOffsets;
+    };
+
+    class PrecompiledReader
+    {
+    public:
+        // Returns false if data isn't a complete precompiled db for sourceHash
+        bool Open(const u8* data, size_t size, u32 sourceHash)
+        {
+            PrecompiledHeader header = {};
+            if (size < sizeof(header))
+            {
+                return false;
+            }
+            memcpy(&header, data, sizeof(header));
+
+            if (header.mMagic != kPrecompiledMagic || header.mVersion != kPrecompiledVersion || header.mSourceHash != sourceHash)
+            {
+                return false;
+            }
+
+            // A partially written file never matches
+            const u64 expectedSize = sizeof(header) + static_cast<u64>(header.mNumWords) * sizeof(u32) + header.mStringsSize;
+            if (expectedSize != size)
+            {
+                return false;
+            }
+
+            mWords = data + sizeof(header);
+            mNumWords = header.mNumWords;
+            mStrings = reinterpret_cast<const char*>(mWords + mNumWords * sizeof(u32));
+            mStringsSize = header.mStringsSize;
+
+            // So that strings can't run off the end of the table
+            return mStringsSize == 0 || mStrings[mStringsSize - 1] == '\0';
+        }
+
+        u32 U32()
+        {
+            if (mPos >= mNumWords)
+            {
+                throw Oddlib::Exception("Precompiled resource db is truncated");
+            }
+            u32 value = 0;
+            memcpy(&value, mWords + mPos * sizeof(u32), sizeof(value));
+            mPos++;
+            return value;
+        }
+
+        s32 S32()
+        {
+            return static_cast<s32>(U32());
+        }
+
+        bool Bool()
+        {
+            return U32() != 0;
+        }
+
+        u32 Count()
+        {
+            // Every item takes at least one word, so anything bigger is corrupt (and would be a huge reserve())
+            const u32 count = U32();
+            if (count > mNumWords - mPos)
+            {
+                throw Oddlib::Exception("Precompiled resource db has a bad count");
+            }
+            return count;
+        }
+
+        std::string String()
+        {
+            const u32 offset = U32();
+            if (offset >= mStringsSize)
+            {
+                throw Oddlib::Exception("Precompiled resource db has a bad string offset");
+            }
+            return std::string(mStrings + offset);
+        }
+
+        bool AtEnd() const
+        {
+            return mPos == mNumWords;
+        }
+
+    private:
+        const u8* mWords = nullptr;
+        u32 mNumWords = 0;
+        u32 mPos = 0;
+        const char* mStrings = nullptr;
+        u32 mStringsSize = 0;
+    };
+
+    void WriteStringSet(PrecompiledWriter& w, const std::set<std::string>& strings)
+    {
+        w.Count(strings.size());
+        for (const std::string& str : strings)
+        {
+            w.String(str);
+        }
+    }
+
+    std::set<std::string> ReadStringSet(PrecompiledReader& r)
+    {
+        std::set<std::string> ret;
+        const u32 count = r.Count();
+        for (u32 i = 0; i < count; i++)
+        {
+            ret.emplace_hint(std::end(ret), r.String());
+        }
+        return ret;
+    }
+
+    void WriteSoundResources(PrecompiledWriter& w, const SoundResources& sounds)
+    {
+        w.Count(sounds.mSounds.size());
+        for (const SoundResource& sound : sounds.mSounds)
+        {
+            w.String(sound.mResourceName);
+            w.Bool(sound.mIsCacheResident);
+            w.U32(sound.mMusic.mResourceId);
+            WriteStringSet(w, sound.mMusic.mSoundBanks);
+            w.S32(sound.mSoundEffect.mVolume);
+            w.S32(sound.mSoundEffect.mMinPitch);
+            w.S32(sound.mSoundEffect.mMaxPitch);
+            w.Count(sound.mSoundEffect.mSoundBanks.size());
+            for (const SoundEffectResourceLocation& location : sound.mSoundEffect.mSoundBanks)
+            {
+                w.S32(location.mProgram);
+                w.S32(location.mTone);
+                WriteStringSet(w, location.mSoundBanks);
+            }
+            w.String(sound.mComment);
+        }
+
+        w.Count(sounds.mSoundBanks.size());
+        for (const SoundBankLocation& soundBank : sounds.mSoundBanks)
+        {
+            w.String(soundBank.mName);
+            w.String(soundBank.mDataSetName);
+            w.String(soundBank.mSeqFileName);
+            w.String(soundBank.mSoundBankName);
+        }
+
+        w.Count(sounds.mThemes.size());
+        for (const MusicTheme& theme : sounds.mThemes)
+        {
+            w.String(theme.mName);
+            w.Count(theme.mEntries.size());
+            for (const auto& entries : theme.mEntries)
+            {
+                w.String(entries.first);
+                w.Count(entries.second.size());
+                for (const MusicThemeEntry& entry : entries.second)
+                {
+                    w.String(entry.mMusicName);
+                    w.S32(entry.mLoopCount);
+                }
+            }
+        }
+    }
+
+    void ReadSoundResources(PrecompiledReader& r, SoundResources& sounds)
+    {
+        sounds.mSounds.resize(r.Count());
+        for (SoundResource& sound : sounds.mSounds)
+        {
+            sound.mResourceName = r.String();
+            sound.mIsCacheResident = r.Bool();
+            sound.mMusic.mResourceId = r.U32();
+            sound.mMusic.mSoundBanks = ReadStringSet(r);
+            sound.mSoundEffect.mVolume = r.S32();
+            sound.mSoundEffect.mMinPitch = r.S32();
+            sound.mSoundEffect.mMaxPitch = r.S32();
+            sound.mSoundEffect.mSoundBanks.resize(r.Count());
+            for (SoundEffectResourceLocation& location : sound.mSoundEffect.mSoundBanks)
+            {
+                location.mProgram = r.S32();
+                location.mTone = r.S32();
+                location.mSoundBanks = ReadStringSet(r);
+            }
+            sound.mComment = r.String();
+        }
+
+        sounds.mSoundBanks.resize(r.Count());
+        for (SoundBankLocation& soundBank : sounds.mSoundBanks)
+        {
+            soundBank.mName = r.String();
+            soundBank.mDataSetName = r.String();
+            soundBank.mSeqFileName = r.String();
+            soundBank.mSoundBankName = r.String();
+        }
+
+        sounds.mThemes.resize(r.Count());
+        for (MusicTheme& theme : sounds.mThemes)
+        {
+            theme.mName = r.String();
+            const u32 numEntries = r.Count();
+            for (u32 i = 0; i < numEntries; i++)
+            {
+                auto it = theme.mEntries.emplace_hint(std::end(theme.mEntries), r.String(), std::vector<MusicThemeEntry>());
+                it->second.resize(r.Count());
+                for (MusicThemeEntry& entry : it->second)
+                {
+                    entry.mMusicName = r.String();
+                    entry.mLoopCount = r.S32();
+                }
+            }
+        }
+    }
+}
+
+u32 ResourceMapper::PrecompiledSourceHash(const std::vector<std::string>& jsonFiles)
+{
+    u32 hash = kPrecompiledVersion;
+    for (const std::string& json : jsonFiles)
+    {
+        hash = Oddlib::HashU32(hash ^ Oddlib::HashBytes(json.data(), json.size()));
+        hash = Oddlib::HashU32(hash ^ static_cast<u32>(json.size()));
+    }
+    return hash;
+}
+
+std::vector<u8> ResourceMapper::SavePrecompiled(u32 sourceHash) const
+{
+    TRACE_ENTRYEXIT;
+
+    PrecompiledWriter w;
+
+    w.Count(mFileLocations.size());
+    for (const auto& file : mFileLocations)
+    {
+        w.String(file.first);
+        w.Count(file.second.size());
+        for (const auto& dataSet : file.second)
+        {
+            w.String(dataSet.first);
+            w.Count(dataSet.second.size());
+            for (const DataSetFileAttributes& attributes : dataSet.second)
+            {
+                w.String(attributes.mLvlName.Str());
+                w.Bool(attributes.mIsPsx);
+                w.Bool(attributes.mIsAo);
+                w.Bool(attributes.mScaleFrameOffsets);
+            }
+        }
+    }
+
+    w.Count(mAnimMaps.size());
+    for (const auto& anim : mAnimMaps)
+    {
+        w.String(anim.first);
+        w.U32(anim.second.mBlendingMode);
+        w.Count(anim.second.mLocations.size());
+        for (const AnimFileLocations& location : anim.second.mLocations)
+        {
+            w.String(location.mDataSetName);
+            w.Count(location.mFiles.size());
+            for (const AnimFile& animFile : location.mFiles)
+            {
+                w.String(animFile.mFile.Str());
+                w.U32(animFile.mId);
+                w.U32(animFile.mAnimationIndex);
+            }
+        }
+    }
+
+    w.Count(mFmvMaps.size());
+    for (const auto& fmv : mFmvMaps)
+    {
+        w.String(fmv.first);
+        w.Count(fmv.second.mLocations.size());
+        for (const FmvFileLocation& location : fmv.second.mLocations)
+        {
+            w.String(location.mDataSetName);
+            w.String(location.mFileName);
+            w.U32(location.mStartSector);
+            w.U32(location.mEndSector);
+        }
+    }
+
+    w.Count(mPathMaps.size());
+    for (const auto& path : mPathMaps)
+    {
+        w.String(path.first);
+        w.U32(path.second.mId);
+        w.U32(path.second.mCollisionOffset);
+        w.U32(path.second.mIndexTableOffset);
+        w.U32(path.second.mObjectOffset);
+        w.U32(path.second.mNumberOfScreensX);
+        w.U32(path.second.mNumberOfScreensY);
+        w.String(path.second.mMusicTheme);
+        w.Count(path.second.mLocations.size());
+        for (const PathLocation& location : path.second.mLocations)
+        {
+            w.String(location.mDataSetName);
+            w.String(location.mDataSetFileName);
+        }
+    }
+
+    WriteSoundResources(w, mSoundResources);
+
+    return w.Finish(sourceHash);
+}
+
+bool ResourceMapper::LoadPrecompiled(const u8* data, size_t size, u32 sourceHash)
+{
+    TRACE_ENTRYEXIT;
+
+    PrecompiledReader r;
+    if (!r.Open(data, size, sourceHash))
+    {
+        return false;
+    }
+
+    // Built up on the side so a bad file leaves this object as it was
+    decltype(mFileLocations) fileLocations;
+    decltype(mAnimMaps) animMaps;
+    decltype(mFmvMaps) fmvMaps;
+    decltype(mPathMaps) pathMaps;
+    SoundResources soundResources;
+
+    try
+    {
+        const u32 numFiles = r.Count();
+        fileLocations.reserve(numFiles);
+        for (u32 i = 0; i < numFiles; i++)
+        {
+            auto& dataSets = fileLocations[r.String()];
+            const u32 numDataSets = r.Count();
+            dataSets.reserve(numDataSets);
+            for (u32 j = 0; j < numDataSets; j++)
+            {
+                auto& attributesList = dataSets[r.String()];
+                attributesList.resize(r.Count());
+                for (DataSetFileAttributes& attributes : attributesList)
+                {
+                    attributes.mLvlName = Symbol(r.String());
+                    attributes.mIsPsx = r.Bool();
+                    attributes.mIsAo = r.Bool();
+                    attributes.mScaleFrameOffsets = r.Bool();
+                }
+            }
+        }
+
+        const u32 numAnims = r.Count();
+        animMaps.reserve(numAnims);
+        for (u32 i = 0; i < numAnims; i++)
+        {
+            AnimMapping& mapping = animMaps[r.String()];
+            mapping.mBlendingMode = r.U32();
+            mapping.mLocations.resize(r.Count());
+            for (AnimFileLocations& location : mapping.mLocations)
+            {
+                location.mDataSetName = r.String();
+                location.mFiles.resize(r.Count());
+                for (AnimFile& animFile : location.mFiles)
+                {
+                    animFile.mFile = Symbol(r.String());
+                    animFile.mId = r.U32();
+                    animFile.mAnimationIndex = r.U32();
+                }
+            }
+        }
+
+        const u32 numFmvs = r.Count();
+        fmvMaps.reserve(numFmvs);
+        for (u32 i = 0; i < numFmvs; i++)
+        {
+            FmvMapping& mapping = fmvMaps[r.String()];
+            mapping.mLocations.resize(r.Count());
+            for (FmvFileLocation& location : mapping.mLocations)
+            {
+                location.mDataSetName = r.String();
+                location.mFileName = r.String();
+                location.mStartSector = r.U32();
+                location.mEndSector = r.U32();
+            }
+        }
+
+        const u32 numPaths = r.Count();
+        pathMaps.reserve(numPaths);
+        for (u32 i = 0; i < numPaths; i++)
+        {
+            PathMapping& mapping = pathMaps[r.String()];
+            mapping.mId = r.U32();
+            mapping.mCollisionOffset = r.U32();
+            mapping.mIndexTableOffset = r.U32();
+            mapping.mObjectOffset = r.U32();
+            mapping.mNumberOfScreensX = r.U32();
+            mapping.mNumberOfScreensY = r.U32();
+            mapping.mMusicTheme = r.String();
+            mapping.mLocations.resize(r.Count());
+            for (PathLocation& location : mapping.mLocations)
+            {
+                location.mDataSetName = r.String();
+                location.mDataSetFileName = r.String();
+            }
+        }
+
+        ReadSoundResources(r, soundResources);
+
+        if (!r.AtEnd())
+        {
+            throw Oddlib::Exception("Precompiled resource db has trailing data");
+        }
+    }
+    catch (const Oddlib::Exception& e)
+    {
+        LOG_ERROR(e.what());
+        return false;
+    }
+
+    mFileLocations = std::move(fileLocations);
+    mAnimMaps = std::move(animMaps);
+    mFmvMaps = std::move(fmvMaps);
+    mPathMaps = std::move(pathMaps);
+    mSoundResources = std::move(soundResources);
+    return true;
+}
@@ -25,6 +25,61 @@ u32 Animation::AnimationSetHolder::MaxH() const
     return mAnimSetPtr->MaxH();
 }
 
+TextureHandle Animation::AnimationSetHolder::FrameTexture(AbstractRenderer& rend, const Oddlib::Animation::Frame& frame) const
+{
+    // All frames of the set share the atlas page textures, these are owned by the renderer and live
+    // for as long as the AnimationSet does
+    const std::weak_ptr<const void> owner = mAnimSetPtr;
+    const TextureHandle cached = rend.CachedTexture(owner, frame.mAtlasIndex);
+    if (cached.IsValid())
+    {
+        return cached;
+    }
+    const SDL_Surface* atlas = mAnimSetPtr->Atlas(frame.mAtlasIndex);
+    if (mAnimSetPtr->IsIndexed())
+    {
+        if (rend.IndexedTexturesSupported())
+        {
+            // Indices can't be filtered, blending two of them gives an unrelated colour
+            assert(atlas->pitch == atlas->w);
+            return rend.AddCachedTexture(owner, frame.mAtlasIndex, AbstractRenderer::eTextureFormats::eR, atlas->w, atlas->h, AbstractRenderer::eTextureFormats::eR, atlas->pixels, false);
+        }
+
+        // Can only be drawn in the colours of the set's own palette
+        std::vector<u32> rgba;
+        Oddlib::AnimationSet::ExpandIndexed(atlas, mAnimSetPtr->GetPalette(), rgba);
+        return rend.AddCachedTexture(owner, frame.mAtlasIndex, AbstractRenderer::eTextureFormats::eRGBA, atlas->w, atlas->h, AbstractRenderer::eTextureFormats::eRGBA, rgba.data(), true);
+    }
+    return rend.AddCachedTexture(owner, frame.mAtlasIndex, AbstractRenderer::eTextureFormats::eRGBA, atlas->w, atlas->h, AbstractRenderer::eTextureFormats::eRGBA, atlas->pixels, true);
+}
+
+TextureHandle Animation::AnimationSetHolder::PaletteTexture(AbstractRenderer& rend, const SP_Palette& palette) const
+{
+    if (!mAnimSetPtr->IsIndexed() || !rend.IndexedTexturesSupported())
+    {
+        return TextureHandle();
+    }
+
+    // The set's own palette is keyed after all of its atlas pages, a replacement palette owns its texture
+    std::weak_ptr<const void> owner;
+    if (palette)
+    {
+        owner = palette;
+    }
+    else
+    {
+        owner = mAnimSetPtr;
+    }
+    const u32 key = palette ? 0 : mAnimSetPtr->NumberOfAtlases();
+    const TextureHandle cached = rend.CachedTexture(owner, key);
+    if (cached.IsValid())
+    {
+        return cached;
+    }
+    const Oddlib::AnimationSet::Palette& colours = palette ? *palette : mAnimSetPtr->GetPalette();
+    return rend.AddCachedTexture(owner, key, AbstractRenderer::eTextureFormats::eRGBA, Oddlib::AnimationSet::kPaletteSize, 1, AbstractRenderer::eTextureFormats::eRGBA, colours.data(), false);
+}
+
 Animation::Animation(AnimationSetHolder anim, bool isPsx, bool scaleFrameOffsets, u32 defaultBlendingMode, const std::string& sourceDataSet) : mAnim(anim), mIsPsx(isPsx), mScaleFrameOffsets(scaleFrameOffsets), mSourceDataSet(sourceDataSet)
 {
     switch (defaultBlendingMode)
@@ -115,10 +170,13 @@ void Animation::Render(AbstractRenderer& rend, bool flipX, int layer, AbstractRe
     {
         xFrameOffset = -xFrameOffset;
     }
-    // Render sprite as textured quad
-    const TextureHandle textureId = rend.CreateTexture(AbstractRenderer::eTextureFormats::eRGBA, frame.mFrame->w, frame.mFrame->h, AbstractRenderer::eTextureFormats::eRGBA, frame.mFrame->pixels, true);
-    rend.TexturedQuad(
+    // Render sprite as textured quad, with the colours looked up in the palette texture if it is indexed
+    const TextureHandle textureId = mAnim.FrameTexture(rend, frame);
+    const TextureHandle paletteId = mAnim.PaletteTexture(rend, mPalette);
+    rend.IndexedQuadUV(
         textureId,
+        paletteId,
+        frame.mU0, frame.mV0, frame.mU1, frame.mV1,
         xpos + xFrameOffset,
         ypos + yFrameOffset,
         static_cast<f32>(frame.mFrame->w) * (flipX ? -ScaleX() : ScaleX()),
@@ -128,7 +186,6 @@ void Animation::Render(AbstractRenderer& rend, bool flipX, int layer, AbstractRe
         AbstractRenderer::eNormal,
         coordinateSystem
     );
-    rend.DestroyTexture(textureId);
 
     if (Debugging().mAnimBoundingBoxes)
     {
@@ -166,6 +223,11 @@ void Animation::Render(AbstractRenderer& rend, bool flipX, int layer, AbstractRe
     }
 }
 
+void Animation::SetPalette(AnimationSetHolder::SP_Palette palette)
+{
+    mPalette = std::move(palette);
+}
+
 void Animation::SetFrame(u32 frame)
 {
     mCounter = 0;
@@ -255,37 +317,87 @@ f32 Animation::ScaleX() const
 
 const /*static*/ f32 Animation::kPcToPsxScaleFactor = 1.73913043478f;
 
+static std::string LoadResourceMapJson(IFileSystem& fileSystem, const char* fileName)
+{
+    auto stream = fileSystem.Open(fileName);
+    assert(stream != nullptr);
+    return stream->LoadAllToString();
+}
+
 ResourceMapper::ResourceMapper(IFileSystem& fileSystem, 
     const char* dataSetContentsFile,
     const char* animationResourceFile,
     const char* soundResourceMapFile,
     const char* pathsResourceMapFile,
-    const char* fmvsResourceMapFile)
+    const char* fmvsResourceMapFile,
+    const char* precompiledFile)
 {
-    auto dataSetContentStream = fileSystem.Open(dataSetContentsFile);
-    assert(dataSetContentStream != nullptr);
-    const auto dataSetContentsJsonData = dataSetContentStream->LoadAllToString();
-    ParseDataSetContentsJson(dataSetContentsJsonData);
+    const std::vector<std::string> json =
+    {
+        LoadResourceMapJson(fileSystem, dataSetContentsFile),
+        LoadResourceMapJson(fileSystem, animationResourceFile),
+        LoadResourceMapJson(fileSystem, soundResourceMapFile),
+        LoadResourceMapJson(fileSystem, pathsResourceMapFile),
+        LoadResourceMapJson(fileSystem, fmvsResourceMapFile)
+    };
+
+    // Reading and hashing the json is cheap compared to parsing it
+    const u32 sourceHash = PrecompiledSourceHash(json);
+    if (precompiledFile)
+    {
+        std::string fileName = precompiledFile;
+        if (fileSystem.FileExists(fileName))
+        {
+            auto stream = fileSystem.Open(fileName);
+            bool loaded = false;
+            if (const Oddlib::MemoryStream* memoryStream = dynamic_cast<const Oddlib::MemoryStream*>(stream.get()))
+            {
+                // Mapped, no need to copy it
+                loaded = LoadPrecompiled(memoryStream->Data(), memoryStream->Size(), sourceHash);
+            }
+            else if (stream)
+            {
+                const std::vector<u8> data = Oddlib::IStream::ReadAll(*stream);
+                loaded = LoadPrecompiled(data.data(), data.size(), sourceHash);
+            }
 
-    auto animationResourcesStream = fileSystem.Open(animationResourceFile);
-    assert(animationResourcesStream != nullptr);
-    const auto animationJson = animationResourcesStream->LoadAllToString();
-    ParseAnimationResourcesJson(animationJson);
+            if (loaded)
+            {
+                LOG_INFO("Loaded precompiled resource maps from " << precompiledFile);
+                return;
+            }
+            LOG_INFO(precompiledFile << " is out of date, parsing the resource map json");
+        }
+    }
 
-    auto soundResourcesStream = fileSystem.Open(soundResourceMapFile);
-    assert(soundResourcesStream != nullptr);
-    const auto soundJsonData = soundResourcesStream->LoadAllToString();
-    mSoundResources.Parse(soundJsonData);
+    ParseDataSetContentsJson(json[0]);
+    ParseAnimationResourcesJson(json[1]);
+    mSoundResources.Parse(json[2]);
+    ParsePathResourceJson(json[3]);
+    ParseFmvResourceJson(json[4]);
+    SortMaps();
 
-    auto pathResourcesStream = fileSystem.Open(pathsResourceMapFile);
-    assert(pathResourcesStream != nullptr);
-    const auto pathJsonData = pathResourcesStream->LoadAllToString();
-    ParsePathResourceJson(pathJsonData);
+    if (precompiledFile)
+    {
+        try
+        {
+            std::vector<u8> data = SavePrecompiled(sourceHash);
+            fileSystem.Create(precompiledFile)->Write(data);
+        }
+        catch (const Oddlib::Exception& e)
+        {
+            // Not fatal, it'll just be parsed again next time
+            LOG_ERROR("Failed to write " << precompiledFile << ": " << e.what());
+        }
+    }
+}
 
-    auto fmvResourcesStream = fileSystem.Open(fmvsResourceMapFile);
-    assert(fmvResourcesStream != nullptr);
-    const auto fmvJsonData = fmvResourcesStream->LoadAllToString();
-    ParseFmvResourceJson(fmvJsonData);
+void ResourceMapper::SortMaps()
+{
+    // The hash maps are in json order, put them back in to name order for the debug UIs that list them
+    mAnimMaps.SortByKey();
+    mFmvMaps.SortByKey();
+    mPathMaps.SortByKey();
 }
 
 std::vector<std::tuple<const char*, const char*, bool>> ResourceMapper::DebugUi(const char* dataSetFilter, const char* nameFilter)
@@ -351,7 +463,7 @@ std::vector<std::tuple<const char*, const char*, bool>> ResourceMapper::DebugUi(
     return ret;
 }
 
-const MusicTheme* ResourceMapper::FindSoundTheme(const char* themeName)
+const MusicTheme* ResourceMapper::FindSoundTheme(const char* themeName) const
 {
     return mSoundResources.FindMusicTheme(themeName);
 }
@@ -366,20 +478,78 @@ const std::vector<SoundBankLocation>& ResourceMapper::GetSoundBankResources() co
     return mSoundResources.mSoundBanks;
 }
 
-const SoundBankLocation* ResourceMapper::FindSoundBank(const std::string& soundBank)
+const SoundBankLocation* ResourceMapper::FindSoundBank(const std::string& soundBank) const
 {
     return mSoundResources.FindSoundBank(soundBank);
 }
 
-ResourceLocator::ResourceLocator(ResourceMapper&& resourceMapper, DataPaths&& dataPaths)
-    : mResMapper(std::move(resourceMapper)), mDataPaths(std::move(dataPaths))
+ResourceLocator::ResourceLocator(ResourceMapper&& resourceMapper, DataPaths&& dataPaths, JobSystem& jobSystem, DecodedAssetCache* decodedCache)
+    : mJobSystem(jobSystem), mDecodedCache(decodedCache), mResMapper(std::move(resourceMapper)), mDataPaths(std::move(dataPaths))
 {
 
 }
 
 ResourceLocator::~ResourceLocator()
 {
+    std::unique_lock<std::mutex> lock(mRequests->mMutex);
+    mRequests->mClosed = true;
+    mRequests->mIdle.wait(lock, [this]()
+    {
+        return mRequests->mRunning == 0;
+    });
+}
+
+template<class Func>
+std::function<typename std::result_of<Func()>::type()> ResourceLocator::Guarded(Func func)
+{
+    using ResultType = typename std::result_of<Func()>::type;
+    std::shared_ptr<Requests> requests = mRequests;
+    return [requests, func]()
+    {
+        {
+            std::lock_guard<std::mutex> lock(requests->mMutex);
+            if (requests->mClosed)
+            {
+                return ResultType();
+            }
+            requests->mRunning++;
+        }
 
+        auto done = [&requests]()
+        {
+            {
+                std::lock_guard<std::mutex> lock(requests->mMutex);
+                requests->mRunning--;
+            }
+            requests->mIdle.notify_all();
+        };
+
+        try
+        {
+            ResultType result = func();
+            done();
+            return result;
+        }
+        catch (...)
+        {
+            done();
+            throw;
+        }
+    };
+}
+
+template<class Func>
+std::future<typename std::result_of<Func()>::type> ResourceLocator::Run(JobPriority priority, Func func)
+{
+    return mJobSystem.Async(priority, Guarded(func));
+}
+
+template<class Func>
+void ResourceLocator::RunInBackground(Func func)
+{
+    // Returns a dummy value as Guarded() needs something to return when closed
+    auto background = Guarded([func]() { func(); return true; });
+    mJobSystem.Then({}, JobPriority::eLow, [background]() { background(); });
 }
 
 std::vector<std::tuple<const char*, const char*, bool>> ResourceLocator::DebugUi(const char* dataSetFilter, const char* nameFilter)
@@ -389,10 +559,8 @@ std::vector<std::tuple<const char*, const char*, bool>> ResourceLocator::DebugUi
 
 std::future<std::string> ResourceLocator::LocateScript(const std::string& scriptName)
 {
-    return std::async(std::launch::async, [=]() 
+    return Run(JobPriority::eNormal, [=]() 
     {
-        std::unique_lock<std::mutex> lock(mMutex);
-
         // Look for the engine built-in script first
         std::string fileName = "{GameDir}\\data\\scripts\\" + scriptName;
         if (mDataPaths.GameFs().FileExists(fileName))
@@ -425,7 +593,7 @@ std::unique_ptr<ISound> ResourceLocator::DoLoadSoundMusic(const char* resourceNa
 
     for (const ResourceMapper::DataSetFileAttributes& bsqFileAttributes : *bsqFileLocationsInThisDataSet)
     {
-        std::shared_ptr<Oddlib::LvlArchive> lvl = OpenLvl(*fs.mFileSystem, fs.mDataSetName, bsqFileAttributes.mLvlName);
+        std::shared_ptr<Oddlib::LvlArchive> lvl = OpenLvl(*fs.mFileSystem, ResourceCache::LvlKey(fs.mDataSet, bsqFileAttributes.mLvlName));
         if (lvl)
         {
             std::string vh = sbl->mSoundBankName + ".VH";
@@ -470,9 +638,9 @@ std::unique_ptr<ISound> ResourceLocator::DoLoadSoundMusic(const char* resourceNa
     return nullptr;
 }
 
-std::future<std::unique_ptr<Vab>> ResourceLocator::LocateVab(const std::string& dataSetName, const std::string& baseVabName)
+std::future<std::unique_ptr<Vab>> ResourceLocator::LocateVab(const std::string& dataSetName, const std::string& baseVabName, JobPriority priority)
 {
-    return std::async(std::launch::async, [=]() 
+    return Run(priority, [=]() 
     {
         for (const DataPaths::FileSystemInfo& fs : mDataPaths.ActiveDataPaths())
         {
@@ -487,7 +655,7 @@ std::future<std::unique_ptr<Vab>> ResourceLocator::LocateVab(const std::string&
 
                 for (const ResourceMapper::DataSetFileAttributes& vhFileAttributes : *bsqFileLocationsInThisDataSet)
                 {
-                    std::shared_ptr<Oddlib::LvlArchive> lvl = OpenLvl(*fs.mFileSystem, fs.mDataSetName, vhFileAttributes.mLvlName);
+                    std::shared_ptr<Oddlib::LvlArchive> lvl = OpenLvl(*fs.mFileSystem, ResourceCache::LvlKey(fs.mDataSet, vhFileAttributes.mLvlName));
                     if (lvl)
                     {
                         const std::string vb = baseVabName + ".VB";
@@ -543,7 +711,7 @@ std::unique_ptr<ISound> ResourceLocator::DoLoadSoundEffect(const char* resourceN
 
     for (const ResourceMapper::DataSetFileAttributes& bsqFileAttributes : *bsqFileLocationsInThisDataSet)
     {
-        std::shared_ptr<Oddlib::LvlArchive> lvl = OpenLvl(*fs.mFileSystem, fs.mDataSetName, bsqFileAttributes.mLvlName);
+        std::shared_ptr<Oddlib::LvlArchive> lvl = OpenLvl(*fs.mFileSystem, ResourceCache::LvlKey(fs.mDataSet, bsqFileAttributes.mLvlName));
         if (lvl)
         {
             std::string vh = sbl->mSoundBankName + ".VH";
@@ -586,12 +754,10 @@ std::unique_ptr<ISound> ResourceLocator::DoLoadSoundEffect(const char* resourceN
     return nullptr;
 }
 
-std::future<std::unique_ptr<ISound>> ResourceLocator::LocateSound(const std::string& resourceName, const std::string&explicitSoundBankName /*= ""*/, bool useMusicRec /*= true*/, bool useSfxRec /*= true*/)
+std::future<std::unique_ptr<ISound>> ResourceLocator::LocateSound(const std::string& resourceName, const std::string&explicitSoundBankName /*= ""*/, bool useMusicRec /*= true*/, bool useSfxRec /*= true*/, JobPriority priority /*= JobPriority::eNormal*/)
 {
-    return std::async(std::launch::async, [=]()
+    return Run(priority, [=]()
     {
-        std::unique_lock<std::mutex> lock(mMutex);
-
         const SoundResource* sr = mResMapper.FindSound(resourceName.c_str());
         for (const DataPaths::FileSystemInfo& fs : mDataPaths.ActiveDataPaths())
         {
@@ -645,11 +811,17 @@ std::future<std::unique_ptr<ISound>> ResourceLocator::LocateSound(const std::str
     });
 }
 
-up_future_UP_Path ResourceLocator::LocatePath(const std::string& resourceName)
+up_future_SP_Path ResourceLocator::LocatePath(const std::string& resourceName, JobPriority priority)
 {
-    return std::make_unique<future_UP_Path>(std::async(std::launch::async, [=]() -> Oddlib::UP_Path
+    return std::make_unique<future_SP_Path>(Run(priority, [=]() -> Oddlib::SP_Path
     {
-        std::unique_lock<std::mutex> lock(mMutex);
+        const ResidencyManager::Key key = ResidencyManager::Key::Path(resourceName);
+        Oddlib::SP_Path resident = mResidency.Find<Oddlib::Path>(key);
+        if (resident)
+        {
+            return resident;
+        }
+
         const ResourceMapper::PathMapping* mapping = mResMapper.FindPath(resourceName.c_str());
         if (mapping)
         {
@@ -669,7 +841,7 @@ up_future_UP_Path ResourceLocator::LocatePath(const std::string& resourceName)
                         {
                             for (const ResourceMapper::DataSetFileAttributes& attributes : *locationsInThisDataSet)
                             {
-                                std::shared_ptr<Oddlib::LvlArchive> lvl = OpenLvl(*fs.mFileSystem, fs.mDataSetName, attributes.mLvlName);
+                                std::shared_ptr<Oddlib::LvlArchive> lvl = OpenLvl(*fs.mFileSystem, ResourceCache::LvlKey(fs.mDataSet, attributes.mLvlName));
                                 if (lvl)
                                 {
                                     auto lvlFile = lvl->FileByName(pathLocation->mDataSetFileName);
@@ -677,13 +849,15 @@ up_future_UP_Path ResourceLocator::LocatePath(const std::string& resourceName)
                                     {
                                         auto chunk = lvlFile->ChunkById(mapping->mId);
                                         auto stream = chunk->Stream();
-                                        return std::make_unique<Oddlib::Path>(mapping->mMusicTheme, *stream,
+                                        auto path = std::make_shared<Oddlib::Path>(mapping->mMusicTheme, *stream,
                                             mapping->mCollisionOffset,
                                             mapping->mIndexTableOffset,
                                             mapping->mObjectOffset,
                                             mapping->mNumberOfScreensX,
                                             mapping->mNumberOfScreensY,
                                             attributes.mIsAo);
+                                        mResidency.Add(key, path, path->SizeInBytes());
+                                        return path;
                                     }
                                 }
 
@@ -697,13 +871,37 @@ up_future_UP_Path ResourceLocator::LocatePath(const std::string& resourceName)
     }));
 }
 
-std::future<std::unique_ptr<Oddlib::IBits>> ResourceLocator::LocateCamera(const std::string& resourceName)
+static size_t SurfaceSizeInBytes(const SDL_Surface* surface)
+{
+    return surface ? static_cast<size_t>(surface->h) * static_cast<size_t>(surface->pitch) : 0;
+}
+
+static size_t CameraSizeInBytes(const Oddlib::IBits& cam)
+{
+    size_t size = SurfaceSizeInBytes(cam.GetSurface());
+    if (cam.GetFg1())
+    {
+        size += SurfaceSizeInBytes(cam.GetFg1()->GetSurface());
+    }
+    return size;
+}
+
+std::future<std::shared_ptr<Oddlib::IBits>> ResourceLocator::LocateCamera(const std::string& resourceName, JobPriority priority)
 {
     LOG_INFO("Requesting camera " << resourceName);
-    return std::async(std::launch::async, [=]() 
+    return Run(priority, [=]() -> std::shared_ptr<Oddlib::IBits>
     {
-        std::unique_lock<std::mutex> lock(mMutex);
-        return DoLocateCamera(resourceName.c_str(), false);
+        const ResidencyManager::Key key = ResidencyManager::Key::Camera(resourceName);
+        std::shared_ptr<Oddlib::IBits> cam = mResidency.Find<Oddlib::IBits>(key);
+        if (!cam)
+        {
+            cam = DoLocateCamera(resourceName.c_str(), false);
+            if (cam)
+            {
+                mResidency.Add(key, cam, CameraSizeInBytes(*cam));
+            }
+        }
+        return cam;
     });
 }
 
@@ -781,7 +979,7 @@ static void ApplyDelta(SDL_Surface* deltaSurface, SDL_Surface* originalCameraSur
     }
 }
 
-std::unique_ptr<Oddlib::IBits> ResourceLocator::DoLocateCamera(const char* resourceName, bool ignoreMods)
+std::shared_ptr<Oddlib::IBits> ResourceLocator::DoLocateCamera(const char* resourceName, bool ignoreMods)
 {
     std::string deltaName;
     std::string modName;
@@ -839,7 +1037,7 @@ std::unique_ptr<Oddlib::IBits> ResourceLocator::DoLocateCamera(const char* resou
             {
                 for (const ResourceMapper::DataSetFileAttributes& attributes : *locationsInThisDataSet)
                 {
-                    std::shared_ptr<Oddlib::LvlArchive> lvl = OpenLvl(*fs.mFileSystem, fs.mDataSetName, attributes.mLvlName);
+                    std::shared_ptr<Oddlib::LvlArchive> lvl = OpenLvl(*fs.mFileSystem, ResourceCache::LvlKey(fs.mDataSet, attributes.mLvlName));
                     if (lvl)
                     {
                         auto lvlFile = lvl->FileByName(resourceName);
@@ -855,8 +1053,28 @@ std::unique_ptr<Oddlib::IBits> ResourceLocator::DoLocateCamera(const char* resou
                                 fg1Stream = fg1Chunk->Stream();
                             }
 
+                            const DecodedAssetCache::Key cacheKey = { fs.mDataSetName, attributes.mLvlName.Str(), resourceName, bitsChunk->Id(), bitsChunk->Size() + (fg1Chunk ? fg1Chunk->Size() : 0) };
+                            if (mDecodedCache)
+                            {
+                                std::unique_ptr<Oddlib::IBits> cam = mDecodedCache->LoadCamera(cacheKey);
+                                if (cam)
+                                {
+                                    LOG_INFO("Loaded original camera from the decoded asset cache for " << fs.mDataSetName);
+                                    return cam;
+                                }
+                            }
+
                             LOG_INFO("Loaded original camera from " << fs.mDataSetName << " has foreground layer: " << (fg1Stream ? "true" : "false"));
-                            return Oddlib::MakeBits(*bitsStream, fg1Stream.get());
+                            std::shared_ptr<Oddlib::IBits> cam = Oddlib::MakeBits(*bitsStream, fg1Stream.get());
+                            if (mDecodedCache)
+                            {
+                                // Compressing it would otherwise delay the camera
+                                RunInBackground([this, cacheKey, cam]()
+                                {
+                                    mDecodedCache->SaveCamera(cacheKey, *cam);
+                                });
+                            }
+                            return cam;
                         }
                     }
                 }
@@ -868,10 +1086,9 @@ std::unique_ptr<Oddlib::IBits> ResourceLocator::DoLocateCamera(const char* resou
 
 std::future<std::unique_ptr<IMovie>> ResourceLocator::LocateFmv(IAudioController& audioController, const std::string& resourceName, const ResourceMapper::FmvFileLocation* location)
 {
-    return std::async(std::launch::async, [this, &audioController, resourceName, location ]() 
+    return Run(JobPriority::eHigh, [this, &audioController, resourceName, location ]() 
     {
         // Try from explicitly passed in location
-        std::unique_lock<std::mutex> lock(mMutex);
         if (location)
         {
             for (const DataPaths::FileSystemInfo& fs : mDataPaths.ActiveDataPaths())
@@ -953,18 +1170,23 @@ std::unique_ptr<IMovie> ResourceLocator::DoLocateFmvFromFileLocation(const Resou
                     subTitles = std::make_unique<SubTitleParser>(std::move(subsStream));
                 }
             }
-            return IMovie::Factory(resourceName, audioController, std::move(stream), std::move(subTitles), location.mStartSector, location.mEndSector);
+            // Frames are decoded on the movie's own thread, each one is wanted as soon as it can be ready.
+            // The JobSystem outlives every movie.
+            JobSystem& jobSystem = mJobSystem;
+            return IMovie::Factory(resourceName, audioController, std::move(stream), std::move(subTitles), location.mStartSector, location.mEndSector,
+                [&jobSystem](u32 count, const std::function<void(u32)>& func)
+            {
+                jobSystem.ParallelFor(JobPriority::eHigh, count, 1, func);
+            });
         }
     }
     return nullptr;
 }
 
-std::future<std::unique_ptr<Animation>> ResourceLocator::LocateAnimation(const std::string& resourceName)
+std::future<std::unique_ptr<Animation>> ResourceLocator::LocateAnimation(const std::string& resourceName, JobPriority priority)
 {
-    return std::async(std::launch::async, [=]() 
+    return Run(priority, [=]() 
     {
-        std::unique_lock<std::mutex> lock(mMutex);
-
         const ResourceMapper::AnimMapping* animMapping = mResMapper.FindAnimation(resourceName.c_str());
         if (!animMapping)
         {
@@ -998,9 +1220,8 @@ std::future<std::unique_ptr<Animation>> ResourceLocator::LocateAnimation(const s
 
 std::future<std::unique_ptr<Animation>> ResourceLocator::LocateAnimation(const std::string& resourceName, const std::string& dataSetName)
 {
-    return std::async(std::launch::async, [=]() 
+    return Run(JobPriority::eNormal, [=]() 
     {
-        std::unique_lock<std::mutex> lock(mMutex);
         for (const DataPaths::FileSystemInfo& fs : mDataPaths.ActiveDataPaths())
         {
             if (fs.mDataSetName == dataSetName)
@@ -1022,21 +1243,19 @@ std::future<std::unique_ptr<Animation>> ResourceLocator::LocateAnimation(const s
     });
 }
 
-std::shared_ptr<Oddlib::LvlArchive> ResourceLocator::OpenLvl(IFileSystem& fs, const std::string& dataSetName, const std::string& lvlName)
+std::shared_ptr<Oddlib::LvlArchive> ResourceLocator::OpenLvl(IFileSystem& fs, const ResourceCache::LvlKey& key)
 {
-    auto lvlPtr = mCache.GetLvl(dataSetName, lvlName);
-    if (!lvlPtr)
+    // Only one thread opens/parses a given LVL, others asking for it at the same time wait for it
+    return mCache.GetOrAddLvl(key, [&]()
     {
-        // Try to open new lvl since it wasn't in the cache
-        auto lvlStream = fs.Open(lvlName);
+        std::unique_ptr<Oddlib::LvlArchive> lvl;
+        auto lvlStream = fs.Open(key.mLvl.Str());
         if (lvlStream)
         {
-            // Cache this lvl
-            auto lvl = std::make_unique<Oddlib::LvlArchive>(std::move(lvlStream));
-            lvlPtr = mCache.AddLvl(std::move(lvl), dataSetName, lvlName);
+            lvl = std::make_unique<Oddlib::LvlArchive>(std::move(lvlStream));
         }
-    }
-    return lvlPtr;
+        return lvl;
+    });
 }
 
 const std::vector<SoundResource>& ResourceLocator::GetSoundResources() const
@@ -1051,9 +1270,8 @@ const std::vector<SoundBankLocation>& ResourceLocator::GetSoundBankResources() c
 
 std::future<const MusicTheme*> ResourceLocator::LocateSoundTheme(const std::string& themeName)
 {
-    return std::async(std::launch::async, [=]() 
+    return Run(JobPriority::eNormal, [=]() 
     {
-        std::unique_lock<std::mutex> lock(mMutex);
         return mResMapper.FindSoundTheme(themeName.c_str());
     });
 }
@@ -1076,14 +1294,30 @@ std::unique_ptr<Animation> ResourceLocator::DoLocateAnimation(const DataPaths::F
                     // Loop through each LVL and see if animFile exists there
                     for (const ResourceMapper::DataSetFileAttributes& dataSetFileAttributes : *fileLocations)
                     {
-                        auto lvlPtr = OpenLvl(*fs.mFileSystem, fs.mDataSetName, dataSetFileAttributes.mLvlName);
-                        if (lvlPtr)
+                        // Going back to something that was recently shown doesn't need the LVL re-opening. A decoded set
+                        // doesn't read from its LVL, so only the set itself is kept resident.
+                        const ResidencyManager::Key key = ResidencyManager::Key::AnimationSet(fs.mDataSet, dataSetFileAttributes.mLvlName, animFile.mFile, animFile.mId);
+                        std::shared_ptr<Oddlib::LvlArchive> lvlPtr;
+                        std::shared_ptr<Oddlib::AnimationSet> animSetPtr = mResidency.Find<Oddlib::AnimationSet>(key);
+                        if (!animSetPtr)
                         {
-                            auto animSetPtr = mCache.GetAnimSet(fs.mDataSetName, dataSetFileAttributes.mLvlName, animFile.mFile, animFile.mId);
-                            if (!animSetPtr)
+                            const ResourceCache::LvlKey lvlKey(fs.mDataSet, dataSetFileAttributes.mLvlName);
+                            lvlPtr = OpenLvl(*fs.mFileSystem, lvlKey);
+                            if (!lvlPtr)
                             {
+                                continue;
+                            }
+
+                            // Only set when this request decoded the set and it is to be saved once shared
+                            bool saveToDecodedCache = false;
+                            DecodedAssetCache::Key decodedCacheKey = {};
+
+                            animSetPtr = mCache.GetOrAddAnimSet(ResourceCache::AnimSetKey(lvlKey, animFile.mFile, animFile.mId), [&]()
+                            {
+                                std::unique_ptr<Oddlib::AnimationSet> animSet;
+
                                 // Open the file within the archive
-                                auto lvlFile = lvlPtr->FileByName(animFile.mFile);
+                                auto lvlFile = lvlPtr->FileByName(animFile.mFile.Str());
                                 if (lvlFile)
                                 {
                                     // Get the chunk within the file that lives in the lvl
@@ -1100,22 +1334,51 @@ std::unique_ptr<Animation> ResourceLocator::DoLocateAnimation(const DataPaths::F
                                             << " is psx " << dataSetFileAttributes.mIsPsx
                                             << " scale frame offsets " << dataSetFileAttributes.mScaleFrameOffsets);
 
-                                        auto stream = chunk->Stream();
-                                        Oddlib::AnimSerializer as(*stream, dataSetFileAttributes.mIsPsx);
-                                        animSetPtr = mCache.AddAnimSet(std::make_unique<Oddlib::AnimationSet>(as), fs.mDataSetName, dataSetFileAttributes.mLvlName, animFile.mFile, animFile.mId);
+                                        const DecodedAssetCache::Key cacheKey = { fs.mDataSetName, dataSetFileAttributes.mLvlName.Str(), animFile.mFile.Str(), animFile.mId, chunk->Size() };
+                                        if (mDecodedCache)
+                                        {
+                                            animSet = mDecodedCache->LoadAnimationSet(cacheKey, mIndexedAnimations);
+                                        }
+
+                                        if (!animSet)
+                                        {
+                                            auto stream = chunk->Stream();
+                                            Oddlib::AnimSerializer as(*stream, dataSetFileAttributes.mIsPsx);
+                                            // This job waits on the frames, so they're decoded at high priority
+                                            animSet = std::make_unique<Oddlib::AnimationSet>(as, [this](u32 count, const std::function<void(u32)>& func)
+                                            {
+                                                mJobSystem.ParallelFor(JobPriority::eHigh, count, 1, func);
+                                            }, mIndexedAnimations);
+                                            saveToDecodedCache = mDecodedCache != nullptr;
+                                            decodedCacheKey = cacheKey;
+                                        }
                                     }
                                 }
-                            }
+                                return animSet;
+                            });
 
-                            // Construct the animation from the chunk bytes
-                            return std::make_unique<Animation>(
-                                Animation::AnimationSetHolder(lvlPtr, animSetPtr, animFile.mAnimationIndex),
-                                dataSetFileAttributes.mIsPsx,
-                                dataSetFileAttributes.mScaleFrameOffsets,
-                                animMapping.mBlendingMode,
-                                fs.mDataSetName);
+                            if (animSetPtr)
+                            {
+                                mResidency.Add(key, animSetPtr, animSetPtr->SizeInBytes());
 
+                                if (saveToDecodedCache)
+                                {
+                                    // Compressing it would otherwise delay the animation
+                                    RunInBackground([this, decodedCacheKey, animSetPtr]()
+                                    {
+                                        mDecodedCache->SaveAnimationSet(decodedCacheKey, *animSetPtr);
+                                    });
+                                }
+                            }
                         }
+
+                        // Construct the animation from the chunk bytes
+                        return std::make_unique<Animation>(
+                            Animation::AnimationSetHolder(lvlPtr, animSetPtr, animFile.mAnimationIndex),
+                            dataSetFileAttributes.mIsPsx,
+                            dataSetFileAttributes.mScaleFrameOffsets,
+                            animMapping.mBlendingMode,
+                            fs.mDataSetName);
                     }
                 }
             }
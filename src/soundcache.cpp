@@ -212,12 +212,12 @@ void SoundCache::AsyncQueueWorkerFunction(UP_BaseSoundCacheJob item, const Cance
 
 void SoundCache::CacheSound(ResourceLocator& locator, const std::string& name)
 {
-    mJobTracker.StartJob(std::make_unique<SoundAddToCacheJob>(*this, locator, name));
+    mJobTracker.StartJob(std::make_unique<SoundAddToCacheJob>(*this, locator, name), JobPriority::eLow);
 }
 
 void SoundCache::CacheAllSoundEffects(ResourceLocator& locator)
 {
-    mJobTracker.StartJob(std::make_unique<CacheAllSoundEffectsJob>(*this, locator));
+    mJobTracker.StartJob(std::make_unique<CacheAllSoundEffectsJob>(*this, locator), JobPriority::eLow);
 }
 
 void SoundAddToCacheJob::OnExecute(const CancelFlag& quitFlag)
@@ -0,0 +1,72 @@
+#include "symbol.hpp"
+#include "oddlib/hashindex.hpp"
+#include "stdthread.h"
+#include <deque>
+#include <cstring>
+
+namespace
+{
+    template<class Entry>
+    struct SymbolPool
+    {
+        std::mutex mMutex;
+
+        // deque so that entries never move once handed out
+        std::deque<Entry> mEntries;
+        Oddlib::HashIndex mIndex;
+    };
+}
+
+Symbol::Symbol()
+    : mEntry(Intern("", 0))
+{
+
+}
+
+Symbol::Symbol(const char* str)
+    : mEntry(Intern(str, strlen(str)))
+{
+
+}
+
+Symbol::Symbol(const std::string& str)
+    : mEntry(Intern(str.data(), str.size()))
+{
+
+}
+
+/*static*/ const Symbol::Entry* Symbol::Intern(const char* str, size_t length)
+{
+    // Function local so Symbols can be made during static init
+    static SymbolPool<Entry> pool;
+
+    const u32 hash = Oddlib::HashBytes(str, length);
+    auto isSame = [&](u32 i)
+    {
+        const std::string& existing = pool.mEntries[i].mStr;
+        return existing.size() == length && memcmp(existing.data(), str, length) == 0;
+    };
+
+    std::lock_guard<std::mutex> lock(pool.mMutex);
+    const u32 index = pool.mIndex.Find(hash, isSame);
+    if (index != Oddlib::HashIndex::kNotFound)
+    {
+        return &pool.mEntries[index];
+    }
+
+    pool.mEntries.push_back(Entry{ std::string(str, length), hash });
+    const u32 count = static_cast<u32>(pool.mEntries.size());
+    if (count * 2 > pool.mIndex.Capacity())
+    {
+        pool.mIndex.Reset(count * 2);
+        for (u32 i = 0; i < count; i++)
+        {
+            pool.mIndex.Insert(pool.mEntries[i].mHash, i, [](u32) { return false; });
+        }
+    }
+    else
+    {
+        pool.mIndex.Insert(hash, count - 1, [](u32) { return false; });
+    }
+    return &pool.mEntries.back();
+}
@@ -8,6 +8,7 @@
 #include "sound.hpp"
 #include "editormode.hpp"
 #include "gamemode.hpp"
+#include <algorithm>
 
 void WorldState::RenderGrid(AbstractRenderer& rend) const
 {
@@ -28,6 +29,7 @@ void WorldState::RenderGrid(AbstractRenderer& rend) const
 }
 
 WorldState::WorldState(IAudioController& audioController, ResourceLocator& locator)
+    : mResidency(locator.Residency())
 {
     mPlayFmvState = std::make_unique<PlayFmvState>(audioController, locator);
 }
@@ -119,6 +121,108 @@ void WorldState::SetCurrentCamera(const char* cameraName)
     }
 }
 
+static s32 Sign(s32 value)
+{
+    return (value > 0) - (value < 0);
+}
+
+void WorldState::SetActiveScreen(s32 x, s32 y)
+{
+    if (x == mActiveX && y == mActiveY)
+    {
+        return;
+    }
+
+    auto screenAt = [&](s32 screenX, s32 screenY) -> GridScreen*
+    {
+        if (screenX < 0 || screenY < 0 ||
+            screenX >= static_cast<s32>(mScreens.size()) ||
+            screenY >= static_cast<s32>(mScreens[screenX].size()))
+        {
+            return nullptr;
+        }
+        GridScreen* screen = mScreens[screenX][screenY].get();
+        return (screen && screen->hasTexture()) ? screen : nullptr;
+    };
+
+    auto prefetch = [&](GridScreen* screen, JobPriority priority)
+    {
+        // A promoted screen is asked for again but is already in the list
+        if (screen->Prefetch(priority) && std::find(std::begin(mPrefetchingScreens), std::end(mPrefetchingScreens), screen) == std::end(mPrefetchingScreens))
+        {
+            mPrefetchingScreens.push_back(screen);
+        }
+    };
+
+    std::vector<ResidencyManager::Key> pins;
+    for (s32 screenX = x - 1; screenX <= x + 1; screenX++)
+    {
+        for (s32 screenY = y - 1; screenY <= y + 1; screenY++)
+        {
+            GridScreen* screen = screenAt(screenX, screenY);
+            if (screen)
+            {
+                pins.push_back(ResidencyManager::Key::Camera(screen->FileName()));
+                prefetch(screen, (screenX == x && screenY == y) ? JobPriority::eHigh : JobPriority::eNormal);
+            }
+        }
+    }
+
+    // The neighbours are already on their way, so look one further ahead in the direction of travel
+    if (mActiveX >= 0 && mActiveY >= 0)
+    {
+        GridScreen* ahead = screenAt(x + (Sign(x - mActiveX) * 2), y + (Sign(y - mActiveY) * 2));
+        if (ahead)
+        {
+            prefetch(ahead, JobPriority::eLow);
+        }
+    }
+
+    // Pin the new set before unpinning the old one so screens in both are never up for eviction
+    for (const ResidencyManager::Key& key : pins)
+    {
+        mResidency.Pin(key);
+    }
+    for (const ResidencyManager::Key& key : mPinnedScreens)
+    {
+        mResidency.Unpin(key);
+    }
+
+    mPinnedScreens = std::move(pins);
+    mActiveX = x;
+    mActiveY = y;
+}
+
+void WorldState::ClearActiveScreen()
+{
+    for (const ResidencyManager::Key& key : mPinnedScreens)
+    {
+        mResidency.Unpin(key);
+    }
+    mPinnedScreens.clear();
+    mPrefetchingScreens.clear();
+    mActiveX = -1;
+    mActiveY = -1;
+}
+
+void WorldState::UploadPrefetchedScreens(AbstractRenderer& rend)
+{
+    // The renderer spreads the copies over as many frames as it takes to stay in its upload budget
+    for (auto it = std::begin(mPrefetchingScreens); it != std::end(mPrefetchingScreens);)
+    {
+        GridScreen* screen = *it;
+        if (!screen->IsPrefetching() || screen->UploadIfReady(rend))
+        {
+            // Either done now or was needed right away and loaded by Render() instead
+            it = mPrefetchingScreens.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
 void WorldState::SetGameCameraToCameraAt(u32 x, u32 y)
 {
     const glm::vec2 camPos = glm::vec2(
@@ -166,6 +270,20 @@ World::World(
         RenderDebugFmvSelection();
     });
 
+    Debugging().AddSection([&]()
+    {
+        if (ImGui::CollapsingHeader("Residency"))
+        {
+            const ResidencyManager::Stats stats = mLocator.Residency().GetStats();
+            ImGui::Text("Hit rate: %.1f%% (%llu hits, %llu misses)", stats.HitRate() * 100.0f,
+                static_cast<unsigned long long>(stats.mHits), static_cast<unsigned long long>(stats.mMisses));
+            ImGui::Text("Resident: %u assets, %.2f of %.2f MB", stats.mEntries,
+                stats.mBytesResident / (1024.0 * 1024.0), stats.mBudget / (1024.0 * 1024.0));
+            ImGui::Text("Pinned: %.2f MB", stats.mBytesPinned / (1024.0 * 1024.0));
+            ImGui::Text("Evictions: %llu", static_cast<unsigned long long>(stats.mEvictions));
+        }
+    });
+
     // Debugging - reload path and load next path
     static std::string currentPathName;
     static s32 nextPathIndex;
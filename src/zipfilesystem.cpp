@@ -173,6 +173,8 @@ bool ZipFileSystem::LocateEndOfCentralDirectoryRecord()
 
 std::unique_ptr<Oddlib::IStream> ZipFileSystem::Open(const std::string& fileName)
 {
+    std::lock_guard<std::mutex> lock(mMutex);
+
     size_t idx = 0;
     bool found = false;
     for (size_t i = 0; i < mRecords.size(); i++)
@@ -270,20 +272,42 @@ std::unique_ptr<Oddlib::IStream> ZipFileSystem::Open(const std::string& fileName
         return nullptr;
     }
 
-    // TODO: Wrap a stream around the compressed data, loading the whole thing is memory heavy and slow
     auto compressedSize = r.mLocalFileHeader.mDataDescriptor.mCompressedSize;
     if (compressedSize > 0)
     {
-        std::vector<u8> buffer(compressedSize);
-        std::vector<u8> out(r.mLocalFileHeader.mDataDescriptor.mUnCompressedSize);
-        size_t actualOut = 0;
+        // When the zip is mapped/in memory stored entries are just a view and deflated entries
+        // decompress straight out of it, otherwise the compressed data has to be loaded first
+        Oddlib::MemoryStream* memoryStream = dynamic_cast<Oddlib::MemoryStream*>(mStream.get());
+        if (memoryStream && r.mLocalFileHeader.mCompressionMethod == eNone)
+        {
+            return std::unique_ptr<Oddlib::IStream>(memoryStream->Clone(static_cast<u32>(memoryStream->Pos()), compressedSize));
+        }
 
-        mStream->Read(buffer);
+        std::vector<u8> buffer;
+        const u8* compressedData = nullptr;
+        if (memoryStream)
+        {
+            if (compressedSize > memoryStream->Size() - memoryStream->Pos())
+            {
+                LOG_ERROR("Compressed data for " << fileName << " is out of bounds");
+                return nullptr;
+            }
+            compressedData = memoryStream->Data() + memoryStream->Pos();
+        }
+        else
+        {
+            buffer.resize(compressedSize);
+            mStream->Read(buffer);
+            compressedData = buffer.data();
+        }
 
         if (r.mLocalFileHeader.mCompressionMethod == eDeflate)
         {
+            std::vector<u8> out(r.mLocalFileHeader.mDataDescriptor.mUnCompressedSize);
+            size_t actualOut = 0;
+
             deflate_decompressor* decompressor = deflate_alloc_decompressor();
-            decompress_result result = deflate_decompress(decompressor, buffer.data(), buffer.size(), out.data(), out.size(), &actualOut);
+            decompress_result result = deflate_decompress(decompressor, compressedData, compressedSize, out.data(), out.size(), &actualOut);
             switch (result)
             {
             case DECOMPRESS_BAD_DATA:
@@ -296,13 +320,10 @@ std::unique_ptr<Oddlib::IStream> ZipFileSystem::Open(const std::string& fileName
                 break;
             }
             deflate_free_decompressor(decompressor);
-        }
-        else
-        {
-            out = buffer;
+            return std::make_unique<Oddlib::MemoryStream>(std::move(out));
         }
 
-        return std::make_unique<Oddlib::MemoryStream>(std::move(out));
+        return std::make_unique<Oddlib::MemoryStream>(std::move(buffer));
     }
     return std::make_unique<Oddlib::MemoryStream>(std::vector<u8>());
 }
@@ -0,0 +1,152 @@
+#include <gmock/gmock.h>
+#include "abstractrenderer.hpp"
+#include <cstdint>
+
+struct TestRowUpload
+{
+    void* mTexture;
+    u32 mY;
+    u32 mRows;
+    const void* mPixels;
+
+    bool operator == (const TestRowUpload& rhs) const
+    {
+        return mTexture == rhs.mTexture && mY == rhs.mY && mRows == rhs.mRows && mPixels == rhs.mPixels;
+    }
+};
+
+static std::ostream& operator << (std::ostream& os, const TestRowUpload& upload)
+{
+    return os << upload.mTexture << " y " << upload.mY << " rows " << upload.mRows << " pixels " << upload.mPixels;
+}
+
+// Draws nothing, only records the rows that are copied in to textures
+class TestRenderer : public AbstractRenderer
+{
+public:
+    std::vector<TestRowUpload> mRowUploads;
+
+    std::vector<TestRowUpload> Frame()
+    {
+        mRowUploads.clear();
+        EndFrame();
+        return mRowUploads;
+    }
+
+    virtual void ClearFrameBufferImpl(f32, f32, f32, f32) override { }
+    virtual void RenderCommandsImpl() override { }
+    virtual void ImGuiRender() override { }
+    virtual const char* Name() const override { return "Test"; }
+    virtual void SetVSync(bool) override { }
+
+    virtual TextureHandle CreateTexture(eTextureFormats, u32, u32, eTextureFormats, const void*, bool) override
+    {
+        TextureHandle handle;
+        handle.mData = reinterpret_cast<void*>(static_cast<uintptr_t>(++mNextTexture));
+        return handle;
+    }
+
+    virtual void UpdateTexture(TextureHandle, u32, u32, eTextureFormats, const void*) override { }
+
+    virtual void UpdateTextureRows(TextureHandle handle, u32 y, u32, u32 rows, eTextureFormats, const void* pixels) override
+    {
+        mRowUploads.push_back(TestRowUpload{ handle.mData, y, rows, pixels });
+    }
+
+protected:
+    virtual void OnSetRenderState(CmdState&) override { }
+    virtual void DestroyTextures() override { }
+
+private:
+    u32 mNextTexture = 0;
+};
+
+TEST(AbstractRenderer, StagedUploadsStayInBudget)
+{
+    TestRenderer rend;
+
+    // 3 rows of the first texture per frame
+    const u32 kRgbaRow = 16 * 4;
+    const u32 kRgbRow = 8 * 3;
+    rend.SetStagedUploadBudget(kRgbaRow * 3);
+
+    auto rgbaPixels = std::make_shared<std::vector<u8>>(kRgbaRow * 8);
+    auto rgbPixels = std::make_shared<std::vector<u8>>(kRgbRow * 4);
+    std::weak_ptr<std::vector<u8>> rgbaOwner = rgbaPixels;
+    const u8* rgba = rgbaPixels->data();
+    const u8* rgb = rgbPixels->data();
+
+    const TextureHandle first = rend.CreateTextureStaged(AbstractRenderer::eTextureFormats::eRGBA, 16, 8, AbstractRenderer::eTextureFormats::eRGBA, rgba, std::move(rgbaPixels), false);
+    const TextureHandle second = rend.CreateTextureStaged(AbstractRenderer::eTextureFormats::eRGB, 8, 4, AbstractRenderer::eTextureFormats::eRGB, rgb, std::move(rgbPixels), false);
+    ASSERT_TRUE(first.IsValid());
+    ASSERT_TRUE(second.IsValid());
+    ASSERT_FALSE(rend.IsStagedUploadDone(first));
+    ASSERT_FALSE(rend.IsStagedUploadDone(second));
+
+    // Oldest first, each frame carries on from the row the last one stopped at
+    ASSERT_THAT(rend.Frame(), testing::ElementsAre(TestRowUpload{ first.mData, 0, 3, rgba }));
+    ASSERT_THAT(rend.Frame(), testing::ElementsAre(TestRowUpload{ first.mData, 3, 3, rgba + (3 * kRgbaRow) }));
+    ASSERT_FALSE(rend.IsStagedUploadDone(first));
+
+    // 2 rows finish the first texture, what is left of the budget covers 2 rows of the second but
+    // isn't rounded up to a third
+    ASSERT_THAT(rend.Frame(), testing::ElementsAre(
+        TestRowUpload{ first.mData, 6, 2, rgba + (6 * kRgbaRow) },
+        TestRowUpload{ second.mData, 0, 2, rgb }));
+    ASSERT_TRUE(rend.IsStagedUploadDone(first));
+    ASSERT_TRUE(rgbaOwner.expired());
+    ASSERT_FALSE(rend.IsStagedUploadDone(second));
+
+    ASSERT_THAT(rend.Frame(), testing::ElementsAre(TestRowUpload{ second.mData, 2, 2, rgb + (2 * kRgbRow) }));
+    ASSERT_TRUE(rend.IsStagedUploadDone(second));
+    ASSERT_TRUE(rend.Frame().empty());
+}
+
+TEST(AbstractRenderer, StagedUploadBudgetSmallerThanARow)
+{
+    TestRenderer rend;
+    rend.SetStagedUploadBudget(16);
+
+    auto pixels = std::make_shared<std::vector<u8>>(32 * 4 * 2);
+    const u8* data = pixels->data();
+    const TextureHandle texture = rend.CreateTextureStaged(AbstractRenderer::eTextureFormats::eRGBA, 32, 2, AbstractRenderer::eTextureFormats::eRGBA, data, std::move(pixels), false);
+
+    // Still a row each frame
+    ASSERT_THAT(rend.Frame(), testing::ElementsAre(TestRowUpload{ texture.mData, 0, 1, data }));
+    ASSERT_THAT(rend.Frame(), testing::ElementsAre(TestRowUpload{ texture.mData, 1, 1, data + (32 * 4) }));
+    ASSERT_TRUE(rend.IsStagedUploadDone(texture));
+}
+
+TEST(AbstractRenderer, FinishAndDestroyStagedUploads)
+{
+    TestRenderer rend;
+    const u32 kRow = 4 * 4;
+    rend.SetStagedUploadBudget(kRow);
+
+    auto finishedPixels = std::make_shared<std::vector<u8>>(kRow * 10);
+    auto destroyedPixels = std::make_shared<std::vector<u8>>(kRow * 10);
+    auto waitingPixels = std::make_shared<std::vector<u8>>(kRow * 10);
+    std::weak_ptr<std::vector<u8>> destroyedOwner = destroyedPixels;
+    const u8* finished = finishedPixels->data();
+    const u8* destroyed = destroyedPixels->data();
+    const u8* waiting = waitingPixels->data();
+
+    const TextureHandle finishedTexture = rend.CreateTextureStaged(AbstractRenderer::eTextureFormats::eRGBA, 4, 10, AbstractRenderer::eTextureFormats::eRGBA, finished, std::move(finishedPixels), false);
+    const TextureHandle destroyedTexture = rend.CreateTextureStaged(AbstractRenderer::eTextureFormats::eRGBA, 4, 10, AbstractRenderer::eTextureFormats::eRGBA, destroyed, std::move(destroyedPixels), false);
+    const TextureHandle waitingTexture = rend.CreateTextureStaged(AbstractRenderer::eTextureFormats::eRGBA, 4, 10, AbstractRenderer::eTextureFormats::eRGBA, waiting, std::move(waitingPixels), false);
+
+    ASSERT_THAT(rend.Frame(), testing::ElementsAre(TestRowUpload{ finishedTexture.mData, 0, 1, finished }));
+
+    // Needed right now, the rest is copied straight away whatever the budget
+    rend.mRowUploads.clear();
+    rend.FinishStagedUpload(finishedTexture);
+    ASSERT_THAT(rend.mRowUploads, testing::ElementsAre(TestRowUpload{ finishedTexture.mData, 1, 9, finished + kRow }));
+    ASSERT_TRUE(rend.IsStagedUploadDone(finishedTexture));
+
+    // Destroying a texture drops what is left of its copy and lets go of the pixels
+    rend.DestroyTexture(destroyedTexture);
+    ASSERT_TRUE(rend.IsStagedUploadDone(destroyedTexture));
+    ASSERT_TRUE(destroyedOwner.expired());
+
+    ASSERT_THAT(rend.Frame(), testing::ElementsAre(TestRowUpload{ waitingTexture.mData, 0, 1, waiting }));
+}
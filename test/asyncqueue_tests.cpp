@@ -1,5 +1,9 @@
 #include <gmock/gmock.h>
 #include "asyncqueue.hpp"
+#include "jobsystem.hpp"
+#include "workstealingdeque.hpp"
+#include <chrono>
+#include <thread>
 
 class TestJob
 {
@@ -36,3 +40,481 @@ TEST(ASyncQueue, QueueWork)
 
     ASSERT_EQ(TestJob::mNumComplete, 100);
 }
+
+class OrderedJob
+{
+public:
+    OrderedJob(std::vector<int>& order, int id, std::atomic_bool* block = nullptr)
+        : mOrder(&order), mId(id), mBlock(block)
+    {
+
+    }
+
+    void OnExecute(std::atomic_bool&)
+    {
+        while (mBlock && *mBlock) {}
+        mOrder->push_back(mId);
+    }
+
+    void OnFinished()
+    {
+
+    }
+
+private:
+    std::vector<int>* mOrder;
+    int mId;
+    std::atomic_bool* mBlock;
+};
+
+TEST(ASyncQueue, Priorities)
+{
+    std::vector<int> order;
+    std::atomic_bool block{ true };
+
+    ASyncQueue<OrderedJob> q;
+    q.Start(1);
+
+    // Keep the only worker busy while the rest are queued
+    q.Add(OrderedJob(order, 0, &block));
+    while (q.IsIdle()) {}
+
+    q.Add(OrderedJob(order, 1), 2);
+    q.Add(OrderedJob(order, 2), 1);
+    q.Add(OrderedJob(order, 3), 0);
+    q.Add(OrderedJob(order, 4), 2);
+    q.Add(OrderedJob(order, 5), 0);
+    block = false;
+
+    while (!q.IsIdle()) {};
+    q.Update();
+
+    ASSERT_EQ((std::vector<int>{ 0, 3, 5, 2, 1, 4 }), order);
+}
+
+class SpawningJob
+{
+public:
+    SpawningJob(ASyncQueue<SpawningJob>& queue, std::atomic<int>& executed, int children)
+        : mQueue(&queue), mExecuted(&executed), mChildren(children)
+    {
+
+    }
+
+    void OnExecute(std::atomic_bool&)
+    {
+        // Added from a worker, so these go to its own deque for the other workers to steal
+        for (int i = 0; i < mChildren; i++)
+        {
+            mQueue->Add(SpawningJob(*mQueue, *mExecuted, 0), 1);
+        }
+        (*mExecuted)++;
+    }
+
+    void OnFinished()
+    {
+
+    }
+
+private:
+    ASyncQueue<SpawningJob>* mQueue;
+    std::atomic<int>* mExecuted;
+    int mChildren;
+};
+
+TEST(ASyncQueue, ChildItems)
+{
+    std::atomic<int> executed{ 0 };
+
+    ASyncQueue<SpawningJob> q;
+    q.Start(4);
+
+    for (int i = 0; i < 10; i++)
+    {
+        q.Add(SpawningJob(q, executed, 1000));
+    }
+
+    while (!q.IsIdle()) {};
+    q.Update();
+
+    ASSERT_EQ(10 + (10 * 1000), executed);
+}
+
+class TokenJob
+{
+public:
+    explicit TokenJob(std::shared_ptr<int> token)
+        : mToken(std::move(token))
+    {
+
+    }
+
+    void OnExecute(std::atomic_bool&)
+    {
+
+    }
+
+    void OnFinished()
+    {
+
+    }
+
+private:
+    std::shared_ptr<int> mToken;
+};
+
+TEST(ASyncQueue, AddRacingStopDoesNotLeak)
+{
+    for (int run = 0; run < 20; run++)
+    {
+        auto token = std::make_shared<int>(0);
+        {
+            ASyncQueue<TokenJob> q;
+            q.Start(2);
+
+            std::atomic_bool adding{ true };
+            std::vector<std::thread> adders;
+            for (int i = 0; i < 4; i++)
+            {
+                adders.emplace_back([&]()
+                {
+                    while (adding)
+                    {
+                        q.Add(TokenJob(token));
+                    }
+                });
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            q.Stop();
+            adding = false;
+            for (auto& adder : adders)
+            {
+                adder.join();
+            }
+        }
+
+        // Every copy that was queued, run or dropped has been freed with the queue
+        ASSERT_EQ(1, token.use_count());
+    }
+}
+
+TEST(WorkStealingDeque, OwnerIsLifoThievesAreFifo)
+{
+    int items[4] = {};
+    WorkStealingDeque<int> deque(2);
+    ASSERT_EQ(nullptr, deque.Pop());
+    ASSERT_EQ(nullptr, deque.Steal());
+
+    // Grows past the initial capacity
+    for (int& item : items)
+    {
+        deque.Push(&item);
+    }
+
+    ASSERT_EQ(&items[3], deque.Pop());
+    ASSERT_EQ(&items[0], deque.Steal());
+    ASSERT_EQ(&items[2], deque.Pop());
+    ASSERT_EQ(&items[1], deque.Steal());
+    ASSERT_TRUE(deque.Empty());
+    ASSERT_EQ(nullptr, deque.Pop());
+}
+
+TEST(WorkStealingDeque, EveryItemTakenOnce)
+{
+    const int kNumItems = 100000;
+    std::vector<int> items(kNumItems);
+    std::vector<std::atomic<int>> taken(kNumItems);
+    for (auto& count : taken)
+    {
+        count = 0;
+    }
+
+    WorkStealingDeque<int> deque(64);
+    std::atomic_bool done{ false };
+
+    auto take = [&](int* item)
+    {
+        taken[item - items.data()]++;
+    };
+
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < 3; i++)
+    {
+        thieves.emplace_back([&]()
+        {
+            while (!done)
+            {
+                if (int* item = deque.Steal())
+                {
+                    take(item);
+                }
+            }
+        });
+    }
+
+    // The owner keeps popping some of its own items while the thieves steal
+    for (int i = 0; i < kNumItems; i++)
+    {
+        deque.Push(&items[i]);
+        if (i % 3 == 0)
+        {
+            if (int* item = deque.Pop())
+            {
+                take(item);
+            }
+        }
+    }
+
+    while (int* item = deque.Pop())
+    {
+        take(item);
+    }
+
+    done = true;
+    for (auto& thief : thieves)
+    {
+        thief.join();
+    }
+
+    for (int i = 0; i < kNumItems; i++)
+    {
+        ASSERT_EQ(1, taken[i]) << "item " << i;
+    }
+}
+
+// The single locked deque that ASyncQueue used to be, as the baseline for the benchmark
+template<class QueuedItemType>
+class LockedQueue
+{
+public:
+    explicit LockedQueue(s32 numWorkers)
+    {
+        for (s32 i = 0; i < numWorkers; i++)
+        {
+            mWorkers.emplace_back([this]()
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                for (;;)
+                {
+                    mHaveWork.wait(lock, [this]() { return !mQueue.empty() || mQuit; });
+                    if (mQuit)
+                    {
+                        return;
+                    }
+                    QueuedItemType item = std::move(mQueue.front());
+                    mQueue.pop_front();
+                    lock.unlock();
+                    std::atomic_bool stop{ false };
+                    item.OnExecute(stop);
+                    lock.lock();
+                }
+            });
+        }
+    }
+
+    ~LockedQueue()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mQuit = true;
+        }
+        mHaveWork.notify_all();
+        for (auto& worker : mWorkers)
+        {
+            worker.join();
+        }
+    }
+
+    void Add(QueuedItemType item)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mQueue.push_back(std::move(item));
+        }
+        mHaveWork.notify_one();
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mHaveWork;
+    std::deque<QueuedItemType> mQueue;
+    std::vector<std::thread> mWorkers;
+    bool mQuit = false;
+};
+
+class CountingJob
+{
+public:
+    explicit CountingJob(std::atomic<int>& executed)
+        : mExecuted(&executed)
+    {
+
+    }
+
+    void OnExecute(std::atomic_bool&)
+    {
+        (*mExecuted)++;
+    }
+
+    void OnFinished()
+    {
+
+    }
+
+private:
+    std::atomic<int>* mExecuted;
+};
+
+TEST(ASyncQueue, DISABLED_ThroughputBenchmark)
+{
+    const int kNumItems = 1000000;
+    const s32 numWorkers = std::max(static_cast<s32>(std::thread::hardware_concurrency()) - 1, 1);
+
+    auto elapsedMs = [](std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+    };
+
+    // Tiny items added from the main thread
+    std::atomic<int> executed{ 0 };
+    auto start = std::chrono::high_resolution_clock::now();
+    {
+        LockedQueue<CountingJob> q(numWorkers);
+        for (int i = 0; i < kNumItems; i++)
+        {
+            q.Add(CountingJob(executed));
+        }
+        while (executed < kNumItems) {}
+    }
+    const auto lockedMs = elapsedMs(start);
+
+    executed = 0;
+    start = std::chrono::high_resolution_clock::now();
+    {
+        ASyncQueue<CountingJob> q;
+        q.Start(numWorkers);
+        for (int i = 0; i < kNumItems; i++)
+        {
+            q.Add(CountingJob(executed));
+        }
+        while (executed < kNumItems) {}
+        q.Update();
+    }
+    const auto injectedMs = elapsedMs(start);
+
+    // Tiny items added by the workers themselves, the case per worker deques are for
+    std::atomic<int> spawned{ 0 };
+    const int kNumParents = numWorkers * 4;
+    start = std::chrono::high_resolution_clock::now();
+    {
+        ASyncQueue<SpawningJob> q;
+        q.Start(numWorkers);
+        for (int i = 0; i < kNumParents; i++)
+        {
+            q.Add(SpawningJob(q, spawned, kNumItems / kNumParents));
+        }
+        while (!q.IsIdle()) {}
+        q.Update();
+    }
+    const auto spawnedMs = elapsedMs(start);
+
+    LOG_INFO(kNumItems << " items on " << numWorkers << " workers: single locked queue " << lockedMs << "ms, "
+        << "work stealing added from main thread " << injectedMs << "ms, added from workers " << spawnedMs << "ms");
+}
+
+TEST(JobSystem, AsyncFromJobDoesNotStarvePool)
+{
+    JobSystem jobSystem;
+
+    std::atomic<int> callbacks{ 0 };
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 32; i++)
+    {
+        // Each job blocks on another request, which has to run on the same worker
+        results.push_back(jobSystem.Async(JobPriority::eNormal, [&jobSystem, i]()
+        {
+            return jobSystem.Async(JobPriority::eLow, [i]() { return i * 2; }).get() + 1;
+        }, [&callbacks]() { callbacks++; }));
+    }
+
+    for (int i = 0; i < 32; i++)
+    {
+        ASSERT_EQ(i * 2 + 1, results[i].get());
+    }
+
+    // Completion callbacks only happen in Update(), the nested requests don't have any
+    ASSERT_EQ(0, callbacks);
+    while (callbacks < 32)
+    {
+        jobSystem.Update();
+    }
+    jobSystem.Update();
+    ASSERT_EQ(32, callbacks);
+}
+
+TEST(JobSystem, DependenciesExecuteFirst)
+{
+    JobSystem jobSystem;
+
+    std::mutex orderMutex;
+    std::vector<std::string> order;
+    auto stage = [&](const char* name)
+    {
+        return [&, name]()
+        {
+            std::lock_guard<std::mutex> lock(orderMutex);
+            order.push_back(name);
+        };
+    };
+
+    // Diamond: open -> (parse, decode) -> join, with the last stage added once the first has
+    // already executed
+    std::promise<void> opened;
+    SP_IJob open = jobSystem.Then({}, JobPriority::eNormal, [&]() { stage("open")(); opened.set_value(); });
+    SP_IJob parse = jobSystem.Then({ open }, JobPriority::eNormal, stage("parse"));
+    SP_IJob decode = jobSystem.Then({ open }, JobPriority::eLow, stage("decode"));
+    SP_IJob join = jobSystem.Then({ parse, decode }, JobPriority::eHigh, stage("join"));
+    opened.get_future().wait();
+
+    std::promise<void> done;
+    jobSystem.Then({ join, open }, JobPriority::eNormal, [&]() { done.set_value(); });
+    done.get_future().wait();
+
+    ASSERT_EQ(4u, order.size());
+    ASSERT_EQ("open", order[0]);
+    ASSERT_TRUE((order[1] == "parse" && order[2] == "decode") || (order[1] == "decode" && order[2] == "parse"));
+    ASSERT_EQ("join", order[3]);
+}
+
+TEST(JobSystem, ParallelForDoesEveryIndexOnce)
+{
+    JobSystem jobSystem;
+
+    const u32 kCount = 10000;
+    std::vector<std::atomic<int>> done(kCount);
+    for (auto& count : done)
+    {
+        count = 0;
+    }
+
+    // From the main thread and nested inside of a job
+    jobSystem.ParallelFor(JobPriority::eNormal, kCount, 64, [&](u32 i) { done[i]++; });
+    jobSystem.Async(JobPriority::eNormal, [&]()
+    {
+        jobSystem.ParallelFor(JobPriority::eNormal, kCount, 7, [&](u32 i) { done[i]++; });
+    }).get();
+
+    for (u32 i = 0; i < kCount; i++)
+    {
+        ASSERT_EQ(2, done[i]) << "index " << i;
+    }
+
+    ASSERT_THROW(jobSystem.ParallelFor(JobPriority::eNormal, kCount, 16, [&](u32 i)
+    {
+        if (i == kCount / 2)
+        {
+            throw std::runtime_error("Bad frame");
+        }
+    }), std::runtime_error);
+}
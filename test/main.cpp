@@ -1,10 +1,17 @@
 #include <gmock/gmock.h>
 #include <array>
+#include <cstring>
 #include "oddlib/lvlarchive.hpp"
 #include "oddlib/anim.hpp"
+#include "oddlib/simd.hpp"
+#include "oddlib/bits_factory.hpp"
 #include "oddlib/exceptions.hpp"
 #include "cdromfilesystem.hpp"
 #include "logger.hpp"
+#include "filesystem.hpp"
+#include "decodedassetcache.hpp"
+#include "string_util.hpp"
+#include "jobsystem.hpp"
 #include "SDL.h"
 #include "sample.lvl.g.h"
 #include "test.bin.g.h"
@@ -12,6 +19,8 @@
 #include "subtitles.hpp"
 #include "msvc_sdl_link.hpp"
 #include <setjmp.h>
+#include <chrono>
+#include <fstream>
 
 // Don't use SDL main
 #undef main
@@ -87,6 +96,626 @@ TEST(LvlArchive, ReadFiles)
 
 }
 
+TEST(MemoryStream, ClonesAreViews)
+{
+    Oddlib::MemoryStream stream(std::vector<u8>{ 1, 2, 3, 4, 5, 6, 7, 8 });
+    ASSERT_EQ(8u, stream.Size());
+
+    u16 value = 0;
+    stream.Read(value);
+    ASSERT_EQ(0x0201, value);
+    ASSERT_EQ(2u, stream.Pos());
+
+    // Clones start at the beginning and share the same bytes
+    std::unique_ptr<Oddlib::IStream> clone(stream.Clone());
+    ASSERT_EQ(0u, clone->Pos());
+    ASSERT_EQ(8u, clone->Size());
+    ASSERT_EQ(stream.Data(), static_cast<Oddlib::MemoryStream*>(clone.get())->Data());
+
+    // Sub streams are relative to the stream they came from, including other sub streams
+    std::unique_ptr<Oddlib::IStream> sub(stream.Clone(2, 5));
+    ASSERT_EQ(5u, sub->Size());
+    std::unique_ptr<Oddlib::IStream> subSub(sub->Clone(1, 3));
+    std::vector<u8> bytes(3);
+    subSub->Read(bytes);
+    ASSERT_EQ((std::vector<u8>{ 4, 5, 6 }), bytes);
+    ASSERT_TRUE(subSub->AtEnd());
+
+    // Reading or seeking past the end of a view fails rather than running in to the rest of the buffer
+    ASSERT_THROW(subSub->Read(value), Oddlib::Exception);
+    ASSERT_THROW(sub->Seek(6), Oddlib::Exception);
+    ASSERT_THROW(sub->Clone(4, 2), Oddlib::Exception);
+    ASSERT_THROW(stream.Write(value), Oddlib::Exception);
+
+    ASSERT_EQ(std::string("\x03\x04\x05\x06\x07", 5), sub->LoadAllToString());
+}
+
+TEST(LvlArchive, ChunkStreamsFromMemory)
+{
+    Oddlib::LvlArchive lvl(get_sample());
+    auto chunk = lvl.FileByName("HELLO.VH")->ChunkById(0);
+    ASSERT_NE(nullptr, chunk);
+
+    auto stream = chunk->Stream();
+    ASSERT_EQ(chunk->ReadData(), Oddlib::IStream::ReadAll(*stream));
+}
+
+// Palette conversion and expansion are vectorised, every level must give the same frames
+TEST(AnimationSet, simd_frames_match_scalar)
+{
+    Oddlib::LvlArchive lvl(get_sample());
+    const Oddlib::SimdLevel oldLevel = Oddlib::ActiveSimdLevel();
+
+    u32 checked = 0;
+    for (u32 i = 0; i < lvl.FileCount(); i++)
+    {
+        auto file = lvl.FileByIndex(i);
+        for (u32 j = 0; j < file->ChunkCount(); j++)
+        {
+            auto chunk = file->ChunkByIndex(j);
+            if (chunk->Type() != Oddlib::MakeType("Anim"))
+            {
+                continue;
+            }
+
+            std::vector<u8> expected;
+            for (int level = static_cast<int>(Oddlib::SimdLevel::eScalar); level <= static_cast<int>(Oddlib::DetectedSimdLevel()); level++)
+            {
+                Oddlib::SetSimdLevel(static_cast<Oddlib::SimdLevel>(level));
+                auto stream = chunk->Stream();
+                Oddlib::AnimSerializer as(*stream, false);
+                Oddlib::AnimationSet animSet(as);
+
+                std::vector<u8> atlases;
+                for (u32 k = 0; k < animSet.NumberOfAtlases(); k++)
+                {
+                    SDLHelpers::WriteSurface(atlases, animSet.Atlas(k));
+                }
+
+                if (level == static_cast<int>(Oddlib::SimdLevel::eScalar))
+                {
+                    expected = atlases;
+                }
+                ASSERT_EQ(expected, atlases) << file->FileName() << " " << chunk->Id() << " " << Oddlib::SimdLevelName(static_cast<Oddlib::SimdLevel>(level));
+            }
+            checked++;
+        }
+    }
+
+    Oddlib::SetSimdLevel(oldLevel);
+    ASSERT_GT(checked, 0u);
+}
+
+static std::vector<Oddlib::LvlArchive::FileChunk*> AnimChunks(Oddlib::LvlArchive& lvl)
+{
+    std::vector<Oddlib::LvlArchive::FileChunk*> chunks;
+    for (u32 i = 0; i < lvl.FileCount(); i++)
+    {
+        auto file = lvl.FileByIndex(i);
+        for (u32 j = 0; j < file->ChunkCount(); j++)
+        {
+            auto chunk = file->ChunkByIndex(j);
+            if (chunk->Type() == Oddlib::MakeType("Anim"))
+            {
+                chunks.push_back(chunk);
+            }
+        }
+    }
+    return chunks;
+}
+
+// Drawing an indexed atlas through its palette must look the same as drawing the RGBA one
+TEST(AnimationSet, indexed_atlases_expand_to_rgba)
+{
+    Oddlib::LvlArchive lvl(get_sample());
+    const auto chunks = AnimChunks(lvl);
+    ASSERT_FALSE(chunks.empty());
+
+    for (auto chunk : chunks)
+    {
+        auto rgbaStream = chunk->Stream();
+        Oddlib::AnimSerializer rgbaAs(*rgbaStream, false);
+        Oddlib::AnimationSet rgba(rgbaAs);
+
+        auto indexedStream = chunk->Stream();
+        Oddlib::AnimSerializer indexedAs(*indexedStream, false);
+        Oddlib::AnimationSet indexed(indexedAs, nullptr, true);
+
+        ASSERT_FALSE(rgba.IsIndexed());
+        ASSERT_TRUE(indexed.IsIndexed());
+        ASSERT_EQ(rgba.NumberOfAtlases(), indexed.NumberOfAtlases());
+        for (u32 k = 0; k < rgba.NumberOfAtlases(); k++)
+        {
+            const SDL_Surface* expected = rgba.Atlas(k);
+            const SDL_Surface* atlas = indexed.Atlas(k);
+            ASSERT_EQ(8, atlas->format->BitsPerPixel);
+            ASSERT_EQ(expected->h, atlas->h);
+
+            // Indexed pages are widened to a multiple of 4 pixels, the extra columns must be transparent
+            ASSERT_EQ((expected->w + 3) & ~3, atlas->w);
+
+            std::vector<u32> expanded;
+            Oddlib::AnimationSet::ExpandIndexed(atlas, indexed.GetPalette(), expanded);
+            for (int y = 0; y < atlas->h; y++)
+            {
+                const u8* expectedRow = static_cast<const u8*>(expected->pixels) + (y * expected->pitch);
+                const u32* expandedRow = expanded.data() + (y * atlas->w);
+                ASSERT_EQ(0, memcmp(expectedRow, expandedRow, expected->w * sizeof(u32))) << chunk->Id() << " atlas " << k << " row " << y;
+                for (int x = expected->w; x < atlas->w; x++)
+                {
+                    ASSERT_EQ(0u, expandedRow[x]);
+                }
+            }
+        }
+    }
+}
+
+TEST(AnimationSet, indexed_cache_round_trip)
+{
+    Oddlib::LvlArchive lvl(get_sample());
+    const auto chunks = AnimChunks(lvl);
+    ASSERT_FALSE(chunks.empty());
+
+    for (auto chunk : chunks)
+    {
+        auto stream = chunk->Stream();
+        Oddlib::AnimSerializer as(*stream, false);
+        Oddlib::AnimationSet animSet(as, nullptr, true);
+
+        std::vector<u8> cache;
+        animSet.WriteCache(cache);
+
+        std::vector<u8> cacheCopy = cache;
+        Oddlib::MemoryStream cacheStream(std::move(cacheCopy));
+        auto cached = Oddlib::AnimationSet::ReadCache(cacheStream);
+        ASSERT_TRUE(cached->IsIndexed());
+        ASSERT_EQ(animSet.GetPalette(), cached->GetPalette());
+        ASSERT_EQ(animSet.NumberOfAnimations(), cached->NumberOfAnimations());
+
+        // Written again it must be the same bytes, so nothing was lost on the way through
+        std::vector<u8> recached;
+        cached->WriteCache(recached);
+        ASSERT_EQ(cache, recached) << chunk->Id();
+    }
+}
+
+static Oddlib::AnimationSet::ParallelFor JobSystemParallelFor(JobSystem& jobSystem)
+{
+    return [&jobSystem](u32 count, const std::function<void(u32 index)>& func)
+    {
+        jobSystem.ParallelFor(JobPriority::eHigh, count, 1, func);
+    };
+}
+
+// Frames decoded on the workers must land in the same places of the same atlases as when decoded in order
+TEST(AnimationSet, parallel_decode_matches_serial)
+{
+    Oddlib::LvlArchive lvl(get_sample());
+    const auto chunks = AnimChunks(lvl);
+    ASSERT_FALSE(chunks.empty());
+
+    JobSystem jobSystem;
+    for (auto chunk : chunks)
+    {
+        for (bool indexed : { false, true })
+        {
+            auto serialStream = chunk->Stream();
+            Oddlib::AnimSerializer serialAs(*serialStream, false);
+            Oddlib::AnimationSet serial(serialAs, nullptr, indexed);
+
+            auto parallelStream = chunk->Stream();
+            Oddlib::AnimSerializer parallelAs(*parallelStream, false);
+            Oddlib::AnimationSet parallel(parallelAs, JobSystemParallelFor(jobSystem), indexed);
+
+            ASSERT_EQ(serial.NumberOfAtlases(), parallel.NumberOfAtlases());
+            for (u32 k = 0; k < serial.NumberOfAtlases(); k++)
+            {
+                std::vector<u8> expected;
+                SDLHelpers::WriteSurface(expected, serial.Atlas(k));
+                std::vector<u8> actual;
+                SDLHelpers::WriteSurface(actual, parallel.Atlas(k));
+                ASSERT_EQ(expected, actual) << chunk->Id() << " atlas " << k << (indexed ? " indexed" : "");
+            }
+
+            // Covers where each frame was put as well as the pixels
+            std::vector<u8> expectedCache;
+            serial.WriteCache(expectedCache);
+            std::vector<u8> actualCache;
+            parallel.WriteCache(actualCache);
+            ASSERT_EQ(expectedCache, actualCache) << chunk->Id() << (indexed ? " indexed" : "");
+        }
+    }
+    jobSystem.Update();
+}
+
+// Needs a real LVL in the working directory, the sample one is too small to measure
+TEST(AnimationSet, DISABLED_ParallelDecodeBenchmark)
+{
+    Oddlib::LvlArchive lvl("R1.LVL");
+    const auto chunks = AnimChunks(lvl);
+    JobSystem jobSystem;
+
+    const u32 kIterations = 10;
+    u32 sets = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u32 n = 0; n < kIterations; n++)
+    {
+        for (auto chunk : chunks)
+        {
+            auto stream = chunk->Stream();
+            Oddlib::AnimSerializer as(*stream, false);
+            Oddlib::AnimationSet animSet(as);
+            sets++;
+        }
+    }
+    const auto serialUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (u32 n = 0; n < kIterations; n++)
+    {
+        for (auto chunk : chunks)
+        {
+            auto stream = chunk->Stream();
+            Oddlib::AnimSerializer as(*stream, false);
+            Oddlib::AnimationSet animSet(as, JobSystemParallelFor(jobSystem));
+        }
+    }
+    const auto parallelUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+    jobSystem.Update();
+
+    LOG_INFO(sets << " animation sets: serial " << serialUs << "us, parallel " << parallelUs << "us");
+}
+
+TEST(AnimationSet, cache_accepts_empty_frames)
+{
+    Oddlib::LvlArchive lvl(get_sample());
+    auto stream = lvl.FileByName("GRENGLOW.BAN")->ChunkById(0x177a)->Stream();
+    Oddlib::AnimSerializer as(*stream, false);
+    Oddlib::AnimationSet animSet(as);
+
+    std::vector<u8> cache;
+    animSet.WriteCache(cache);
+
+    // Walk to the first frame rect: max w/h, indexed flag, atlases then the frame count, offset and atlas index
+    Oddlib::MemoryStream walker(std::vector<u8>(cache.begin(), cache.end()));
+    u32 value = 0;
+    walker.Read(value);
+    walker.Read(value);
+    walker.Read(value);
+    ASSERT_EQ(0u, value);
+    u32 numAtlases = 0;
+    walker.Read(numAtlases);
+    for (u32 i = 0; i < numAtlases; i++)
+    {
+        SDLHelpers::ReadSurface(walker);
+    }
+    u32 numFrames = 0;
+    walker.Read(numFrames);
+    ASSERT_GT(numFrames, 0u);
+    const size_t rectPos = walker.Pos() + (sizeof(u32) * 2);
+
+    // A frame that decodes to nothing gets a zero sized rect and must survive being cached
+    const s32 zero = 0;
+    memcpy(cache.data() + rectPos + (sizeof(s32) * 2), &zero, sizeof(zero));
+    memcpy(cache.data() + rectPos + (sizeof(s32) * 3), &zero, sizeof(zero));
+
+    Oddlib::MemoryStream cacheStream(std::move(cache));
+    auto cached = Oddlib::AnimationSet::ReadCache(cacheStream);
+    ASSERT_EQ(animSet.NumberOfAnimations(), cached->NumberOfAnimations());
+}
+
+// Writes the cache files in to the working directory, each test deletes what it made
+class DecodedAssetCacheTestFs : public OSBaseFileSystem
+{
+public:
+    virtual std::string FsPath() const override
+    {
+        return ".";
+    }
+
+    virtual std::string ExpandPath(const std::string& path) override
+    {
+        std::string ret = path;
+        string_util::replace_all(ret, "{CacheDir}", ".");
+        return ret;
+    }
+
+    std::vector<std::string> CacheFiles()
+    {
+        return EnumerateFiles(".", "DecodedAssetCacheTest_*.dcache");
+    }
+
+    void DeleteCacheFiles()
+    {
+        for (const std::string& file : CacheFiles())
+        {
+            DeleteFile(file);
+        }
+    }
+
+    std::vector<u8> ReadCacheFile()
+    {
+        std::ifstream in(CacheFiles().at(0), std::ios::binary);
+        return std::vector<u8>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void WriteCacheFile(const std::vector<u8>& data)
+    {
+        std::ofstream out(CacheFiles().at(0), std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+};
+
+static const DecodedAssetCache::Key kTestCacheKey = { "DecodedAssetCacheTest", "R1.LVL", "GRENGLOW.BAN", 0x177a, 6010 };
+
+static std::unique_ptr<Oddlib::AnimationSet> SampleAnimationSet()
+{
+    Oddlib::LvlArchive lvl(get_sample());
+    auto stream = lvl.FileByName("GRENGLOW.BAN")->ChunkById(0x177a)->Stream();
+    Oddlib::AnimSerializer as(*stream, false);
+    return std::make_unique<Oddlib::AnimationSet>(as);
+}
+
+TEST(DecodedAssetCache, AnimationSetRoundTrip)
+{
+    DecodedAssetCacheTestFs fs;
+    fs.DeleteCacheFiles();
+    DecodedAssetCache cache(fs);
+
+    auto animSet = SampleAnimationSet();
+    ASSERT_EQ(nullptr, cache.LoadAnimationSet(kTestCacheKey, false));
+    cache.SaveAnimationSet(kTestCacheKey, *animSet);
+    ASSERT_EQ(1u, fs.CacheFiles().size());
+
+    auto cached = cache.LoadAnimationSet(kTestCacheKey, false);
+    ASSERT_NE(nullptr, cached);
+    ASSERT_EQ(1u, cache.Hits());
+
+    std::vector<u8> expected;
+    animSet->WriteCache(expected);
+    std::vector<u8> actual;
+    cached->WriteCache(actual);
+    ASSERT_EQ(expected, actual);
+
+    // The indexed set is a separate entry, as is anything with another chunk size
+    ASSERT_EQ(nullptr, cache.LoadAnimationSet(kTestCacheKey, true));
+    DecodedAssetCache::Key otherSize = kTestCacheKey;
+    otherSize.mSourceSize++;
+    ASSERT_EQ(nullptr, cache.LoadAnimationSet(otherSize, false));
+
+    fs.DeleteCacheFiles();
+}
+
+TEST(DecodedAssetCache, CameraRoundTrip)
+{
+    DecodedAssetCacheTestFs fs;
+    fs.DeleteCacheFiles();
+    DecodedAssetCache cache(fs);
+
+    // Same formats the camera decoders make, filled with something that isn't all one colour
+    SDL_SurfacePtr camera(SDL_CreateRGBSurface(0, 640, 240, 24, 0x0000FF, 0x00FF00, 0xFF0000, 0));
+    SDL_SurfacePtr fg1(SDL_CreateRGBSurface(0, 640, 240, 32, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000));
+    for (SDL_Surface* surface : { camera.get(), fg1.get() })
+    {
+        u8* pixels = static_cast<u8*>(surface->pixels);
+        for (int i = 0; i < surface->pitch * surface->h; i++)
+        {
+            pixels[i] = static_cast<u8>(i * 31);
+        }
+    }
+    std::vector<u8> expectedCamera;
+    SDLHelpers::WriteSurface(expectedCamera, camera.get());
+    std::vector<u8> expectedFg1;
+    SDLHelpers::WriteSurface(expectedFg1, fg1.get());
+
+    cache.SaveCamera(kTestCacheKey, *Oddlib::MakeBits(std::move(camera), std::move(fg1)));
+    auto cached = cache.LoadCamera(kTestCacheKey);
+    ASSERT_NE(nullptr, cached);
+    ASSERT_NE(nullptr, cached->GetFg1());
+
+    std::vector<u8> actualCamera;
+    SDLHelpers::WriteSurface(actualCamera, cached->GetSurface());
+    ASSERT_EQ(expectedCamera, actualCamera);
+    std::vector<u8> actualFg1;
+    SDLHelpers::WriteSurface(actualFg1, cached->GetFg1()->GetSurface());
+    ASSERT_EQ(expectedFg1, actualFg1);
+
+    fs.DeleteCacheFiles();
+}
+
+// A damaged entry is a miss that gets decoded again, never an exception
+TEST(DecodedAssetCache, DamagedEntriesMiss)
+{
+    DecodedAssetCacheTestFs fs;
+    fs.DeleteCacheFiles();
+    DecodedAssetCache cache(fs);
+
+    auto animSet = SampleAnimationSet();
+    cache.SaveAnimationSet(kTestCacheKey, *animSet);
+    const std::vector<u8> good = fs.ReadCacheFile();
+    ASSERT_GT(good.size(), 64u);
+
+    std::vector<u8> payload;
+    ASSERT_TRUE(cache.Load(DecodedAssetCache::eKind::eAnimationSet, kTestCacheKey, payload));
+    ASSERT_EQ(1u, cache.Hits());
+
+    const auto expectMiss = [&](const std::vector<u8>& data, const char* what)
+    {
+        fs.WriteCacheFile(data);
+        const u32 misses = cache.Misses();
+        std::vector<u8> loaded;
+        ASSERT_NO_THROW(ASSERT_FALSE(cache.Load(DecodedAssetCache::eKind::eAnimationSet, kTestCacheKey, loaded))) << what;
+        ASSERT_EQ(misses + 1, cache.Misses()) << what;
+        ASSERT_NO_THROW(ASSERT_EQ(nullptr, cache.LoadAnimationSet(kTestCacheKey, false))) << what;
+    };
+
+    expectMiss(std::vector<u8>(), "empty");
+    expectMiss(std::vector<u8>(good.begin(), good.begin() + 8), "truncated header");
+    expectMiss(std::vector<u8>(good.begin(), good.end() - 1), "truncated data");
+
+    // Header starts magic, version
+    std::vector<u8> corrupt = good;
+    corrupt[0] ^= 0xFF;
+    expectMiss(corrupt, "corrupt magic");
+
+    std::vector<u8> wrongVersion = good;
+    wrongVersion[sizeof(u32)]++;
+    expectMiss(wrongVersion, "wrong version");
+
+    std::vector<u8> corruptData = good;
+    for (size_t i = corruptData.size() - 16; i < corruptData.size(); i++)
+    {
+        corruptData[i] ^= 0x5A;
+    }
+    expectMiss(corruptData, "corrupt data");
+
+    // And a good entry loads again after all that
+    fs.WriteCacheFile(good);
+    ASSERT_NE(nullptr, cache.LoadAnimationSet(kTestCacheKey, false));
+
+    fs.DeleteCacheFiles();
+}
+
+TEST(LvlArchive, MappedFile)
+{
+    const std::string fileName = "mapped_sample.lvl";
+    {
+        const std::vector<u8> data = get_sample();
+        std::ofstream out(fileName, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+    auto mapped = Oddlib::MapFile(fileName);
+    if (!mapped)
+    {
+        // No mmap on this platform, the file path constructor falls back to reading
+        std::remove(fileName.c_str());
+        return;
+    }
+    ASSERT_EQ(get_sample(), Oddlib::IStream::ReadAll(*mapped));
+
+    auto lvl = std::make_unique<Oddlib::LvlArchive>(std::move(mapped));
+    Oddlib::LvlArchive inMemory(get_sample());
+    const std::vector<u8> expected = inMemory.FileByName("HELLO.VH")->ChunkById(0)->ReadData();
+    auto stream = lvl->FileByName("HELLO.VH")->ChunkById(0)->Stream();
+
+    // Chunk streams point in to the mapping and keep it alive after the archive and file have gone
+    auto memoryStream = dynamic_cast<Oddlib::MemoryStream*>(stream.get());
+    ASSERT_NE(nullptr, memoryStream);
+    lvl.reset();
+    std::remove(fileName.c_str());
+    ASSERT_EQ(expected, Oddlib::IStream::ReadAll(*stream));
+}
+
+// What FileByName/ChunkById/ChunkByType used to do, to check the index against
+static Oddlib::LvlArchive::FileChunk* LinearChunkSearch(Oddlib::LvlArchive::File& file, bool byId, u32 value)
+{
+    for (u32 i = 0; i < file.ChunkCount(); i++)
+    {
+        Oddlib::LvlArchive::FileChunk* chunk = file.ChunkByIndex(i);
+        if ((byId ? chunk->Id() : chunk->Type()) == value)
+        {
+            return chunk;
+        }
+    }
+    return nullptr;
+}
+
+TEST(LvlArchive, IndexedLookups)
+{
+    Oddlib::LvlArchive lvl(get_sample());
+    for (u32 i = 0; i < lvl.FileCount(); i++)
+    {
+        Oddlib::LvlArchive::File* file = lvl.FileByIndex(i);
+        ASSERT_EQ(file, lvl.FileByName(file->FileName()));
+        for (u32 j = 0; j < file->ChunkCount(); j++)
+        {
+            const Oddlib::LvlArchive::FileChunk* chunk = file->ChunkByIndex(j);
+            ASSERT_EQ(LinearChunkSearch(*file, true, chunk->Id()), file->ChunkById(chunk->Id()));
+            ASSERT_EQ(LinearChunkSearch(*file, false, chunk->Type()), file->ChunkByType(chunk->Type()));
+        }
+        ASSERT_EQ(nullptr, file->ChunkById(0xDEADBEEF));
+        ASSERT_EQ(nullptr, file->ChunkByType(Oddlib::MakeType("Nope")));
+    }
+    ASSERT_EQ(nullptr, lvl.FileByName(""));
+    ASSERT_EQ(nullptr, lvl.FileByName("GRENGLOW.BA"));
+}
+
+TEST(HashIndex, CollisionsAndDuplicates)
+{
+    // Everything in the same bucket to force probing, duplicates keep the first value
+    std::vector<u32> keys = { 5, 9, 5, 12, 9, 7 };
+    Oddlib::HashIndex index;
+    index.Reset(static_cast<u32>(keys.size()));
+    for (u32 i = 0; i < keys.size(); i++)
+    {
+        index.Insert(0, i, [&](u32 existing) { return keys[existing] == keys[i]; });
+    }
+
+    auto find = [&](u32 key) { return index.Find(0, [&](u32 i) { return keys[i] == key; }); };
+    ASSERT_EQ(0u, find(5));
+    ASSERT_EQ(1u, find(9));
+    ASSERT_EQ(3u, find(12));
+    ASSERT_EQ(5u, find(7));
+    const u32 notFound = Oddlib::HashIndex::kNotFound;
+    ASSERT_EQ(notFound, find(6));
+
+    Oddlib::HashIndex empty;
+    ASSERT_EQ(notFound, empty.Find(0, [](u32) { return true; }));
+}
+
+// Needs a full AE LVL in the working directory
+TEST(LvlArchive, DISABLED_LookupBenchmark)
+{
+    Oddlib::LvlArchive lvl("R1.LVL");
+
+    const u32 kIterations = 1000;
+    u32 lookups = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u32 n = 0; n < kIterations; n++)
+    {
+        for (u32 i = 0; i < lvl.FileCount(); i++)
+        {
+            Oddlib::LvlArchive::File* file = lvl.FileByName(lvl.FileByIndex(i)->FileName());
+            for (u32 j = 0; j < file->ChunkCount(); j++)
+            {
+                const Oddlib::LvlArchive::FileChunk* chunk = file->ChunkByIndex(j);
+                ASSERT_NE(nullptr, file->ChunkById(chunk->Id()));
+                ASSERT_NE(nullptr, file->ChunkByType(chunk->Type()));
+                lookups += 2;
+            }
+            lookups++;
+        }
+    }
+    const auto indexedUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (u32 n = 0; n < kIterations; n++)
+    {
+        for (u32 i = 0; i < lvl.FileCount(); i++)
+        {
+            const std::string& name = lvl.FileByIndex(i)->FileName();
+            Oddlib::LvlArchive::File* file = nullptr;
+            for (u32 k = 0; k < lvl.FileCount() && !file; k++)
+            {
+                if (lvl.FileByIndex(k)->FileName() == name)
+                {
+                    file = lvl.FileByIndex(k);
+                }
+            }
+            for (u32 j = 0; j < file->ChunkCount(); j++)
+            {
+                const Oddlib::LvlArchive::FileChunk* chunk = file->ChunkByIndex(j);
+                ASSERT_NE(nullptr, LinearChunkSearch(*file, true, chunk->Id()));
+                ASSERT_NE(nullptr, LinearChunkSearch(*file, false, chunk->Type()));
+            }
+        }
+    }
+    const auto linearUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+    LOG_INFO(lookups << " lookups: indexed " << indexedUs << "us, linear scan " << linearUs << "us");
+}
+
 static void IndentTest(int level)
 {
     TRACE_ENTRYEXIT;
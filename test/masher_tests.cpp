@@ -1,5 +1,13 @@
 #include <gmock/gmock.h>
 #include "oddlib/masher.hpp"
+#include "oddlib/mdec_simd.hpp"
+#include "oddlib/pixel_simd.hpp"
+#include "oddlib/simd.hpp"
+#include "logger.hpp"
+#include "jobsystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <random>
 #include "all_colours_high_compression_30_fps.ddv.g.h"
 #include "ddv_test1.ddv.g.h"
 #include "all_colours_low_compression_30_fps.ddv.g.h"
@@ -1814,3 +1822,356 @@ TEST(Masher, Decode16BitStereoAudio)
     memcpy(expected16.data(), kExpected.data(), kExpected.size());
     ASSERT_TRUE(memcmp(expected16.data(), outPtr.data(), outPtr.size()*sizeof(u16)) == 0);
 }
+
+static bool SimdLevelAvailable(Oddlib::SimdLevel level)
+{
+    return static_cast<int>(Oddlib::DetectedSimdLevel()) >= static_cast<int>(level);
+}
+
+TEST(MdecSimd, MasherIdctMatchesScalar)
+{
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<s32> small(-64, 64);
+    std::uniform_int_distribution<s32> full(-32768, 32767);
+    for (u32 i = 0; i < 2000; i++)
+    {
+        // Coefficients in the low half of every 32bit slot, junk in the high half that must be ignored
+        std::array<s16, 128> input = {};
+        for (u32 j = 0; j < 64; j++)
+        {
+            input[j * 2] = static_cast<s16>(i < 1000 ? small(rng) : full(rng));
+            input[j * 2 + 1] = static_cast<s16>(full(rng));
+        }
+
+        std::array<s32, 64> expected = {};
+        Oddlib::Mdec::Scalar::MasherIdct(input.data(), expected.data());
+
+        std::array<s32, 64> actual = {};
+#ifdef ODDLIB_X86_SIMD
+        if (SimdLevelAvailable(Oddlib::SimdLevel::eSse41))
+        {
+            Oddlib::Mdec::Sse41::MasherIdct(input.data(), actual.data());
+            ASSERT_EQ(expected, actual);
+        }
+        if (SimdLevelAvailable(Oddlib::SimdLevel::eAvx2))
+        {
+            Oddlib::Mdec::Avx2::MasherIdct(input.data(), actual.data());
+            ASSERT_EQ(expected, actual);
+        }
+#endif
+        Oddlib::Mdec::MasherIdct(input.data(), actual.data());
+        ASSERT_EQ(expected, actual);
+    }
+}
+
+TEST(MdecSimd, MasherBlitMacroblockMatchesScalar)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<s32> value(-300, 400);
+
+    // Not a multiple of 16 so the right and bottom macroblocks are clipped
+    const s32 width = 40;
+    const s32 height = 24;
+    for (u32 i = 0; i < 200; i++)
+    {
+        std::array<std::array<s32, 64>, 6> blocks;
+        for (auto& block : blocks)
+        {
+            for (s32& v : block)
+            {
+                v = value(rng);
+            }
+        }
+        const s32* const luma[4] = { blocks[2].data(), blocks[3].data(), blocks[4].data(), blocks[5].data() };
+
+        for (s32 yoff = 0; yoff < height; yoff += 16)
+        {
+            for (s32 xoff = 0; xoff < width; xoff += 16)
+            {
+                std::vector<u32> expected(width * height, 0xDEADBEEF);
+                Oddlib::Mdec::Scalar::MasherBlitMacroblock(blocks[0].data(), blocks[1].data(), luma, expected.data(), xoff, yoff, width, height);
+
+                std::vector<u32> actual(width * height, 0xDEADBEEF);
+#ifdef ODDLIB_X86_SIMD
+                if (SimdLevelAvailable(Oddlib::SimdLevel::eSse41))
+                {
+                    Oddlib::Mdec::Sse41::MasherBlitMacroblock(blocks[0].data(), blocks[1].data(), luma, actual.data(), xoff, yoff, width, height);
+                    ASSERT_EQ(expected, actual);
+                }
+                if (SimdLevelAvailable(Oddlib::SimdLevel::eAvx2))
+                {
+                    std::fill(actual.begin(), actual.end(), 0xDEADBEEF);
+                    Oddlib::Mdec::Avx2::MasherBlitMacroblock(blocks[0].data(), blocks[1].data(), luma, actual.data(), xoff, yoff, width, height);
+                    ASSERT_EQ(expected, actual);
+                }
+#endif
+            }
+        }
+    }
+}
+
+TEST(MdecSimd, PsxIdctMatchesScalar)
+{
+    std::mt19937 rng(99);
+    std::uniform_int_distribution<s32> coefficient(-2048, 2047);
+    std::uniform_int_distribution<s32> full(-32768, 32767);
+    std::uniform_int_distribution<u32> sparse(0, 3);
+    for (u32 i = 0; i < 2000; i++)
+    {
+        // Mostly empty like real blocks so the DC only row/column paths get hit too
+        std::array<s16, 64> input = {};
+        for (s16& v : input)
+        {
+            if (sparse(rng) == 0)
+            {
+                v = static_cast<s16>(i < 1000 ? coefficient(rng) : full(rng));
+            }
+        }
+
+        std::array<s16, 64> expected = input;
+        Oddlib::Mdec::Scalar::PsxIdct(expected.data());
+
+#ifdef ODDLIB_X86_SIMD
+        if (SimdLevelAvailable(Oddlib::SimdLevel::eSse41))
+        {
+            std::array<s16, 64> actual = input;
+            Oddlib::Mdec::Sse41::PsxIdct(actual.data());
+            ASSERT_EQ(expected, actual);
+        }
+        if (SimdLevelAvailable(Oddlib::SimdLevel::eAvx2))
+        {
+            std::array<s16, 64> actual = input;
+            Oddlib::Mdec::Avx2::PsxIdct(actual.data());
+            ASSERT_EQ(expected, actual);
+        }
+#endif
+    }
+}
+
+TEST(PixelSimd, Rgb565ToRgb24MatchesScalar)
+{
+    // Every colour, converted from each start offset so that every tail length is hit too
+    std::vector<u16> colours(65536);
+    for (u32 i = 0; i < colours.size(); i++)
+    {
+        colours[i] = static_cast<u16>(i);
+    }
+
+    std::vector<u8> expected(colours.size() * 3);
+    Oddlib::Pixels::Scalar::Rgb565ToRgb24(colours.data(), expected.data(), static_cast<u32>(colours.size()));
+    ASSERT_EQ(255, expected[0xFFFF * 3 + 0]);
+    ASSERT_EQ(255, expected[0xFFFF * 3 + 1]);
+    ASSERT_EQ(255, expected[0xFFFF * 3 + 2]);
+    ASSERT_EQ((13 * 255) / 31, expected[(13 << 11) * 3]);
+
+#ifdef ODDLIB_X86_SIMD
+    for (u32 offset = 0; offset < 33; offset++)
+    {
+        const u32 count = static_cast<u32>(colours.size()) - offset;
+        if (SimdLevelAvailable(Oddlib::SimdLevel::eSse41))
+        {
+            std::vector<u8> actual(count * 3);
+            Oddlib::Pixels::Sse41::Rgb565ToRgb24(colours.data() + offset, actual.data(), count);
+            ASSERT_TRUE(std::equal(actual.begin(), actual.end(), expected.begin() + (offset * 3)));
+        }
+        if (SimdLevelAvailable(Oddlib::SimdLevel::eAvx2))
+        {
+            std::vector<u8> actual(count * 3);
+            Oddlib::Pixels::Avx2::Rgb565ToRgb24(colours.data() + offset, actual.data(), count);
+            ASSERT_TRUE(std::equal(actual.begin(), actual.end(), expected.begin() + (offset * 3)));
+        }
+    }
+#endif
+}
+
+TEST(PixelSimd, Bgr555ToRgbaMatchesScalar)
+{
+    std::vector<u16> colours(65536);
+    for (u32 i = 0; i < colours.size(); i++)
+    {
+        colours[i] = static_cast<u16>(i);
+    }
+
+    std::vector<u32> expected(colours.size());
+    Oddlib::Pixels::Scalar::Bgr555ToRgba(colours.data(), expected.data(), static_cast<u32>(colours.size()));
+    ASSERT_EQ(0x00000000u, expected[0x0000]);
+    ASSERT_EQ(0x0000007Fu, expected[0x8000]);
+    ASSERT_EQ(0xFF0000FFu, expected[0x001F]);
+    ASSERT_EQ(0x0000FF7Fu, expected[0xFC00]);
+
+#ifdef ODDLIB_X86_SIMD
+    for (u32 offset = 0; offset < 17; offset++)
+    {
+        const u32 count = static_cast<u32>(colours.size()) - offset;
+        if (SimdLevelAvailable(Oddlib::SimdLevel::eSse41))
+        {
+            std::vector<u32> actual(count);
+            Oddlib::Pixels::Sse41::Bgr555ToRgba(colours.data() + offset, actual.data(), count);
+            ASSERT_TRUE(std::equal(actual.begin(), actual.end(), expected.begin() + offset));
+        }
+        if (SimdLevelAvailable(Oddlib::SimdLevel::eAvx2))
+        {
+            std::vector<u32> actual(count);
+            Oddlib::Pixels::Avx2::Bgr555ToRgba(colours.data() + offset, actual.data(), count);
+            ASSERT_TRUE(std::equal(actual.begin(), actual.end(), expected.begin() + offset));
+        }
+    }
+#endif
+}
+
+TEST(PixelSimd, ExpandPalette4MatchesScalar)
+{
+    std::mt19937 rng(4);
+    std::uniform_int_distribution<u32> full;
+    std::array<u32, 16> palette;
+    for (u32& colour : palette)
+    {
+        colour = full(rng);
+    }
+
+    std::vector<u8> indices(4096);
+    for (u8& packed : indices)
+    {
+        packed = static_cast<u8>(full(rng));
+    }
+
+    // Odd counts leave the high nibble of the last byte unused
+    for (u32 count = 0; count <= indices.size() * 2; count += (count < 200 ? 1 : 997))
+    {
+        std::vector<u32> expected(count);
+        Oddlib::Pixels::Scalar::ExpandPalette4(indices.data(), expected.data(), count, palette.data());
+        for (u32 i = 0; i < count; i++)
+        {
+            ASSERT_EQ(palette[(indices[i / 2] >> ((i & 1) * 4)) & 0x0F], expected[i]);
+        }
+
+#ifdef ODDLIB_X86_SIMD
+        if (SimdLevelAvailable(Oddlib::SimdLevel::eSse41))
+        {
+            std::vector<u32> actual(count);
+            Oddlib::Pixels::Sse41::ExpandPalette4(indices.data(), actual.data(), count, palette.data());
+            ASSERT_EQ(expected, actual);
+        }
+        if (SimdLevelAvailable(Oddlib::SimdLevel::eAvx2))
+        {
+            std::vector<u32> actual(count);
+            Oddlib::Pixels::Avx2::ExpandPalette4(indices.data(), actual.data(), count, palette.data());
+            ASSERT_EQ(expected, actual);
+        }
+#endif
+    }
+}
+
+// Whole frames must come out the same at every level, also logs how fast each level decodes
+TEST(Masher, simd_frames_match_scalar)
+{
+    const std::vector<u8> ddv = get_all_colours_low_compression_30_fps();
+    const Oddlib::SimdLevel detected = Oddlib::DetectedSimdLevel();
+
+    std::vector<u32> expected;
+    for (int level = 0; level <= static_cast<int>(detected); level++)
+    {
+        Oddlib::SetSimdLevel(static_cast<Oddlib::SimdLevel>(level));
+
+        const u32 kRuns = 100;
+        std::vector<u32> pixelBuffer;
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (u32 i = 0; i < kRuns; i++)
+        {
+            TestMasher masher(std::make_unique<Oddlib::MemoryStream>(std::vector<u8>(ddv)));
+            pixelBuffer.assign(masher.Width() * masher.Height(), 0);
+            while (masher.Update(pixelBuffer.data(), nullptr))
+            {
+
+            }
+        }
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+        LOG_INFO(Oddlib::SimdLevelName(static_cast<Oddlib::SimdLevel>(level)) << ": " << kRuns << " decodes in " << us << "us");
+
+        if (expected.empty())
+        {
+            expected = pixelBuffer;
+        }
+        else
+        {
+            ASSERT_EQ(expected, pixelBuffer);
+        }
+    }
+    Oddlib::SetSimdLevel(detected);
+}
+
+static std::vector<u32> DecodeAllFrames(const std::vector<u8>& ddv, const Oddlib::Masher::ParallelFor& parallelFor)
+{
+    TestMasher masher(std::make_unique<Oddlib::MemoryStream>(std::vector<u8>(ddv)));
+    masher.SetParallelFor(parallelFor);
+
+    // Every frame of the clip, one after the other
+    std::vector<u32> frames;
+    std::vector<u32> pixelBuffer(masher.Width() * masher.Height());
+    while (masher.Update(pixelBuffer.data(), nullptr))
+    {
+        frames.insert(std::end(frames), std::begin(pixelBuffer), std::end(pixelBuffer));
+    }
+    EXPECT_EQ(masher.NumberOfFrames() * pixelBuffer.size(), frames.size());
+    return frames;
+}
+
+static Oddlib::Masher::ParallelFor JobSystemParallelFor(JobSystem& jobSystem)
+{
+    return [&jobSystem](u32 count, const std::function<void(u32)>& func)
+    {
+        jobSystem.ParallelFor(JobPriority::eHigh, count, 1, func);
+    };
+}
+
+// Frames must come out the same no matter how the macroblock columns are spread over threads
+TEST(Masher, threaded_frames_match_serial)
+{
+    const std::vector<u8> ddv = get_all_colours_low_compression_30_fps();
+    const std::vector<u32> expected = DecodeAllFrames(ddv, nullptr);
+    ASSERT_FALSE(expected.empty());
+
+    // Columns don't depend on each other, so any order gives the same frames
+    ASSERT_EQ(expected, DecodeAllFrames(ddv, [](u32 count, const std::function<void(u32)>& func)
+    {
+        for (u32 i = count; i > 0; i--)
+        {
+            func(i - 1);
+        }
+    }));
+
+    JobSystem jobSystem;
+    ASSERT_EQ(expected, DecodeAllFrames(ddv, JobSystemParallelFor(jobSystem)));
+}
+
+// Logs how much faster frames decode when the columns are spread over the JobSystem
+TEST(Masher, DISABLED_ThreadedDecodeBenchmark)
+{
+    const std::vector<u8> ddv = get_all_colours_low_compression_30_fps();
+    JobSystem jobSystem;
+
+    // The clip is short, so it is played over and over until enough frames have been timed that
+    // opening the stream doesn't count
+    const u32 kMinFrames = 3000;
+    const auto benchmark = [&](const char* name, const Oddlib::Masher::ParallelFor& parallelFor)
+    {
+        u32 frameCount = 0;
+        std::vector<u32> pixelBuffer;
+        const auto start = std::chrono::high_resolution_clock::now();
+        while (frameCount < kMinFrames)
+        {
+            TestMasher masher(std::make_unique<Oddlib::MemoryStream>(std::vector<u8>(ddv)));
+            masher.SetParallelFor(parallelFor);
+            pixelBuffer.resize(masher.Width() * masher.Height());
+            while (masher.Update(pixelBuffer.data(), nullptr))
+            {
+                frameCount++;
+            }
+        }
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+        LOG_INFO(name << ": " << frameCount << " frames in " << us << "us, " << (us / frameCount) << "us per frame");
+    };
+
+    benchmark("Serial", nullptr);
+    benchmark("JobSystem", JobSystemParallelFor(jobSystem));
+}
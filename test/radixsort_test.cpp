@@ -0,0 +1,91 @@
+#include <gmock/gmock.h>
+#include "radixsort.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+struct TestSortItem
+{
+    u64 mKey;
+    u32 mPayload;
+};
+
+// Keys shaped like the renderers draw command keys: a handful of layers with the submission
+// index in the low bits
+static std::vector<TestSortItem> MakeDrawCommandKeys(u32 count)
+{
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<u32> layer(0, 8);
+
+    std::vector<TestSortItem> items;
+    items.reserve(count);
+    for (u32 i = 0; i < count; i++)
+    {
+        const u64 key = (static_cast<u64>(1000 + (layer(rng) * 1000)) << 32) | i;
+        items.push_back(TestSortItem{ key, i });
+    }
+    return items;
+}
+
+TEST(RadixSort, MatchesStableSort)
+{
+    std::mt19937_64 rng(42);
+    std::vector<TestSortItem> items;
+    for (u32 i = 0; i < 5000; i++)
+    {
+        // Lots of duplicate keys to check stability
+        items.push_back(TestSortItem{ rng() % 97, i });
+    }
+
+    std::vector<TestSortItem> expected = items;
+    std::stable_sort(expected.begin(), expected.end(), [](const TestSortItem& a, const TestSortItem& b) { return a.mKey < b.mKey; });
+
+    std::vector<TestSortItem> scratch;
+    RadixSortByKey(items, scratch);
+
+    ASSERT_EQ(expected.size(), items.size());
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        ASSERT_EQ(expected[i].mKey, items[i].mKey);
+        ASSERT_EQ(expected[i].mPayload, items[i].mPayload);
+    }
+}
+
+TEST(RadixSort, EmptyAndSingle)
+{
+    std::vector<TestSortItem> items;
+    std::vector<TestSortItem> scratch;
+    RadixSortByKey(items, scratch);
+    ASSERT_TRUE(items.empty());
+
+    items.push_back(TestSortItem{ 7, 1 });
+    RadixSortByKey(items, scratch);
+    ASSERT_EQ(7u, items[0].mKey);
+}
+
+TEST(RadixSort, DISABLED_DrawCommandBenchmark)
+{
+    for (u32 count : { 10000u, 50000u, 100000u })
+    {
+        const std::vector<TestSortItem> input = MakeDrawCommandKeys(count);
+
+        std::vector<TestSortItem> radixSorted = input;
+        std::vector<TestSortItem> scratch;
+        auto start = std::chrono::high_resolution_clock::now();
+        RadixSortByKey(radixSorted, scratch);
+        const auto radixUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::vector<TestSortItem> stableSorted = input;
+        start = std::chrono::high_resolution_clock::now();
+        std::stable_sort(stableSorted.begin(), stableSorted.end(), [](const TestSortItem& a, const TestSortItem& b) { return a.mKey < b.mKey; });
+        const auto stableUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+        LOG_INFO(count << " commands: radix sort " << radixUs << "us, std::stable_sort " << stableUs << "us");
+
+        for (size_t i = 0; i < count; i++)
+        {
+            ASSERT_EQ(stableSorted[i].mPayload, radixSorted[i].mPayload);
+        }
+    }
+}
@@ -5,6 +5,11 @@
 #include "logger.hpp"
 #include "resourcemapper.hpp"
 #include "inmemoryfs.hpp"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <fstream>
+#include <map>
 
 using namespace ::testing;
 
@@ -135,7 +140,7 @@ TEST(ResourceLocator, DISABLED_ResourceGroup)
                 "AoPc", 
                 std::vector<ResourceMapper::AnimFile> 
                 {
-                    ResourceMapper::AnimFile { "SLIGZ.BND", 417, 1 }
+                    ResourceMapper::AnimFile { Symbol("SLIGZ.BND"), 417, 1 }
                 }
             }
         }
@@ -150,13 +155,14 @@ TEST(ResourceLocator, DISABLED_ResourceGroup)
                 "AoPc", 
                 std::vector<ResourceMapper::AnimFile>
                 {
-                    ResourceMapper::AnimFile { "SLIGZ.BND", 417, 1 }
+                    ResourceMapper::AnimFile { Symbol("SLIGZ.BND"), 417, 1 }
                 }
             }
         } 
     });
 
-    ResourceLocator locator(std::move(mapper), std::move(paths));
+    JobSystem jobSystem;
+    ResourceLocator locator(std::move(mapper), std::move(paths), jobSystem);
 
     ResourceCache<Animation> group(locator);
 
@@ -263,16 +269,16 @@ TEST(ResourceLocator, ParseResourceMap)
         ASSERT_EQ(1u, r1->mLocations[1].mFiles.size());
 
         ASSERT_EQ("AoPc", r1->mLocations[0].mDataSetName);
-        ASSERT_EQ("ABEBSIC.BAN", r1->mLocations[0].mFiles[0].mFile);
+        ASSERT_EQ("ABEBSIC.BAN", r1->mLocations[0].mFiles[0].mFile.Str());
         ASSERT_EQ(1u, r1->mLocations[0].mFiles[0].mAnimationIndex);
         ASSERT_EQ(10u, r1->mLocations[0].mFiles[0].mId);
 
-        ASSERT_EQ("ANOTHER.BAN", r1->mLocations[0].mFiles[1].mFile);
+        ASSERT_EQ("ANOTHER.BAN", r1->mLocations[0].mFiles[1].mFile.Str());
         ASSERT_EQ(99u, r1->mLocations[0].mFiles[1].mAnimationIndex);
         ASSERT_EQ(50u, r1->mLocations[0].mFiles[1].mId);
 
         ASSERT_EQ("AoPcDemo", r1->mLocations[1].mDataSetName);
-        ASSERT_EQ("ABEBSIC.BAN", r1->mLocations[1].mFiles[0].mFile);
+        ASSERT_EQ("ABEBSIC.BAN", r1->mLocations[1].mFiles[0].mFile.Str());
         ASSERT_EQ(1u, r1->mLocations[1].mFiles[0].mAnimationIndex);
         ASSERT_EQ(10u, r1->mLocations[1].mFiles[0].mId);
 
@@ -423,7 +429,7 @@ TEST(ResourceLocator, LocateAnimation)
                 "AoPc",
                 std::vector<ResourceMapper::AnimFile>
                 {
-                    ResourceMapper::AnimFile{ "SLIGZ.BND", 417, 1 }
+                    ResourceMapper::AnimFile{ Symbol("SLIGZ.BND"), 417, 1 }
                 }
             }
         }
@@ -439,13 +445,14 @@ TEST(ResourceLocator, LocateAnimation)
                 "AoPc",
                 std::vector<ResourceMapper::AnimFile>
                 {
-                    ResourceMapper::AnimFile{ "SLIGZ.BND", 417, 1 }
+                    ResourceMapper::AnimFile{ Symbol("SLIGZ.BND"), 417, 1 }
                 }
             }
         }
     });
 
-    ResourceLocator locator(std::move(mapper), std::move(paths));
+    JobSystem jobSystem;
+    ResourceLocator locator(std::move(mapper), std::move(paths), jobSystem);
 
     std::unique_ptr<Animation> resMapped1 = locator.LocateAnimation("SLIGZ.BND_417_1").get();
 
@@ -455,6 +462,354 @@ TEST(ResourceLocator, LocateAnimation)
     auto resDirect = locator.LocateAnimation("SLIGZ.BND_417_1", "AePc");
 }
 
+static std::vector<u8> EmptyLvl()
+{
+    // Just a header with the magic and no files
+    std::vector<u8> data(32);
+    data[8] = 'I';
+    data[9] = 'n';
+    data[10] = 'd';
+    data[11] = 'x';
+    return data;
+}
+
+TEST(ResourceCache, ConcurrentLoadsAreShared)
+{
+    ResourceCache cache;
+    std::atomic<u32> loads(0);
+    const ResourceCache::LvlKey s1(Symbol("AePc"), Symbol("S1.LVL"));
+    const ResourceCache::LvlKey r1(Symbol("AePc"), Symbol("R1.LVL"));
+
+    std::vector<std::shared_ptr<Oddlib::LvlArchive>> lvls(8);
+    std::vector<std::thread> threads;
+    for (u32 i = 0; i < lvls.size(); i++)
+    {
+        threads.emplace_back([&, i]()
+        {
+            // Half the threads want each LVL, only the first to ask for each one should load it
+            lvls[i] = cache.GetOrAddLvl(i % 2 ? r1 : s1, [&]()
+            {
+                loads++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                return std::make_unique<Oddlib::LvlArchive>(EmptyLvl());
+            });
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    ASSERT_EQ(2u, loads);
+    ASSERT_NE(lvls[0], lvls[1]);
+    for (u32 i = 2; i < lvls.size(); i++)
+    {
+        ASSERT_EQ(lvls[i % 2], lvls[i]);
+    }
+    ASSERT_EQ(lvls[0], cache.GetLvl(s1));
+
+    // Keys built from the same names separately find the same entry
+    ASSERT_EQ(lvls[1], cache.GetLvl(ResourceCache::LvlKey(Symbol("AePc"), Symbol(std::string("R1.LVL")))));
+
+    // Entries go away with the last reference
+    lvls.clear();
+    ASSERT_EQ(nullptr, cache.GetLvl(s1));
+
+    // A failed load doesn't leave the key stuck as in-flight
+    ASSERT_EQ(nullptr, cache.GetOrAddLvl(s1, []() { return std::unique_ptr<Oddlib::LvlArchive>(); }));
+    ASSERT_NE(nullptr, cache.GetOrAddLvl(s1, []() { return std::make_unique<Oddlib::LvlArchive>(EmptyLvl()); }));
+}
+
+TEST(ResourceCache, ConcurrentLoadsShareFailure)
+{
+    ResourceCache cache;
+    std::atomic<u32> loads(0);
+    std::promise<void> loading;
+    std::promise<void> finishLoad;
+    std::shared_future<void> finishLoadFuture = finishLoad.get_future().share();
+
+    const ResourceCache::AnimSetKey key(ResourceCache::LvlKey(Symbol("AePc"), Symbol("R1.LVL")), Symbol("ABEBSIC.BAN"), 10);
+
+    std::vector<std::shared_ptr<Oddlib::AnimationSet>> sets(8);
+    std::vector<std::thread> threads;
+    for (u32 i = 0; i < sets.size(); i++)
+    {
+        threads.emplace_back([&, i]()
+        {
+            sets[i] = cache.GetOrAddAnimSet(key, [&]()
+            {
+                loads++;
+                loading.set_value();
+                finishLoadFuture.wait();
+                return std::unique_ptr<Oddlib::AnimationSet>();
+            });
+        });
+
+        // The rest are started once the first is inside its load
+        if (i == 0)
+        {
+            loading.get_future().wait();
+        }
+    }
+
+    // Only let the load fail once every other thread has asked for the set and is waiting on it
+    while (cache.GetStats().mCoalesced < sets.size() - 1)
+    {
+        std::this_thread::yield();
+    }
+    finishLoad.set_value();
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // Waiters get the failed result rather than each having a go themselves
+    ASSERT_EQ(1u, loads);
+    for (const auto& set : sets)
+    {
+        ASSERT_EQ(nullptr, set);
+    }
+
+    const ResourceCache::Stats stats = cache.GetStats();
+    ASSERT_EQ(1u, stats.mLoads);
+    ASSERT_EQ(7u, stats.mCoalesced);
+    ASSERT_EQ(0u, stats.mHits);
+}
+
+TEST(ResidencyManager, EvictsLeastRecentlyUsedUnpinned)
+{
+    ResidencyManager residency(300);
+    std::vector<std::weak_ptr<std::string>> objects;
+    const auto add = [&](const char* name)
+    {
+        auto obj = std::make_shared<std::string>(name);
+        objects.push_back(obj);
+        residency.Add(ResidencyManager::Key::Camera(name), obj, 100);
+    };
+
+    // Pins can be taken before anything is loaded
+    residency.Pin(ResidencyManager::Key::Camera("C.CAM"));
+
+    add("A.CAM");
+    add("B.CAM");
+    add("C.CAM");
+
+    // Nothing else is holding on to them
+    for (const auto& obj : objects)
+    {
+        ASSERT_FALSE(obj.expired());
+    }
+
+    // Touch A so B is the oldest, then go over budget
+    ASSERT_EQ("A.CAM", *residency.Find<std::string>(ResidencyManager::Key::Camera("A.CAM")));
+    add("D.CAM");
+    ASSERT_TRUE(objects[1].expired());
+    ASSERT_EQ(nullptr, residency.Find<std::string>(ResidencyManager::Key::Camera("B.CAM")));
+
+    // Pinned entries stay even when they are the oldest
+    add("E.CAM");
+    ASSERT_FALSE(objects[2].expired());
+    ASSERT_TRUE(objects[0].expired());
+
+    // Same name but a different kind of asset is a different key
+    ASSERT_EQ(nullptr, residency.Find<std::string>(ResidencyManager::Key::Path("C.CAM")));
+
+    ResidencyManager::Stats stats = residency.GetStats();
+    ASSERT_EQ(3u, stats.mEntries);
+    ASSERT_EQ(300u, stats.mBytesResident);
+    ASSERT_EQ(100u, stats.mBytesPinned);
+    ASSERT_EQ(2u, stats.mEvictions);
+    ASSERT_EQ(1u, stats.mHits);
+    ASSERT_EQ(2u, stats.mMisses);
+
+    // Once unpinned it is evicted first when the budget shrinks
+    residency.Unpin(ResidencyManager::Key::Camera("C.CAM"));
+    residency.SetBudget(200);
+    ASSERT_TRUE(objects[2].expired());
+    ASSERT_FALSE(objects[3].expired());
+    ASSERT_FALSE(objects[4].expired());
+
+    residency.Clear();
+    stats = residency.GetStats();
+    ASSERT_EQ(0u, stats.mEntries);
+    ASSERT_EQ(0u, stats.mBytesResident);
+    for (const auto& obj : objects)
+    {
+        ASSERT_TRUE(obj.expired());
+    }
+}
+
+TEST(ResourceMapper, Precompiled)
+{
+    const std::string json =
+        R"(
+[{
+    "data_set_name": "AePc",
+    "is_psx": false,
+    "is_ao": false,
+    "scale_frame_offsets": true,
+    "lvls": [{ "name": "R1.LVL", "files": ["ABEBSIC.BAN", "R1P01.BND"] }],
+    "animations": [{
+        "blend_mode": "B100F100",
+        "locations": [{ "dataset": "AePc", "files": [{ "filename": "ABEBSIC.BAN", "id": 10, "index": 1 }] }],
+        "name": "ABEBSIC.BAN_10_AePc_1"
+    }],
+    "paths": [{
+        "collision_offset": 400,
+        "id": 88,
+        "locations": [{ "dataset": "AePc", "file_name": "R1P01.BND" }],
+        "number_of_screens_x": 6,
+        "number_of_screens_y": 8,
+        "object_indextable_offset": 7628,
+        "object_offset": 2460,
+        "resource_name": "R1PATH_1",
+        "music_theme": "RuptureFarms"
+    }],
+    "fmvs": [{ "locations": [{ "dataset": "AePc", "file": "TRAIN2.DDV" }], "name": "TRAIN2_DDV_AePc" }],
+    "sound_resources": [{
+        "resource_name": "ABE_HELLO",
+        "comment": "Hi",
+        "is_cache_resident": true,
+        "sample": { "volume": 100, "min_pitch": 1, "max_pitch": 2, "locations": [{ "program": 3, "tone": 4, "sound_banks": ["MLSNDFX"] }] }
+    }],
+    "sound_banks": [{ "data_set": "AePc", "name": "MLSNDFX", "vab_name": "MLSNDFX.VH", "bsq_name": "MLSNDFX.BSQ" }],
+    "themes": [{ "name": "RuptureFarms", "base": ["R1_BASE"] }]
+}]
+)";
+
+    InMemoryFileSystem fs;
+    fs.AddFile("maps.json", json);
+
+    // Can't write the db to this file system, which is logged but otherwise ignored
+    ResourceMapper parsed(fs, "maps.json", "maps.json", "maps.json", "maps.json", "maps.json", "maps.db");
+    ASSERT_NE(nullptr, parsed.FindAnimation("ABEBSIC.BAN_10_AePc_1"));
+
+    const u32 sourceHash = ResourceMapper::PrecompiledSourceHash(std::vector<std::string>(5, json));
+    const std::vector<u8> db = parsed.SavePrecompiled(sourceHash);
+
+    // Round trips exactly
+    ResourceMapper loaded;
+    ASSERT_TRUE(loaded.LoadPrecompiled(db.data(), db.size(), sourceHash));
+    ASSERT_EQ(db, loaded.SavePrecompiled(sourceHash));
+
+    const ResourceMapper::PathMapping* path = loaded.FindPath("R1PATH_1");
+    ASSERT_NE(nullptr, path);
+    ASSERT_EQ(7628u, path->mIndexTableOffset);
+    ASSERT_EQ("RuptureFarms", path->mMusicTheme);
+    ASSERT_EQ("R1P01.BND", path->mLocations[0].mDataSetFileName);
+
+    const std::vector<ResourceMapper::DataSetFileAttributes>* attributes = loaded.FindFileLocation("AePc", "ABEBSIC.BAN");
+    ASSERT_NE(nullptr, attributes);
+    ASSERT_EQ("R1.LVL", (*attributes)[0].mLvlName.Str());
+    ASSERT_TRUE((*attributes)[0].mScaleFrameOffsets);
+
+    const SoundResource* sound = loaded.FindSound("ABE_HELLO");
+    ASSERT_NE(nullptr, sound);
+    ASSERT_TRUE(sound->mIsCacheResident);
+    ASSERT_EQ(4, sound->mSoundEffect.mSoundBanks[0].mTone);
+    ASSERT_EQ(1u, sound->mSoundEffect.mSoundBanks[0].mSoundBanks.count("MLSNDFX"));
+    ASSERT_NE(nullptr, loaded.FindSoundBank("MLSNDFX"));
+    ASSERT_NE(nullptr, loaded.FindSoundTheme("RuptureFarms")->FindEntry("base"));
+
+    // Stale or partially written dbs are rejected and leave the mapper alone
+    ResourceMapper rejected;
+    ASSERT_FALSE(rejected.LoadPrecompiled(db.data(), db.size(), sourceHash + 1));
+    ASSERT_FALSE(rejected.LoadPrecompiled(db.data(), db.size() - 1, sourceHash));
+    ASSERT_FALSE(rejected.LoadPrecompiled(db.data(), 4, sourceHash));
+    ASSERT_EQ(nullptr, rejected.FindPath("R1PATH_1"));
+
+    // When the db matches the json it is used instead of parsing, which this shows by having
+    // something in the db that isn't in the json
+    loaded.AddAnimMapping("ONLY_IN_DB", ResourceMapper::AnimMapping{ 0, {} });
+    fs.AddFile("maps.db", loaded.SavePrecompiled(sourceHash));
+    ResourceMapper fromDb(fs, "maps.json", "maps.json", "maps.json", "maps.json", "maps.json", "maps.db");
+    ASSERT_NE(nullptr, fromDb.FindAnimation("ONLY_IN_DB"));
+
+    // And ignored once the json changes
+    fs.AddFile("maps.json", json + " ");
+    ResourceMapper reparsed(fs, "maps.json", "maps.json", "maps.json", "maps.json", "maps.json", "maps.db");
+    ASSERT_EQ(nullptr, reparsed.FindAnimation("ONLY_IN_DB"));
+    ASSERT_NE(nullptr, reparsed.FindAnimation("ABEBSIC.BAN_10_AePc_1"));
+}
+
+static bool AddFileFromDisk(InMemoryFileSystem& fs, const std::string& fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+    fs.AddFile(fileName, std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()));
+    return true;
+}
+
+// Uses the real resource maps, run from the repository root
+TEST(ResourceMapper, DISABLED_LookupBenchmark)
+{
+    InMemoryFileSystem fs;
+    for (const char* fileName : { "data/dataset_contents.json", "data/animations.json", "data/sounds.json", "data/paths.json", "data/fmvs.json" })
+    {
+        ASSERT_TRUE(AddFileFromDisk(fs, fileName)) << fileName;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    ResourceMapper mapper(fs, "data/dataset_contents.json", "data/animations.json", "data/sounds.json", "data/paths.json", "data/fmvs.json");
+    const auto parseUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+    const std::vector<u8> db = mapper.SavePrecompiled(0);
+    start = std::chrono::high_resolution_clock::now();
+    ResourceMapper precompiled;
+    ASSERT_TRUE(precompiled.LoadPrecompiled(db.data(), db.size(), 0));
+    const auto loadUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+    LOG_INFO("Resource maps: json parse " << parseUs << "us, precompiled load " << loadUs << "us (" << db.size() << " bytes)");
+
+    // What every lookup was before
+    std::map<std::string, ResourceMapper::AnimMapping> animMaps(mapper.AnimMaps().begin(), mapper.AnimMaps().end());
+    std::vector<std::pair<std::string, std::string>> fileLookups;
+    for (const auto& anim : mapper.AnimMaps())
+    {
+        for (const ResourceMapper::AnimFileLocations& location : anim.second.mLocations)
+        {
+            for (const ResourceMapper::AnimFile& file : location.mFiles)
+            {
+                fileLookups.emplace_back(location.mDataSetName, file.mFile.Str());
+            }
+        }
+    }
+
+    const u32 kIterations = 20;
+    u32 found = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (u32 i = 0; i < kIterations; i++)
+    {
+        for (const auto& anim : animMaps)
+        {
+            found += mapper.FindAnimation(anim.first.c_str()) != nullptr;
+        }
+        for (const auto& lookup : fileLookups)
+        {
+            found += mapper.FindFileLocation(lookup.first.c_str(), lookup.second.c_str()) != nullptr;
+        }
+    }
+    const auto flatUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (u32 i = 0; i < kIterations; i++)
+    {
+        for (const auto& anim : animMaps)
+        {
+            found += animMaps.find(anim.first.c_str()) != std::end(animMaps);
+        }
+    }
+    const auto stdMapUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+    LOG_INFO(kIterations * (animMaps.size() + fileLookups.size()) << " StringMap lookups " << flatUs << "us, "
+        << kIterations * animMaps.size() << " std::map animation lookups " << stdMapUs << "us (" << found << " found)");
+}
+
 TEST(ResourceLocator, LocateAnimationMod)
 {
     // TODO: Like LocateAnimation but with mod override with and without original data
@@ -581,13 +936,14 @@ TEST(ResourceLocator, Construct)
                 "AoPc",
                 std::vector<ResourceMapper::AnimFile>
                 {
-                    ResourceMapper::AnimFile{ "SLIGZ.BND", 417, 1 }
+                    ResourceMapper::AnimFile{ Symbol("SLIGZ.BND"), 417, 1 }
                 }
             }
         }
     });
 
-    ResourceLocator resourceLocator(std::move(mapper), std::move(dataPaths2));
+    JobSystem jobSystem;
+    ResourceLocator resourceLocator(std::move(mapper), std::move(dataPaths2), jobSystem);
     
     // TODO: Handle extra mod dependent data sets
     // Need to merge GD dataset lists so that none "default" data paths appear first
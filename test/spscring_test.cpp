@@ -0,0 +1,66 @@
+#include <gmock/gmock.h>
+#include "spscring.hpp"
+#include "stdthread.h"
+#include "types.hpp"
+
+TEST(SpscRing, PushPopBounded)
+{
+    SpscRing<int> ring(3);
+    ASSERT_TRUE(ring.Empty());
+    ASSERT_TRUE(ring.Push(1));
+    ASSERT_TRUE(ring.Push(2));
+    ASSERT_TRUE(ring.Push(3));
+    ASSERT_TRUE(ring.Full());
+    ASSERT_FALSE(ring.Push(4));
+
+    ASSERT_EQ(1, *ring.Front());
+    ring.Pop();
+
+    int out[3] = {};
+    ASSERT_EQ(2u, ring.Pop(out, 3));
+    ASSERT_EQ(2, out[0]);
+    ASSERT_EQ(3, out[1]);
+    ASSERT_EQ(nullptr, ring.Front());
+}
+
+TEST(SpscRing, ProducerConsumerThreads)
+{
+    const u32 kCount = 10000;
+    SpscRing<u32> ring(64);
+
+    std::thread producer([&]()
+    {
+        u32 next = 0;
+        while (next < kCount)
+        {
+            std::vector<u32> block;
+            for (u32 i = next; i < std::min(next + 10, kCount); i++)
+            {
+                block.push_back(i);
+            }
+            const u32 pushed = static_cast<u32>(ring.Push(block.begin(), block.size()));
+            if (!pushed)
+            {
+                std::this_thread::yield();
+            }
+            next += pushed;
+        }
+    });
+
+    u32 expected = 0;
+    while (expected < kCount)
+    {
+        u32 value = 0;
+        if (ring.Pop(&value, 1))
+        {
+            ASSERT_EQ(expected, value);
+            expected++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    ASSERT_TRUE(ring.Empty());
+}
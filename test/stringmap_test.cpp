@@ -0,0 +1,80 @@
+#include <gmock/gmock.h>
+#include "stringmap.hpp"
+#include "symbol.hpp"
+#include "stdthread.h"
+#include <map>
+
+TEST(StringMap, MatchesStdMap)
+{
+    StringMap<u32> map;
+    std::map<std::string, u32> expected;
+    for (u32 i = 0; i < 5000; i++)
+    {
+        // Plenty of repeats, the first value for a key has to stick
+        const std::string key = "KEY_" + std::to_string((i * 7919) % 1500);
+        const auto added = map.Insert(key, i);
+        const auto expectedAdded = expected.insert(std::make_pair(key, i));
+        ASSERT_EQ(expectedAdded.second, added.second);
+        ASSERT_EQ(expectedAdded.first->second, *added.first);
+    }
+    ASSERT_EQ(expected.size(), map.size());
+
+    for (const auto& item : expected)
+    {
+        ASSERT_EQ(item.second, *map.Find(item.first));
+        ASSERT_EQ(item.second, *map.Find(item.first.c_str()));
+    }
+    ASSERT_EQ(nullptr, map.Find("KEY_"));
+    ASSERT_EQ(nullptr, map.Find(""));
+
+    map.SortByKey();
+    auto it = expected.begin();
+    for (const auto& item : map)
+    {
+        ASSERT_EQ(it->first, item.first);
+        ASSERT_EQ(it->second, item.second);
+        ++it;
+    }
+
+    // Still indexed after sorting
+    map["NEW"] = 5;
+    ASSERT_EQ(5u, *map.Find("NEW"));
+    ASSERT_EQ(expected["KEY_7"], *map.Find("KEY_7"));
+
+    StringMap<u32> empty;
+    ASSERT_EQ(nullptr, empty.Find("KEY_7"));
+}
+
+TEST(Symbol, Interning)
+{
+    std::vector<Symbol> symbols(8);
+    std::vector<std::thread> threads;
+    for (u32 i = 0; i < symbols.size(); i++)
+    {
+        threads.emplace_back([&, i]()
+        {
+            // Grow the pool from several threads at once
+            for (u32 j = 0; j < 1000; j++)
+            {
+                Symbol(std::to_string(j * symbols.size() + i));
+            }
+            symbols[i] = Symbol("R1.LVL");
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (const Symbol& symbol : symbols)
+    {
+        ASSERT_EQ(symbols[0], symbol);
+    }
+    ASSERT_EQ(Symbol(std::string("R1.LVL")), symbols[0]);
+    ASSERT_EQ("R1.LVL", symbols[0].Str());
+    ASSERT_NE(Symbol("R2.LVL"), symbols[0]);
+    ASSERT_TRUE(Symbol() == Symbol(""));
+    ASSERT_TRUE(Symbol("A") < Symbol("B"));
+    ASSERT_FALSE(Symbol("B") < Symbol("A"));
+}
@@ -0,0 +1,103 @@
+#include <gmock/gmock.h>
+#include "world.hpp"
+#include "gridmap.hpp"
+#include "jobsystem.hpp"
+#include "inmemoryfs.hpp"
+#include "fmv.hpp"
+
+class NullAudioController : public IAudioController
+{
+public:
+    virtual void AddPlayer(IAudioPlayer* /*player*/) override { }
+    virtual void RemovePlayer(IAudioPlayer* /*player*/) override { }
+    virtual u16 AudioFrameSize() const override { return 0; }
+    virtual u32 SampleRate() const override { return 0; }
+    virtual void SetExclusiveAudioPlayer(IAudioPlayer* /*player*/) override { }
+};
+
+static std::string TestCameraName(s32 x, s32 y)
+{
+    return "C" + std::to_string(x) + "_" + std::to_string(y);
+}
+
+TEST(WorldState, SetActiveScreenPrefetchSelection)
+{
+    // None of the cameras exist, so the requests finish straight away but the futures are kept by
+    // the screens until something takes the result
+    JobSystem jobSystem;
+    InMemoryFileSystem fs;
+    ResourceLocator locator(ResourceMapper(), DataPaths(fs, "datasetids.json", "datasets.json"), jobSystem);
+    NullAudioController audioController;
+    WorldState worldState(audioController, locator);
+
+    const s32 kMapSize = 5;
+    worldState.mScreens.resize(kMapSize);
+    for (s32 x = 0; x < kMapSize; x++)
+    {
+        for (s32 y = 0; y < kMapSize; y++)
+        {
+            // Blank names are screens with no camera, those are never asked for
+            const std::string name = (x == 1 && y == 0) ? "        " : TestCameraName(x, y);
+            worldState.mScreens[x].push_back(std::make_unique<GridScreen>(Oddlib::Path::Camera(name), locator));
+        }
+    }
+
+    auto screen = [&](s32 x, s32 y) -> const GridScreen&
+    {
+        return *worldState.mScreens[x][y];
+    };
+
+    auto isPinned = [&](s32 x, s32 y)
+    {
+        return locator.Residency().IsPinned(ResidencyManager::Key::Camera(TestCameraName(x, y)));
+    };
+
+    // The screen that is entered and the 8 around it
+    worldState.SetActiveScreen(1, 1);
+    for (s32 x = 0; x < kMapSize; x++)
+    {
+        for (s32 y = 0; y < kMapSize; y++)
+        {
+            const bool around = x <= 2 && y <= 2 && !(x == 1 && y == 0);
+            ASSERT_EQ(around, screen(x, y).IsPrefetching()) << x << "," << y;
+            ASSERT_EQ(around, isPinned(x, y)) << x << "," << y;
+        }
+    }
+    ASSERT_EQ(JobPriority::eHigh, screen(1, 1).PrefetchPriority());
+    ASSERT_EQ(JobPriority::eNormal, screen(0, 0).PrefetchPriority());
+    ASSERT_EQ(JobPriority::eNormal, screen(2, 1).PrefetchPriority());
+
+    // Moving right: the neighbour that is entered is wanted now, the new column comes in behind it
+    // and the screen after next is fetched in the background
+    worldState.SetActiveScreen(2, 1);
+    ASSERT_EQ(JobPriority::eHigh, screen(2, 1).PrefetchPriority());
+    ASSERT_EQ(JobPriority::eHigh, screen(1, 1).PrefetchPriority());
+    for (s32 y = 0; y <= 2; y++)
+    {
+        ASSERT_TRUE(screen(3, y).IsPrefetching()) << y;
+        ASSERT_EQ(JobPriority::eNormal, screen(3, y).PrefetchPriority()) << y;
+        ASSERT_TRUE(isPinned(3, y)) << y;
+
+        // Left behind, no longer kept resident
+        ASSERT_FALSE(isPinned(0, y)) << y;
+    }
+    ASSERT_TRUE(screen(4, 1).IsPrefetching());
+    ASSERT_EQ(JobPriority::eLow, screen(4, 1).PrefetchPriority());
+    ASSERT_FALSE(isPinned(4, 1));
+    ASSERT_FALSE(screen(4, 0).IsPrefetching());
+    ASSERT_FALSE(screen(4, 2).IsPrefetching());
+    ASSERT_FALSE(screen(2, 3).IsPrefetching());
+
+    // Nothing changes when the screen is the same
+    worldState.SetActiveScreen(2, 1);
+    ASSERT_EQ(JobPriority::eLow, screen(4, 1).PrefetchPriority());
+
+    // Entering the background screen promotes it too
+    worldState.SetActiveScreen(3, 1);
+    ASSERT_EQ(JobPriority::eNormal, screen(4, 1).PrefetchPriority());
+    worldState.SetActiveScreen(4, 1);
+    ASSERT_EQ(JobPriority::eHigh, screen(4, 1).PrefetchPriority());
+
+    worldState.ClearActiveScreen();
+    ASSERT_FALSE(isPinned(4, 1));
+}